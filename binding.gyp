@@ -5,7 +5,21 @@
       'sources': [
         'src/ndbus.cc',
         'src/ndbus-utils.cc',
-        'src/ndbus-connection-setup.cc'
+        'src/ndbus-connection-setup.cc',
+        'src/ndbus-names.cc',
+        'src/ndbus-fd.cc',
+        'src/ndbus-batch.cc',
+        'src/ndbus-template.cc',
+        'src/ndbus-string.cc',
+        'src/ndbus-raw.cc',
+        'src/ndbus-codec.cc',
+        'src/ndbus-introspect.cc',
+        'src/ndbus-properties.cc',
+        'src/ndbus-objects.cc',
+        'src/ndbus-cancel.cc',
+        'src/ndbus-reconnect.cc',
+        'src/ndbus-metrics.cc',
+        'src/ndbus-trace.cc'
       ],
       'libraries': [
         '<!@(pkg-config glib-2.0 --libs)',
@@ -15,6 +15,7 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 */
 
 var events = require('events'),
+    fs = require('fs'),
     binding = require('./build/Release/ndbus'),
     prop;
 
@@ -30,6 +31,382 @@ if (!Array.isArray) {
   });
 }
 
+function abortError () {
+  var error = new Error('The operation was aborted');
+  error.name = 'AbortError';
+  error.code = 'ABORT_ERR';
+  return error;
+}
+
+function isAbortSignal (obj) {
+  return obj !== null && typeof obj === 'object' &&
+         typeof obj.aborted === 'boolean' &&
+         typeof obj.addEventListener === 'function';
+}
+
+//an AbortSignal given after the arguments of a call
+function popAbortSignal (args) {
+  return args.length && isAbortSignal(args[args.length - 1]) ? args.pop() : null;
+}
+
+/*
+ * Cancels the call id when signal aborts, and then calls reject with an
+ * AbortError. Returns a function which stops watching.
+ */
+function watchAbort (signal, id, reject) {
+  var abort = function () {
+    signal.removeEventListener('abort', abort);
+    if (binding.cancelCall(id)) {
+      reject(abortError());
+    }
+  };
+  if (!signal || !id) {
+    return function () {};
+  }
+  signal.addEventListener('abort', abort);
+  return function () {
+    signal.removeEventListener('abort', abort);
+  };
+}
+
+/*
+ * A Promise of the reply to the call which make(callback) makes on the
+ * connection of msg and returns the id of, which signal may abort. While
+ * connect() is on its way the call waits for it, and if signal aborts
+ * meanwhile it is never made. A reply handed over before make() has
+ * returned, as one from the cache of a prepared call is, settles the
+ * Promise on the next tick rather than inside the binding.
+ */
+function abortableCall (signal, msg, make) {
+  return new Promise(function (resolve, reject) {
+    var unwatch = null,
+        settled = false,
+        starting = false;
+    if (signal && signal.aborted) {
+      throw abortError();
+    }
+    function settle (error, result) {
+      if (error) {
+        reject(error);
+      } else {
+        resolve(result);
+      }
+    }
+    function callback (error, result) {
+      settled = true;
+      if (unwatch) {
+        unwatch();
+      }
+      if (starting) {
+        process.nextTick(settle, error, result);
+      } else {
+        settle(error, result);
+      }
+    }
+    function run () {
+      var id;
+      if (settled) {
+        return 0;
+      }
+      if (unwatch) {
+        unwatch();
+        unwatch = null;
+      }
+      starting = true;
+      try {
+        id = make(callback);
+      } finally {
+        starting = false;
+      }
+      if (!settled) {
+        unwatch = watchAbort(signal, id, reject);
+      }
+      return id;
+    }
+    if (!queueWhileConnecting(msg, run, callback)) {
+      run();
+    } else if (signal) {
+      var abort = function () {
+        callback(abortError());
+      };
+      signal.addEventListener('abort', abort);
+      unwatch = function () {
+        signal.removeEventListener('abort', abort);
+      };
+    }
+  });
+}
+
+//the connect() still on its way per bus, with what waits on it
+var connecting = {};
+
+function connectionKey (msg) {
+  return msg.bus + (msg.address ? ' ' + msg.address : '');
+}
+
+/*
+ * Queues op, or fail with the error, for when the connect() of the bus
+ * of msg is done. Returns false if there is none on its way.
+ */
+function queueWhileConnecting (msg, op, fail) {
+  var pending = connecting[connectionKey(msg)];
+  if (!pending) {
+    return false;
+  }
+  pending.queue.push({op: op, fail: fail});
+  return true;
+}
+
+/*
+ * Runs op on the connection of msg, opening it as init always did if
+ * need be, unless connect() is still at it. Returns what op returned,
+ * or true if it got queued.
+ */
+function whenConnected (msg, op, fail) {
+  if (queueWhileConnecting(msg, op, fail)) {
+    return true;
+  }
+  binding.init.call(msg);
+  return op();
+}
+
+/*
+ * Wraps op to run with the arguments msg has now, which may have been
+ * cleared or replaced by the time a queued op runs.
+ */
+function withCurrentArgs (msg, op) {
+  var signature = msg._signature,
+      inputArgs = msg._inputArgs.slice();
+  return function () {
+    var signatureThen = msg._signature,
+        inputArgsThen = msg._inputArgs;
+    msg._signature = signature;
+    msg._inputArgs = inputArgs;
+    try {
+      return op();
+    } finally {
+      msg._signature = signatureThen;
+      msg._inputArgs = inputArgsThen;
+    }
+  };
+}
+
+var PreparedMessage = Object.create(Object.prototype, {
+  message: {
+    value: null
+  },
+  id: {
+    value: 0
+  },
+  emit: {
+    value: function (/*arg1, arg2...*/) {
+      var self = this,
+          args = Array.prototype.slice.call(arguments),
+          emit = function () {
+            return binding.emitPrepared.call(self.message, self.id, args);
+          },
+          fail = function (e) {
+            self.message.emit('error', e);
+          };
+      try {
+        return queueWhileConnecting(this.message, emit, fail) || emit();
+      } catch (e) {
+        fail(e);
+      }
+      return false;
+    }
+  },
+  call: {
+    value: function (/*arg1, arg2..., [signal]*/) {
+      var self = this,
+          args = Array.prototype.slice.call(arguments),
+          signal = popAbortSignal(args);
+      return abortableCall(signal, this.message, function (callback) {
+        return binding.callPrepared.call(self.message, self.id, args, callback);
+      });
+    }
+  },
+  stats: {
+    value: function () {
+      return binding.getPreparedStats(this.id);
+    }
+  },
+  release: {
+    value: function () {
+      binding.releasePrepared(this.id);
+    }
+  }
+});
+
+var PropertyMirror = Object.create(events.EventEmitter.prototype, {
+  id: {
+    value: 0,
+    writable: true
+  },
+  destination: {
+    value: null
+  },
+  path: {
+    value: null
+  },
+  iface: {
+    value: null
+  },
+  get: {
+    value: function (name) {
+      return binding.getMirroredProperty(this.id, name);
+    }
+  },
+  getAll: {
+    value: function () {
+      return binding.getMirroredProperties(this.id);
+    }
+  },
+  release: {
+    value: function () {
+      binding.releaseMirror(this.id);
+    }
+  }
+});
+
+var ObjectMirror = Object.create(events.EventEmitter.prototype, {
+  id: {
+    value: 0,
+    writable: true
+  },
+  destination: {
+    value: null
+  },
+  path: {
+    value: null
+  },
+  get: {
+    value: function (path) {
+      return binding.getManagedObject(this.id, path);
+    }
+  },
+  getAll: {
+    value: function (prefix) {
+      return binding.getManagedObjects(this.id, prefix);
+    }
+  },
+  paths: {
+    value: function (prefix) {
+      return binding.getManagedPaths(this.id, prefix);
+    }
+  },
+  release: {
+    value: function () {
+      binding.releaseObjectMirror(this.id);
+    }
+  }
+});
+
+var ObjectProxy = Object.create(Object.prototype, {
+  message: {
+    value: null
+  },
+  destination: {
+    value: null
+  },
+  path: {
+    value: null
+  },
+  owner: {
+    value: null
+  },
+  description: {
+    value: null
+  },
+  _prepared: {
+    value: null
+  },
+  on: {
+    value: function (iface, member, listener) {
+      var signals = (this.description.interfaces[iface] || {}).signals || {},
+          message = this.message,
+          watcher;
+      if (!signals.hasOwnProperty(member)) {
+        throw {name: binding.constants.DBUS_ERROR_INVALID_ARGS,
+        message: 'No such signal ' + iface + '.' + member};
+      }
+      watcher = Object.create(message, {
+        type: {value: binding.constants.DBUS_MESSAGE_TYPE_SIGNAL},
+        sender: {value: this.destination},
+        path: {value: this.path},
+        iface: {value: iface},
+        member: {value: member},
+        decodeFlags: {value: message.decodeFlags | binding.constants.NDBUS_DECODE_CODEC}
+      });
+      events.EventEmitter.call(watcher);
+      watcher.on('signalReceipt', function (signal) {
+        listener.apply(signal, Array.prototype.slice.call(arguments, 1));
+      });
+      watcher.on('error', function (e) {
+        message.emit('error', e);
+      });
+      watcher.addMatch();
+      return watcher;
+    }
+  },
+  release: {
+    value: function () {
+      this._prepared.forEach(function (id) {
+        binding.releasePrepared(id);
+      });
+      this._prepared.length = 0;
+    }
+  }
+});
+
+function createProxy (message, destination, path, owner, description) {
+  var caller = Object.create(message, {
+        type: {value: binding.constants.DBUS_MESSAGE_TYPE_METHOD_CALL}
+      }),
+      proxy = Object.create(ObjectProxy, {
+        message: {value: message},
+        destination: {value: destination},
+        path: {value: path},
+        owner: {value: owner},
+        description: {value: description},
+        _prepared: {value: []}
+      }),
+      iface, methods, member, id;
+
+  function method (id) {
+    var args = Array.prototype.slice.call(arguments, 1),
+        signal = popAbortSignal(args);
+    return abortableCall(signal, caller, function (callback) {
+      return binding.callPrepared.call(caller, id, args, callback);
+    });
+  }
+
+  try {
+    for (iface in description.interfaces) {
+      methods = description.interfaces[iface].methods || {};
+      proxy[iface] = {};
+      for (member in methods) {
+        id = binding.prepare.call(caller, {
+          destination: destination,
+          path: path,
+          iface: iface,
+          member: member,
+          signature: methods[member].signature,
+          replySignature: methods[member].replySignature,
+          codec: true,
+          decodeFlags: message.decodeFlags | binding.constants.NDBUS_DECODE_CODEC
+        });
+        proxy._prepared.push(id);
+        proxy[iface][member] = method.bind(null, id);
+      }
+    }
+  } catch (e) {
+    proxy.release();
+    throw e;
+  }
+  return proxy;
+}
+
 exports.DBusMessage = Object.create(events.EventEmitter.prototype, {
   _inputArgs: {
     value: [],
@@ -69,10 +446,64 @@ exports.DBusMessage = Object.create(events.EventEmitter.prototype, {
   variantPolicy: {
     value: binding.constants.NDBUS_VARIANT_POLICY_DEFAULT
   },
+  decodeFlags: {
+    value: binding.constants.NDBUS_DECODE_DEFAULT
+  },
+  codec: {
+    value: false
+  },
+  signal: {
+    value: null
+  },
+  connect: {
+    value: function () {
+      var self = this,
+          key = connectionKey(this),
+          pending = connecting[key];
+      if (pending) {
+        return pending.promise;
+      }
+      if (this.bus === binding.constants.NDBUS_BUS_PEER) {
+        return new Promise(function (resolve) {
+          binding.init.call(self);
+          resolve();
+        });
+      }
+      pending = {queue: []};
+      pending.promise = new Promise(function (resolve, reject) {
+        var ready = binding.connect.call(self, function (error) {
+          delete connecting[key];
+          pending.queue.forEach(function (entry) {
+            try {
+              if (error) {
+                entry.fail(error);
+              } else {
+                entry.op();
+              }
+            } catch (e) {
+              entry.fail(e);
+            }
+          });
+          if (error) {
+            reject(error);
+          } else {
+            resolve();
+          }
+        });
+        if (ready) {
+          resolve();
+        } else {
+          connecting[key] = pending;
+        }
+      });
+      return pending.promise;
+    }
+  },
   closeConnection: {
     value: function () {
-      var msgBus = this.bus;
-      process.nextTick(function(){binding.deinit(msgBus);});
+      var msgBus = this.bus,
+          msgAddress = this.address;
+      process.nextTick(function(){binding.deinit(msgBus, msgAddress);});
     }
   },
   appendArgs: {
@@ -99,8 +530,7 @@ exports.DBusMessage = Object.create(events.EventEmitter.prototype, {
           throw {name: binding.constants.DBUS_ERROR_FAILED,
           message: 'Cannot add match rule. Message type must be a signal'};
         }
-        binding.init.call(this);
-        binding.addMatch.call(this);
+        whenConnected(this, binding.addMatch.bind(this), this.emit.bind(this, 'error'));
       } catch (e) {
         this.emit('error', e);
       }
@@ -113,32 +543,363 @@ exports.DBusMessage = Object.create(events.EventEmitter.prototype, {
           throw {name: binding.constants.DBUS_ERROR_FAILED,
           message: 'Cannot remove match. Message type must be a signal'};
         }
-        binding.removeMatch.call(this);
+        if (!queueWhileConnecting(this, binding.removeMatch.bind(this),
+                                  this.emit.bind(this, 'error'))) {
+          binding.removeMatch.call(this);
+        }
       } catch (e) {
         this.emit('error', e);
       }
     }
   },
+  requestName: {
+    value: function (name, flags) {
+      var self = this;
+      return new Promise(function (resolve, reject) {
+        whenConnected(self, function () {
+          binding.requestName.call(self, name, flags || 0, function (error, reply) {
+            if (error) {
+              reject(error);
+            } else {
+              resolve(reply);
+            }
+          });
+        }, reject);
+      });
+    }
+  },
+  releaseName: {
+    value: function (name) {
+      var self = this;
+      return new Promise(function (resolve, reject) {
+        whenConnected(self, function () {
+          binding.releaseName.call(self, name, function (error, reply) {
+            if (error) {
+              reject(error);
+            } else {
+              resolve(reply);
+            }
+          });
+        }, reject);
+      });
+    }
+  },
+  hasName: {
+    value: function (name) {
+      return binding.hasName.call(this, name);
+    }
+  },
+  getNameOwner: {
+    value: function (name) {
+      var self = this;
+      return new Promise(function (resolve, reject) {
+        whenConnected(self, function () {
+          binding.getNameOwner.call(self, name, function (error, owner) {
+            if (error) {
+              reject(error);
+            } else {
+              resolve(owner);
+            }
+          });
+        }, reject);
+      });
+    }
+  },
   send: {
     value: function () {
+      var self = this,
+          fail = this.emit.bind(this, 'error'),
+          send = function () {
+            var call = {},
+                writable;
+            if (self.type === binding.constants.DBUS_MESSAGE_TYPE_SIGNAL) {
+              return binding.sendSignal.call(self);
+            }
+            if (self.signal && self.signal.aborted) {
+              throw abortError();
+            }
+            writable = binding.invokeMethod.call(self, call);
+            if (self.signal) {
+              watchAbort(self.signal, call.id, fail);
+            }
+            return writable;
+          };
       try {
         if (!this.type) {
           throw {name: binding.constants.DBUS_ERROR_FAILED,
           message: 'Invalid message type'};
         }
+        if (connecting[connectionKey(this)]) {
+          return queueWhileConnecting(this, withCurrentArgs(this, send), fail);
+        }
         binding.init.call(this);
-        if (this.type === binding.constants.DBUS_MESSAGE_TYPE_SIGNAL) {
-          binding.sendSignal.call(this);
-        } else {
-          binding.invokeMethod.call(this);
+        return send();
+      } catch (e) {
+        this.emit('error', e);
+      }
+      return false;
+    }
+  },
+  sendBatch: {
+    value: function (entries) {
+      try {
+        return whenConnected(this, binding.sendBatch.bind(this, entries),
+                             this.emit.bind(this, 'error'));
+      } catch (e) {
+        this.emit('error', e);
+      }
+      return false;
+    }
+  },
+  callBatch: {
+    value: function (entries, signal) {
+      var self = this,
+          settlers = [],
+          promises = [],
+          callbacks = [],
+          len = Array.isArray(entries) ? entries.length : 0,
+          i = 0,
+          ids;
+      for (; i<len; i++) {
+        promises.push(new Promise(function (resolve, reject) {
+          settlers.push({resolve: resolve, reject: reject});
+        }));
+        callbacks.push(function (settler, error, args) {
+          if (settler.unwatch) {
+            settler.unwatch();
+          }
+          if (error) {
+            settler.reject(error);
+          } else {
+            settler.resolve(args);
+          }
+        }.bind(null, settlers[i]));
+      }
+      function fail (e) {
+        settlers.forEach(function (settler) {
+          settler.reject(e);
+        });
+      }
+      try {
+        if (signal && signal.aborted) {
+          throw abortError();
+        }
+        whenConnected(this, function () {
+          //aborted while connect() was on its way
+          if (signal && signal.aborted) {
+            throw abortError();
+          }
+          ids = binding.callBatch.call(self, entries, callbacks);
+          for (i = 0; signal && i<len; i++) {
+            settlers[i].unwatch = watchAbort(signal, ids[i], settlers[i].reject);
+          }
+        }, fail);
+      } catch (e) {
+        fail(e);
+      }
+      return promises;
+    }
+  },
+  proxy: {
+    value: function (destination, path) {
+      var self = this,
+          peer = this.bus === binding.constants.NDBUS_BUS_PEER;
+      return (peer ? Promise.resolve(null) : this.getNameOwner(destination))
+        .then(function (owner) {
+          return new Promise(function (resolve, reject) {
+            whenConnected(self, function () {
+              binding.introspect.call(self, peer ? null : owner || destination, path,
+                                      function (error, description) {
+                if (error) {
+                  reject(error);
+                } else {
+                  resolve(createProxy(self, destination, path, owner, description));
+                }
+              });
+            }, reject);
+          });
+        });
+    }
+  },
+  mirrorProperties: {
+    value: function (destination, path, iface) {
+      var self = this,
+          mirror = Object.create(PropertyMirror, {
+            destination: {value: destination},
+            path: {value: path},
+            iface: {value: iface}
+          });
+      events.EventEmitter.call(mirror);
+      return new Promise(function (resolve, reject) {
+        whenConnected(self, function () {
+          mirror.id = binding.mirrorProperties.call(self, mirror, destination, path, iface,
+                                                    function (error) {
+            if (error) {
+              reject(error);
+            } else {
+              resolve(mirror);
+            }
+          });
+        }, reject);
+      });
+    }
+  },
+  mirrorObjects: {
+    value: function (destination, path) {
+      var self = this,
+          mirror = Object.create(ObjectMirror, {
+            destination: {value: destination},
+            path: {value: path}
+          });
+      events.EventEmitter.call(mirror);
+      return new Promise(function (resolve, reject) {
+        whenConnected(self, function () {
+          mirror.id = binding.mirrorObjects.call(self, mirror, destination, path,
+                                                 function (error) {
+            if (error) {
+              reject(error);
+            } else {
+              resolve(mirror);
+            }
+          });
+        }, reject);
+      });
+    }
+  },
+  prepare: {
+    value: function (spec) {
+      try {
+        //a prepared message needs no connection until it is sent
+        if (!connecting[connectionKey(this)]) {
+          binding.init.call(this);
         }
+        return Object.create(PreparedMessage, {
+          message: {value: this},
+          id: {value: binding.prepare.call(this, spec)}
+        });
+      } catch (e) {
+        this.emit('error', e);
+      }
+      return null;
+    }
+  },
+  setLimits: {
+    value: function (limits) {
+      try {
+        whenConnected(this, binding.setLimits.bind(this, limits),
+                      this.emit.bind(this, 'error'));
       } catch (e) {
         this.emit('error', e);
       }
     }
+  },
+  setReconnect: {
+    value: function (options) {
+      try {
+        if (!connecting[connectionKey(this)]) {
+          binding.init.call(this);
+        }
+        binding.setReconnect.call(this, options);
+      } catch (e) {
+        this.emit('error', e);
+      }
+    }
+  },
+  reconnectStats: {
+    value: function () {
+      return binding.getReconnectStats.call(this);
+    }
+  },
+  setMetrics: {
+    value: function (options) {
+      try {
+        whenConnected(this, binding.setMetrics.bind(this, options),
+                      this.emit.bind(this, 'error'));
+      } catch (e) {
+        this.emit('error', e);
+      }
+    }
+  },
+  metrics: {
+    value: function () {
+      return binding.getMetrics.call(this);
+    }
+  },
+  marshal: {
+    value: function () {
+      try {
+        return binding.marshal.call(this);
+      } catch (e) {
+        this.emit('error', e);
+      }
+      return null;
+    }
+  },
+  sendRaw: {
+    value: function (buffer) {
+      try {
+        return whenConnected(this, binding.sendRaw.bind(this, buffer),
+                             this.emit.bind(this, 'error'));
+      } catch (e) {
+        this.emit('error', e);
+      }
+      return false;
+    }
+  },
+  callRaw: {
+    value: function (buffer, signal) {
+      var self = this;
+      return abortableCall(signal, this, function (callback) {
+        binding.init.call(self);
+        return binding.callRaw.call(self, buffer, callback);
+      });
+    }
   }
 });
 
+exports.DBusServer = Object.create(events.EventEmitter.prototype, {
+  address: {
+    value: null,
+    writable: true
+  },
+  close: {
+    value: function () {
+      binding.closeServer(this.address);
+    }
+  }
+});
+
+exports.listen = function (address) {
+  var server = Object.create(exports.DBusServer);
+  server.address = binding.listen(address, server);
+  return server;
+};
+
+exports.connectPeer = function (address) {
+  binding.init.call({bus: binding.constants.NDBUS_BUS_PEER, address: address});
+  return address;
+};
+
+exports.bufferToMemfd = function (buffer) {
+  return binding.createMemfd(buffer);
+};
+
+exports.demarshal = function (buffer, decodeFlags) {
+  return binding.demarshal(buffer, decodeFlags);
+};
+
+exports.memfdToBuffer = function (fd) {
+  try {
+    return binding.mapFd(fd);
+  } finally {
+    fs.closeSync(fd);
+  }
+};
+
+binding.onPeerConnection = function (peerAddress) {
+  this.emit('connection', peerAddress);
+};
+
 binding.onMethodResponse = function (args, error) {
   if (error) {
     this.emit('error', error);
@@ -148,6 +909,38 @@ binding.onMethodResponse = function (args, error) {
   }
 };
 
+binding.onDrain = function (objectList) {
+  var len = objectList.length,
+      i = 0;
+  for (; i<len; i++) {
+    objectList[i].emit('drain');
+  }
+};
+
+binding.onReconnect = function (objectList, stats) {
+  var len = objectList.length,
+      seen = [],
+      i = 0;
+  for (; i<len; i++) {
+    if (seen.indexOf(objectList[i]) < 0) {
+      seen.push(objectList[i]);
+      objectList[i].emit('reconnect', stats);
+    }
+  }
+};
+
+binding.onPropertiesChanged = function (changed, invalidated) {
+  this.emit('changed', changed, invalidated);
+};
+
+binding.onObjectsChanged = function (event) {
+  this.emit.apply(this, event);
+};
+
+binding.onNameOwnership = function (acquired, name) {
+  this.emit(acquired ? 'nameAcquired' : 'nameLost', name);
+};
+
 binding.onSignalReceipt = function (objectList, signal, args) {
   if (Array.isArray(objectList)) {
     var len = objectList.length,
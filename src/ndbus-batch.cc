@@ -0,0 +1,349 @@
+/*
+ * Copyright (c) 2011, Motorola Mobility, Inc
+ * All Rights Reserved.
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+#include "ndbus.h"
+
+namespace ndbus {
+
+/**
+ * A batch mostly repeats a handful of signatures, so each one is
+ * validated and split once, keyed by the signature string.
+ */
+static NDbusSignature*
+NDbusBatchSignature (GHashTable *signatures, const gchar *signature) {
+  NDbusSignature *compiled = (NDbusSignature *)
+    g_hash_table_lookup(signatures, signature);
+  if (!compiled) {
+    compiled = NDbusSignatureNew(signature);
+    if (compiled)
+      g_hash_table_insert(signatures, compiled->signature, compiled);
+  }
+  return compiled;
+}
+
+/**
+ * Reads name from entry, falling back to the message object
+ * the batch is sent through.
+ */
+static Local<Value>
+NDbusBatchProperty (Local<Object> entry, Local<Object> obj,
+    const gchar *name) {
+  Local<Value> value = NDbusGetProperty(entry, name);
+  if (NDbusIsValidV8Value(value))
+    return value;
+  return NDbusGetProperty(obj, name);
+}
+
+//EXPOSED
+/**
+ * Creates a message without arguments from the path, iface, member
+ * and destination of entry, or else of obj. Returns NULL and sets
+ * error if any of them is missing or invalid. Without cnxn_info the
+ * message is not sent anywhere yet, so no destination is required.
+ */
+DBusMessage*
+NDbusNewMessageFromEntry (Local<Object> obj, Local<Object> entry,
+    gint message_type, NDbusConnectionInfo *cnxn_info,
+    Local<Object> *error) {
+  Isolate* isolate = Isolate::GetCurrent();
+
+  gchar *object_path = NDbusV8StringToCStr(
+      NDbusBatchProperty(entry, obj, NDBUS_PROPERTY_PATH));
+  gchar *interface = NDbusV8StringToCStr(
+      NDbusBatchProperty(entry, obj, NDBUS_PROPERTY_INTERFACE));
+  gchar *member = NDbusV8StringToCStr(
+      NDbusBatchProperty(entry, obj, NDBUS_PROPERTY_MEMBER));
+  gchar *destination = NDbusV8StringToCStr(
+      NDbusBatchProperty(entry, obj, NDBUS_PROPERTY_DEST));
+
+  DBusMessage *msg = NULL;
+  if (!object_path || !dbus_validate_path(object_path, NULL)) {
+    NDBUS_SET_EXCPN(*error, DBUS_ERROR_FAILED, NDBUS_ERROR_PATH);
+  } else if (!member || !dbus_validate_member(member, NULL)) {
+    NDBUS_SET_EXCPN(*error, DBUS_ERROR_FAILED, NDBUS_ERROR_MEMBER);
+  } else if (interface ? !dbus_validate_interface(interface, NULL) :
+      message_type == DBUS_MESSAGE_TYPE_SIGNAL) {
+    NDBUS_SET_EXCPN(*error, DBUS_ERROR_FAILED, NDBUS_ERROR_INTERFACE);
+  } else if (destination ? !dbus_validate_bus_name(destination, NULL) :
+      (message_type != DBUS_MESSAGE_TYPE_SIGNAL && cnxn_info && !cnxn_info->peer)) {
+    NDBUS_SET_EXCPN(*error, DBUS_ERROR_FAILED, NDBUS_ERROR_DEST);
+  } else {
+    if (message_type == DBUS_MESSAGE_TYPE_SIGNAL) {
+      msg = dbus_message_new_signal(object_path, interface, member);
+      if (msg && destination)
+        dbus_message_set_destination(msg, destination);
+    } else {
+      msg = dbus_message_new_method_call(destination, object_path,
+          interface, member);
+    }
+    if (!msg)
+      NDBUS_SET_EXCPN(*error, DBUS_ERROR_NO_MEMORY, NDBUS_ERROR_OOM);
+  }
+  NDbusFree(destination, interface, object_path, member);
+  return msg;
+}
+
+static DBusMessage*
+NDbusBatchNewMessage (Local<Object> obj, Local<Value> value,
+    gint message_type, NDbusConnectionInfo *cnxn_info,
+    GHashTable *signatures, NDbusVariantPolicy variantPolicy,
+    gboolean codec, Local<Object> *error) {
+  Isolate* isolate = Isolate::GetCurrent();
+
+  if (!value->IsObject()) {
+    NDBUS_SET_EXCPN(*error, DBUS_ERROR_INVALID_ARGS, NDBUS_ERROR_BATCH);
+    return NULL;
+  }
+  Local<Object> entry = Local<Object>::Cast(value);
+
+  DBusMessage *msg = NDbusNewMessageFromEntry(obj, entry,
+      message_type, cnxn_info, error);
+  if (!msg)
+    return NULL;
+  NDBUS_PROBE(message__create, msg);
+
+  gchar *signature = NDbusV8StringToCStr(
+      NDbusGetProperty(entry, NDBUS_PROPERTY_ENTRY_SIGN));
+  Local<Value> args = NDbusGetProperty(entry, NDBUS_PROPERTY_ENTRY_ARGS);
+  //a signature without an args array, or args without a signature
+  if (signature ? !args->IsArray() : !(args->IsUndefined() || args->IsNull())) {
+    NDBUS_SET_EXCPN(*error, DBUS_ERROR_INVALID_ARGS, NDBUS_ERROR_BATCH);
+    dbus_message_unref(msg);
+    msg = NULL;
+  } else if (signature) {
+    NDbusSignature *compiled = NDbusBatchSignature(signatures, signature);
+    if (!compiled) {
+      NDBUS_SET_EXCPN(*error, DBUS_ERROR_INVALID_SIGNATURE, NDBUS_ERROR_SIGN);
+    } else if (!NDbusMessageAppendSignatureArgs(&msg, compiled,
+          Local<Array>::Cast(args), error, variantPolicy, codec)) {
+      //error is set already
+    } else if (!NDbusCanSendMessage(cnxn_info->cnxn, msg)) {
+      NDBUS_SET_EXCPN(*error, DBUS_ERROR_NOT_SUPPORTED, NDBUS_ERROR_UNIXFD);
+    } else {
+      g_free(signature);
+      return msg;
+    }
+    dbus_message_unref(msg);
+    msg = NULL;
+  }
+  g_free(signature);
+  return msg;
+}
+
+/**
+ * Builds the messages of every entry in entries. Nothing is sent
+ * unless all of them are valid, the failing one is told by index.
+ */
+static GPtrArray*
+NDbusBatchNewMessages (Local<Object> obj, Local<Array> entries,
+    gint message_type, NDbusConnectionInfo *cnxn_info,
+    Local<Object> *error) {
+  Isolate* isolate = Isolate::GetCurrent();
+
+  NDbusVariantPolicy variantPolicy = (NDbusVariantPolicy)NDbusGetProperty(obj,
+        NDBUS_PROPERTY_VARIANT_POLICY)->IntegerValue();
+  gboolean codec = NDbusGetProperty(obj, NDBUS_PROPERTY_CODEC)->BooleanValue();
+  GHashTable *signatures = g_hash_table_new_full(g_str_hash,
+      g_str_equal, NULL, (GDestroyNotify) NDbusSignatureFree);
+  guint len = entries->Length();
+  GPtrArray *msgs = g_ptr_array_sized_new(len);
+  g_ptr_array_set_free_func(msgs, (GDestroyNotify) dbus_message_unref);
+
+  for (guint i = 0; i < len; i++) {
+    DBusMessage *msg = NDbusBatchNewMessage(obj, entries->Get(i),
+        message_type, cnxn_info, signatures, variantPolicy, codec, error);
+    if (!msg) {
+      (*error)->Set(v8::String::NewFromUtf8(isolate, NDBUS_PROPERTY_INDEX),
+          Uint32::NewFromUnsigned(isolate, i));
+      g_ptr_array_unref(msgs);
+      msgs = NULL;
+      break;
+    }
+    g_ptr_array_add(msgs, msg);
+  }
+  g_hash_table_unref(signatures);
+  return msgs;
+}
+
+//EXPOSED
+/**
+ * Hands reply, NULL if there was none, to the callback of cb_info
+ * as (error, args).
+ */
+void
+NDbusDispatchCallbackReply (NDbusCallbackInfo *cb_info,
+    DBusMessage *reply) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  const gint argc = 2;
+  Local<Value> argv[argc];
+  if (reply && cb_info->reply_signature &&
+      dbus_message_get_type(reply) == DBUS_MESSAGE_TYPE_METHOD_RETURN &&
+      !dbus_message_has_signature(reply, cb_info->reply_signature)) {
+    argv[1] = Undefined(isolate);
+    NDBUS_SET_EXCPN(argv[0], DBUS_ERROR_INVALID_SIGNATURE, NDBUS_ERROR_REPLY_SIGN);
+  } else {
+    NDbusRetrieveReplyArgs(reply, cb_info->decode_flags, &argv[1], &argv[0]);
+  }
+
+  Local<Function> func =
+    Local<Function>::New(isolate, cb_info->callback);
+  NDBUS_PROBE(callback__start, reply);
+  if (NDbusIsValidV8Value(func))
+    func->Call(func, argc, argv);
+  NDBUS_PROBE(callback__done, reply);
+}
+
+//EXPOSED
+/**
+ * Hands the reply of a method-call to the callback of the
+ * NDbusCallbackInfo in user_data as (error, args).
+ */
+void
+NDbusHandleCallbackReply (DBusPendingCall *pending,
+    void *user_data) {
+  g_return_if_fail(pending != NULL);
+
+  DBusMessage *reply = dbus_pending_call_steal_reply(pending);
+  NDbusTimeReply(pending, reply);
+  NDbusDispatchCallbackReply((NDbusCallbackInfo *)user_data, reply);
+
+  if (reply)
+    dbus_message_unref(reply);
+  dbus_pending_call_unref(pending);
+}
+
+//EXPOSED
+/**
+ * Sends a signal for every entry of args[0] in one go. The messages
+ * are built and their send preallocated before any is queued, so the
+ * batch is either queued whole or not at all.
+ */
+void
+NDbusSendBatch (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  if (!args[0]->IsArray())
+    NDBUS_EXCPN_BATCH;
+
+  NDbusConnectionInfo *cnxn_info = NDbusGetConnection(args.This());
+  if (!cnxn_info || !cnxn_info->cnxn)
+    NDBUS_EXCPN_DISCONNECTED;
+  DBusConnection *bus_cnxn = cnxn_info->cnxn;
+
+  Local<Object> error;
+  GPtrArray *msgs = NDbusBatchNewMessages(args.This(),
+      Local<Array>::Cast(args[0]), DBUS_MESSAGE_TYPE_SIGNAL,
+      cnxn_info, &error);
+  if (!msgs) {
+    isolate->ThrowException(error);
+    return;
+  }
+
+  DBusPreallocatedSend **preallocated =
+    g_new0(DBusPreallocatedSend *, msgs->len + 1);
+  guint i;
+  for (i = 0; i < msgs->len; i++) {
+    preallocated[i] = dbus_connection_preallocate_send(bus_cnxn);
+    if (!preallocated[i])
+      break;
+  }
+
+  if (i < msgs->len) {
+    while (i-- > 0)
+      dbus_connection_free_preallocated_send(bus_cnxn, preallocated[i]);
+    g_free(preallocated);
+    g_ptr_array_unref(msgs);
+    NDBUS_EXCPN_OOM;
+  }
+
+  for (i = 0; i < msgs->len; i++) {
+    DBusMessage *msg = (DBusMessage *)g_ptr_array_index(msgs, i);
+    dbus_connection_send_preallocated(bus_cnxn, preallocated[i], msg, NULL);
+    NDbusCountMessage(cnxn_info, msg, FALSE);
+  }
+  g_free(preallocated);
+  g_ptr_array_unref(msgs);
+
+  args.GetReturnValue().Set(NDbusCheckWritable(cnxn_info, args.This()) == TRUE);
+}
+
+//EXPOSED
+/**
+ * Sends a method-call for every entry of args[0] in one go. The reply
+ * to each one is handed to the callback at the same index of args[1].
+ * Returns the ids of the calls for cancelCall(), in the same order.
+ */
+void
+NDbusCallBatch (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  if (!args[0]->IsArray() || !args[1]->IsArray())
+    NDBUS_EXCPN_BATCH;
+  Local<Array> entries = Local<Array>::Cast(args[0]);
+  Local<Array> callbacks = Local<Array>::Cast(args[1]);
+  if (callbacks->Length() != entries->Length())
+    NDBUS_EXCPN_BATCH;
+  for (guint i = 0; i < callbacks->Length(); i++) {
+    if (!callbacks->Get(i)->IsFunction())
+      NDBUS_EXCPN_CALLBACK;
+  }
+
+  NDbusConnectionInfo *cnxn_info = NDbusGetConnection(args.This());
+  if (!cnxn_info || !cnxn_info->cnxn)
+    NDBUS_EXCPN_DISCONNECTED;
+  DBusConnection *bus_cnxn = cnxn_info->cnxn;
+
+  Local<Object> error;
+  GPtrArray *msgs = NDbusBatchNewMessages(args.This(), entries,
+      DBUS_MESSAGE_TYPE_METHOD_CALL, cnxn_info, &error);
+  if (!msgs) {
+    isolate->ThrowException(error);
+    return;
+  }
+
+  Local<Array> call_ids = Array::New(isolate, msgs->len);
+  guint decode_flags = NDbusGetDecodeFlags(args.This());
+  gint default_timeout = NDbusGetProperty(args.This(),
+      NDBUS_PROPERTY_TIMEOUT)->IntegerValue();
+  for (guint i = 0; i < msgs->len; i++) {
+    Local<Object> entry = Local<Object>::Cast(entries->Get(i));
+    Local<Value> timeout = NDbusGetProperty(entry, NDBUS_PROPERTY_TIMEOUT);
+
+    DBusPendingCall *pending = NULL;
+    if (!dbus_connection_send_with_reply(bus_cnxn,
+          (DBusMessage *)g_ptr_array_index(msgs, i), &pending,
+          timeout->IsInt32() ? timeout->Int32Value() : default_timeout) ||
+        !pending) {
+      g_ptr_array_unref(msgs);
+      NDBUS_EXCPN_OOM;
+    }
+    NDbusTimeCall(cnxn_info, (DBusMessage *)g_ptr_array_index(msgs, i),
+        pending);
+
+    NDbusCallbackInfo *cb_info = g_new0(NDbusCallbackInfo, 1);
+    cb_info->callback.Reset(isolate, Local<Function>::Cast(callbacks->Get(i)));
+    cb_info->cnxn_info = NDbusConnectionInfoRef(cnxn_info);
+    cb_info->decode_flags = decode_flags;
+    dbus_pending_call_set_notify(pending, NDbusHandleCallbackReply,
+        (void *)cb_info, NDbusFreeCallbackInfo);
+    call_ids->Set(i, Uint32::NewFromUnsigned(isolate,
+          NDbusTrackPendingCall(pending)));
+  }
+  g_ptr_array_unref(msgs);
+
+  NDbusCheckWritable(cnxn_info, args.This());
+  args.GetReturnValue().Set(call_ids);
+}
+
+} //namespace ndbus
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2011, Motorola Mobility, Inc
+ * All Rights Reserved.
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+#include "ndbus.h"
+
+namespace ndbus {
+
+/**
+ * Method-calls in flight by call id, so that they can be cancelled.
+ * The id sits in a data slot of the pending call, whose free function
+ * drops the entry when the call is over, however it ended.
+ */
+static GHashTable *calls = NULL;
+static dbus_int32_t call_slot = -1;
+static guint last_call_id = 0;
+
+static void
+NDbusUntrackPendingCall (void *data) {
+  if (calls)
+    g_hash_table_remove(calls, data);
+}
+
+//EXPOSED
+guint
+NDbusNextCallId (void) {
+  //0 is no call
+  if (++last_call_id == 0)
+    ++last_call_id;
+  return last_call_id;
+}
+
+//EXPOSED
+/**
+ * Makes pending cancellable by cancelCall() and returns its id, or 0
+ * if memory runs out, in which case it simply runs its course.
+ */
+guint
+NDbusTrackPendingCall (DBusPendingCall *pending) {
+  if (call_slot == -1 &&
+      !dbus_pending_call_allocate_data_slot(&call_slot))
+    return 0;
+
+  guint id = NDbusNextCallId();
+  if (!dbus_pending_call_set_data(pending, call_slot,
+        GUINT_TO_POINTER(id), NDbusUntrackPendingCall))
+    return 0;
+  if (calls == NULL)
+    calls = g_hash_table_new(g_direct_hash, g_direct_equal);
+  g_hash_table_insert(calls, GUINT_TO_POINTER(id), pending);
+  return id;
+}
+
+/**
+ * Cancels the call id unless its reply is being handed over. The
+ * reference its notify function would have dropped is dropped here,
+ * which frees the pending call and with it its user data right away.
+ */
+static gboolean
+NDbusCancelPendingCall (guint id) {
+  DBusPendingCall *pending = calls ? (DBusPendingCall *)
+    g_hash_table_lookup(calls, GUINT_TO_POINTER(id)) : NULL;
+  if (pending == NULL || dbus_pending_call_get_completed(pending))
+    return FALSE;
+
+  g_hash_table_remove(calls, GUINT_TO_POINTER(id));
+  dbus_pending_call_cancel(pending);
+  dbus_pending_call_unref(pending);
+  return TRUE;
+}
+
+//EXPOSED
+/**
+ * Cancels the method-call args[0], an id returned by the functions
+ * which start one, so that its callback is never called. Returns
+ * whether it was still in flight.
+ */
+void
+NDbusCancelCall (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  gboolean cancelled = FALSE;
+  if (args[0]->IsUint32() && args[0]->Uint32Value() != 0) {
+    guint id = args[0]->Uint32Value();
+    cancelled = NDbusCancelPendingCall(id) || NDbusCancelFlightWaiter(id);
+  }
+  args.GetReturnValue().Set(cancelled == TRUE);
+}
+
+} //namespace ndbus
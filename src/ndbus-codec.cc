@@ -0,0 +1,1009 @@
+/*
+ * Copyright (c) 2011, Motorola Mobility, Inc
+ * All Rights Reserved.
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+/*
+ * A marshaller and unmarshaller of the D-Bus wire format which does not
+ * go through DBusMessageIter. Bodies are written and read directly, one
+ * complete type at a time, driven by a signature compiled once into a
+ * program. libdbus only carries the result: encoded messages are handed
+ * to it with dbus_message_demarshal(), which validates them once, and
+ * received ones are taken from it with dbus_message_marshal().
+ *
+ * Unix fds live outside the wire format, so signatures with 'h' are
+ * left to the iterators.
+ */
+
+#include "ndbus.h"
+
+namespace ndbus {
+
+//containers nested deeper than this, which includes variants, are refused
+#define NDBUS_CODEC_MAX_DEPTH         64
+//the most programs kept for variants and received messages
+#define NDBUS_CODEC_CACHE_SIZE        256
+//fixed part of the header: endianness, type, flags, version, body
+//length, serial and the length of the header fields array
+#define NDBUS_CODEC_HEADER_SIZE       16
+
+#define NDBUS_CODEC_ALIGN(n, a)       (((n) + (a) - 1) & ~((gsize) (a) - 1))
+
+/**
+ * next[i] is the position right past the complete type which starts at
+ * position i of signature, and args[k] where the k-th argument starts,
+ * with args[n_args] being the end of the signature.
+ */
+struct _NDbusCodecProgram {
+  gint ref_count;
+  gchar *signature;
+  guint8 next[DBUS_MAXIMUM_SIGNATURE_LENGTH + 1];
+  guint n_args;
+  guint8 args[DBUS_MAXIMUM_SIGNATURE_LENGTH + 1];
+};
+
+typedef struct {
+  const guint8 *data;
+  gsize len;
+  gsize pos;
+  gboolean swap;
+} NDbusCodecReader;
+
+static GHashTable *programs = NULL;
+
+static guint
+NDbusCodecAlignment (gchar type) {
+  switch (type) {
+    case DBUS_TYPE_BYTE:
+    case DBUS_TYPE_SIGNATURE:
+    case DBUS_TYPE_VARIANT:
+      return 1;
+    case DBUS_TYPE_INT16:
+    case DBUS_TYPE_UINT16:
+      return 2;
+    case DBUS_TYPE_INT64:
+    case DBUS_TYPE_UINT64:
+    case DBUS_TYPE_DOUBLE:
+    case DBUS_STRUCT_BEGIN_CHAR:
+    case DBUS_DICT_ENTRY_BEGIN_CHAR:
+      return 8;
+    default:
+      return 4;
+  }
+}
+
+/**
+ * Fills in next for the complete type at i of a valid signature.
+ * @return the position past it
+ */
+static guint
+NDbusCodecCompileType (NDbusCodecProgram *program, guint i) {
+  const gchar *signature = program->signature;
+  guint end;
+  switch (signature[i]) {
+    case DBUS_TYPE_ARRAY:
+      end = NDbusCodecCompileType(program, i + 1);
+      break;
+    case DBUS_STRUCT_BEGIN_CHAR:
+    case DBUS_DICT_ENTRY_BEGIN_CHAR:
+      end = i + 1;
+      while (signature[end] != DBUS_STRUCT_END_CHAR &&
+          signature[end] != DBUS_DICT_ENTRY_END_CHAR)
+        end = NDbusCodecCompileType(program, end);
+      end++;
+      break;
+    default:
+      end = i + 1;
+      break;
+  }
+  program->next[i] = end;
+  return end;
+}
+
+//EXPOSED
+/**
+ * Compiles signature for the codec.
+ * @return the program, or NULL if signature is invalid or has unix fds
+ */
+NDbusCodecProgram*
+NDbusCodecProgramNew (const gchar *signature) {
+  if (!dbus_signature_validate(signature, NULL) ||
+      strchr(signature, DBUS_TYPE_UNIX_FD))
+    return NULL;
+
+  NDbusCodecProgram *program = g_new0(NDbusCodecProgram, 1);
+  program->ref_count = 1;
+  program->signature = g_strdup(signature);
+  guint len = strlen(signature);
+  guint i = 0;
+  while (i < len) {
+    program->args[program->n_args++] = i;
+    i = NDbusCodecCompileType(program, i);
+  }
+  program->args[program->n_args] = len;
+  return program;
+}
+
+NDbusCodecProgram*
+NDbusCodecProgramRef (NDbusCodecProgram *program) {
+  if (program)
+    program->ref_count++;
+  return program;
+}
+
+void
+NDbusCodecProgramUnref (NDbusCodecProgram *program) {
+  if (program == NULL || --program->ref_count > 0)
+    return;
+  g_free(program->signature);
+  g_free(program);
+}
+
+/**
+ * The program for signature, kept for the next time. Variants and
+ * received messages bring signatures of their own, which are few but
+ * unknown in advance, so the cache is simply emptied when full.
+ * Programs of the outer values may go with it, so each caller holds
+ * a reference and drops it with NDbusCodecProgramUnref when done.
+ */
+static NDbusCodecProgram*
+NDbusCodecLookupProgram (const gchar *signature) {
+  if (programs == NULL)
+    programs = g_hash_table_new_full(g_str_hash, g_str_equal,
+        NULL, (GDestroyNotify) NDbusCodecProgramUnref);
+
+  NDbusCodecProgram *program = (NDbusCodecProgram *)
+    g_hash_table_lookup(programs, signature);
+  if (!program) {
+    program = NDbusCodecProgramNew(signature);
+    if (!program)
+      return NULL;
+    if (g_hash_table_size(programs) >= NDBUS_CODEC_CACHE_SIZE)
+      g_hash_table_remove_all(programs);
+    g_hash_table_insert(programs, program->signature, program);
+  }
+  return NDbusCodecProgramRef(program);
+}
+
+/*
+ * Writing. Everything is aligned relative to the start of the message,
+ * which is also the start of w, and written in native byte order.
+ */
+
+static void
+NDbusCodecPad (GByteArray *w, guint alignment) {
+  static const guint8 zeros[8] = { 0 };
+  guint pad = NDBUS_CODEC_ALIGN(w->len, alignment) - w->len;
+  if (pad)
+    g_byte_array_append(w, zeros, pad);
+}
+
+static void
+NDbusCodecPut (GByteArray *w, const void *value, guint size) {
+  NDbusCodecPad(w, size);
+  g_byte_array_append(w, (const guint8 *) value, size);
+}
+
+static void
+NDbusCodecPatch (GByteArray *w, guint offset, guint32 value) {
+  memcpy(w->data + offset, &value, sizeof(value));
+}
+
+/**
+ * Writes a string, or a signature with its one byte length, straight
+ * from V8 into w. As with the iterators, an embedded NUL ends it.
+ */
+static gint
+NDbusCodecPutString (GByteArray *w, gchar type, Local<Value> value) {
+  if (!value->IsString())
+    return TYPE_MISMATCH;
+
+  Local<v8::String> str = Local<v8::String>::Cast(value);
+  gint len = str->Utf8Length();
+  guint header = type == DBUS_TYPE_SIGNATURE ? 1 : 4;
+
+  NDbusCodecPad(w, header);
+  guint start = w->len;
+  g_byte_array_set_size(w, start + header + len + 1);
+  gchar *data = (gchar *) w->data + start + header;
+  str->WriteUtf8(data, len, NULL, v8::String::NO_NULL_TERMINATION |
+      v8::String::REPLACE_INVALID_UTF8);
+
+  const gchar *nul = (const gchar *) memchr(data, '\0', len);
+  if (nul) {
+    len = nul - data;
+    g_byte_array_set_size(w, start + header + len + 1);
+    data = (gchar *) w->data + start + header;
+  }
+  data[len] = '\0';
+
+  if (type == DBUS_TYPE_SIGNATURE) {
+    if (len > DBUS_MAXIMUM_SIGNATURE_LENGTH)
+      return TYPE_MISMATCH;
+    w->data[start] = len;
+  } else {
+    NDbusCodecPatch(w, start, len);
+  }
+  return SUCCESS;
+}
+
+static gint NDbusCodecEncode (GByteArray *w, const NDbusCodecProgram *program,
+    guint pc, Local<Value> value, NDbusVariantPolicy variantPolicy, guint depth);
+
+/**
+ * Opens an array: its length, to be patched by NDbusCodecEndArray,
+ * and the padding up to the first element, which is not counted.
+ * @return the offset of the length
+ */
+static guint
+NDbusCodecBeginArray (GByteArray *w, gchar element_type, guint *start) {
+  guint32 placeholder = 0;
+  NDbusCodecPut(w, &placeholder, 4);
+  guint offset = w->len - 4;
+  NDbusCodecPad(w, NDbusCodecAlignment(element_type));
+  *start = w->len;
+  return offset;
+}
+
+static gint
+NDbusCodecEndArray (GByteArray *w, guint offset, guint start) {
+  if (w->len - start > DBUS_MAXIMUM_ARRAY_LENGTH)
+    return TYPE_MISMATCH;
+  NDbusCodecPatch(w, offset, w->len - start);
+  return SUCCESS;
+}
+
+static gint
+NDbusCodecEncodeDict (GByteArray *w, const NDbusCodecProgram *program,
+    guint pc, Local<Value> value, NDbusVariantPolicy variantPolicy, guint depth) {
+  if (!value->IsObject())
+    return TYPE_MISMATCH;
+
+  //"a{kv}": the key is at pc + 2, the value right after it
+  guint key_pc = pc + 2;
+  guint value_pc = program->next[key_pc];
+  guint start;
+  guint offset = NDbusCodecBeginArray(w, DBUS_DICT_ENTRY_BEGIN_CHAR, &start);
+
+  gboolean map = value->IsMap();
+  Local<Object> obj = Local<Object>::Cast(value);
+  Local<Array> entries = map ?
+    Local<Map>::Cast(value)->AsArray() : obj->GetOwnPropertyNames();
+  guint len = entries->Length();
+  for (guint i = 0; i < len; i += map ? 2 : 1) {
+    NDbusCodecPad(w, 8);
+    Local<Value> key = entries->Get(i);
+    gint status = NDbusCodecEncode(w, program, key_pc, key,
+        variantPolicy, depth + 1);
+    if (status != SUCCESS)
+      return status;
+    status = NDbusCodecEncode(w, program, value_pc,
+        map ? entries->Get(i + 1) : obj->Get(key), variantPolicy, depth + 1);
+    if (status != SUCCESS)
+      return status;
+  }
+  return NDbusCodecEndArray(w, offset, start);
+}
+
+/**
+ * Arrays given as a TypedArray, or as { columns, length } for structs
+ * of fixed-width types, as the iterators accept them.
+ * @return TYPE_NOT_SUPPORTED if value is neither
+ */
+static gint
+NDbusCodecEncodeFixedArray (GByteArray *w, const NDbusCodecProgram *program,
+    guint pc, Local<Value> value) {
+  Isolate* isolate = Isolate::GetCurrent();
+  guint element_pc = pc + 1;
+  gchar element_type = program->signature[element_pc];
+  guint element_len = program->next[element_pc] - element_pc;
+  guint start;
+
+  if (element_len == 1 && element_type != DBUS_TYPE_BOOLEAN &&
+      NDbusIsColumn(value, element_type)) {
+    Local<TypedArray> typed = Local<TypedArray>::Cast(value);
+    guint offset = NDbusCodecBeginArray(w, element_type, &start);
+    g_byte_array_append(w, (const guint8 *)
+        typed->Buffer()->GetContents().Data() + typed->ByteOffset(),
+        typed->ByteLength());
+    return NDbusCodecEndArray(w, offset, start);
+  }
+
+  gchar element[DBUS_MAXIMUM_SIGNATURE_LENGTH + 1];
+  gchar types[DBUS_MAXIMUM_SIGNATURE_LENGTH];
+  memcpy(element, program->signature + element_pc, element_len);
+  element[element_len] = '\0';
+  gint ncols = NDbusColumnTypes(element, types);
+  if (ncols == 0 || value->IsArray() || !value->IsObject())
+    return TYPE_NOT_SUPPORTED;
+
+  Local<Object> obj = Local<Object>::Cast(value);
+  Local<Value> columns_value =
+    obj->Get(v8::String::NewFromUtf8(isolate, NDBUS_PROPERTY_COLUMNS));
+  if (!columns_value->IsArray())
+    return TYPE_MISMATCH;
+  Local<Array> columns = Local<Array>::Cast(columns_value);
+  if (columns->Length() != (guint) ncols)
+    return TYPE_MISMATCH;
+  Local<Value> length =
+    obj->Get(v8::String::NewFromUtf8(isolate, NDBUS_PROPERTY_LENGTH));
+
+  const guint8 *data[DBUS_MAXIMUM_SIGNATURE_LENGTH];
+  gsize size[DBUS_MAXIMUM_SIGNATURE_LENGTH];
+  guint len = 0;
+  for (gint col = 0; col < ncols; col++) {
+    Local<Value> column = columns->Get(col);
+    if (!NDbusIsColumn(column, types[col]))
+      return TYPE_MISMATCH;
+    Local<TypedArray> typed = Local<TypedArray>::Cast(column);
+    if (col == 0)
+      len = length->IsUint32() ? length->Uint32Value() : typed->Length();
+    if (typed->Length() < len)
+      return TYPE_MISMATCH;
+    size[col] = NDbusColumnElementSize(types[col]);
+    data[col] = (const guint8 *) typed->Buffer()->GetContents().Data() +
+      typed->ByteOffset();
+  }
+
+  guint offset = NDbusCodecBeginArray(w, DBUS_STRUCT_BEGIN_CHAR, &start);
+  for (guint row = 0; row < len; row++) {
+    NDbusCodecPad(w, 8);
+    for (gint col = 0; col < ncols; col++) {
+      if (types[col] == DBUS_TYPE_BOOLEAN) {
+        guint32 value = data[col][row] ? 1 : 0;
+        NDbusCodecPut(w, &value, 4);
+      } else {
+        NDbusCodecPut(w, data[col] + row * size[col], size[col]);
+      }
+    }
+  }
+  return NDbusCodecEndArray(w, offset, start);
+}
+
+/**
+ * Writes value as the complete type at pc of program, with the same
+ * checks as NDbusMessageAppendArgsReal.
+ */
+static gint
+NDbusCodecEncode (GByteArray *w, const NDbusCodecProgram *program,
+    guint pc, Local<Value> value, NDbusVariantPolicy variantPolicy, guint depth) {
+  if (depth > NDBUS_CODEC_MAX_DEPTH)
+    return TYPE_NOT_SUPPORTED;
+
+  gchar type = program->signature[pc];
+  switch (type) {
+    case DBUS_TYPE_BOOLEAN:
+      {
+        if (!value->IsBoolean())
+          return TYPE_MISMATCH;
+        guint32 val = value->BooleanValue() ? 1 : 0;
+        NDbusCodecPut(w, &val, 4);
+        break;
+      }
+    case DBUS_TYPE_BYTE:
+      {
+        if(value->Int32Value() < 0 || value->Int32Value() > 255)
+          return TYPE_MISMATCH;
+        guint8 val = value->Uint32Value();
+        NDbusCodecPut(w, &val, 1);
+        break;
+      }
+    case DBUS_TYPE_INT16:
+      {
+        if(value->Int32Value() < -32768 || value->Int32Value() > 32767)
+          return TYPE_MISMATCH;
+        gint16 val = value->Int32Value();
+        NDbusCodecPut(w, &val, 2);
+        break;
+      }
+    case DBUS_TYPE_UINT16:
+      {
+        if(value->Int32Value() < 0 || value->Int32Value() > 65535)
+          return TYPE_MISMATCH;
+        guint16 val = value->Uint32Value();
+        NDbusCodecPut(w, &val, 2);
+        break;
+      }
+    case DBUS_TYPE_INT32:
+      {
+        if (!value->IsInt32())
+          return TYPE_MISMATCH;
+        gint32 val = value->Int32Value();
+        NDbusCodecPut(w, &val, 4);
+        break;
+      }
+    case DBUS_TYPE_UINT32:
+      {
+        if (!value->IsUint32())
+          return TYPE_MISMATCH;
+        guint32 val = value->Uint32Value();
+        NDbusCodecPut(w, &val, 4);
+        break;
+      }
+    case DBUS_TYPE_INT64:
+      {
+        gint64 val;
+#ifdef NDBUS_HAVE_BIGINT
+        if (value->IsBigInt()) {
+          bool lossless;
+          val = Local<BigInt>::Cast(value)->Int64Value(&lossless);
+          if (!lossless)
+            return TYPE_MISMATCH;
+        } else
+#endif
+        if (value->IsNumber())
+          val = value->IntegerValue();
+        else
+          return TYPE_MISMATCH;
+        NDbusCodecPut(w, &val, 8);
+        break;
+      }
+    case DBUS_TYPE_UINT64:
+      {
+        guint64 val;
+#ifdef NDBUS_HAVE_BIGINT
+        if (value->IsBigInt()) {
+          bool lossless;
+          val = Local<BigInt>::Cast(value)->Uint64Value(&lossless);
+          if (!lossless)
+            return TYPE_MISMATCH;
+        } else
+#endif
+        if (value->IsNumber() && value->NumberValue() >= 0 &&
+            value->NumberValue() < 18446744073709551616.0)
+          val = (guint64) value->NumberValue();
+        else
+          return TYPE_MISMATCH;
+        NDbusCodecPut(w, &val, 8);
+        break;
+      }
+    case DBUS_TYPE_DOUBLE:
+      {
+        if (!value->IsNumber())
+          return TYPE_MISMATCH;
+        gdouble val = value->NumberValue();
+        NDbusCodecPut(w, &val, 8);
+        break;
+      }
+    case DBUS_TYPE_SIGNATURE:
+    case DBUS_TYPE_OBJECT_PATH:
+    case DBUS_TYPE_STRING:
+      return NDbusCodecPutString(w, type, value);
+    case DBUS_TYPE_ARRAY:
+      {
+        if (program->signature[pc + 1] == DBUS_DICT_ENTRY_BEGIN_CHAR)
+          return NDbusCodecEncodeDict(w, program, pc, value,
+              variantPolicy, depth);
+
+        gint status = NDbusCodecEncodeFixedArray(w, program, pc, value);
+        if (status != TYPE_NOT_SUPPORTED)
+          return status;
+        if (!value->IsArray())
+          return TYPE_MISMATCH;
+
+        Local<Array> arr = Local<Array>::Cast(value);
+        guint start;
+        guint offset = NDbusCodecBeginArray(w, program->signature[pc + 1], &start);
+        guint len = arr->Length();
+        for (guint i = 0; i < len; i++) {
+          status = NDbusCodecEncode(w, program, pc + 1, arr->Get(i),
+              variantPolicy, depth + 1);
+          if (status != SUCCESS)
+            return status;
+        }
+        return NDbusCodecEndArray(w, offset, start);
+      }
+    case DBUS_TYPE_VARIANT:
+      {
+        gchar vsignature[DBUS_MAXIMUM_SIGNATURE_LENGTH];
+        gint index = 0;
+        gint status = NDbusCreateSignatureForVariant(value, variantPolicy,
+            vsignature, index);
+        if (status != SUCCESS)
+          return status;
+        vsignature[index] = '\0';
+
+        NDbusCodecProgram *vprogram = NDbusCodecLookupProgram(vsignature);
+        if (!vprogram)
+          return TYPE_NOT_SUPPORTED;
+        guint8 len = index;
+        g_byte_array_append(w, &len, 1);
+        g_byte_array_append(w, (const guint8 *) vsignature, index + 1);
+        status = NDbusCodecEncode(w, vprogram, 0, value, variantPolicy, depth + 1);
+        NDbusCodecProgramUnref(vprogram);
+        return status;
+      }
+    default:
+      //structs from JS are not supported by the iterators either
+      return TYPE_NOT_SUPPORTED;
+  }
+  return SUCCESS;
+}
+
+static void
+NDbusCodecPutField (GByteArray *w, guint8 code, gchar type,
+    const gchar *value, gsize len) {
+  if (!value)
+    return;
+
+  const guint8 variant[3] = { 1, (guint8) type, '\0' };
+  NDbusCodecPad(w, 8);
+  g_byte_array_append(w, &code, 1);
+  g_byte_array_append(w, variant, 3);
+  if (type == DBUS_TYPE_SIGNATURE) {
+    guint8 len8 = len;
+    g_byte_array_append(w, &len8, 1);
+  } else {
+    guint32 len32 = len;
+    NDbusCodecPut(w, &len32, 4);
+  }
+  g_byte_array_append(w, (const guint8 *) value, len);
+  g_byte_array_append(w, (const guint8 *) "", 1);
+}
+
+static void
+NDbusCodecPutStringField (GByteArray *w, guint8 code, gchar type,
+    const gchar *value) {
+  if (value)
+    NDbusCodecPutField(w, code, type, value, strlen(value));
+}
+
+//EXPOSED
+/**
+ * Encodes args with program into a new message, which has the header
+ * of the signal or method-call header and no serial yet.
+ * @return SUCCESS with *encoded set, or what went wrong. With
+ * TYPE_NOT_SUPPORTED the iterators may still manage.
+ */
+gint
+NDbusCodecNewMessage (DBusMessage *header, const NDbusCodecProgram *program,
+    Local<Array> args, NDbusVariantPolicy variantPolicy,
+    DBusMessage **encoded) {
+  guint len = args->Length();
+  if (len > program->n_args)
+    return TYPE_MISMATCH;
+
+  guint8 flags = 0;
+  if (dbus_message_get_no_reply(header))
+    flags |= DBUS_HEADER_FLAG_NO_REPLY_EXPECTED;
+  if (!dbus_message_get_auto_start(header))
+    flags |= DBUS_HEADER_FLAG_NO_AUTO_START;
+
+  //serial 1, dbus_message_demarshal() refuses 0
+  guint8 fixed[NDBUS_CODEC_HEADER_SIZE] = { DBUS_COMPILER_BYTE_ORDER,
+    (guint8) dbus_message_get_type(header), flags, DBUS_MAJOR_PROTOCOL_VERSION };
+  guint32 serial = 1;
+  memcpy(fixed + 8, &serial, 4);
+
+  GByteArray *w = g_byte_array_sized_new(NDBUS_STRING_BUFFER_SIZE);
+  g_byte_array_append(w, fixed, NDBUS_CODEC_HEADER_SIZE);
+  NDbusCodecPutStringField(w, DBUS_HEADER_FIELD_PATH,
+      DBUS_TYPE_OBJECT_PATH, dbus_message_get_path(header));
+  NDbusCodecPutStringField(w, DBUS_HEADER_FIELD_INTERFACE,
+      DBUS_TYPE_STRING, dbus_message_get_interface(header));
+  NDbusCodecPutStringField(w, DBUS_HEADER_FIELD_MEMBER,
+      DBUS_TYPE_STRING, dbus_message_get_member(header));
+  NDbusCodecPutStringField(w, DBUS_HEADER_FIELD_DESTINATION,
+      DBUS_TYPE_STRING, dbus_message_get_destination(header));
+  //the signature of the arguments given, which may be fewer
+  if (len)
+    NDbusCodecPutField(w, DBUS_HEADER_FIELD_SIGNATURE, DBUS_TYPE_SIGNATURE,
+        program->signature, program->args[len]);
+  NDbusCodecPatch(w, 12, w->len - NDBUS_CODEC_HEADER_SIZE);
+  NDbusCodecPad(w, 8);
+
+  guint body = w->len;
+  gint status = SUCCESS;
+  for (guint i = 0; i < len && status == SUCCESS; i++)
+    status = NDbusCodecEncode(w, program, program->args[i],
+        args->Get(i), variantPolicy, 0);
+  NDbusCodecPatch(w, 4, w->len - body);
+
+  if (status == SUCCESS && w->len > DBUS_MAXIMUM_MESSAGE_LENGTH)
+    status = TYPE_MISMATCH;
+
+  if (status == SUCCESS) {
+    //validated here once, invalid paths or signatures show up as such
+    DBusMessage *msg = dbus_message_demarshal((const gchar *) w->data,
+        w->len, NULL);
+    if (!msg) {
+      status = TYPE_MISMATCH;
+    } else {
+      //a copy has no serial, so the connection gives it a fresh one
+      *encoded = dbus_message_copy(msg);
+      dbus_message_unref(msg);
+      if (!*encoded)
+        status = OUT_OF_MEMORY;
+    }
+  }
+  g_byte_array_free(w, TRUE);
+  return status;
+}
+
+/*
+ * Reading. Everything is checked against the bounds of the body, and
+ * byte-swapped if the message was sent in the other byte order.
+ */
+
+static gboolean
+NDbusCodecAlign (NDbusCodecReader *r, guint alignment) {
+  gsize pos = NDBUS_CODEC_ALIGN(r->pos, alignment);
+  if (pos > r->len)
+    return FALSE;
+  r->pos = pos;
+  return TRUE;
+}
+
+static gboolean
+NDbusCodecGet (NDbusCodecReader *r, void *value, guint size) {
+  if (!NDbusCodecAlign(r, size) || r->len - r->pos < size)
+    return FALSE;
+  memcpy(value, r->data + r->pos, size);
+  r->pos += size;
+  if (r->swap) {
+    if (size == 2)
+      *(guint16 *) value = GUINT16_SWAP_LE_BE(*(guint16 *) value);
+    else if (size == 4)
+      *(guint32 *) value = GUINT32_SWAP_LE_BE(*(guint32 *) value);
+    else if (size == 8)
+      *(guint64 *) value = GUINT64_SWAP_LE_BE(*(guint64 *) value);
+  }
+  return TRUE;
+}
+
+static gboolean
+NDbusCodecGetString (NDbusCodecReader *r, gchar type,
+    const gchar **value, guint32 *len) {
+  if (type == DBUS_TYPE_SIGNATURE) {
+    guint8 len8;
+    if (!NDbusCodecGet(r, &len8, 1))
+      return FALSE;
+    *len = len8;
+  } else if (!NDbusCodecGet(r, len, 4)) {
+    return FALSE;
+  }
+  if (r->len - r->pos <= *len || r->data[r->pos + *len] != '\0')
+    return FALSE;
+  *value = (const gchar *) r->data + r->pos;
+  r->pos += *len + 1;
+  return TRUE;
+}
+
+static gboolean NDbusCodecDecode (NDbusCodecReader *r,
+    const NDbusCodecProgram *program, guint pc, guint decode_flags,
+    guint depth, Local<Value> *ret);
+
+/**
+ * Reads the dictionary or array at pc into *ret.
+ */
+static gboolean
+NDbusCodecDecodeArray (NDbusCodecReader *r, const NDbusCodecProgram *program,
+    guint pc, guint decode_flags, guint depth, Local<Value> *ret) {
+  Isolate* isolate = Isolate::GetCurrent();
+  guint element_pc = pc + 1;
+  gchar element_type = program->signature[element_pc];
+
+  guint32 len;
+  if (!NDbusCodecGet(r, &len, 4) ||
+      !NDbusCodecAlign(r, NDbusCodecAlignment(element_type)) ||
+      r->len - r->pos < len)
+    return FALSE;
+  gsize end = r->pos + len;
+
+  if (element_type == DBUS_DICT_ENTRY_BEGIN_CHAR) {
+    guint key_pc = element_pc + 1;
+    guint value_pc = program->next[key_pc];
+    gboolean map = decode_flags & NDBUS_DECODE_DICT_AS_MAP;
+    Local<Context> context = isolate->GetCurrentContext();
+    Local<Map> dict_map;
+    Local<Object> dict_obj;
+    if (map)
+      dict_map = Map::New(isolate);
+    else
+      dict_obj = Object::New(isolate);
+
+    while (r->pos < end) {
+      Local<Value> key, value;
+      if (!NDbusCodecAlign(r, 8) ||
+          !NDbusCodecDecode(r, program, key_pc, decode_flags, depth + 1, &key) ||
+          !NDbusCodecDecode(r, program, value_pc, decode_flags, depth + 1, &value))
+        return FALSE;
+      if (map)
+        dict_map->Set(context, key, value).ToLocalChecked();
+      else
+        dict_obj->ForceSet(key, value, None);
+    }
+    if (map)
+      *ret = dict_map;
+    else
+      *ret = dict_obj;
+    return r->pos == end;
+  }
+
+#ifdef NDBUS_HAVE_BIGINT
+  if ((decode_flags & NDBUS_DECODE_BIGINT) &&
+      (element_type == DBUS_TYPE_INT64 || element_type == DBUS_TYPE_UINT64)) {
+    if (len % 8)
+      return FALSE;
+    Local<ArrayBuffer> buffer = ArrayBuffer::New(isolate, len);
+    guint64 *values = (guint64 *) buffer->GetContents().Data();
+    memcpy(values, r->data + r->pos, len);
+    if (r->swap) {
+      for (guint i = 0; i < len / 8; i++)
+        values[i] = GUINT64_SWAP_LE_BE(values[i]);
+    }
+    r->pos = end;
+    if (element_type == DBUS_TYPE_INT64)
+      *ret = BigInt64Array::New(buffer, 0, len / 8);
+    else
+      *ret = BigUint64Array::New(buffer, 0, len / 8);
+    return TRUE;
+  }
+#endif
+
+  //known up front for fixed-width elements, the rest is grown
+  guint count = 0;
+  switch (element_type) {
+    case DBUS_TYPE_BYTE:
+      count = len;
+      break;
+    case DBUS_TYPE_INT16:
+    case DBUS_TYPE_UINT16:
+      count = len / 2;
+      break;
+    case DBUS_TYPE_BOOLEAN:
+    case DBUS_TYPE_INT32:
+    case DBUS_TYPE_UINT32:
+      count = len / 4;
+      break;
+    case DBUS_TYPE_INT64:
+    case DBUS_TYPE_UINT64:
+    case DBUS_TYPE_DOUBLE:
+      count = len / 8;
+      break;
+  }
+
+  Local<Array> arr = Array::New(isolate, count);
+  guint i = 0;
+  while (r->pos < end) {
+    Local<Value> value;
+    if (!NDbusCodecDecode(r, program, element_pc, decode_flags, depth + 1, &value))
+      return FALSE;
+    arr->Set(i++, value);
+  }
+  *ret = arr;
+  return r->pos == end;
+}
+
+static Local<Value>
+NDbusCodecNewString (const gchar *value, guint32 len) {
+  Isolate* isolate = Isolate::GetCurrent();
+  if (NDbusIsAscii(value, len))
+    return v8::String::NewFromOneByte(isolate, (const uint8_t *) value,
+        v8::NewStringType::kNormal, len).ToLocalChecked();
+  return v8::String::NewFromUtf8(isolate, value,
+      v8::String::kNormalString, len);
+}
+
+/**
+ * Reads the complete type at pc of program into *ret, the same way
+ * NDbusExtractMessageArgs does.
+ * @return FALSE if the body does not hold it
+ */
+static gboolean
+NDbusCodecDecode (NDbusCodecReader *r, const NDbusCodecProgram *program,
+    guint pc, guint decode_flags, guint depth, Local<Value> *ret) {
+  Isolate* isolate = Isolate::GetCurrent();
+  EscapableHandleScope scope(isolate);
+
+  if (depth > NDBUS_CODEC_MAX_DEPTH)
+    return FALSE;
+
+  Local<Value> value;
+  gchar type = program->signature[pc];
+  switch (type) {
+    case DBUS_TYPE_BOOLEAN:
+      {
+        guint32 val;
+        if (!NDbusCodecGet(r, &val, 4) || val > 1)
+          return FALSE;
+        value = Boolean::New(isolate, val);
+        break;
+      }
+    case DBUS_TYPE_BYTE:
+      {
+        guint8 val;
+        if (!NDbusCodecGet(r, &val, 1))
+          return FALSE;
+        value = Uint32::NewFromUnsigned(isolate, val);
+        break;
+      }
+    case DBUS_TYPE_INT16:
+      {
+        gint16 val;
+        if (!NDbusCodecGet(r, &val, 2))
+          return FALSE;
+        value = Int32::New(isolate, val);
+        break;
+      }
+    case DBUS_TYPE_UINT16:
+      {
+        guint16 val;
+        if (!NDbusCodecGet(r, &val, 2))
+          return FALSE;
+        value = Uint32::NewFromUnsigned(isolate, val);
+        break;
+      }
+    case DBUS_TYPE_INT32:
+      {
+        gint32 val;
+        if (!NDbusCodecGet(r, &val, 4))
+          return FALSE;
+        value = Int32::New(isolate, val);
+        break;
+      }
+    case DBUS_TYPE_UINT32:
+      {
+        guint32 val;
+        if (!NDbusCodecGet(r, &val, 4))
+          return FALSE;
+        value = Uint32::NewFromUnsigned(isolate, val);
+        break;
+      }
+    case DBUS_TYPE_INT64:
+      {
+        gint64 val;
+        if (!NDbusCodecGet(r, &val, 8))
+          return FALSE;
+#ifdef NDBUS_HAVE_BIGINT
+        if ((decode_flags & NDBUS_DECODE_BIGINT) ||
+            ((decode_flags & NDBUS_DECODE_BIGINT_UNSAFE) &&
+             (val > NDBUS_MAX_SAFE_INTEGER || val < -NDBUS_MAX_SAFE_INTEGER))) {
+          value = BigInt::New(isolate, val);
+          break;
+        }
+#endif
+        value = Number::New(isolate, val);
+        break;
+      }
+    case DBUS_TYPE_UINT64:
+      {
+        guint64 val;
+        if (!NDbusCodecGet(r, &val, 8))
+          return FALSE;
+#ifdef NDBUS_HAVE_BIGINT
+        if ((decode_flags & NDBUS_DECODE_BIGINT) ||
+            ((decode_flags & NDBUS_DECODE_BIGINT_UNSAFE) &&
+             val > (guint64) NDBUS_MAX_SAFE_INTEGER)) {
+          value = BigInt::NewFromUnsigned(isolate, val);
+          break;
+        }
+#endif
+        value = Number::New(isolate, val);
+        break;
+      }
+    case DBUS_TYPE_DOUBLE:
+      {
+        gdouble val;
+        if (!NDbusCodecGet(r, &val, 8))
+          return FALSE;
+        value = Number::New(isolate, val);
+        break;
+      }
+    case DBUS_TYPE_SIGNATURE:
+    case DBUS_TYPE_OBJECT_PATH:
+    case DBUS_TYPE_STRING:
+      {
+        const gchar *val;
+        guint32 len;
+        if (!NDbusCodecGetString(r, type, &val, &len))
+          return FALSE;
+        value = NDbusCodecNewString(val, len);
+        break;
+      }
+    case DBUS_TYPE_ARRAY:
+      if (!NDbusCodecDecodeArray(r, program, pc, decode_flags, depth, &value))
+        return FALSE;
+      break;
+    case DBUS_STRUCT_BEGIN_CHAR:
+      {
+        guint count = 0;
+        for (guint i = pc + 1; program->signature[i] != DBUS_STRUCT_END_CHAR;
+            i = program->next[i])
+          count++;
+
+        if (!NDbusCodecAlign(r, 8))
+          return FALSE;
+        Local<Array> arr = Array::New(isolate, count);
+        guint i = pc + 1;
+        for (guint n = 0; n < count; n++) {
+          Local<Value> member;
+          if (!NDbusCodecDecode(r, program, i, decode_flags, depth + 1, &member))
+            return FALSE;
+          arr->Set(n, member);
+          i = program->next[i];
+        }
+        value = arr;
+        break;
+      }
+    case DBUS_TYPE_VARIANT:
+      {
+        const gchar *vsignature;
+        guint32 len;
+        if (!NDbusCodecGetString(r, DBUS_TYPE_SIGNATURE, &vsignature, &len))
+          return FALSE;
+        NDbusCodecProgram *vprogram = NDbusCodecLookupProgram(vsignature);
+        gboolean ok = vprogram && vprogram->n_args == 1 &&
+          NDbusCodecDecode(r, vprogram, 0, decode_flags, depth + 1, &value);
+        NDbusCodecProgramUnref(vprogram);
+        if (!ok)
+          return FALSE;
+        break;
+      }
+    default:
+      return FALSE;
+  }
+  *ret = scope.Escape(value);
+  return TRUE;
+}
+
+//EXPOSED
+/**
+ * Reads the arguments of msg with the codec from a marshalled copy of
+ * it, which costs one copy of the message.
+ * @return the arguments, or an empty handle if the codec cannot read
+ * them, as with unix fds, and the iterators have to
+ */
+Local<Value>
+NDbusCodecRetrieveMessageArgs (DBusMessage *msg, guint decode_flags) {
+  Isolate* isolate = Isolate::GetCurrent();
+  EscapableHandleScope scope(isolate);
+
+  const gchar *signature = dbus_message_get_signature(msg);
+  NDbusCodecProgram *program = NDbusCodecLookupProgram(signature);
+  if (!program)
+    return Local<Value>();
+
+  gchar *data = NULL;
+  gint len = 0;
+  if (!dbus_message_marshal(msg, &data, &len)) {
+    NDbusCodecProgramUnref(program);
+    return Local<Value>();
+  }
+
+  NDbusCodecReader r = { (const guint8 *) data, 0, 0,
+    data[0] != DBUS_COMPILER_BYTE_ORDER };
+  guint32 body_len, fields_len;
+  memcpy(&body_len, data + 4, 4);
+  memcpy(&fields_len, data + 12, 4);
+  if (r.swap) {
+    body_len = GUINT32_SWAP_LE_BE(body_len);
+    fields_len = GUINT32_SWAP_LE_BE(fields_len);
+  }
+  r.pos = NDBUS_CODEC_ALIGN(NDBUS_CODEC_HEADER_SIZE + (gsize) fields_len, 8);
+  r.len = r.pos + body_len;
+
+  Local<Array> args = Array::New(isolate, program->n_args);
+  gboolean ok = r.len <= (gsize) len;
+  for (guint i = 0; ok && i < program->n_args; i++) {
+    Local<Value> value;
+    ok = NDbusCodecDecode(&r, program, program->args[i],
+        decode_flags, 0, &value);
+    if (ok)
+      args->Set(i, value);
+  }
+  ok = ok && r.pos == r.len;
+  dbus_free(data);
+  NDbusCodecProgramUnref(program);
+
+  if (!ok)
+    return Local<Value>();
+  return scope.Escape(args);
+}
+
+} //namespace ndbus
@@ -14,6 +14,15 @@
 namespace ndbus {
 extern "C" {
 
+/**
+ * A poll handle along with the connection it writes for, if any,
+ * to tell it when its outgoing queue may have drained.
+ */
+typedef struct {
+  uv_poll_t iow;
+  NDbusConnectionInfo *cnxn_info;
+} NDbusWatchInfo;
+
 static void
 handle_asyncw_freed (void *data) {
   uv_async_t *asyncw = (uv_async_t *)data;
@@ -50,7 +59,17 @@ iow_cb (uv_poll_t *w, gint status, gint events) {
   }
 #endif
 
+  NDbusConnectionInfo *cnxn_info = ((NDbusWatchInfo *)w)->cnxn_info;
+  glong queued = NDBUS_PROBE_ENABLED(flush) && (events & UV_WRITABLE) &&
+    cnxn_info && cnxn_info->cnxn ?
+    dbus_connection_get_outgoing_size(cnxn_info->cnxn) : 0;
+
   dbus_watch_handle (watch, dbus_condition);
+
+  if (queued > 0 && cnxn_info->cnxn)
+    NDBUS_PROBE_FLUSH(cnxn_info->cnxn, queued);
+  if ((events & UV_WRITABLE) && cnxn_info)
+    NDbusCheckDrain(cnxn_info);
 }
 
 static dbus_bool_t
@@ -68,11 +87,16 @@ add_watch (DBusWatch *watch, void *data) {
   if (flags & DBUS_WATCH_WRITABLE)
     events |= UV_WRITABLE;
 
-  uv_poll_t *iow = g_new0(uv_poll_t, 1);
+  NDbusWatchInfo *watch_info = g_new0(NDbusWatchInfo, 1);
+  watch_info->cnxn_info = (NDbusConnectionInfo *)data;
+  uv_poll_t *iow = &watch_info->iow;
   iow->data = (void *)watch;
   uv_poll_init(uv_default_loop(), iow, fd);
   uv_poll_start(iow, events, iow_cb);
-  uv_unref((uv_handle_t *)iow);
+  //a listening server and a connection with messages
+  //still to write should keep the loop alive
+  if (data && !(flags & DBUS_WATCH_WRITABLE))
+    uv_unref((uv_handle_t *)iow);
 
   dbus_watch_set_data(watch, (void *)iow, handle_iow_freed);
   return true;
@@ -156,18 +180,24 @@ wakeup_ev (void *data) {
 static void
 asyncw_cb (uv_async_t *w) {
   DBusConnection *bus_cnxn = (DBusConnection *)w->data;
+  guint64 started = NDbusMetricsNow();
   dbus_connection_read_write(bus_cnxn, 0);
   while (dbus_connection_dispatch(bus_cnxn) ==
       DBUS_DISPATCH_DATA_REMAINS);
+  NDbusCountDispatch(started);
 }
 
+} //extern "C"
+
 gboolean
-NDbusConnectionSetupWithEvLoop (DBusConnection *bus_cnxn) {
+NDbusConnectionSetupWithEvLoop (NDbusConnectionInfo *cnxn_info) {
+  DBusConnection *bus_cnxn = cnxn_info->cnxn;
   if (!dbus_connection_set_watch_functions (bus_cnxn,
       add_watch,
       remove_watch,
       watch_toggled,
-      NULL, NULL))
+      (void *)NDbusConnectionInfoRef(cnxn_info),
+      (DBusFreeFunction)NDbusConnectionInfoUnref))
     return false;
 
   if (!dbus_connection_set_timeout_functions(bus_cnxn,
@@ -188,5 +218,23 @@ NDbusConnectionSetupWithEvLoop (DBusConnection *bus_cnxn) {
   return true;
 }
 
-} //extern "C"
+gboolean
+NDbusServerSetupWithEvLoop (DBusServer *server) {
+  if (!dbus_server_set_watch_functions (server,
+      add_watch,
+      remove_watch,
+      watch_toggled,
+      NULL, NULL))
+    return false;
+
+  if (!dbus_server_set_timeout_functions(server,
+      add_timeout,
+      remove_timeout,
+      timeout_toggled,
+      NULL, NULL))
+    return false;
+
+  return true;
+}
+
 } //namespace ndbus
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2011, Motorola Mobility, Inc
+ * All Rights Reserved.
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+#include "ndbus.h"
+#include <node_buffer.h>
+
+extern "C" {
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#ifndef MFD_CLOEXEC
+#include <linux/memfd.h>
+#endif
+#endif
+}
+
+#if defined(SYS_memfd_create) && defined(F_ADD_SEALS) && defined(MFD_ALLOW_SEALING)
+#define NDBUS_HAVE_MEMFD
+#endif
+
+#define NDBUS_MEMFD_NAME              "ndbus"
+#define NDBUS_MEMFD_SEALS             (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL)
+
+namespace ndbus {
+
+#ifdef NDBUS_HAVE_MEMFD
+static gint
+NDbusWriteAll (gint fd, const gchar *data, gsize len) {
+  gsize written = 0;
+  while (written < len) {
+    gssize ret = write(fd, data + written, len - written);
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    written += ret;
+  }
+  return 0;
+}
+
+static void
+NDbusUnmapBuffer (gchar *data, void *hint) {
+  munmap(data, GPOINTER_TO_SIZE(hint));
+}
+#endif
+
+//EXPOSED
+/**
+ * Copies a Buffer into an anonymous memory file and seals it, so that the
+ * receiver can map it without fearing it to shrink or change underneath.
+ * The descriptor is returned to JS, which closes it once it is sent.
+ */
+void
+NDbusCreateMemfd (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  if (!node::Buffer::HasInstance(args[0]))
+    NDBUS_THROW_EXCPN(DBUS_ERROR_INVALID_ARGS, "Invalid buffer");
+
+#ifdef NDBUS_HAVE_MEMFD
+  const gchar *data = node::Buffer::Data(args[0]);
+  gsize len = node::Buffer::Length(args[0]);
+
+  gint fd = syscall(SYS_memfd_create, NDBUS_MEMFD_NAME,
+      MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (fd < 0)
+    NDBUS_THROW_EXCPN(DBUS_ERROR_FAILED, g_strerror(errno));
+
+  if (ftruncate(fd, len) < 0 ||
+      NDbusWriteAll(fd, data, len) < 0 ||
+      fcntl(fd, F_ADD_SEALS, NDBUS_MEMFD_SEALS) < 0) {
+    const gchar *message = g_strerror(errno);
+    close(fd);
+    NDBUS_THROW_EXCPN(DBUS_ERROR_FAILED, message);
+  }
+
+  args.GetReturnValue().Set(Int32::New(isolate, fd));
+#else
+  NDBUS_EXCPN_MEMFD;
+#endif
+}
+
+//EXPOSED
+/**
+ * Maps a sealed memory file received as 'h' into a Buffer. The mapping is
+ * private, so writes to the Buffer stay local, and it is unmapped when the
+ * Buffer is collected. The descriptor itself is left to the caller.
+ */
+void
+NDbusMapFd (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  if (!args[0]->IsInt32() || args[0]->Int32Value() < 0)
+    NDBUS_EXCPN_FD;
+
+#ifdef NDBUS_HAVE_MEMFD
+  gint fd = args[0]->Int32Value();
+
+  //an unsealed file may be truncated by the sender while mapped
+  gint seals = fcntl(fd, F_GET_SEALS);
+  if (seals < 0 ||
+      (seals & (F_SEAL_SHRINK | F_SEAL_WRITE)) != (F_SEAL_SHRINK | F_SEAL_WRITE))
+    NDBUS_THROW_EXCPN(DBUS_ERROR_ACCESS_DENIED, "File descriptor is not sealed");
+
+  struct stat st;
+  if (fstat(fd, &st) < 0)
+    NDBUS_THROW_EXCPN(DBUS_ERROR_FAILED, g_strerror(errno));
+
+  gsize len = st.st_size;
+  if (!len) {
+    args.GetReturnValue().Set(node::Buffer::New(isolate, 0).ToLocalChecked());
+    return;
+  }
+
+  gpointer data = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED)
+    NDBUS_THROW_EXCPN(DBUS_ERROR_FAILED, g_strerror(errno));
+
+  Local<Object> buffer;
+  if (!node::Buffer::New(isolate, (gchar *)data, len,
+        NDbusUnmapBuffer, GSIZE_TO_POINTER(len)).ToLocal(&buffer)) {
+    munmap(data, len);
+    NDBUS_EXCPN_OOM;
+  }
+  args.GetReturnValue().Set(buffer);
+#else
+  NDBUS_EXCPN_MEMFD;
+#endif
+}
+
+} //namespace ndbus
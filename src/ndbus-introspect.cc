@@ -0,0 +1,450 @@
+/*
+ * Copyright (c) 2011, Motorola Mobility, Inc
+ * All Rights Reserved.
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+#include "ndbus.h"
+
+namespace ndbus {
+
+#define NDBUS_MEMBER_METHOD           'm'
+#define NDBUS_MEMBER_SIGNAL           's'
+#define NDBUS_MEMBER_PROPERTY         'p'
+
+/**
+ * Where the parser is in the XML. Only the interfaces and children of
+ * the outermost <node> are the object's own.
+ */
+typedef struct {
+  NDbusIntrospection *introspection;
+  gchar *interface;
+  NDbusIntrospectMember *member;
+  GString *in;
+  GString *out;
+  guint node_depth;
+} NDbusIntrospectParser;
+
+static void
+NDbusFreeIntrospectMember (gpointer data) {
+  NDbusIntrospectMember *member = (NDbusIntrospectMember *)data;
+  if (member) {
+    g_free(member->interface);
+    g_free(member->name);
+    g_free(member->signature);
+    g_free(member->reply_signature);
+    g_free(member->access);
+    g_free(member);
+  }
+}
+
+//EXPOSED
+void
+NDbusFreeIntrospection (gpointer data) {
+  NDbusIntrospection *introspection = (NDbusIntrospection *)data;
+  if (introspection) {
+    g_slist_free_full(introspection->waiters,
+        (GDestroyNotify) NDbusFreeCallbackInfo);
+    g_ptr_array_unref(introspection->members);
+    g_ptr_array_unref(introspection->nodes);
+    g_free(introspection->owner);
+    g_free(introspection);
+  }
+}
+
+static gchar*
+NDbusIntrospectKey (const gchar *owner, const gchar *path) {
+  //a space is in neither bus names nor object paths
+  return g_strconcat(owner ? owner : "", " ", path, NULL);
+}
+
+static gboolean
+NDbusIsIntrospectionOf (gpointer key, gpointer value,
+    gpointer user_data) {
+  NDbusIntrospection *introspection = (NDbusIntrospection *)value;
+  //one still being fetched has nothing to forget yet
+  return introspection->resolved &&
+    g_strcmp0(introspection->owner, (const gchar *)user_data) == 0;
+}
+
+/**
+ * Forgets every object introspected on owner, which is gone or has
+ * been replaced, so that the next proxy() asks again.
+ */
+void
+NDbusInvalidateIntrospections (NDbusConnectionInfo *cnxn_info,
+    const gchar *owner) {
+  g_hash_table_foreach_remove(cnxn_info->introspections,
+      NDbusIsIntrospectionOf, (gpointer)owner);
+}
+
+static const gchar*
+NDbusGetAttribute (const gchar **names, const gchar **values,
+    const gchar *name) {
+  for (; *names; names++, values++) {
+    if (g_str_equal(*names, name))
+      return *values;
+  }
+  return NULL;
+}
+
+static void
+NDbusIntrospectStart (GMarkupParseContext *context,
+    const gchar *element, const gchar **names, const gchar **values,
+    gpointer user_data, GError **error) {
+  NDbusIntrospectParser *parser = (NDbusIntrospectParser *)user_data;
+  const gchar *name = NDbusGetAttribute(names, values, "name");
+
+  if (g_str_equal(element, "node")) {
+    //children are listed by a relative name, or inlined in full
+    if (++parser->node_depth == 2 && name)
+      g_ptr_array_add(parser->introspection->nodes, g_strdup(name));
+    return;
+  }
+  if (parser->node_depth != 1)
+    return;
+
+  if (g_str_equal(element, "interface")) {
+    if (!name || parser->interface) {
+      g_set_error_literal(error, G_MARKUP_ERROR,
+          G_MARKUP_ERROR_INVALID_CONTENT, NDBUS_ERROR_INTROSPECT);
+      return;
+    }
+    parser->interface = g_strdup(name);
+    return;
+  }
+
+  gchar kind;
+  if (g_str_equal(element, "method"))
+    kind = NDBUS_MEMBER_METHOD;
+  else if (g_str_equal(element, "signal"))
+    kind = NDBUS_MEMBER_SIGNAL;
+  else if (g_str_equal(element, "property"))
+    kind = NDBUS_MEMBER_PROPERTY;
+  else if (g_str_equal(element, "arg") && parser->member) {
+    const gchar *type = NDbusGetAttribute(names, values, "type");
+    const gchar *direction = NDbusGetAttribute(names, values, "direction");
+    if (!type) {
+      g_set_error_literal(error, G_MARKUP_ERROR,
+          G_MARKUP_ERROR_MISSING_ATTRIBUTE, NDBUS_ERROR_INTROSPECT);
+      return;
+    }
+    //method arguments are in unless stated, signal ones always out
+    if (parser->member->kind == NDBUS_MEMBER_METHOD &&
+        g_strcmp0(direction, "out") != 0)
+      g_string_append(parser->in, type);
+    else
+      g_string_append(parser->out, type);
+    return;
+  } else
+    return;
+
+  if (!name || !parser->interface || parser->member) {
+    g_set_error_literal(error, G_MARKUP_ERROR,
+        G_MARKUP_ERROR_INVALID_CONTENT, NDBUS_ERROR_INTROSPECT);
+    return;
+  }
+
+  NDbusIntrospectMember *member = g_new0(NDbusIntrospectMember, 1);
+  member->interface = g_strdup(parser->interface);
+  member->name = g_strdup(name);
+  member->kind = kind;
+  if (kind == NDBUS_MEMBER_PROPERTY) {
+    member->signature =
+      g_strdup(NDbusGetAttribute(names, values, "type"));
+    member->access =
+      g_strdup(NDbusGetAttribute(names, values, "access"));
+  }
+  parser->member = member;
+  g_string_truncate(parser->in, 0);
+  g_string_truncate(parser->out, 0);
+}
+
+static void
+NDbusIntrospectEnd (GMarkupParseContext *context,
+    const gchar *element, gpointer user_data, GError **error) {
+  NDbusIntrospectParser *parser = (NDbusIntrospectParser *)user_data;
+
+  if (g_str_equal(element, "node")) {
+    parser->node_depth--;
+    return;
+  }
+  if (parser->node_depth != 1)
+    return;
+
+  if (g_str_equal(element, "interface")) {
+    g_free(parser->interface);
+    parser->interface = NULL;
+    return;
+  }
+  if (!parser->member || (!g_str_equal(element, "method") &&
+        !g_str_equal(element, "signal") && !g_str_equal(element, "property")))
+    return;
+
+  NDbusIntrospectMember *member = parser->member;
+  parser->member = NULL;
+  if (member->kind == NDBUS_MEMBER_METHOD) {
+    member->signature = g_strdup(parser->in->str);
+    member->reply_signature = g_strdup(parser->out->str);
+  } else if (member->kind == NDBUS_MEMBER_SIGNAL) {
+    member->signature = g_strdup(parser->out->str);
+  }
+
+  //checked here once, so that calls built from it need no more checks
+  if (!member->signature ||
+      !dbus_signature_validate(member->signature, NULL) ||
+      (member->reply_signature &&
+       !dbus_signature_validate(member->reply_signature, NULL)) ||
+      (member->kind == NDBUS_MEMBER_PROPERTY &&
+       !dbus_signature_validate_single(member->signature, NULL))) {
+    NDbusFreeIntrospectMember(member);
+    g_set_error_literal(error, G_MARKUP_ERROR,
+        G_MARKUP_ERROR_INVALID_CONTENT, NDBUS_ERROR_INTROSPECT);
+    return;
+  }
+  g_ptr_array_add(parser->introspection->members, member);
+}
+
+static const GMarkupParser introspect_parser = {
+  NDbusIntrospectStart,
+  NDbusIntrospectEnd,
+  NULL,
+  NULL,
+  NULL
+};
+
+/**
+ * Parses the XML returned by Introspect into introspection.
+ */
+static gboolean
+NDbusParseIntrospection (NDbusIntrospection *introspection,
+    const gchar *xml) {
+  NDbusIntrospectParser parser = { introspection, NULL, NULL,
+    g_string_new(NULL), g_string_new(NULL), 0 };
+  GMarkupParseContext *context = g_markup_parse_context_new(
+      &introspect_parser, (GMarkupParseFlags) 0, &parser, NULL);
+
+  gboolean parsed =
+    g_markup_parse_context_parse(context, xml, -1, NULL) &&
+    g_markup_parse_context_end_parse(context, NULL);
+
+  g_markup_parse_context_free(context);
+  NDbusFreeIntrospectMember(parser.member);
+  g_free(parser.interface);
+  g_string_free(parser.in, TRUE);
+  g_string_free(parser.out, TRUE);
+  return parsed;
+}
+
+static Local<Object>
+NDbusGetChild (Local<Object> parent, const gchar *name) {
+  Isolate* isolate = Isolate::GetCurrent();
+  Local<v8::String> key = v8::String::NewFromUtf8(isolate, name);
+  Local<Value> child = parent->Get(key);
+  if (child->IsObject())
+    return Local<Object>::Cast(child);
+
+  Local<Object> obj = Object::New(isolate);
+  parent->Set(key, obj);
+  return obj;
+}
+
+/**
+ * { interfaces: { <interface>: { methods: { <name>: { signature,
+ * replySignature } }, signals: { <name>: { signature } },
+ * properties: { <name>: { signature, access } } } }, nodes: [...] }
+ */
+static Local<Object>
+NDbusDescribeIntrospection (NDbusIntrospection *introspection) {
+  Isolate* isolate = Isolate::GetCurrent();
+  EscapableHandleScope scope(isolate);
+
+  Local<Object> description = Object::New(isolate);
+  Local<Object> interfaces = NDbusGetChild(description, "interfaces");
+  for (guint i = 0; i < introspection->members->len; i++) {
+    NDbusIntrospectMember *member = (NDbusIntrospectMember *)
+      g_ptr_array_index(introspection->members, i);
+    Local<Object> iface = NDbusGetChild(interfaces, member->interface);
+    Local<Object> entry = NDbusGetChild(NDbusGetChild(iface,
+          member->kind == NDBUS_MEMBER_METHOD ? "methods" :
+          member->kind == NDBUS_MEMBER_SIGNAL ? "signals" : "properties"),
+        member->name);
+    entry->Set(v8::String::NewFromUtf8(isolate, NDBUS_PROPERTY_ENTRY_SIGN),
+        v8::String::NewFromUtf8(isolate, member->signature));
+    if (member->reply_signature)
+      entry->Set(v8::String::NewFromUtf8(isolate, NDBUS_PROPERTY_REPLY_SIGN),
+          v8::String::NewFromUtf8(isolate, member->reply_signature));
+    if (member->access)
+      entry->Set(v8::String::NewFromUtf8(isolate, "access"),
+          v8::String::NewFromUtf8(isolate, member->access));
+  }
+
+  Local<Array> nodes = Array::New(isolate, introspection->nodes->len);
+  for (guint i = 0; i < introspection->nodes->len; i++)
+    nodes->Set(i, v8::String::NewFromUtf8(isolate,
+          (const gchar *) g_ptr_array_index(introspection->nodes, i)));
+  description->Set(v8::String::NewFromUtf8(isolate, "nodes"), nodes);
+  return scope.Escape(description);
+}
+
+static void
+NDbusNotifyIntrospectWaiters (GSList *waiters,
+    Local<Value> error, Local<Value> description) {
+  Isolate* isolate = Isolate::GetCurrent();
+  Local<Value> argv[2];
+  argv[0] = error;
+  argv[1] = description;
+
+  GSList *tmp = waiters;
+  while (tmp != NULL) {
+    NDbusCallbackInfo *waiter = (NDbusCallbackInfo *)tmp->data;
+    Local<Function> func =
+      Local<Function>::New(isolate, waiter->callback);
+    if (NDbusIsValidV8Value(func))
+      func->Call(func, 2, argv);
+    tmp = g_slist_next(tmp);
+  }
+  g_slist_free_full(waiters, (GDestroyNotify) NDbusFreeCallbackInfo);
+}
+
+static void
+NDbusHandleIntrospectReply (DBusPendingCall *pending,
+    void *user_data) {
+  g_return_if_fail(pending != NULL);
+
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  NDbusCallbackInfo *cb_info = (NDbusCallbackInfo *)user_data;
+  NDbusConnectionInfo *cnxn_info = cb_info->cnxn_info;
+  DBusMessage *reply = dbus_pending_call_steal_reply(pending);
+  dbus_pending_call_unref(pending);
+
+  NDbusIntrospection *introspection = cnxn_info->cnxn ?
+    (NDbusIntrospection *) g_hash_table_lookup(cnxn_info->introspections,
+        cb_info->name) : NULL;
+  if (introspection == NULL) {
+    if (reply)
+      dbus_message_unref(reply);
+    return;
+  }
+
+  Local<Value> error = Undefined(isolate);
+  const gchar *xml = NULL;
+  DBusError dbus_error;
+  dbus_error_init(&dbus_error);
+  if (!reply) {
+    NDBUS_SET_EXCPN(error, DBUS_ERROR_NO_REPLY, NDBUS_ERROR_NOREPLY);
+  } else if (dbus_set_error_from_message(&dbus_error, reply) ||
+      !dbus_message_get_args(reply, &dbus_error,
+        DBUS_TYPE_STRING, &xml, DBUS_TYPE_INVALID)) {
+    NDBUS_SET_EXCPN(error, dbus_error.name, dbus_error.message);
+    dbus_error_free(&dbus_error);
+  } else if (!NDbusParseIntrospection(introspection, xml)) {
+    NDBUS_SET_EXCPN(error, DBUS_ERROR_INVALID_ARGS, NDBUS_ERROR_INTROSPECT);
+  } else {
+    introspection->resolved = TRUE;
+  }
+
+  GSList *waiters = introspection->waiters;
+  introspection->waiters = NULL;
+  if (introspection->resolved) {
+    NDbusNotifyIntrospectWaiters(waiters, error,
+        NDbusDescribeIntrospection(introspection));
+  } else {
+    //failures are not cached, the next caller asks again
+    g_hash_table_remove(cnxn_info->introspections, cb_info->name);
+    NDbusNotifyIntrospectWaiters(waiters, error, Undefined(isolate));
+  }
+  if (reply)
+    dbus_message_unref(reply);
+}
+
+//EXPOSED
+/**
+ * Hands callback the description of the object at args[1] of the
+ * unique name args[0], or of the peer if args[0] is null. Objects are
+ * introspected once per owner and path, concurrent callers share the
+ * one Introspect call.
+ */
+void
+NDbusIntrospect (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  NDbusConnectionInfo *cnxn_info = NDbusGetConnection(args.This());
+  if (!cnxn_info || !cnxn_info->cnxn)
+    NDBUS_EXCPN_DISCONNECTED;
+  if (!args[2]->IsFunction())
+    NDBUS_EXCPN_CALLBACK;
+
+  gchar *owner = NDbusV8StringToCStr(args[0]);
+  gchar *path = NDbusV8StringToCStr(args[1]);
+  if ((owner && !dbus_validate_bus_name(owner, NULL)) ||
+      (!owner && !cnxn_info->peer)) {
+    g_free(owner);
+    g_free(path);
+    NDBUS_EXCPN_NAME;
+  }
+  if (!path || !dbus_validate_path(path, NULL)) {
+    g_free(owner);
+    g_free(path);
+    NDBUS_EXCPN_PATH;
+  }
+
+  gchar *key = NDbusIntrospectKey(owner, path);
+  NDbusIntrospection *introspection = (NDbusIntrospection *)
+    g_hash_table_lookup(cnxn_info->introspections, key);
+  gboolean queried = TRUE;
+
+  if (introspection == NULL) {
+    DBusMessage *msg = dbus_message_new_method_call(owner, path,
+        DBUS_INTERFACE_INTROSPECTABLE, "Introspect");
+    DBusPendingCall *pending = NULL;
+    queried = msg && dbus_connection_send_with_reply(cnxn_info->cnxn,
+        msg, &pending, DBUS_TIMEOUT_USE_DEFAULT) && pending;
+    if (msg)
+      dbus_message_unref(msg);
+
+    if (queried) {
+      introspection = g_new0(NDbusIntrospection, 1);
+      introspection->owner = g_strdup(owner);
+      introspection->members =
+        g_ptr_array_new_with_free_func(NDbusFreeIntrospectMember);
+      introspection->nodes = g_ptr_array_new_with_free_func(g_free);
+      g_hash_table_insert(cnxn_info->introspections,
+          g_strdup(key), introspection);
+
+      NDbusCallbackInfo *cb_info = g_new0(NDbusCallbackInfo, 1);
+      cb_info->cnxn_info = NDbusConnectionInfoRef(cnxn_info);
+      cb_info->name = g_strdup(key);
+      dbus_pending_call_set_notify(pending, NDbusHandleIntrospectReply,
+          (void *)cb_info, NDbusFreeCallbackInfo);
+    }
+  }
+  g_free(owner);
+  g_free(path);
+  g_free(key);
+  if (!queried)
+    NDBUS_EXCPN_OOM;
+
+  Local<Function> callback = Local<Function>::Cast(args[2]);
+  if (introspection->resolved) {
+    Local<Value> argv[2];
+    argv[0] = Undefined(isolate);
+    argv[1] = NDbusDescribeIntrospection(introspection);
+    callback->Call(callback, 2, argv);
+  } else {
+    NDbusCallbackInfo *waiter = g_new0(NDbusCallbackInfo, 1);
+    waiter->callback.Reset(isolate, callback);
+    introspection->waiters = g_slist_append(introspection->waiters, waiter);
+  }
+
+  args.GetReturnValue().Set(TRUE);
+}
+
+} //namespace ndbus
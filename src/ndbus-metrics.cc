@@ -0,0 +1,434 @@
+/*
+ * Copyright (c) 2011, Motorola Mobility, Inc
+ * All Rights Reserved.
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+#include "ndbus.h"
+
+namespace ndbus {
+
+/**
+ * Latencies are kept in microseconds, HDR style: exact below 8, then
+ * 8 buckets for every power of 2, so that a bucket is at most 12.5%
+ * wide. The last one, from about 19 hours on, takes whatever is longer.
+ */
+#define NDBUS_LATENCY_SUB_BUCKETS  8
+#define NDBUS_LATENCY_BUCKETS      272
+
+struct _NDbusLatency {
+  gchar *destination;
+  gchar *interface;
+  gchar *member;
+  guint64 count;
+  guint64 sum;
+  guint64 max;
+  guint64 buckets[NDBUS_LATENCY_BUCKETS];
+};
+
+/**
+ * A method-call in flight, in a data slot of its pending call.
+ */
+typedef struct {
+  NDbusConnectionInfo *cnxn_info;
+  NDbusLatency *latency;
+  guint64 sent_at;
+} NDbusCallTiming;
+
+/**
+ * The work all connections share the loop for, in nanoseconds.
+ */
+typedef struct {
+  guint64 encodes;
+  guint64 encode_time;
+  guint64 decodes;
+  guint64 decode_time;
+  guint64 dispatches;
+  guint64 dispatch_time;
+  guint64 dispatch_max;
+} NDbusLoopMetrics;
+
+static NDbusLoopMetrics loop_metrics;
+static dbus_int32_t timing_slot = -1;
+
+static const gchar *message_types[DBUS_NUM_MESSAGE_TYPES] = {
+  NULL, "methodCall", "methodReturn", "error", "signal"
+};
+
+static void
+NDbusFreeLatency (gpointer data) {
+  NDbusLatency *latency = (NDbusLatency *)data;
+  g_free(latency->destination);
+  g_free(latency->interface);
+  g_free(latency->member);
+  g_free(latency);
+}
+
+static guint
+NDbusLatencyBucket (guint64 usec) {
+  if (usec < NDBUS_LATENCY_SUB_BUCKETS)
+    return usec;
+  guint exponent = g_bit_storage(usec) - 1;
+  guint bucket = (exponent - 2) * NDBUS_LATENCY_SUB_BUCKETS +
+    ((usec >> (exponent - 3)) & (NDBUS_LATENCY_SUB_BUCKETS - 1));
+  return MIN(bucket, NDBUS_LATENCY_BUCKETS - 1);
+}
+
+/**
+ * The microseconds every latency in bucket is below.
+ */
+static guint64
+NDbusLatencyBucketEnd (guint bucket) {
+  if (bucket < NDBUS_LATENCY_SUB_BUCKETS)
+    return bucket + 1;
+  guint exponent = bucket / NDBUS_LATENCY_SUB_BUCKETS + 2;
+  return (guint64)(NDBUS_LATENCY_SUB_BUCKETS +
+      bucket % NDBUS_LATENCY_SUB_BUCKETS + 1) << (exponent - 3);
+}
+
+static void
+NDbusFreeCallTiming (void *data) {
+  NDbusCallTiming *timing = (NDbusCallTiming *)data;
+  timing->cnxn_info->metrics.pending_calls--;
+  NDbusConnectionInfoUnref(timing->cnxn_info);
+  g_free(timing);
+}
+
+//EXPOSED
+guint64
+NDbusMetricsNow (void) {
+  return uv_hrtime();
+}
+
+//EXPOSED
+void
+NDbusCountEncode (guint64 started) {
+  loop_metrics.encodes++;
+  loop_metrics.encode_time += uv_hrtime() - started;
+}
+
+//EXPOSED
+void
+NDbusCountDecode (guint64 started) {
+  loop_metrics.decodes++;
+  loop_metrics.decode_time += uv_hrtime() - started;
+}
+
+//EXPOSED
+/**
+ * A turn of dispatching whatever a connection read, started at started.
+ */
+void
+NDbusCountDispatch (guint64 started) {
+  guint64 elapsed = uv_hrtime() - started;
+  loop_metrics.dispatches++;
+  loop_metrics.dispatch_time += elapsed;
+  if (elapsed > loop_metrics.dispatch_max)
+    loop_metrics.dispatch_max = elapsed;
+}
+
+//EXPOSED
+void
+NDbusCountMessage (NDbusConnectionInfo *cnxn_info,
+    DBusMessage *msg, gboolean incoming) {
+  if (incoming)
+    NDBUS_PROBE(receive, msg);
+  else
+    NDBUS_PROBE(queue, msg);
+
+  NDbusMetrics *metrics = &cnxn_info->metrics;
+  gint type = dbus_message_get_type(msg);
+  if (type <= DBUS_MESSAGE_TYPE_INVALID || type >= DBUS_NUM_MESSAGE_TYPES)
+    return;
+  (incoming ? metrics->messages_in : metrics->messages_out)[type]++;
+
+  char *marshalled;
+  int len;
+  if (metrics->count_bytes &&
+      dbus_message_marshal(msg, &marshalled, &len)) {
+    (incoming ? metrics->bytes_in : metrics->bytes_out)[type] += len;
+    dbus_free(marshalled);
+  }
+}
+
+//EXPOSED
+/**
+ * The latencies of the destination, interface and member of call,
+ * which stay as long as cnxn_info does.
+ */
+NDbusLatency*
+NDbusLatencyFor (NDbusConnectionInfo *cnxn_info, DBusMessage *call) {
+  NDbusMetrics *metrics = &cnxn_info->metrics;
+  if (metrics->latencies == NULL)
+    metrics->latencies = g_hash_table_new_full(g_str_hash,
+        g_str_equal, (GDestroyNotify) g_free, NDbusFreeLatency);
+
+  const gchar *destination = dbus_message_get_destination(call);
+  const gchar *interface = dbus_message_get_interface(call);
+  const gchar *member = dbus_message_get_member(call);
+  gchar *key = g_strdup_printf("%s %s %s", destination ? destination : "",
+      interface ? interface : "", member ? member : "");
+
+  NDbusLatency *latency = (NDbusLatency *)
+    g_hash_table_lookup(metrics->latencies, key);
+  if (latency) {
+    g_free(key);
+    return latency;
+  }
+  latency = g_new0(NDbusLatency, 1);
+  latency->destination = g_strdup(destination);
+  latency->interface = g_strdup(interface);
+  latency->member = g_strdup(member);
+  g_hash_table_insert(metrics->latencies, key, latency);
+  return latency;
+}
+
+//EXPOSED
+void
+NDbusRecordLatency (NDbusLatency *latency, guint64 sent_at) {
+  guint64 usec = (uv_hrtime() - sent_at) / 1000;
+  latency->count++;
+  latency->sum += usec;
+  if (usec > latency->max)
+    latency->max = usec;
+  latency->buckets[NDbusLatencyBucket(usec)]++;
+}
+
+//EXPOSED
+/**
+ * Counts call, just sent with pending for its reply, and times it
+ * until NDbusTimeReply. A call which gets no timing goes uncounted.
+ */
+void
+NDbusTimeCall (NDbusConnectionInfo *cnxn_info,
+    DBusMessage *call, DBusPendingCall *pending) {
+  NDbusCountMessage(cnxn_info, call, FALSE);
+  if (timing_slot == -1 &&
+      !dbus_pending_call_allocate_data_slot(&timing_slot))
+    return;
+
+  NDbusCallTiming *timing = g_new0(NDbusCallTiming, 1);
+  timing->cnxn_info = NDbusConnectionInfoRef(cnxn_info);
+  timing->latency = NDbusLatencyFor(cnxn_info, call);
+  timing->sent_at = uv_hrtime();
+  cnxn_info->metrics.pending_calls++;
+  if (!dbus_pending_call_set_data(pending, timing_slot,
+        timing, NDbusFreeCallTiming))
+    NDbusFreeCallTiming(timing);
+}
+
+//EXPOSED
+/**
+ * Records the latency of the call of pending, which got reply,
+ * NULL if it timed out.
+ */
+void
+NDbusTimeReply (DBusPendingCall *pending, DBusMessage *reply) {
+  NDbusCallTiming *timing = timing_slot == -1 ? NULL :
+    (NDbusCallTiming *)dbus_pending_call_get_data(pending, timing_slot);
+  if (timing == NULL)
+    return;
+  NDbusRecordLatency(timing->latency, timing->sent_at);
+  if (reply)
+    NDbusCountMessage(timing->cnxn_info, reply, TRUE);
+}
+
+//EXPOSED
+void
+NDbusFreeMetrics (NDbusMetrics *metrics) {
+  if (metrics->latencies)
+    g_hash_table_unref(metrics->latencies);
+  metrics->latencies = NULL;
+}
+
+static Local<Object>
+NDbusDescribeMessageCounts (guint64 *counts) {
+  Isolate* isolate = Isolate::GetCurrent();
+  EscapableHandleScope scope(isolate);
+
+  Local<Object> described = Object::New(isolate);
+  for (gint type = DBUS_MESSAGE_TYPE_METHOD_CALL;
+      type < DBUS_NUM_MESSAGE_TYPES; type++)
+    described->Set(v8::String::NewFromUtf8(isolate, message_types[type]),
+        Number::New(isolate, counts[type]));
+  return scope.Escape(described);
+}
+
+/**
+ * The milliseconds below which at least quantile of the latencies are.
+ */
+static gdouble
+NDbusLatencyQuantile (NDbusLatency *latency, gdouble quantile) {
+  guint64 rank = (guint64)(quantile * latency->count + 0.5), seen = 0;
+  for (guint i = 0; i < NDBUS_LATENCY_BUCKETS; i++) {
+    seen += latency->buckets[i];
+    if (seen >= MAX(rank, 1))
+      return MIN(NDbusLatencyBucketEnd(i), latency->max) / 1000.0;
+  }
+  return latency->max / 1000.0;
+}
+
+/**
+ * Latencies as Prometheus takes them: the non-empty buckets as
+ * [upper bound in ms, latencies up to it], cumulative.
+ */
+static Local<Object>
+NDbusDescribeLatency (NDbusLatency *latency) {
+  Isolate* isolate = Isolate::GetCurrent();
+  EscapableHandleScope scope(isolate);
+
+  Local<Object> described = Object::New(isolate);
+  described->Set(v8::String::NewFromUtf8(isolate, "destination"),
+      latency->destination ?
+      Local<Value>(v8::String::NewFromUtf8(isolate, latency->destination)) :
+      Local<Value>(Null(isolate)));
+  described->Set(v8::String::NewFromUtf8(isolate, "interface"),
+      latency->interface ?
+      Local<Value>(v8::String::NewFromUtf8(isolate, latency->interface)) :
+      Local<Value>(Null(isolate)));
+  described->Set(v8::String::NewFromUtf8(isolate, "member"),
+      v8::String::NewFromUtf8(isolate, latency->member ? latency->member : ""));
+  described->Set(v8::String::NewFromUtf8(isolate, "count"),
+      Number::New(isolate, latency->count));
+  described->Set(v8::String::NewFromUtf8(isolate, "sum"),
+      Number::New(isolate, latency->sum / 1000.0));
+  described->Set(v8::String::NewFromUtf8(isolate, "max"),
+      Number::New(isolate, latency->max / 1000.0));
+  described->Set(v8::String::NewFromUtf8(isolate, "p50"),
+      Number::New(isolate, NDbusLatencyQuantile(latency, 0.5)));
+  described->Set(v8::String::NewFromUtf8(isolate, "p90"),
+      Number::New(isolate, NDbusLatencyQuantile(latency, 0.9)));
+  described->Set(v8::String::NewFromUtf8(isolate, "p99"),
+      Number::New(isolate, NDbusLatencyQuantile(latency, 0.99)));
+
+  Local<Array> buckets = Array::New(isolate);
+  guint64 seen = 0;
+  guint n = 0;
+  for (guint i = 0; i < NDBUS_LATENCY_BUCKETS && seen < latency->count; i++) {
+    if (latency->buckets[i] == 0)
+      continue;
+    seen += latency->buckets[i];
+    Local<Array> bucket = Array::New(isolate, 2);
+    bucket->Set(0, Number::New(isolate, NDbusLatencyBucketEnd(i) / 1000.0));
+    bucket->Set(1, Number::New(isolate, seen));
+    buckets->Set(n++, bucket);
+  }
+  described->Set(v8::String::NewFromUtf8(isolate, "buckets"), buckets);
+  return scope.Escape(described);
+}
+
+/**
+ * The listeners of the connection, and the match rules they and the
+ * watched names and mirrors have added on the bus.
+ */
+static void
+NDbusCountMatches (NDbusConnectionInfo *cnxn_info,
+    guint *listeners, guint *matches) {
+  GHashTableIter iter;
+  gpointer value;
+  *listeners = 0;
+  *matches = 0;
+  g_hash_table_iter_init(&iter, cnxn_info->signal_watchers);
+  while (g_hash_table_iter_next(&iter, NULL, &value)) {
+    for (GSList *tmp = (GSList *)value; tmp != NULL; tmp = g_slist_next(tmp)) {
+      (*listeners)++;
+      if (((NDbusObjectInfo *)tmp->data)->match)
+        (*matches)++;
+    }
+  }
+  *matches += g_hash_table_size(cnxn_info->name_owners);
+  g_hash_table_iter_init(&iter, cnxn_info->property_mirrors);
+  while (g_hash_table_iter_next(&iter, NULL, &value))
+    *matches += ((GPtrArray *)value)->len;
+  *matches += cnxn_info->object_mirrors->len * 2;
+}
+
+void NDbusSetMetrics (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  if (!args[0]->IsObject())
+    NDBUS_EXCPN_METRICS;
+  Local<Object> options = Local<Object>::Cast(args[0]);
+
+  NDbusConnectionInfo *cnxn_info = NDbusGetConnection(args.This());
+  if (!cnxn_info)
+    NDBUS_EXCPN_DISCONNECTED;
+
+  Local<Value> value = NDbusGetProperty(options, NDBUS_METRICS_BYTES);
+  if (NDbusIsValidV8Value(value))
+    cnxn_info->metrics.count_bytes = value->BooleanValue();
+  args.GetReturnValue().SetUndefined();
+}
+
+/**
+ * A snapshot of the metrics of the connection of this object, and of
+ * the loop it shares with the others. Counters only grow; times are in
+ * milliseconds.
+ */
+void NDbusGetMetrics (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  NDbusConnectionInfo *cnxn_info = NDbusGetConnection(args.This());
+  if (!cnxn_info) {
+    args.GetReturnValue().SetNull();
+    return;
+  }
+  NDbusMetrics *metrics = &cnxn_info->metrics;
+
+  Local<Object> snapshot = Object::New(isolate);
+  snapshot->Set(v8::String::NewFromUtf8(isolate, "messagesIn"),
+      NDbusDescribeMessageCounts(metrics->messages_in));
+  snapshot->Set(v8::String::NewFromUtf8(isolate, "messagesOut"),
+      NDbusDescribeMessageCounts(metrics->messages_out));
+  snapshot->Set(v8::String::NewFromUtf8(isolate, "bytesIn"),
+      NDbusDescribeMessageCounts(metrics->bytes_in));
+  snapshot->Set(v8::String::NewFromUtf8(isolate, "bytesOut"),
+      NDbusDescribeMessageCounts(metrics->bytes_out));
+
+  guint listeners, matches;
+  NDbusCountMatches(cnxn_info, &listeners, &matches);
+  snapshot->Set(v8::String::NewFromUtf8(isolate, "listeners"),
+      Uint32::NewFromUnsigned(isolate, listeners));
+  snapshot->Set(v8::String::NewFromUtf8(isolate, "matchRules"),
+      Uint32::NewFromUnsigned(isolate, matches));
+  snapshot->Set(v8::String::NewFromUtf8(isolate, "pendingCalls"),
+      Uint32::NewFromUnsigned(isolate, metrics->pending_calls));
+  snapshot->Set(v8::String::NewFromUtf8(isolate, "outgoingBytes"),
+      Number::New(isolate, cnxn_info->cnxn ?
+        dbus_connection_get_outgoing_size(cnxn_info->cnxn) : 0));
+
+  snapshot->Set(v8::String::NewFromUtf8(isolate, "encodes"),
+      Number::New(isolate, loop_metrics.encodes));
+  snapshot->Set(v8::String::NewFromUtf8(isolate, "encodeTime"),
+      Number::New(isolate, loop_metrics.encode_time / 1e6));
+  snapshot->Set(v8::String::NewFromUtf8(isolate, "decodes"),
+      Number::New(isolate, loop_metrics.decodes));
+  snapshot->Set(v8::String::NewFromUtf8(isolate, "decodeTime"),
+      Number::New(isolate, loop_metrics.decode_time / 1e6));
+  snapshot->Set(v8::String::NewFromUtf8(isolate, "dispatchTurns"),
+      Number::New(isolate, loop_metrics.dispatches));
+  snapshot->Set(v8::String::NewFromUtf8(isolate, "dispatchTime"),
+      Number::New(isolate, loop_metrics.dispatch_time / 1e6));
+  snapshot->Set(v8::String::NewFromUtf8(isolate, "dispatchMaxTime"),
+      Number::New(isolate, loop_metrics.dispatch_max / 1e6));
+
+  Local<Array> latencies = Array::New(isolate);
+  if (metrics->latencies) {
+    GHashTableIter iter;
+    gpointer value;
+    guint i = 0;
+    g_hash_table_iter_init(&iter, metrics->latencies);
+    while (g_hash_table_iter_next(&iter, NULL, &value))
+      latencies->Set(i++, NDbusDescribeLatency((NDbusLatency *)value));
+  }
+  snapshot->Set(v8::String::NewFromUtf8(isolate, "latencies"), latencies);
+
+  args.GetReturnValue().Set(snapshot);
+}
+} //namespace ndbus
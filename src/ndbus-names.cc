@@ -0,0 +1,650 @@
+/*
+ * Copyright (c) 2011, Motorola Mobility, Inc
+ * All Rights Reserved.
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+#include "ndbus.h"
+
+namespace ndbus {
+
+//EXPOSED
+void
+NDbusFreeCallbackInfo (void *data) {
+  NDbusCallbackInfo *cb_info = (NDbusCallbackInfo *)data;
+  if (cb_info) {
+    cb_info->callback.Reset();
+    NDbusConnectionInfoUnref(cb_info->cnxn_info);
+    g_free(cb_info->name);
+    g_free(cb_info->reply_signature);
+    g_free(cb_info);
+  }
+}
+
+//EXPOSED
+void
+NDbusFreeNameInfo (gpointer data) {
+  NDbusNameInfo *name_info = (NDbusNameInfo *)data;
+  if (name_info) {
+    name_info->owner.Reset();
+    g_free(name_info);
+  }
+}
+
+static void
+NDbusRemoveNameInfo (NDbusConnectionInfo *cnxn_info,
+    const gchar *name) {
+  g_hash_table_remove(cnxn_info->owned_names, name);
+}
+
+/**
+ * Sends a method-call to the bus daemon without blocking. The reply
+ * is handed to notify along with a callback info which is released
+ * once the pending call goes away.
+ */
+static gboolean
+NDbusCallBusDaemon (NDbusConnectionInfo *cnxn_info,
+    DBusMessage *msg, const gchar *name,
+    Local<Function> callback,
+    DBusPendingCallNotifyFunction notify) {
+  DBusPendingCall *pending = NULL;
+  if (!dbus_connection_send_with_reply(cnxn_info->cnxn, msg,
+        &pending, DBUS_TIMEOUT_USE_DEFAULT) || !pending)
+    return FALSE;
+
+  NDbusCallbackInfo *cb_info = g_new0(NDbusCallbackInfo, 1);
+  cb_info->callback.Reset(Isolate::GetCurrent(), callback);
+  cb_info->cnxn_info = NDbusConnectionInfoRef(cnxn_info);
+  cb_info->name = g_strdup(name);
+  dbus_pending_call_set_notify(pending, notify,
+      (void *)cb_info, NDbusFreeCallbackInfo);
+  return TRUE;
+}
+
+/**
+ * Extracts the uint32 reply code of RequestName/ReleaseName into
+ * argv, or an error object if the daemon refused the call.
+ */
+static gboolean
+NDbusGetNameReplyCode (DBusPendingCall *pending,
+    Local<Value> *argv, guint32 *code) {
+  Isolate* isolate = Isolate::GetCurrent();
+  DBusMessage *reply = dbus_pending_call_steal_reply(pending);
+  gboolean ret = FALSE;
+
+  argv[0] = Undefined(isolate);
+  argv[1] = Undefined(isolate);
+  if (!reply) {
+    NDBUS_SET_EXCPN(argv[0], DBUS_ERROR_NO_REPLY, NDBUS_ERROR_NOREPLY);
+    return FALSE;
+  }
+
+  DBusError error;
+  dbus_error_init(&error);
+  if (dbus_set_error_from_message(&error, reply) ||
+      !dbus_message_get_args(reply, &error,
+        DBUS_TYPE_UINT32, code, DBUS_TYPE_INVALID)) {
+    NDBUS_SET_EXCPN(argv[0], error.name, error.message);
+    dbus_error_free(&error);
+  } else {
+    argv[1] = Uint32::NewFromUnsigned(isolate, *code);
+    ret = TRUE;
+  }
+  dbus_message_unref(reply);
+  return ret;
+}
+
+static void
+NDbusInvokeCallback (NDbusCallbackInfo *cb_info,
+    gint argc, Local<Value> *argv) {
+  Isolate* isolate = Isolate::GetCurrent();
+  Local<Function> func =
+    Local<Function>::New(isolate, cb_info->callback);
+  if (NDbusIsValidV8Value(func))
+    func->Call(func, argc, argv);
+}
+
+static void
+NDbusHandleRequestNameReply (DBusPendingCall *pending,
+    void *user_data) {
+  g_return_if_fail(pending != NULL);
+
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  NDbusCallbackInfo *cb_info = (NDbusCallbackInfo *)user_data;
+  NDbusConnectionInfo *cnxn_info = cb_info->cnxn_info;
+  Local<Value> argv[2];
+  guint32 code = 0;
+  gboolean replied = NDbusGetNameReplyCode(pending, argv, &code);
+
+  if (cnxn_info->cnxn) {
+    NDbusNameInfo *name_info = (NDbusNameInfo *)
+      g_hash_table_lookup(cnxn_info->owned_names, cb_info->name);
+    if (name_info) {
+      //a failed request again for a name held already leaves it held
+      if ((!replied && !name_info->primary) ||
+          code == DBUS_REQUEST_NAME_REPLY_EXISTS)
+        NDbusRemoveNameInfo(cnxn_info, cb_info->name);
+      else
+        name_info->primary =
+          (code != DBUS_REQUEST_NAME_REPLY_IN_QUEUE);
+    }
+  }
+
+  NDbusInvokeCallback(cb_info, 2, argv);
+  dbus_pending_call_unref(pending);
+}
+
+static void
+NDbusHandleReleaseNameReply (DBusPendingCall *pending,
+    void *user_data) {
+  g_return_if_fail(pending != NULL);
+
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  NDbusCallbackInfo *cb_info = (NDbusCallbackInfo *)user_data;
+  Local<Value> argv[2];
+  guint32 code = 0;
+
+  if (NDbusGetNameReplyCode(pending, argv, &code) &&
+      cb_info->cnxn_info->cnxn)
+    NDbusRemoveNameInfo(cb_info->cnxn_info, cb_info->name);
+
+  NDbusInvokeCallback(cb_info, 2, argv);
+  dbus_pending_call_unref(pending);
+}
+
+gboolean
+NDbusRequestNameReal (NDbusConnectionInfo *cnxn_info,
+    const gchar *name, guint flags,
+    Local<Object> owner, Local<Function> callback) {
+  DBusMessage *msg =
+    dbus_message_new_method_call(DBUS_SERVICE_DBUS,
+        DBUS_PATH_DBUS, DBUS_INTERFACE_DBUS, "RequestName");
+  if (msg == NULL)
+    return FALSE;
+
+  dbus_uint32_t name_flags = flags;
+  if (!dbus_message_append_args(msg,
+        DBUS_TYPE_STRING, &name,
+        DBUS_TYPE_UINT32, &name_flags,
+        DBUS_TYPE_INVALID)) {
+    dbus_message_unref(msg);
+    return FALSE;
+  }
+
+  //NameAcquired is sent by the daemon before the reply, so the owner
+  //has to be known by the time the request leaves
+  NDbusNameInfo *name_info = (NDbusNameInfo *)
+    g_hash_table_lookup(cnxn_info->owned_names, name);
+  if (name_info == NULL) {
+    name_info = g_new0(NDbusNameInfo, 1);
+    g_hash_table_insert(cnxn_info->owned_names,
+        g_strdup(name), name_info);
+  }
+  name_info->owner.Reset(Isolate::GetCurrent(), owner);
+  name_info->flags = flags;
+
+  gboolean sent = NDbusCallBusDaemon(cnxn_info, msg, name,
+      callback, NDbusHandleRequestNameReply);
+  if (!sent && !name_info->primary)
+    NDbusRemoveNameInfo(cnxn_info, name);
+  dbus_message_unref(msg);
+  return sent;
+}
+
+gboolean
+NDbusReleaseNameReal (NDbusConnectionInfo *cnxn_info,
+    const gchar *name, Local<Function> callback) {
+  DBusMessage *msg =
+    dbus_message_new_method_call(DBUS_SERVICE_DBUS,
+        DBUS_PATH_DBUS, DBUS_INTERFACE_DBUS, "ReleaseName");
+  if (msg == NULL)
+    return FALSE;
+
+  if (!dbus_message_append_args(msg,
+        DBUS_TYPE_STRING, &name,
+        DBUS_TYPE_INVALID)) {
+    dbus_message_unref(msg);
+    return FALSE;
+  }
+
+  gboolean sent = NDbusCallBusDaemon(cnxn_info, msg, name,
+      callback, NDbusHandleReleaseNameReply);
+  dbus_message_unref(msg);
+  return sent;
+}
+
+gboolean
+NDbusIsNameOwner (NDbusConnectionInfo *cnxn_info,
+    const gchar *name) {
+  NDbusNameInfo *name_info = (NDbusNameInfo *)
+    g_hash_table_lookup(cnxn_info->owned_names, name);
+  return (name_info && name_info->primary);
+}
+
+/**
+ * Keeps owned_names in step with NameAcquired/NameLost which the
+ * daemon unicasts to us, and lets the requesting object know.
+ * Returns TRUE if the message was one of those signals.
+ */
+gboolean
+NDbusHandleNameOwnership (NDbusConnectionInfo *cnxn_info,
+    DBusMessage *message) {
+  gboolean acquired;
+  if (dbus_message_is_signal(message,
+        DBUS_INTERFACE_DBUS, "NameAcquired"))
+    acquired = TRUE;
+  else if (dbus_message_is_signal(message,
+        DBUS_INTERFACE_DBUS, "NameLost"))
+    acquired = FALSE;
+  else
+    return FALSE;
+
+  const gchar *name = NULL;
+  if (!dbus_message_get_args(message, NULL,
+        DBUS_TYPE_STRING, &name, DBUS_TYPE_INVALID))
+    return TRUE;
+
+  NDbusNameInfo *name_info = (NDbusNameInfo *)
+    g_hash_table_lookup(cnxn_info->owned_names, name);
+  if (name_info == NULL || name_info->primary == acquired)
+    return TRUE;
+
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  name_info->primary = acquired;
+  Local<Object> owner =
+    Local<Object>::New(isolate, name_info->owner);
+
+  //without a place in the queue, a lost name is gone for good
+  if (!acquired &&
+      (name_info->flags & DBUS_NAME_FLAG_DO_NOT_QUEUE))
+    NDbusRemoveNameInfo(cnxn_info, name);
+
+  Handle<Object> local_global_target = Local<Object>::New(isolate, global_target);
+  Local<Function> func = Local<Function>::Cast(local_global_target->Get(NDBUS_CB_NAMEOWNERSHIP));
+  const gint argc = 2;
+  Local<Value> argv[argc];
+  argv[0] = Boolean::New(isolate, acquired);
+  argv[1] = v8::String::NewFromUtf8(isolate, name);
+
+  if (NDbusIsValidV8Value(owner) &&
+      NDbusIsValidV8Value(func) &&
+      func->IsFunction())
+    func->Call(owner, argc, argv);
+  return TRUE;
+}
+
+//EXPOSED
+void
+NDbusFreeOwnerInfo (gpointer data) {
+  NDbusOwnerInfo *owner_info = (NDbusOwnerInfo *)data;
+  if (owner_info) {
+    g_slist_free_full(owner_info->waiters,
+        (GDestroyNotify) NDbusFreeCallbackInfo);
+    g_free(owner_info->owner);
+    g_free(owner_info);
+  }
+}
+
+void
+NDbusFreeOwnerAliases (gpointer data) {
+  g_slist_free_full((GSList *)data, g_free);
+}
+
+GSList*
+NDbusGetOwnerAliases (NDbusConnectionInfo *cnxn_info,
+    const gchar *unique_name) {
+  return (GSList *)
+    g_hash_table_lookup(cnxn_info->owner_aliases, unique_name);
+}
+
+/**
+ * Stores the updated list of well-known names of owner. The list was
+ * changed in place, so the old one must not be freed by the table.
+ */
+static void
+NDbusSetOwnerAliases (NDbusConnectionInfo *cnxn_info,
+    const gchar *owner, GSList *aliases) {
+  gpointer key = NULL, old_aliases = NULL;
+  if (g_hash_table_lookup_extended(cnxn_info->owner_aliases, owner,
+        &key, &old_aliases))
+    g_hash_table_steal(cnxn_info->owner_aliases, owner);
+  else
+    key = g_strdup(owner);
+
+  if (aliases)
+    g_hash_table_insert(cnxn_info->owner_aliases, key, aliases);
+  else
+    g_free(key);
+}
+
+/**
+ * Moves a well-known name over to a new unique owner (or none) and keeps
+ * the unique name -> well-known names index in step.
+ */
+static void
+NDbusSetNameOwner (NDbusConnectionInfo *cnxn_info,
+    NDbusOwnerInfo *owner_info, const gchar *name,
+    const gchar *owner) {
+  if (owner && owner[0] == '\0')
+    owner = NULL;
+
+  if (owner_info->owner) {
+    GSList *aliases = NDbusGetOwnerAliases(cnxn_info, owner_info->owner);
+    GSList *tmp = aliases;
+    while (tmp != NULL) {
+      if (g_str_equal(tmp->data, name)) {
+        g_free(tmp->data);
+        aliases = g_slist_delete_link(aliases, tmp);
+        break;
+      }
+      tmp = g_slist_next(tmp);
+    }
+    NDbusSetOwnerAliases(cnxn_info, owner_info->owner, aliases);
+    g_free(owner_info->owner);
+    owner_info->owner = NULL;
+  }
+
+  if (owner) {
+    GSList *aliases = NDbusGetOwnerAliases(cnxn_info, owner);
+    aliases = g_slist_prepend(aliases, g_strdup(name));
+    NDbusSetOwnerAliases(cnxn_info, owner, aliases);
+    owner_info->owner = g_strdup(owner);
+  }
+  owner_info->resolved = TRUE;
+}
+
+static void
+NDbusNotifyOwnerWaiters (NDbusOwnerInfo *owner_info,
+    Local<Value> error) {
+  Isolate* isolate = Isolate::GetCurrent();
+  GSList *waiters = owner_info->waiters;
+  owner_info->waiters = NULL;
+
+  Local<Value> argv[2];
+  argv[0] = error;
+  if (NDbusIsValidV8Value(error) || !owner_info->owner)
+    argv[1] = Null(isolate);
+  else
+    argv[1] = v8::String::NewFromUtf8(isolate, owner_info->owner);
+
+  GSList *tmp = waiters;
+  while (tmp != NULL) {
+    NDbusInvokeCallback((NDbusCallbackInfo *)tmp->data, 2, argv);
+    tmp = g_slist_next(tmp);
+  }
+  g_slist_free_full(waiters, (GDestroyNotify) NDbusFreeCallbackInfo);
+}
+
+static void
+NDbusHandleGetNameOwnerReply (DBusPendingCall *pending,
+    void *user_data) {
+  g_return_if_fail(pending != NULL);
+
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  NDbusCallbackInfo *cb_info = (NDbusCallbackInfo *)user_data;
+  NDbusConnectionInfo *cnxn_info = cb_info->cnxn_info;
+  DBusMessage *reply = dbus_pending_call_steal_reply(pending);
+  dbus_pending_call_unref(pending);
+
+  NDbusOwnerInfo *owner_info = cnxn_info->cnxn ? (NDbusOwnerInfo *)
+    g_hash_table_lookup(cnxn_info->name_owners, cb_info->name) : NULL;
+  if (owner_info == NULL) {
+    if (reply)
+      dbus_message_unref(reply);
+    return;
+  }
+  owner_info->querying = FALSE;
+
+  Local<Value> error = Undefined(isolate);
+  const gchar *owner = NULL;
+  DBusError dbus_error;
+  dbus_error_init(&dbus_error);
+  if (!reply) {
+    NDBUS_SET_EXCPN(error, DBUS_ERROR_NO_REPLY, NDBUS_ERROR_NOREPLY);
+  } else if (dbus_set_error_from_message(&dbus_error, reply)) {
+    //no owner is an answer as good as any other
+    if (dbus_error_has_name(&dbus_error, DBUS_ERROR_NAME_HAS_NO_OWNER))
+      NDbusSetNameOwner(cnxn_info, owner_info, cb_info->name, NULL);
+    else
+      NDBUS_SET_EXCPN(error, dbus_error.name, dbus_error.message);
+    dbus_error_free(&dbus_error);
+  } else if (dbus_message_get_args(reply, &dbus_error,
+        DBUS_TYPE_STRING, &owner, DBUS_TYPE_INVALID)) {
+    NDbusSetNameOwner(cnxn_info, owner_info, cb_info->name, owner);
+  } else {
+    NDBUS_SET_EXCPN(error, dbus_error.name, dbus_error.message);
+    dbus_error_free(&dbus_error);
+  }
+
+  NDbusNotifyOwnerWaiters(owner_info, error);
+  if (reply)
+    dbus_message_unref(reply);
+}
+
+/**
+ * Adds the NameOwnerChanged match of name and sends one GetNameOwner.
+ * The match goes out first so that no change can slip in between.
+ */
+static void
+NDbusQueryNameOwner (NDbusConnectionInfo *cnxn_info,
+    NDbusOwnerInfo *owner_info, const gchar *name) {
+  gchar *match_str =
+    g_strconcat("type='signal',sender='", DBUS_SERVICE_DBUS,
+        "',path='", DBUS_PATH_DBUS,
+        "',interface='", DBUS_INTERFACE_DBUS,
+        "',member='NameOwnerChanged',arg0='", name, "'", NULL);
+  dbus_bus_add_match(cnxn_info->cnxn, match_str, NULL);
+  g_free(match_str);
+
+  DBusMessage *msg =
+    dbus_message_new_method_call(DBUS_SERVICE_DBUS,
+        DBUS_PATH_DBUS, DBUS_INTERFACE_DBUS, "GetNameOwner");
+  if (msg) {
+    if (dbus_message_append_args(msg,
+          DBUS_TYPE_STRING, &name, DBUS_TYPE_INVALID))
+      owner_info->querying = NDbusCallBusDaemon(cnxn_info, msg, name,
+          Local<Function>(), NDbusHandleGetNameOwnerReply);
+    dbus_message_unref(msg);
+  }
+}
+
+/**
+ * Starts tracking the owner of a well-known name: a match on its
+ * NameOwnerChanged keeps the cache current and one GetNameOwner seeds
+ * it. While the bus is away, that waits for the reconnect.
+ */
+NDbusOwnerInfo*
+NDbusWatchNameOwner (NDbusConnectionInfo *cnxn_info,
+    const gchar *name) {
+  NDbusOwnerInfo *owner_info = (NDbusOwnerInfo *)
+    g_hash_table_lookup(cnxn_info->name_owners, name);
+  if (owner_info)
+    return owner_info;
+
+  owner_info = g_new0(NDbusOwnerInfo, 1);
+  g_hash_table_insert(cnxn_info->name_owners,
+      g_strdup(name), owner_info);
+  if (cnxn_info->cnxn)
+    NDbusQueryNameOwner(cnxn_info, owner_info, name);
+  return owner_info;
+}
+
+/**
+ * Forgets the owners of all watched names, which may have changed
+ * unseen while the bus was away, and watches them again on the new
+ * connection. Returns the number of matches added.
+ */
+guint
+NDbusRewatchNameOwners (NDbusConnectionInfo *cnxn_info) {
+  GHashTableIter iter;
+  gpointer name, value;
+  g_hash_table_iter_init(&iter, cnxn_info->name_owners);
+  while (g_hash_table_iter_next(&iter, &name, &value)) {
+    NDbusOwnerInfo *owner_info = (NDbusOwnerInfo *)value;
+    NDbusSetNameOwner(cnxn_info, owner_info, (const gchar *)name, NULL);
+    owner_info->resolved = FALSE;
+    NDbusQueryNameOwner(cnxn_info, owner_info, (const gchar *)name);
+  }
+  return g_hash_table_size(cnxn_info->name_owners);
+}
+
+/**
+ * Tells the owners of the names held on a connection which went away
+ * that they lost them. The names stay listed to be requested again.
+ */
+void
+NDbusLoseOwnedNames (NDbusConnectionInfo *cnxn_info) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  Handle<Object> local_global_target = Local<Object>::New(isolate, global_target);
+  Local<Function> func = Local<Function>::Cast(local_global_target->Get(NDBUS_CB_NAMEOWNERSHIP));
+  if (!NDbusIsValidV8Value(func) || !func->IsFunction())
+    return;
+
+  GPtrArray *lost = g_ptr_array_new_with_free_func(g_free);
+  GHashTableIter iter;
+  gpointer name, value;
+  g_hash_table_iter_init(&iter, cnxn_info->owned_names);
+  while (g_hash_table_iter_next(&iter, &name, &value)) {
+    NDbusNameInfo *name_info = (NDbusNameInfo *)value;
+    if (name_info->primary) {
+      name_info->primary = FALSE;
+      g_ptr_array_add(lost, g_strdup((const gchar *)name));
+    }
+  }
+
+  //a handler may release the name
+  for (guint i = 0; i < lost->len; i++) {
+    const gchar *name = (const gchar *)g_ptr_array_index(lost, i);
+    NDbusNameInfo *name_info = (NDbusNameInfo *)
+      g_hash_table_lookup(cnxn_info->owned_names, name);
+    if (name_info == NULL)
+      continue;
+    Local<Object> owner = Local<Object>::New(isolate, name_info->owner);
+    Local<Value> argv[2];
+    argv[0] = Boolean::New(isolate, false);
+    argv[1] = v8::String::NewFromUtf8(isolate, name);
+    if (NDbusIsValidV8Value(owner))
+      func->Call(owner, 2, argv);
+  }
+  g_ptr_array_unref(lost);
+}
+
+/**
+ * Requests again, with the flags they were first requested with, the
+ * names held before the bus went away. Returns how many were sent.
+ */
+guint
+NDbusRequestOwnedNames (NDbusConnectionInfo *cnxn_info) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  GPtrArray *names = g_ptr_array_new_with_free_func(g_free);
+  GHashTableIter iter;
+  gpointer name;
+  g_hash_table_iter_init(&iter, cnxn_info->owned_names);
+  while (g_hash_table_iter_next(&iter, &name, NULL))
+    g_ptr_array_add(names, g_strdup((const gchar *)name));
+
+  guint requested = 0;
+  for (guint i = 0; i < names->len; i++) {
+    const gchar *name = (const gchar *)g_ptr_array_index(names, i);
+    NDbusNameInfo *name_info = (NDbusNameInfo *)
+      g_hash_table_lookup(cnxn_info->owned_names, name);
+    Local<Object> owner = Local<Object>::New(isolate, name_info->owner);
+    if (NDbusRequestNameReal(cnxn_info, name, name_info->flags,
+          owner, Local<Function>()))
+      requested++;
+  }
+  g_ptr_array_unref(names);
+  return requested;
+}
+
+/**
+ * Hands the owner of name to callback, straight from the cache if it
+ * is known. Unique names are their own owners.
+ */
+gboolean
+NDbusGetNameOwnerReal (NDbusConnectionInfo *cnxn_info,
+    const gchar *name, Local<Function> callback) {
+  Isolate* isolate = Isolate::GetCurrent();
+
+  if (name[0] == ':' || g_str_equal(name, DBUS_SERVICE_DBUS)) {
+    Local<Value> argv[2];
+    argv[0] = Undefined(isolate);
+    argv[1] = v8::String::NewFromUtf8(isolate, name);
+    callback->Call(callback, 2, argv);
+    return TRUE;
+  }
+
+  NDbusOwnerInfo *owner_info = NDbusWatchNameOwner(cnxn_info, name);
+  if (!owner_info->resolved && !owner_info->querying) {
+    //an earlier lookup failed, so try again; the callback only waits
+    //once the query is out, as it is not called back if that fails
+    DBusMessage *msg =
+      dbus_message_new_method_call(DBUS_SERVICE_DBUS,
+          DBUS_PATH_DBUS, DBUS_INTERFACE_DBUS, "GetNameOwner");
+    if (msg == NULL)
+      return FALSE;
+    if (dbus_message_append_args(msg,
+          DBUS_TYPE_STRING, &name, DBUS_TYPE_INVALID))
+      owner_info->querying = NDbusCallBusDaemon(cnxn_info, msg, name,
+          Local<Function>(), NDbusHandleGetNameOwnerReply);
+    dbus_message_unref(msg);
+    if (!owner_info->querying)
+      return FALSE;
+  }
+
+  NDbusCallbackInfo *waiter = g_new0(NDbusCallbackInfo, 1);
+  waiter->callback.Reset(isolate, callback);
+  owner_info->waiters = g_slist_append(owner_info->waiters, waiter);
+  if (owner_info->resolved)
+    NDbusNotifyOwnerWaiters(owner_info, Undefined(isolate));
+  return TRUE;
+}
+
+gboolean
+NDbusHandleNameOwnerChanged (NDbusConnectionInfo *cnxn_info,
+    DBusMessage *message) {
+  if (!dbus_message_is_signal(message,
+        DBUS_INTERFACE_DBUS, "NameOwnerChanged"))
+    return FALSE;
+
+  const gchar *name = NULL, *old_owner = NULL, *new_owner = NULL;
+  if (!dbus_message_get_args(message, NULL,
+        DBUS_TYPE_STRING, &name,
+        DBUS_TYPE_STRING, &old_owner,
+        DBUS_TYPE_STRING, &new_owner,
+        DBUS_TYPE_INVALID))
+    return TRUE;
+
+  NDbusOwnerInfo *owner_info = (NDbusOwnerInfo *)
+    g_hash_table_lookup(cnxn_info->name_owners, name);
+  if (owner_info)
+    NDbusSetNameOwner(cnxn_info, owner_info, name, new_owner);
+
+  //what the old owner, or the name while it had none, was found to
+  //implement says nothing about the new one
+  if (!g_str_equal(old_owner, new_owner)) {
+    NDbusInvalidateIntrospections(cnxn_info,
+        old_owner[0] != '\0' ? old_owner : name);
+    NDbusReseedPropertyMirrors(cnxn_info, name, new_owner);
+    NDbusReseedObjectMirrors(cnxn_info, name, new_owner);
+  }
+  return TRUE;
+}
+
+} //namespace ndbus
@@ -0,0 +1,761 @@
+/*
+ * Copyright (c) 2011, Motorola Mobility, Inc
+ * All Rights Reserved.
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+#include "ndbus.h"
+
+namespace ndbus {
+
+#define NDBUS_INTERFACE_OBJECT_MANAGER "org.freedesktop.DBus.ObjectManager"
+#define NDBUS_MANAGED_OBJECTS_SIGN    "a{oa{sa{sv}}}"
+#define NDBUS_INTERFACES_ADDED_SIGN   "oa{sa{sv}}"
+#define NDBUS_INTERFACES_REMOVED_SIGN "oas"
+#define NDBUS_PROPERTIES_CHANGED_SIGN "sa{sv}as"
+
+static GHashTable *object_mirrors = NULL;
+static guint last_object_mirror_id = 0;
+
+static void
+NDbusFreeManagedObject (gpointer data) {
+  NDbusManagedObject *object = (NDbusManagedObject *)data;
+  if (object) {
+    g_hash_table_unref(object->interfaces);
+    g_free(object->path);
+    g_free(object);
+  }
+}
+
+static gint
+NDbusCompareManagedObjects (gconstpointer a, gconstpointer b,
+    gpointer user_data) {
+  return strcmp(((const NDbusManagedObject *)a)->path,
+      ((const NDbusManagedObject *)b)->path);
+}
+
+/**
+ * Whether path is prefix or below it. '/' sorts before every other
+ * character of an object path, so the paths below prefix come right
+ * after it in objects.
+ */
+static gboolean
+NDbusIsUnderPath (const gchar *path, const gchar *prefix) {
+  gsize len = strlen(prefix);
+  if (strncmp(path, prefix, len) != 0)
+    return FALSE;
+  return path[len] == '\0' || path[len] == '/' || g_str_equal(prefix, "/");
+}
+
+static void
+NDbusClearManagedObjects (NDbusObjectMirror *mirror) {
+  g_hash_table_remove_all(mirror->index);
+  g_sequence_remove_range(g_sequence_get_begin_iter(mirror->objects),
+      g_sequence_get_end_iter(mirror->objects));
+}
+
+static void
+NDbusFreeObjectMirror (gpointer data) {
+  NDbusObjectMirror *mirror = (NDbusObjectMirror *)data;
+  if (mirror == NULL)
+    return;
+
+  NDbusConnectionInfo *cnxn_info = mirror->cnxn_info;
+  g_ptr_array_remove_fast(cnxn_info->object_mirrors, mirror);
+  if (cnxn_info->cnxn) {
+    dbus_bus_remove_match(cnxn_info->cnxn, mirror->match, NULL);
+    dbus_bus_remove_match(cnxn_info->cnxn, mirror->properties_match, NULL);
+  }
+  NDbusConnectionInfoUnref(cnxn_info);
+
+  g_hash_table_unref(mirror->index);
+  g_sequence_free(mirror->objects);
+  mirror->object.Reset();
+  mirror->callback.Reset();
+  g_free(mirror->destination);
+  g_free(mirror->owner);
+  g_free(mirror->path);
+  g_free(mirror->match);
+  g_free(mirror->properties_match);
+  g_free(mirror);
+}
+
+static NDbusObjectMirror*
+NDbusLookupObjectMirror (Local<Value> id) {
+  if (object_mirrors == NULL || !id->IsUint32())
+    return NULL;
+  return (NDbusObjectMirror *)g_hash_table_lookup(object_mirrors,
+      GUINT_TO_POINTER(id->Uint32Value()));
+}
+
+static NDbusManagedObject*
+NDbusLookupManagedObject (NDbusObjectMirror *mirror, const gchar *path) {
+  GSequenceIter *iter = (GSequenceIter *)
+    g_hash_table_lookup(mirror->index, path);
+  return iter ? (NDbusManagedObject *)g_sequence_get(iter) : NULL;
+}
+
+static void
+NDbusRemoveManagedObject (NDbusObjectMirror *mirror, const gchar *path) {
+  GSequenceIter *iter = (GSequenceIter *)
+    g_hash_table_lookup(mirror->index, path);
+  if (iter) {
+    //the key is the path of the object, which goes with it
+    g_hash_table_remove(mirror->index, path);
+    g_sequence_remove(iter);
+  }
+}
+
+/**
+ * The entries of a decoded dictionary, an object or a Map depending
+ * on the decode flags, as a flat [key, value, ...] array.
+ */
+static Local<Array>
+NDbusDictEntries (Local<Value> dict) {
+  Isolate* isolate = Isolate::GetCurrent();
+  EscapableHandleScope scope(isolate);
+
+  if (dict->IsMap())
+    return scope.Escape(Local<Map>::Cast(dict)->AsArray());
+
+  Local<Array> entries = Array::New(isolate);
+  if (dict->IsObject()) {
+    Local<Object> obj = Local<Object>::Cast(dict);
+    Local<Array> names = obj->GetOwnPropertyNames();
+    guint len = names->Length();
+    for (guint i = 0; i < len; i++) {
+      entries->Set(2 * i, names->Get(i));
+      entries->Set(2 * i + 1, obj->Get(names->Get(i)));
+    }
+  }
+  return scope.Escape(entries);
+}
+
+/**
+ * Adds the interfaces of ifaces, { interface: { name: value } }, to the
+ * object at path, which is created if need be.
+ */
+static void
+NDbusAddInterfaces (NDbusObjectMirror *mirror, const gchar *path,
+    Local<Value> ifaces) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  NDbusManagedObject *object = NDbusLookupManagedObject(mirror, path);
+  if (object == NULL) {
+    object = g_new0(NDbusManagedObject, 1);
+    object->path = g_strdup(path);
+    object->interfaces = g_hash_table_new_full(g_str_hash, g_str_equal,
+        g_free, (GDestroyNotify) g_hash_table_unref);
+    GSequenceIter *iter = g_sequence_insert_sorted(mirror->objects,
+        object, NDbusCompareManagedObjects, NULL);
+    g_hash_table_insert(mirror->index, object->path, iter);
+  }
+
+  Local<Array> entries = NDbusDictEntries(ifaces);
+  Local<Object> unused = Object::New(isolate);
+  guint len = entries->Length();
+  for (guint i = 0; i < len; i += 2) {
+    gchar *interface = NDbusV8StringToCStr(entries->Get(i));
+    if (!interface)
+      continue;
+    GHashTable *values = NDbusPropertyValuesNew();
+    NDbusStoreProperties(values, entries->Get(i + 1), unused);
+    g_hash_table_replace(object->interfaces, interface, values);
+  }
+}
+
+static void
+NDbusRemoveInterfaces (NDbusObjectMirror *mirror, const gchar *path,
+    Local<Array> names) {
+  NDbusManagedObject *object = NDbusLookupManagedObject(mirror, path);
+  if (object == NULL)
+    return;
+
+  guint len = names->Length();
+  for (guint i = 0; i < len; i++) {
+    gchar *interface = NDbusV8StringToCStr(names->Get(i));
+    if (interface)
+      g_hash_table_remove(object->interfaces, interface);
+    g_free(interface);
+  }
+  //an object without interfaces is gone
+  if (g_hash_table_size(object->interfaces) == 0)
+    NDbusRemoveManagedObject(mirror, path);
+}
+
+/**
+ * { interface: { name: value } } of object.
+ */
+static Local<Object>
+NDbusDescribeManagedObject (NDbusManagedObject *object) {
+  Isolate* isolate = Isolate::GetCurrent();
+  EscapableHandleScope scope(isolate);
+
+  Local<Object> ifaces = Object::New(isolate);
+  GHashTableIter iter;
+  gpointer interface, values;
+  g_hash_table_iter_init(&iter, object->interfaces);
+  while (g_hash_table_iter_next(&iter, &interface, &values))
+    ifaces->Set(v8::String::NewFromUtf8(isolate, (const gchar *)interface),
+        NDbusDescribeProperties((GHashTable *)values));
+  return scope.Escape(ifaces);
+}
+
+static Local<Array>
+NDbusInterfaceNames (NDbusManagedObject *object) {
+  Isolate* isolate = Isolate::GetCurrent();
+  EscapableHandleScope scope(isolate);
+
+  Local<Array> names = Array::New(isolate);
+  GHashTableIter iter;
+  gpointer interface;
+  guint i = 0;
+  g_hash_table_iter_init(&iter, object->interfaces);
+  while (g_hash_table_iter_next(&iter, &interface, NULL))
+    names->Set(i++, v8::String::NewFromUtf8(isolate, (const gchar *)interface));
+  return scope.Escape(names);
+}
+
+static void
+NDbusAddEvent (Local<Array> events, const gchar *name, gint argc,
+    Local<Value> *argv) {
+  Isolate* isolate = Isolate::GetCurrent();
+  Local<Array> event = Array::New(isolate, argc + 1);
+  event->Set(0, v8::String::NewFromUtf8(isolate, name));
+  for (gint i = 0; i < argc; i++)
+    event->Set(i + 1, argv[i]);
+  events->Set(events->Length(), event);
+}
+
+/**
+ * Emits events, each an [event, args...] array, on the JS mirror once
+ * the replica is up to date. A listener may release the mirror.
+ */
+static void
+NDbusEmitObjectEvents (guint id, Local<Array> events) {
+  Isolate* isolate = Isolate::GetCurrent();
+  Handle<Object> local_global_target = Local<Object>::New(isolate, global_target);
+  Local<Function> func = Local<Function>::Cast(
+      local_global_target->Get(NDBUS_CB_OBJECTSCHANGED));
+  if (!NDbusIsValidV8Value(func) || !func->IsFunction())
+    return;
+
+  guint len = events->Length();
+  for (guint i = 0; i < len; i++) {
+    NDbusObjectMirror *mirror = (NDbusObjectMirror *)
+      g_hash_table_lookup(object_mirrors, GUINT_TO_POINTER(id));
+    if (mirror == NULL)
+      return;
+    Local<Object> object = Local<Object>::New(isolate, mirror->object);
+    Local<Value> argv[1] = { events->Get(i) };
+    func->Call(object, 1, argv);
+  }
+}
+
+static void NDbusHandleManagedObjectsReply (DBusPendingCall *pending,
+    void *user_data);
+
+static gboolean
+NDbusSeedObjectMirror (NDbusObjectMirror *mirror) {
+  NDbusConnectionInfo *cnxn_info = mirror->cnxn_info;
+  if (!cnxn_info->cnxn)
+    return FALSE;
+
+  DBusMessage *msg = dbus_message_new_method_call(mirror->destination,
+      mirror->path, NDBUS_INTERFACE_OBJECT_MANAGER, "GetManagedObjects");
+  if (msg == NULL)
+    return FALSE;
+
+  DBusPendingCall *pending = NULL;
+  gboolean sent = dbus_connection_send_with_reply(cnxn_info->cnxn, msg,
+      &pending, DBUS_TIMEOUT_USE_DEFAULT) && pending;
+  if (sent) {
+    mirror->seeded = FALSE;
+    mirror->seed_serial = dbus_message_get_serial(msg);
+    dbus_pending_call_set_notify(pending, NDbusHandleManagedObjectsReply,
+        GUINT_TO_POINTER(mirror->id), NULL);
+  }
+  dbus_message_unref(msg);
+  return sent;
+}
+
+/**
+ * Replaces the replica with the objects of the reply. Interfaces which
+ * are gone are announced as removed, and all current ones as added,
+ * unless this is the first seed.
+ */
+static void
+NDbusHandleManagedObjectsReply (DBusPendingCall *pending,
+    void *user_data) {
+  g_return_if_fail(pending != NULL);
+
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  DBusMessage *reply = dbus_pending_call_steal_reply(pending);
+  dbus_pending_call_unref(pending);
+
+  NDbusObjectMirror *mirror = object_mirrors ? (NDbusObjectMirror *)
+    g_hash_table_lookup(object_mirrors, user_data) : NULL;
+  if (mirror == NULL || (reply &&
+        dbus_message_get_reply_serial(reply) != mirror->seed_serial)) {
+    if (reply)
+      dbus_message_unref(reply);
+    return;
+  }
+  mirror->seed_serial = 0;
+
+  Local<Value> error = Undefined(isolate);
+  Local<Array> entries = Array::New(isolate);
+  if (!reply) {
+    NDBUS_SET_EXCPN(error, DBUS_ERROR_NO_REPLY, NDBUS_ERROR_NOREPLY);
+  } else if (dbus_message_get_type(reply) == DBUS_MESSAGE_TYPE_ERROR) {
+    DBusError dbus_error;
+    dbus_error_init(&dbus_error);
+    dbus_set_error_from_message(&dbus_error, reply);
+    NDBUS_SET_EXCPN(error, dbus_error.name, dbus_error.message);
+    dbus_error_free(&dbus_error);
+  } else if (!dbus_message_has_signature(reply, NDBUS_MANAGED_OBJECTS_SIGN)) {
+    NDBUS_SET_EXCPN(error, DBUS_ERROR_INVALID_SIGNATURE, NDBUS_ERROR_REPLY_SIGN);
+  } else {
+    Local<Array> args = Local<Array>::Cast(NDbusRetrieveMessageArgs(reply,
+          mirror->decode_flags & ~NDBUS_DECODE_RAW));
+    entries = NDbusDictEntries(args->Get(0));
+    g_free(mirror->owner);
+    mirror->owner = g_strdup(dbus_message_get_sender(reply));
+    mirror->seeded = TRUE;
+  }
+  if (reply)
+    dbus_message_unref(reply);
+
+  //what the old replica has and the new one will not
+  Local<Array> events = Array::New(isolate);
+  GHashTable *paths = g_hash_table_new(g_str_hash, g_str_equal);
+  guint len = entries->Length();
+  gchar **new_paths = g_new0(gchar *, len / 2 + 1);
+  for (guint i = 0; i < len; i += 2) {
+    new_paths[i / 2] = NDbusV8StringToCStr(entries->Get(i));
+    if (new_paths[i / 2])
+      g_hash_table_insert(paths, new_paths[i / 2], GUINT_TO_POINTER(i + 1));
+  }
+
+  GSequenceIter *iter = g_sequence_get_begin_iter(mirror->objects);
+  for (; !g_sequence_iter_is_end(iter); iter = g_sequence_iter_next(iter)) {
+    NDbusManagedObject *object = (NDbusManagedObject *)g_sequence_get(iter);
+    gpointer at = g_hash_table_lookup(paths, object->path);
+    Local<Array> removed = NDbusInterfaceNames(object);
+    if (at) {
+      //only the interfaces the object has lost
+      Local<Value> ifaces = entries->Get(GPOINTER_TO_UINT(at));
+      Local<Array> lost = Array::New(isolate);
+      guint n = 0;
+      for (guint j = 0; j < removed->Length(); j++) {
+        Local<Value> name = removed->Get(j);
+        if (!ifaces->IsObject() ||
+            !(ifaces->IsMap() ? Local<Map>::Cast(ifaces)->Has(
+                isolate->GetCurrentContext(), name).FromMaybe(false) :
+              Local<Object>::Cast(ifaces)->HasOwnProperty(
+                isolate->GetCurrentContext(), Local<v8::String>::Cast(name)).FromMaybe(false)))
+          lost->Set(n++, name);
+      }
+      removed = lost;
+    }
+    if (removed->Length() > 0) {
+      Local<Value> argv[2] = {
+        v8::String::NewFromUtf8(isolate, object->path), removed };
+      NDbusAddEvent(events, "interfacesRemoved", 2, argv);
+    }
+  }
+
+  NDbusClearManagedObjects(mirror);
+  for (guint i = 0; i < len; i += 2) {
+    if (!new_paths[i / 2])
+      continue;
+    Local<Value> ifaces = entries->Get(i + 1);
+    NDbusAddInterfaces(mirror, new_paths[i / 2], ifaces);
+    Local<Value> argv[2] = { entries->Get(i), ifaces };
+    NDbusAddEvent(events, "interfacesAdded", 2, argv);
+  }
+  g_hash_table_unref(paths);
+  g_strfreev(new_paths);
+
+  if (!mirror->callback.IsEmpty()) {
+    //the first seed settles mirrorObjects(), a failed one for good
+    Local<Function> callback = Local<Function>::New(isolate, mirror->callback);
+    mirror->callback.Reset();
+    if (!mirror->seeded)
+      g_hash_table_remove(object_mirrors, user_data);
+    Local<Value> argv[1] = { error };
+    callback->Call(callback, 1, argv);
+  } else {
+    NDbusEmitObjectEvents(GPOINTER_TO_UINT(user_data), events);
+  }
+}
+
+/**
+ * Applies one signal to mirror and adds the event it makes to events.
+ */
+static void
+NDbusApplyObjectSignal (NDbusObjectMirror *mirror, DBusMessage *message,
+    Local<Array> args, Local<Array> events) {
+  Isolate* isolate = Isolate::GetCurrent();
+  const gchar *member = dbus_message_get_member(message);
+
+  if (g_str_equal(member, "InterfacesAdded")) {
+    gchar *path = NDbusV8StringToCStr(args->Get(0));
+    if (path) {
+      NDbusAddInterfaces(mirror, path, args->Get(1));
+      Local<Value> argv[2] = { args->Get(0), args->Get(1) };
+      NDbusAddEvent(events, "interfacesAdded", 2, argv);
+    }
+    g_free(path);
+  } else if (g_str_equal(member, "InterfacesRemoved")) {
+    gchar *path = NDbusV8StringToCStr(args->Get(0));
+    if (path) {
+      NDbusRemoveInterfaces(mirror, path, Local<Array>::Cast(args->Get(1)));
+      Local<Value> argv[2] = { args->Get(0), args->Get(1) };
+      NDbusAddEvent(events, "interfacesRemoved", 2, argv);
+    }
+    g_free(path);
+  } else {
+    const gchar *path = dbus_message_get_path(message);
+    NDbusManagedObject *object = NDbusLookupManagedObject(mirror, path);
+    gchar *interface = NDbusV8StringToCStr(args->Get(0));
+    GHashTable *values = object && interface ? (GHashTable *)
+      g_hash_table_lookup(object->interfaces, interface) : NULL;
+    g_free(interface);
+    if (values == NULL)
+      return;
+
+    Local<Object> changed = Object::New(isolate);
+    NDbusStoreProperties(values, args->Get(1), changed);
+    Local<Array> invalidated = Local<Array>::Cast(args->Get(2));
+    for (guint i = 0; i < invalidated->Length(); i++) {
+      gchar *name = NDbusV8StringToCStr(invalidated->Get(i));
+      if (name)
+        g_hash_table_remove(values, name);
+      g_free(name);
+    }
+    Local<Value> argv[4] = { v8::String::NewFromUtf8(isolate, path),
+      args->Get(0), changed, invalidated };
+    NDbusAddEvent(events, "propertiesChanged", 4, argv);
+  }
+}
+
+/**
+ * Applies InterfacesAdded, InterfacesRemoved and PropertiesChanged to
+ * the replicas they concern. Returns TRUE if the message was one.
+ */
+gboolean
+NDbusHandleObjectManagerSignal (NDbusConnectionInfo *cnxn_info,
+    DBusMessage *message) {
+  const gchar *path = dbus_message_get_path(message);
+  gboolean manager;
+  if (dbus_message_is_signal(message,
+        NDBUS_INTERFACE_OBJECT_MANAGER, "InterfacesAdded"))
+    manager = dbus_message_has_signature(message, NDBUS_INTERFACES_ADDED_SIGN);
+  else if (dbus_message_is_signal(message,
+        NDBUS_INTERFACE_OBJECT_MANAGER, "InterfacesRemoved"))
+    manager = dbus_message_has_signature(message, NDBUS_INTERFACES_REMOVED_SIGN);
+  else if (dbus_message_is_signal(message,
+        DBUS_INTERFACE_PROPERTIES, "PropertiesChanged")) {
+    if (!dbus_message_has_signature(message, NDBUS_PROPERTIES_CHANGED_SIGN))
+      return TRUE;
+    manager = FALSE;
+  } else
+    return FALSE;
+  if (!path || cnxn_info->object_mirrors->len == 0)
+    return TRUE;
+
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+  const gchar *sender = dbus_message_get_sender(message);
+
+  GArray *targets = g_array_new(FALSE, FALSE, sizeof(guint));
+  for (guint i = 0; i < cnxn_info->object_mirrors->len; i++) {
+    NDbusObjectMirror *mirror = (NDbusObjectMirror *)
+      g_ptr_array_index(cnxn_info->object_mirrors, i);
+    if (!mirror->seeded ||
+        (sender && g_strcmp0(sender, mirror->owner) != 0))
+      continue;
+    //the manager sends the first two, its objects the third
+    if (manager ? g_str_equal(path, mirror->path) :
+        NDbusIsUnderPath(path, mirror->path))
+      g_array_append_val(targets, mirror->id);
+  }
+
+  Local<Array> args;
+  for (guint i = 0; i < targets->len; i++) {
+    guint id = g_array_index(targets, guint, i);
+    NDbusObjectMirror *mirror = (NDbusObjectMirror *)
+      g_hash_table_lookup(object_mirrors, GUINT_TO_POINTER(id));
+    if (mirror == NULL)
+      continue;
+    if (args.IsEmpty())
+      args = Local<Array>::Cast(NDbusRetrieveMessageArgs(message,
+            mirror->decode_flags & ~NDBUS_DECODE_RAW));
+
+    Local<Array> events = Array::New(isolate);
+    NDbusApplyObjectSignal(mirror, message, args, events);
+    NDbusEmitObjectEvents(id, events);
+  }
+  g_array_free(targets, TRUE);
+  return TRUE;
+}
+
+/**
+ * As NDbusReseedPropertyMirrors, for the replicas of destination name.
+ */
+void
+NDbusReseedObjectMirrors (NDbusConnectionInfo *cnxn_info,
+    const gchar *name, const gchar *new_owner) {
+  if (object_mirrors == NULL)
+    return;
+
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  GArray *targets = g_array_new(FALSE, FALSE, sizeof(guint));
+  for (guint i = 0; i < cnxn_info->object_mirrors->len; i++) {
+    NDbusObjectMirror *mirror = (NDbusObjectMirror *)
+      g_ptr_array_index(cnxn_info->object_mirrors, i);
+    if ((name == NULL || g_strcmp0(mirror->destination, name) == 0) &&
+        mirror->callback.IsEmpty())
+      g_array_append_val(targets, mirror->id);
+  }
+
+  for (guint i = 0; i < targets->len; i++) {
+    guint id = g_array_index(targets, guint, i);
+    NDbusObjectMirror *mirror = (NDbusObjectMirror *)
+      g_hash_table_lookup(object_mirrors, GUINT_TO_POINTER(id));
+    if (mirror == NULL)
+      continue;
+    g_free(mirror->owner);
+    mirror->owner = NULL;
+    if ((new_owner == NULL || new_owner[0] != '\0') &&
+        NDbusSeedObjectMirror(mirror))
+      continue;
+
+    mirror->seeded = FALSE;
+    mirror->seed_serial = 0;
+    Local<Array> events = Array::New(isolate);
+    GSequenceIter *iter = g_sequence_get_begin_iter(mirror->objects);
+    for (; !g_sequence_iter_is_end(iter); iter = g_sequence_iter_next(iter)) {
+      NDbusManagedObject *object = (NDbusManagedObject *)g_sequence_get(iter);
+      Local<Value> argv[2] = { v8::String::NewFromUtf8(isolate, object->path),
+        NDbusInterfaceNames(object) };
+      NDbusAddEvent(events, "interfacesRemoved", 2, argv);
+    }
+    NDbusClearManagedObjects(mirror);
+    NDbusEmitObjectEvents(id, events);
+  }
+  g_array_free(targets, TRUE);
+}
+
+/**
+ * As NDbusRestorePropertyMirrors, for the replicas on a connection.
+ */
+guint
+NDbusRestoreObjectMirrors (NDbusConnectionInfo *cnxn_info) {
+  for (guint i = 0; i < cnxn_info->object_mirrors->len; i++) {
+    NDbusObjectMirror *mirror = (NDbusObjectMirror *)
+      g_ptr_array_index(cnxn_info->object_mirrors, i);
+    dbus_bus_add_match(cnxn_info->cnxn, mirror->match, NULL);
+    dbus_bus_add_match(cnxn_info->cnxn, mirror->properties_match, NULL);
+  }
+  NDbusReseedObjectMirrors(cnxn_info, NULL, NULL);
+  return cnxn_info->object_mirrors->len * 2;
+}
+
+//EXPOSED
+/**
+ * Starts replicating the objects of the ObjectManager at args[2] of
+ * args[1] into the JS mirror args[0]. The matches go out before
+ * GetManagedObjects, args[3] is called once the replica is seeded.
+ * Returns the id of the replica.
+ */
+void
+NDbusMirrorObjects (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  NDbusConnectionInfo *cnxn_info = NDbusGetConnection(args.This());
+  if (!cnxn_info || !cnxn_info->cnxn)
+    NDBUS_EXCPN_DISCONNECTED;
+  if (!args[0]->IsObject() || !args[3]->IsFunction())
+    NDBUS_EXCPN_CALLBACK;
+
+  gchar *destination = NDbusV8StringToCStr(args[1]);
+  gchar *path = NDbusV8StringToCStr(args[2]);
+  const gchar *invalid = NULL;
+  if (destination ? !dbus_validate_bus_name(destination, NULL) :
+      !cnxn_info->peer)
+    invalid = NDBUS_ERROR_DEST;
+  else if (!path || !dbus_validate_path(path, NULL))
+    invalid = NDBUS_ERROR_PATH;
+  if (invalid) {
+    g_free(destination);
+    g_free(path);
+    NDBUS_THROW_EXCPN(DBUS_ERROR_INVALID_ARGS, invalid);
+  }
+
+  NDbusObjectMirror *mirror = g_new0(NDbusObjectMirror, 1);
+  mirror->id = ++last_object_mirror_id;
+  mirror->cnxn_info = NDbusConnectionInfoRef(cnxn_info);
+  mirror->destination = destination;
+  mirror->path = path;
+  mirror->decode_flags = NDbusGetDecodeFlags(args.This());
+  mirror->objects = g_sequence_new(NDbusFreeManagedObject);
+  mirror->index = g_hash_table_new(g_str_hash, g_str_equal);
+  mirror->object.Reset(isolate, Local<Object>::Cast(args[0]));
+  mirror->callback.Reset(isolate, Local<Function>::Cast(args[3]));
+
+  if (object_mirrors == NULL)
+    object_mirrors = g_hash_table_new_full(g_direct_hash,
+        g_direct_equal, NULL, NDbusFreeObjectMirror);
+  g_hash_table_insert(object_mirrors, GUINT_TO_POINTER(mirror->id), mirror);
+  g_ptr_array_add(cnxn_info->object_mirrors, mirror);
+
+  if (destination && destination[0] != ':')
+    NDbusWatchNameOwner(cnxn_info, destination);
+
+  gchar *sender = destination ?
+    g_strconcat(",sender='", destination, "'", NULL) : g_strdup("");
+  mirror->match = g_strconcat("type='signal',interface='",
+      NDBUS_INTERFACE_OBJECT_MANAGER, "',path='", path, "'", sender, NULL);
+  mirror->properties_match = g_strconcat("type='signal',interface='",
+      DBUS_INTERFACE_PROPERTIES, "',member='PropertiesChanged',path_namespace='",
+      path, "'", sender, NULL);
+  g_free(sender);
+  if (!cnxn_info->peer) {
+    dbus_bus_add_match(cnxn_info->cnxn, mirror->match, NULL);
+    dbus_bus_add_match(cnxn_info->cnxn, mirror->properties_match, NULL);
+  }
+
+  if (!NDbusSeedObjectMirror(mirror)) {
+    g_hash_table_remove(object_mirrors, GUINT_TO_POINTER(mirror->id));
+    NDBUS_EXCPN_OOM;
+  }
+  args.GetReturnValue().Set(Uint32::NewFromUnsigned(isolate, mirror->id));
+}
+
+//EXPOSED
+/**
+ * { interface: { name: value } } of the object at args[1] of replica
+ * args[0], or undefined if there is none.
+ */
+void
+NDbusGetManagedObject (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  NDbusObjectMirror *mirror = NDbusLookupObjectMirror(args[0]);
+  if (!mirror)
+    NDBUS_EXCPN_OBJECTS;
+
+  v8::String::Utf8Value path(args[1]);
+  NDbusManagedObject *object = *path ?
+    NDbusLookupManagedObject(mirror, *path) : NULL;
+  if (object)
+    args.GetReturnValue().Set(NDbusDescribeManagedObject(object));
+  else
+    args.GetReturnValue().SetUndefined();
+}
+
+/**
+ * Calls func on each object at or below prefix, in path order, which
+ * is a walk of a range of the sorted objects.
+ */
+static void
+NDbusForEachManagedObject (NDbusObjectMirror *mirror, const gchar *prefix,
+    void (*func) (NDbusManagedObject *, gpointer), gpointer user_data) {
+  GSequenceIter *iter;
+  if (prefix == NULL || g_str_equal(prefix, "/")) {
+    iter = g_sequence_get_begin_iter(mirror->objects);
+  } else {
+    NDbusManagedObject probe = { (gchar *)prefix, NULL };
+    iter = (GSequenceIter *)g_hash_table_lookup(mirror->index, prefix);
+    if (iter == NULL)
+      iter = g_sequence_search(mirror->objects, &probe,
+          NDbusCompareManagedObjects, NULL);
+  }
+
+  for (; !g_sequence_iter_is_end(iter); iter = g_sequence_iter_next(iter)) {
+    NDbusManagedObject *object = (NDbusManagedObject *)g_sequence_get(iter);
+    if (prefix && !NDbusIsUnderPath(object->path, prefix))
+      break;
+    func(object, user_data);
+  }
+}
+
+static void
+NDbusDescribeInto (NDbusManagedObject *object, gpointer user_data) {
+  Isolate* isolate = Isolate::GetCurrent();
+  (*(Local<Object> *)user_data)->Set(
+      v8::String::NewFromUtf8(isolate, object->path),
+      NDbusDescribeManagedObject(object));
+}
+
+static void
+NDbusAppendPath (NDbusManagedObject *object, gpointer user_data) {
+  Isolate* isolate = Isolate::GetCurrent();
+  Local<Array> paths = *(Local<Array> *)user_data;
+  paths->Set(paths->Length(), v8::String::NewFromUtf8(isolate, object->path));
+}
+
+//EXPOSED
+/**
+ * { path: { interface: { name: value } } } of the objects of replica
+ * args[0] at or below path args[1], or of all of them.
+ */
+void
+NDbusGetManagedObjects (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  NDbusObjectMirror *mirror = NDbusLookupObjectMirror(args[0]);
+  if (!mirror)
+    NDBUS_EXCPN_OBJECTS;
+
+  gchar *prefix = NDbusV8StringToCStr(args[1]);
+  Local<Object> objects = Object::New(isolate);
+  NDbusForEachManagedObject(mirror, prefix, NDbusDescribeInto, &objects);
+  g_free(prefix);
+  args.GetReturnValue().Set(objects);
+}
+
+//EXPOSED
+void
+NDbusGetManagedPaths (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  NDbusObjectMirror *mirror = NDbusLookupObjectMirror(args[0]);
+  if (!mirror)
+    NDBUS_EXCPN_OBJECTS;
+
+  gchar *prefix = NDbusV8StringToCStr(args[1]);
+  Local<Array> paths = Array::New(isolate);
+  NDbusForEachManagedObject(mirror, prefix, NDbusAppendPath, &paths);
+  g_free(prefix);
+  args.GetReturnValue().Set(paths);
+}
+
+//EXPOSED
+void
+NDbusReleaseObjectMirror (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  if (object_mirrors && args[0]->IsUint32())
+    g_hash_table_remove(object_mirrors,
+        GUINT_TO_POINTER(args[0]->Uint32Value()));
+  args.GetReturnValue().SetUndefined();
+}
+
+} //namespace ndbus
@@ -0,0 +1,530 @@
+/*
+ * Copyright (c) 2011, Motorola Mobility, Inc
+ * All Rights Reserved.
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+#include "ndbus.h"
+
+namespace ndbus {
+
+#define NDBUS_PROPERTIES_CHANGED      "PropertiesChanged"
+#define NDBUS_PROPERTIES_CHANGED_SIGN "sa{sv}as"
+#define NDBUS_PROPERTIES_GETALL_SIGN  "a{sv}"
+
+static GHashTable *mirrors = NULL;
+static guint last_mirror_id = 0;
+
+static void
+NDbusFreePropertyValue (gpointer data) {
+  NDbusPropertyValue *value = (NDbusPropertyValue *)data;
+  if (value) {
+    value->value.Reset();
+    g_free(value);
+  }
+}
+
+static gchar*
+NDbusMirrorKey (const gchar *path, const gchar *interface) {
+  return g_strconcat(path, " ", interface, NULL);
+}
+
+static void
+NDbusFreePropertyMirror (gpointer data) {
+  NDbusPropertyMirror *mirror = (NDbusPropertyMirror *)data;
+  if (mirror == NULL)
+    return;
+
+  NDbusConnectionInfo *cnxn_info = mirror->cnxn_info;
+  gchar *key = NDbusMirrorKey(mirror->path, mirror->interface);
+  GPtrArray *index = (GPtrArray *)
+    g_hash_table_lookup(cnxn_info->property_mirrors, key);
+  if (index) {
+    g_ptr_array_remove_fast(index, mirror);
+    if (index->len == 0)
+      g_hash_table_remove(cnxn_info->property_mirrors, key);
+  }
+  g_free(key);
+
+  if (cnxn_info->cnxn)
+    dbus_bus_remove_match(cnxn_info->cnxn, mirror->match, NULL);
+  NDbusConnectionInfoUnref(cnxn_info);
+
+  g_hash_table_unref(mirror->values);
+  mirror->object.Reset();
+  mirror->callback.Reset();
+  g_free(mirror->destination);
+  g_free(mirror->owner);
+  g_free(mirror->path);
+  g_free(mirror->interface);
+  g_free(mirror->match);
+  g_free(mirror);
+}
+
+/**
+ * The properties in values as a { name: value } object.
+ */
+Local<Object>
+NDbusDescribeProperties (GHashTable *values) {
+  Isolate* isolate = Isolate::GetCurrent();
+  EscapableHandleScope scope(isolate);
+
+  Local<Object> properties = Object::New(isolate);
+  GHashTableIter iter;
+  gpointer name, value;
+  g_hash_table_iter_init(&iter, values);
+  while (g_hash_table_iter_next(&iter, &name, &value))
+    properties->Set(v8::String::NewFromUtf8(isolate, (const gchar *)name),
+        Local<Value>::New(isolate, ((NDbusPropertyValue *)value)->value));
+  return scope.Escape(properties);
+}
+
+static NDbusPropertyMirror*
+NDbusLookupMirror (Local<Value> id) {
+  if (mirrors == NULL || !id->IsUint32())
+    return NULL;
+  return (NDbusPropertyMirror *)g_hash_table_lookup(mirrors,
+      GUINT_TO_POINTER(id->Uint32Value()));
+}
+
+//EXPOSED
+GHashTable*
+NDbusPropertyValuesNew (void) {
+  return g_hash_table_new_full(g_str_hash, g_str_equal,
+      g_free, NDbusFreePropertyValue);
+}
+
+/**
+ * Stores the name -> value entries of dict, an object or a Map
+ * depending on the decode flags, into values and adds them to changed.
+ */
+void
+NDbusStoreProperties (GHashTable *values,
+    Local<Value> dict, Local<Object> changed) {
+  Isolate* isolate = Isolate::GetCurrent();
+  if (!dict->IsObject())
+    return;
+
+  gboolean map = dict->IsMap();
+  Local<Object> obj = Local<Object>::Cast(dict);
+  Local<Array> entries = map ?
+    Local<Map>::Cast(dict)->AsArray() : obj->GetOwnPropertyNames();
+  guint len = entries->Length();
+  for (guint i = 0; i < len; i += map ? 2 : 1) {
+    Local<Value> name = entries->Get(i);
+    Local<Value> value = map ? entries->Get(i + 1) : obj->Get(name);
+    gchar *key = NDbusV8StringToCStr(name);
+    if (!key)
+      continue;
+
+    NDbusPropertyValue *stored = g_new0(NDbusPropertyValue, 1);
+    stored->value.Reset(isolate, value);
+    g_hash_table_replace(values, key, stored);
+    changed->Set(name, value);
+  }
+}
+
+static void
+NDbusNotifyPropertiesChanged (NDbusPropertyMirror *mirror,
+    Local<Object> changed, Local<Array> invalidated) {
+  Isolate* isolate = Isolate::GetCurrent();
+  Local<Object> object = Local<Object>::New(isolate, mirror->object);
+  Handle<Object> local_global_target = Local<Object>::New(isolate, global_target);
+  Local<Function> func = Local<Function>::Cast(
+      local_global_target->Get(NDBUS_CB_PROPERTIESCHANGED));
+  Local<Value> argv[2];
+  argv[0] = changed;
+  argv[1] = invalidated;
+
+  if (NDbusIsValidV8Value(object) &&
+      NDbusIsValidV8Value(func) &&
+      func->IsFunction())
+    func->Call(object, 2, argv);
+}
+
+static void NDbusHandleGetAllReply (DBusPendingCall *pending,
+    void *user_data);
+
+/**
+ * Asks the destination for all the properties of the interface. Signals
+ * received until the reply are already reflected in it and dropped.
+ */
+static gboolean
+NDbusSeedPropertyMirror (NDbusPropertyMirror *mirror) {
+  NDbusConnectionInfo *cnxn_info = mirror->cnxn_info;
+  if (!cnxn_info->cnxn)
+    return FALSE;
+
+  DBusMessage *msg = dbus_message_new_method_call(mirror->destination,
+      mirror->path, DBUS_INTERFACE_PROPERTIES, "GetAll");
+  if (msg == NULL)
+    return FALSE;
+
+  const gchar *interface = mirror->interface;
+  DBusPendingCall *pending = NULL;
+  gboolean sent = dbus_message_append_args(msg,
+        DBUS_TYPE_STRING, &interface, DBUS_TYPE_INVALID) &&
+    dbus_connection_send_with_reply(cnxn_info->cnxn, msg,
+        &pending, DBUS_TIMEOUT_USE_DEFAULT) && pending;
+  if (sent) {
+    mirror->seeded = FALSE;
+    mirror->seed_serial = dbus_message_get_serial(msg);
+    dbus_pending_call_set_notify(pending, NDbusHandleGetAllReply,
+        GUINT_TO_POINTER(mirror->id), NULL);
+  }
+  dbus_message_unref(msg);
+  return sent;
+}
+
+static void
+NDbusHandleGetAllReply (DBusPendingCall *pending,
+    void *user_data) {
+  g_return_if_fail(pending != NULL);
+
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  DBusMessage *reply = dbus_pending_call_steal_reply(pending);
+  dbus_pending_call_unref(pending);
+
+  //released meanwhile, or superseded by a later GetAll
+  NDbusPropertyMirror *mirror = mirrors ? (NDbusPropertyMirror *)
+    g_hash_table_lookup(mirrors, user_data) : NULL;
+  if (mirror == NULL || (reply &&
+        dbus_message_get_reply_serial(reply) != mirror->seed_serial)) {
+    if (reply)
+      dbus_message_unref(reply);
+    return;
+  }
+  mirror->seed_serial = 0;
+
+  Local<Value> error = Undefined(isolate);
+  Local<Object> changed = Object::New(isolate);
+  GHashTable *old_values = mirror->values;
+  mirror->values = NDbusPropertyValuesNew();
+
+  if (!reply) {
+    NDBUS_SET_EXCPN(error, DBUS_ERROR_NO_REPLY, NDBUS_ERROR_NOREPLY);
+  } else if (dbus_message_get_type(reply) == DBUS_MESSAGE_TYPE_ERROR) {
+    DBusError dbus_error;
+    dbus_error_init(&dbus_error);
+    dbus_set_error_from_message(&dbus_error, reply);
+    NDBUS_SET_EXCPN(error, dbus_error.name, dbus_error.message);
+    dbus_error_free(&dbus_error);
+  } else if (!dbus_message_has_signature(reply, NDBUS_PROPERTIES_GETALL_SIGN)) {
+    NDBUS_SET_EXCPN(error, DBUS_ERROR_INVALID_SIGNATURE, NDBUS_ERROR_REPLY_SIGN);
+  } else {
+    Local<Array> args = Local<Array>::Cast(NDbusRetrieveMessageArgs(reply,
+          mirror->decode_flags & ~NDBUS_DECODE_RAW));
+    NDbusStoreProperties(mirror->values, args->Get(0), changed);
+    g_free(mirror->owner);
+    mirror->owner = g_strdup(dbus_message_get_sender(reply));
+    mirror->seeded = TRUE;
+  }
+
+  //whatever was there before and is not anymore
+  Local<Array> invalidated = Array::New(isolate);
+  GHashTableIter iter;
+  gpointer name;
+  guint i = 0;
+  g_hash_table_iter_init(&iter, old_values);
+  while (g_hash_table_iter_next(&iter, &name, NULL)) {
+    if (!g_hash_table_contains(mirror->values, name))
+      invalidated->Set(i++, v8::String::NewFromUtf8(isolate, (const gchar *)name));
+  }
+  g_hash_table_unref(old_values);
+  if (reply)
+    dbus_message_unref(reply);
+
+  if (!mirror->callback.IsEmpty()) {
+    //the first seed settles mirrorProperties(), a failed one for good
+    Local<Function> callback = Local<Function>::New(isolate, mirror->callback);
+    mirror->callback.Reset();
+    if (!mirror->seeded)
+      g_hash_table_remove(mirrors, user_data);
+    Local<Value> argv[1] = { error };
+    callback->Call(callback, 1, argv);
+  } else {
+    NDbusNotifyPropertiesChanged(mirror, changed, invalidated);
+  }
+}
+
+/**
+ * Applies PropertiesChanged to the mirrors of its path and interface
+ * which it came from. Returns TRUE if the message was one.
+ */
+gboolean
+NDbusHandlePropertiesChanged (NDbusConnectionInfo *cnxn_info,
+    DBusMessage *message) {
+  if (!dbus_message_is_signal(message,
+        DBUS_INTERFACE_PROPERTIES, NDBUS_PROPERTIES_CHANGED))
+    return FALSE;
+
+  const gchar *interface = NULL;
+  if (!dbus_message_has_signature(message, NDBUS_PROPERTIES_CHANGED_SIGN) ||
+      !dbus_message_get_path(message) ||
+      !dbus_message_get_args(message, NULL,
+        DBUS_TYPE_STRING, &interface, DBUS_TYPE_INVALID))
+    return TRUE;
+
+  gchar *key = NDbusMirrorKey(dbus_message_get_path(message), interface);
+  GPtrArray *index = (GPtrArray *)
+    g_hash_table_lookup(cnxn_info->property_mirrors, key);
+  g_free(key);
+  if (index == NULL)
+    return TRUE;
+
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+  const gchar *sender = dbus_message_get_sender(message);
+  Local<Array> args;
+
+  //listeners may release mirrors, so work on a copy of the index
+  GPtrArray *targets = g_ptr_array_sized_new(index->len);
+  for (guint i = 0; i < index->len; i++) {
+    NDbusPropertyMirror *mirror = (NDbusPropertyMirror *)
+      g_ptr_array_index(index, i);
+    if (mirror->seeded && (!sender || g_strcmp0(sender, mirror->owner) == 0))
+      g_ptr_array_add(targets, GUINT_TO_POINTER(mirror->id));
+  }
+
+  for (guint i = 0; i < targets->len; i++) {
+    NDbusPropertyMirror *mirror = (NDbusPropertyMirror *)
+      g_hash_table_lookup(mirrors, g_ptr_array_index(targets, i));
+    if (mirror == NULL)
+      continue;
+    if (args.IsEmpty())
+      args = Local<Array>::Cast(NDbusRetrieveMessageArgs(message,
+            mirror->decode_flags & ~NDBUS_DECODE_RAW));
+
+    Local<Object> changed = Object::New(isolate);
+    NDbusStoreProperties(mirror->values, args->Get(1), changed);
+
+    //the new value of an invalidated property is not sent along
+    Local<Array> invalidated = Local<Array>::Cast(args->Get(2));
+    for (guint j = 0; j < invalidated->Length(); j++) {
+      gchar *name = NDbusV8StringToCStr(invalidated->Get(j));
+      if (name)
+        g_hash_table_remove(mirror->values, name);
+      g_free(name);
+    }
+    NDbusNotifyPropertiesChanged(mirror, changed, invalidated);
+  }
+  g_ptr_array_unref(targets);
+  return TRUE;
+}
+
+/**
+ * Seeds again the mirrors of destination name, which has moved to
+ * new_owner, or drops their values if it went away. A NULL name stands
+ * for all destinations and a NULL new_owner for one not known yet.
+ */
+void
+NDbusReseedPropertyMirrors (NDbusConnectionInfo *cnxn_info,
+    const gchar *name, const gchar *new_owner) {
+  if (mirrors == NULL)
+    return;
+
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  GPtrArray *targets = g_ptr_array_new();
+  GHashTableIter iter;
+  gpointer id, value;
+  g_hash_table_iter_init(&iter, mirrors);
+  while (g_hash_table_iter_next(&iter, &id, &value)) {
+    NDbusPropertyMirror *mirror = (NDbusPropertyMirror *)value;
+    if (mirror->cnxn_info == cnxn_info &&
+        (name == NULL || g_strcmp0(mirror->destination, name) == 0) &&
+        mirror->callback.IsEmpty())
+      g_ptr_array_add(targets, id);
+  }
+
+  for (guint i = 0; i < targets->len; i++) {
+    NDbusPropertyMirror *mirror = (NDbusPropertyMirror *)
+      g_hash_table_lookup(mirrors, g_ptr_array_index(targets, i));
+    if (mirror == NULL)
+      continue;
+    g_free(mirror->owner);
+    mirror->owner = NULL;
+    if ((new_owner == NULL || new_owner[0] != '\0') &&
+        NDbusSeedPropertyMirror(mirror))
+      continue;
+
+    mirror->seeded = FALSE;
+    mirror->seed_serial = 0;
+    Local<Array> invalidated = Array::New(isolate);
+    GHashTableIter values;
+    gpointer property;
+    guint j = 0;
+    g_hash_table_iter_init(&values, mirror->values);
+    while (g_hash_table_iter_next(&values, &property, NULL))
+      invalidated->Set(j++, v8::String::NewFromUtf8(isolate, (const gchar *)property));
+    g_hash_table_remove_all(mirror->values);
+    NDbusNotifyPropertiesChanged(mirror, Object::New(isolate), invalidated);
+  }
+  g_ptr_array_unref(targets);
+}
+
+/**
+ * Adds again the matches of the mirrors on a connection which came
+ * back and seeds them anew. Returns the number of matches added.
+ */
+guint
+NDbusRestorePropertyMirrors (NDbusConnectionInfo *cnxn_info) {
+  if (mirrors == NULL)
+    return 0;
+
+  guint restored = 0;
+  GHashTableIter iter;
+  gpointer value;
+  g_hash_table_iter_init(&iter, mirrors);
+  while (g_hash_table_iter_next(&iter, NULL, &value)) {
+    NDbusPropertyMirror *mirror = (NDbusPropertyMirror *)value;
+    if (mirror->cnxn_info != cnxn_info)
+      continue;
+    dbus_bus_add_match(cnxn_info->cnxn, mirror->match, NULL);
+    restored++;
+  }
+  NDbusReseedPropertyMirrors(cnxn_info, NULL, NULL);
+  return restored;
+}
+
+//EXPOSED
+/**
+ * Starts mirroring the properties of interface args[3] of the object
+ * at args[2] of args[1] into the JS mirror args[0]. The match goes out
+ * before GetAll so that no change can slip in between. args[4] is
+ * called once the mirror is seeded. Returns the id of the mirror.
+ */
+void
+NDbusMirrorProperties (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  NDbusConnectionInfo *cnxn_info = NDbusGetConnection(args.This());
+  if (!cnxn_info || !cnxn_info->cnxn)
+    NDBUS_EXCPN_DISCONNECTED;
+  if (!args[0]->IsObject() || !args[4]->IsFunction())
+    NDBUS_EXCPN_CALLBACK;
+
+  gchar *destination = NDbusV8StringToCStr(args[1]);
+  gchar *path = NDbusV8StringToCStr(args[2]);
+  gchar *interface = NDbusV8StringToCStr(args[3]);
+  const gchar *invalid = NULL;
+  if (destination ? !dbus_validate_bus_name(destination, NULL) :
+      !cnxn_info->peer)
+    invalid = NDBUS_ERROR_DEST;
+  else if (!path || !dbus_validate_path(path, NULL))
+    invalid = NDBUS_ERROR_PATH;
+  else if (!interface || !dbus_validate_interface(interface, NULL))
+    invalid = NDBUS_ERROR_INTERFACE;
+  if (invalid) {
+    g_free(destination);
+    g_free(path);
+    g_free(interface);
+    NDBUS_THROW_EXCPN(DBUS_ERROR_INVALID_ARGS, invalid);
+  }
+
+  NDbusPropertyMirror *mirror = g_new0(NDbusPropertyMirror, 1);
+  mirror->id = ++last_mirror_id;
+  mirror->cnxn_info = NDbusConnectionInfoRef(cnxn_info);
+  mirror->destination = destination;
+  mirror->path = path;
+  mirror->interface = interface;
+  mirror->decode_flags = NDbusGetDecodeFlags(args.This());
+  mirror->values = NDbusPropertyValuesNew();
+  mirror->object.Reset(isolate, Local<Object>::Cast(args[0]));
+  mirror->callback.Reset(isolate, Local<Function>::Cast(args[4]));
+
+  if (mirrors == NULL)
+    mirrors = g_hash_table_new_full(g_direct_hash,
+        g_direct_equal, NULL, NDbusFreePropertyMirror);
+  g_hash_table_insert(mirrors, GUINT_TO_POINTER(mirror->id), mirror);
+
+  gchar *key = NDbusMirrorKey(path, interface);
+  GPtrArray *index = (GPtrArray *)
+    g_hash_table_lookup(cnxn_info->property_mirrors, key);
+  if (index == NULL) {
+    index = g_ptr_array_new();
+    g_hash_table_insert(cnxn_info->property_mirrors, key, index);
+  } else {
+    g_free(key);
+  }
+  g_ptr_array_add(index, mirror);
+
+  //a well-known destination is followed to its next owner
+  if (destination && destination[0] != ':')
+    NDbusWatchNameOwner(cnxn_info, destination);
+
+  mirror->match = g_strconcat("type='signal',interface='",
+      DBUS_INTERFACE_PROPERTIES, "',member='", NDBUS_PROPERTIES_CHANGED,
+      "',path='", path, "',arg0='", interface, "'", NULL);
+  if (destination) {
+    gchar *match = g_strconcat(mirror->match, ",sender='", destination, "'", NULL);
+    g_free(mirror->match);
+    mirror->match = match;
+  }
+  if (!cnxn_info->peer)
+    dbus_bus_add_match(cnxn_info->cnxn, mirror->match, NULL);
+
+  if (!NDbusSeedPropertyMirror(mirror)) {
+    g_hash_table_remove(mirrors, GUINT_TO_POINTER(mirror->id));
+    NDBUS_EXCPN_OOM;
+  }
+  args.GetReturnValue().Set(Uint32::NewFromUnsigned(isolate, mirror->id));
+}
+
+//EXPOSED
+/**
+ * The mirrored value of property args[1] of mirror args[0], which is
+ * undefined if the object does not have it or only said it changed.
+ */
+void
+NDbusGetMirroredProperty (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  NDbusPropertyMirror *mirror = NDbusLookupMirror(args[0]);
+  if (!mirror)
+    NDBUS_EXCPN_MIRROR;
+
+  v8::String::Utf8Value name(args[1]);
+  NDbusPropertyValue *value = *name ? (NDbusPropertyValue *)
+    g_hash_table_lookup(mirror->values, *name) : NULL;
+  if (value)
+    args.GetReturnValue().Set(Local<Value>::New(isolate, value->value));
+  else
+    args.GetReturnValue().SetUndefined();
+}
+
+//EXPOSED
+void
+NDbusGetMirroredProperties (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  NDbusPropertyMirror *mirror = NDbusLookupMirror(args[0]);
+  if (!mirror)
+    NDBUS_EXCPN_MIRROR;
+
+  args.GetReturnValue().Set(NDbusDescribeProperties(mirror->values));
+}
+
+//EXPOSED
+void
+NDbusReleaseMirror (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  if (mirrors && args[0]->IsUint32())
+    g_hash_table_remove(mirrors,
+        GUINT_TO_POINTER(args[0]->Uint32Value()));
+  args.GetReturnValue().SetUndefined();
+}
+
+} //namespace ndbus
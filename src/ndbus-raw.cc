@@ -0,0 +1,266 @@
+/*
+ * Copyright (c) 2011, Motorola Mobility, Inc
+ * All Rights Reserved.
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+#include "ndbus.h"
+#include <node_buffer.h>
+
+namespace ndbus {
+
+static void
+NDbusFreeMarshalled (char *data, void *hint) {
+  dbus_free(data);
+}
+
+//EXPOSED
+/**
+ * The wire format of msg, in a Buffer which takes over the marshalled
+ * data. Returns an empty handle if msg carries unix fds, which have no
+ * wire format, or memory runs out.
+ */
+Local<Value>
+NDbusMarshalMessage (DBusMessage *msg) {
+  Isolate* isolate = Isolate::GetCurrent();
+
+#ifdef DBUS_TYPE_UNIX_FD
+  if (dbus_message_contains_unix_fds(msg))
+    return Local<Value>();
+#endif
+
+  gchar *data = NULL;
+  gint len = 0;
+  if (!dbus_message_marshal(msg, &data, &len))
+    return Local<Value>();
+
+  Local<Object> buffer;
+  if (!node::Buffer::New(isolate, data, len,
+        NDbusFreeMarshalled, NULL).ToLocal(&buffer)) {
+    dbus_free(data);
+    return Local<Value>();
+  }
+  return buffer;
+}
+
+/**
+ * A sendable message from the marshalled one in value. It is a copy,
+ * which has no serial yet, so the connection gives it a fresh one.
+ * Returns NULL and sets error if value is no valid message.
+ */
+static DBusMessage*
+NDbusDemarshalMessage (Local<Value> value, gboolean copy,
+    Local<Object> *error) {
+  Isolate* isolate = Isolate::GetCurrent();
+
+  if (!node::Buffer::HasInstance(value)) {
+    NDBUS_SET_EXCPN(*error, DBUS_ERROR_INVALID_ARGS, NDBUS_ERROR_RAW);
+    return NULL;
+  }
+
+  DBusError err;
+  dbus_error_init(&err);
+  DBusMessage *msg = dbus_message_demarshal(node::Buffer::Data(value),
+      node::Buffer::Length(value), &err);
+  if (!msg) {
+    NDBUS_SET_EXCPN(*error, err.name, err.message);
+    dbus_error_free(&err);
+    return NULL;
+  }
+
+  if (copy) {
+    DBusMessage *sendable = dbus_message_copy(msg);
+    dbus_message_unref(msg);
+    msg = sendable;
+    if (!msg)
+      NDBUS_SET_EXCPN(*error, DBUS_ERROR_NO_MEMORY, NDBUS_ERROR_OOM);
+  }
+  if (msg && copy)
+    NDBUS_PROBE(message__create, msg);
+  return msg;
+}
+
+static Local<Value>
+NDbusStringOrNull (const gchar *value) {
+  Isolate* isolate = Isolate::GetCurrent();
+  if (value)
+    return v8::String::NewFromUtf8(isolate, value);
+  return Null(isolate);
+}
+
+/**
+ * Builds the message this object would send and returns it marshalled.
+ * It gets serial 1, which demarshalling requires, and a fresh one
+ * whenever it is sent again with sendRaw() or callRaw().
+ */
+void
+NDbusMarshal (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  NDbusVariantPolicy variantPolicy = (NDbusVariantPolicy)NDbusGetProperty(args.This(),
+        NDBUS_PROPERTY_VARIANT_POLICY)->IntegerValue();
+
+  gint message_type =
+    NDbusGetProperty(args.This(),
+        NDBUS_PROPERTY_TYPE)->IntegerValue();
+  if (message_type == DBUS_MESSAGE_TYPE_METHOD_RETURN)
+    message_type = DBUS_MESSAGE_TYPE_METHOD_CALL;
+  else if (message_type != DBUS_MESSAGE_TYPE_METHOD_CALL &&
+      message_type != DBUS_MESSAGE_TYPE_SIGNAL)
+    NDBUS_EXCPN_TYPE;
+
+  //no connection is involved, so no destination is required
+  Local<Object> error;
+  DBusMessage *msg = NDbusNewMessageFromEntry(args.This(), args.This(),
+      message_type, NULL, &error);
+  if (!msg) {
+    isolate->ThrowException(error);
+    return;
+  }
+
+  if (!NDbusMessageAppendArgs(&msg, args.This(), &error, variantPolicy)) {
+    dbus_message_unref(msg);
+    isolate->ThrowException(error);
+    return;
+  }
+
+  dbus_message_set_serial(msg, 1);
+  Local<Value> buffer = NDbusMarshalMessage(msg);
+  dbus_message_unref(msg);
+  if (buffer.IsEmpty())
+    NDBUS_THROW_EXCPN(DBUS_ERROR_NOT_SUPPORTED, NDBUS_ERROR_MARSHAL);
+
+  args.GetReturnValue().Set(buffer);
+}
+
+/**
+ * Decodes the marshalled message in args[0] with the decode flags
+ * in args[1] into a plain object, without sending it anywhere.
+ */
+void
+NDbusDemarshal (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  Local<Object> error;
+  DBusMessage *msg = NDbusDemarshalMessage(args[0], FALSE, &error);
+  if (!msg) {
+    isolate->ThrowException(error);
+    return;
+  }
+  guint decode_flags = args[1]->IsUint32() ?
+    args[1]->Uint32Value() : (guint)NDBUS_DECODE_DEFAULT;
+
+  Local<Object> ret = Object::New(isolate);
+  ret->Set(v8::String::NewFromUtf8(isolate, NDBUS_PROPERTY_TYPE),
+      Integer::New(isolate, dbus_message_get_type(msg)));
+  ret->Set(v8::String::NewFromUtf8(isolate, NDBUS_PROPERTY_PATH),
+      NDbusStringOrNull(dbus_message_get_path(msg)));
+  ret->Set(v8::String::NewFromUtf8(isolate, NDBUS_PROPERTY_INTERFACE),
+      NDbusStringOrNull(dbus_message_get_interface(msg)));
+  ret->Set(v8::String::NewFromUtf8(isolate, NDBUS_PROPERTY_MEMBER),
+      NDbusStringOrNull(dbus_message_get_member(msg)));
+  ret->Set(v8::String::NewFromUtf8(isolate, NDBUS_PROPERTY_SENDER),
+      NDbusStringOrNull(dbus_message_get_sender(msg)));
+  ret->Set(v8::String::NewFromUtf8(isolate, NDBUS_PROPERTY_DEST),
+      NDbusStringOrNull(dbus_message_get_destination(msg)));
+  ret->Set(v8::String::NewFromUtf8(isolate, NDBUS_PROPERTY_ENTRY_SIGN),
+      NDbusStringOrNull(dbus_message_get_signature(msg)));
+  ret->Set(v8::String::NewFromUtf8(isolate, NDBUS_PROPERTY_ENTRY_ARGS),
+      NDbusRetrieveMessageArgs(msg, decode_flags & ~NDBUS_DECODE_RAW));
+  dbus_message_unref(msg);
+
+  args.GetReturnValue().Set(ret);
+}
+
+/**
+ * Sends the marshalled message in args[0], as it is, on the connection
+ * of this object. A reply to a method-call is not waited for.
+ */
+void
+NDbusSendRaw (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  NDbusConnectionInfo *cnxn_info = NDbusGetConnection(args.This());
+  if (!cnxn_info || !cnxn_info->cnxn)
+    NDBUS_EXCPN_DISCONNECTED;
+
+  Local<Object> error;
+  DBusMessage *msg = NDbusDemarshalMessage(args[0], TRUE, &error);
+  if (!msg) {
+    isolate->ThrowException(error);
+    return;
+  }
+
+  if (!dbus_connection_send(cnxn_info->cnxn, msg, NULL)) {
+    dbus_message_unref(msg);
+    NDBUS_EXCPN_OOM;
+  }
+  NDbusCountMessage(cnxn_info, msg, FALSE);
+  dbus_message_unref(msg);
+
+  args.GetReturnValue().Set(NDbusCheckWritable(cnxn_info, args.This()) == TRUE);
+}
+
+/**
+ * Sends the marshalled method-call in args[0] on the connection of this
+ * object and hands its reply to the callback in args[1], decoded with
+ * the decode flags of this object. Returns the id of the call for
+ * cancelCall().
+ */
+void
+NDbusCallRaw (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  if (!args[1]->IsFunction())
+    NDBUS_EXCPN_CALLBACK;
+
+  NDbusConnectionInfo *cnxn_info = NDbusGetConnection(args.This());
+  if (!cnxn_info || !cnxn_info->cnxn)
+    NDBUS_EXCPN_DISCONNECTED;
+
+  Local<Object> error;
+  DBusMessage *msg = NDbusDemarshalMessage(args[0], TRUE, &error);
+  if (!msg) {
+    isolate->ThrowException(error);
+    return;
+  }
+
+  if (dbus_message_get_type(msg) != DBUS_MESSAGE_TYPE_METHOD_CALL) {
+    dbus_message_unref(msg);
+    NDBUS_EXCPN_TYPE;
+  }
+  //the reply is what the caller waits for
+  dbus_message_set_no_reply(msg, FALSE);
+
+  gint timeout = NDbusGetProperty(args.This(),
+      NDBUS_PROPERTY_TIMEOUT)->IntegerValue();
+  DBusPendingCall *pending = NULL;
+  if (!dbus_connection_send_with_reply(cnxn_info->cnxn, msg,
+        &pending, timeout) || !pending) {
+    dbus_message_unref(msg);
+    NDBUS_EXCPN_OOM;
+  }
+  NDbusTimeCall(cnxn_info, msg, pending);
+  dbus_message_unref(msg);
+
+  NDbusCallbackInfo *cb_info = g_new0(NDbusCallbackInfo, 1);
+  cb_info->callback.Reset(isolate, Local<Function>::Cast(args[1]));
+  cb_info->cnxn_info = NDbusConnectionInfoRef(cnxn_info);
+  cb_info->decode_flags = NDbusGetDecodeFlags(args.This());
+  dbus_pending_call_set_notify(pending, NDbusHandleCallbackReply,
+      (void *)cb_info, NDbusFreeCallbackInfo);
+  guint call_id = NDbusTrackPendingCall(pending);
+
+  NDbusCheckWritable(cnxn_info, args.This());
+  args.GetReturnValue().Set(Uint32::NewFromUnsigned(isolate, call_id));
+}
+
+} //namespace ndbus
@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2011, Motorola Mobility, Inc
+ * All Rights Reserved.
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+#include "ndbus.h"
+
+namespace ndbus {
+
+static void NDbusReconnectTimeout (uv_timer_t *timer);
+
+static void
+NDbusFreeReconnectTimer (uv_handle_t *handle) {
+  NDbusConnectionInfoUnref((NDbusConnectionInfo *)handle->data);
+  g_free(handle);
+}
+
+/**
+ * Arms the timer for the next attempt. The delay doubles with every
+ * attempt up to max_delay, and half of it is random so that all the
+ * clients of a restarted daemon do not come back at the same time.
+ */
+static void
+NDbusArmReconnect (NDbusConnectionInfo *cnxn_info) {
+  NDbusReconnectInfo *reconnect = &cnxn_info->reconnect;
+  if (reconnect->timer == NULL) {
+    reconnect->timer = g_new0(uv_timer_t, 1);
+    uv_timer_init(uv_default_loop(), reconnect->timer);
+    reconnect->timer->data = NDbusConnectionInfoRef(cnxn_info);
+  }
+
+  guint64 delay = reconnect->min_delay;
+  for (guint i = 0; i < reconnect->attempts &&
+      delay < reconnect->max_delay; i++)
+    delay *= 2;
+  if (delay > reconnect->max_delay)
+    delay = reconnect->max_delay;
+  delay = delay / 2 + g_random_int_range(0, delay / 2 + 1);
+  uv_timer_start(reconnect->timer, NDbusReconnectTimeout, delay, 0);
+}
+
+/**
+ * Adds the match of every signal listener again, once per listener as
+ * NDbusAddMatch did. Returns the number of matches added.
+ */
+static guint
+NDbusRestoreMatches (NDbusConnectionInfo *cnxn_info) {
+  guint restored = 0;
+  GHashTableIter iter;
+  gpointer value;
+  g_hash_table_iter_init(&iter, cnxn_info->signal_watchers);
+  while (g_hash_table_iter_next(&iter, NULL, &value)) {
+    for (GSList *tmp = (GSList *)value; tmp != NULL; tmp = g_slist_next(tmp)) {
+      NDbusObjectInfo *info = (NDbusObjectInfo *)tmp->data;
+      if (info->match == NULL)
+        continue;
+      dbus_bus_add_match(cnxn_info->cnxn, info->match, NULL);
+      restored++;
+    }
+  }
+  return restored;
+}
+
+/**
+ * The objects which had something going on the connection, listeners
+ * and name owners, to be told it is back. The same object may be in
+ * there more than once.
+ */
+static Local<Array>
+NDbusReconnectedObjects (NDbusConnectionInfo *cnxn_info) {
+  Isolate* isolate = Isolate::GetCurrent();
+  EscapableHandleScope scope(isolate);
+
+  Local<Array> object_list = Array::New(isolate);
+  guint i = 0;
+  GHashTableIter iter;
+  gpointer value;
+  g_hash_table_iter_init(&iter, cnxn_info->signal_watchers);
+  while (g_hash_table_iter_next(&iter, NULL, &value)) {
+    for (GSList *tmp = (GSList *)value; tmp != NULL; tmp = g_slist_next(tmp)) {
+      NDbusObjectInfo *info = (NDbusObjectInfo *)tmp->data;
+      object_list->Set(i++, Local<Object>::New(isolate, info->object));
+    }
+  }
+  g_hash_table_iter_init(&iter, cnxn_info->owned_names);
+  while (g_hash_table_iter_next(&iter, NULL, &value)) {
+    NDbusNameInfo *name_info = (NDbusNameInfo *)value;
+    object_list->Set(i++, Local<Object>::New(isolate, name_info->owner));
+  }
+  return scope.Escape(object_list);
+}
+
+static Local<Object>
+NDbusDescribeReconnect (NDbusConnectionInfo *cnxn_info) {
+  Isolate* isolate = Isolate::GetCurrent();
+  EscapableHandleScope scope(isolate);
+
+  NDbusReconnectInfo *reconnect = &cnxn_info->reconnect;
+  Local<Object> stats = Object::New(isolate);
+  stats->Set(v8::String::NewFromUtf8(isolate, "connected"),
+      Boolean::New(isolate, cnxn_info->cnxn != NULL));
+  stats->Set(v8::String::NewFromUtf8(isolate, "attempts"),
+      Uint32::NewFromUnsigned(isolate, reconnect->attempts));
+  stats->Set(v8::String::NewFromUtf8(isolate, "reconnects"),
+      Uint32::NewFromUnsigned(isolate, reconnect->reconnects));
+  stats->Set(v8::String::NewFromUtf8(isolate, "lastDowntime"),
+      Number::New(isolate, reconnect->last_downtime / 1000.0));
+  stats->Set(v8::String::NewFromUtf8(isolate, "lastRestoreTime"),
+      Number::New(isolate, reconnect->last_restore / 1000.0));
+  stats->Set(v8::String::NewFromUtf8(isolate, "lastAttempts"),
+      Uint32::NewFromUnsigned(isolate, reconnect->last_attempts));
+  stats->Set(v8::String::NewFromUtf8(isolate, "lastMatches"),
+      Uint32::NewFromUnsigned(isolate, reconnect->last_matches));
+  stats->Set(v8::String::NewFromUtf8(isolate, "lastNames"),
+      Uint32::NewFromUnsigned(isolate, reconnect->last_names));
+  return scope.Escape(stats);
+}
+
+/**
+ * Once the bus is there again, every match, watched name, mirror and
+ * owned name goes out at once without waiting for replies, and a single
+ * flush writes them all.
+ */
+static void
+NDbusHandleReconnected (NDbusConnectionInfo *cnxn_info,
+    DBusConnection *bus_cnxn, DBusError *error, gpointer user_data) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  NDbusReconnectInfo *reconnect = &cnxn_info->reconnect;
+  if (cnxn_info->closed)
+    return;
+  if (bus_cnxn == NULL) {
+    LOGV("reconnect attempt %u failed: %s", reconnect->attempts, error->message);
+    NDbusArmReconnect(cnxn_info);
+    return;
+  }
+  if (!NDbusAttachBusConnection(cnxn_info, bus_cnxn)) {
+    cnxn_info->cnxn = NULL;
+    dbus_connection_unref(bus_cnxn);
+    NDbusArmReconnect(cnxn_info);
+    return;
+  }
+  //reconnected, even if a handler below closes the connection again
+  guint attempts = reconnect->attempts;
+  reconnect->attempts = 0;
+  reconnect->pending = FALSE;
+
+  gint64 started = g_get_monotonic_time();
+  guint matches = NDbusRestoreMatches(cnxn_info);
+  matches += NDbusRewatchNameOwners(cnxn_info);
+  matches += NDbusRestorePropertyMirrors(cnxn_info);
+  matches += NDbusRestoreObjectMirrors(cnxn_info);
+  guint names = NDbusRequestOwnedNames(cnxn_info);
+  //the handlers above may have closed the connection
+  if (cnxn_info->cnxn == NULL)
+    return;
+  dbus_connection_flush(cnxn_info->cnxn);
+
+  gint64 now = g_get_monotonic_time();
+  reconnect->reconnects++;
+  reconnect->last_downtime = now - reconnect->disconnected_at;
+  reconnect->last_restore = now - started;
+  reconnect->last_attempts = attempts;
+  reconnect->last_matches = matches;
+  reconnect->last_names = names;
+
+  //queued sends may go on now
+  NDbusCheckDrain(cnxn_info);
+  if (cnxn_info->cnxn == NULL)
+    return;
+
+  Handle<Object> local_global_target = Local<Object>::New(isolate, global_target);
+  Local<Function> func = Local<Function>::Cast(local_global_target->Get(NDBUS_CB_RECONNECT));
+  const gint argc = 2;
+  Local<Value> argv[argc];
+  argv[0] = NDbusReconnectedObjects(cnxn_info);
+  argv[1] = NDbusDescribeReconnect(cnxn_info);
+
+  if (NDbusIsValidV8Value(func) &&
+      func->IsFunction())
+    func->Call(local_global_target, argc, argv);
+}
+
+static void
+NDbusReconnectTimeout (uv_timer_t *timer) {
+  NDbusConnectionInfo *cnxn_info = (NDbusConnectionInfo *)timer->data;
+  cnxn_info->reconnect.attempts++;
+  NDbusOpenBusAsync(cnxn_info, NDbusHandleReconnected, NULL);
+}
+
+//EXPOSED
+/**
+ * Lets go of a bus connection which went away, keeping all that is
+ * needed to restore it, and starts trying to reach the bus again.
+ * Returns FALSE, leaving everything as it is, if reconnect is off.
+ */
+gboolean
+NDbusScheduleReconnect (NDbusConnectionInfo *cnxn_info) {
+  NDbusReconnectInfo *reconnect = &cnxn_info->reconnect;
+  if (!reconnect->enabled || cnxn_info->cnxn == NULL)
+    return FALSE;
+
+  dbus_connection_remove_filter(cnxn_info->cnxn,
+      NDbusMessageFilter, (void *)cnxn_info);
+  dbus_connection_unref(cnxn_info->cnxn);
+  cnxn_info->cnxn = NULL;
+
+  reconnect->disconnected_at = g_get_monotonic_time();
+  reconnect->attempts = 0;
+  reconnect->pending = TRUE;
+  NDbusArmReconnect(cnxn_info);
+
+  //the names went with the connection, until they are granted again;
+  //a handler which closes the connection stops the timer as well
+  NDbusConnectionInfoRef(cnxn_info);
+  NDbusLoseOwnedNames(cnxn_info);
+  NDbusConnectionInfoUnref(cnxn_info);
+  return TRUE;
+}
+
+void
+NDbusStopReconnect (NDbusConnectionInfo *cnxn_info) {
+  uv_timer_t *timer = cnxn_info->reconnect.timer;
+  if (timer == NULL)
+    return;
+  cnxn_info->reconnect.timer = NULL;
+  uv_timer_stop(timer);
+  uv_close((uv_handle_t *)timer, NDbusFreeReconnectTimer);
+}
+
+void NDbusSetReconnect (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  if (!args[0]->IsObject())
+    NDBUS_EXCPN_RECONNECT;
+  Local<Object> options = Local<Object>::Cast(args[0]);
+
+  NDbusConnectionInfo *cnxn_info = NDbusGetConnection(args.This());
+  if (!cnxn_info || cnxn_info->peer)
+    NDBUS_EXCPN_DISCONNECTED;
+  NDbusReconnectInfo *reconnect = &cnxn_info->reconnect;
+
+  gboolean enabled = reconnect->enabled;
+  glong min_delay = reconnect->min_delay;
+  glong max_delay = reconnect->max_delay;
+  Local<Value> value = NDbusGetProperty(options, NDBUS_RECONNECT_ENABLED);
+  if (NDbusIsValidV8Value(value))
+    enabled = value->BooleanValue();
+  if (!NDbusGetLimit(options, NDBUS_RECONNECT_MIN_DELAY, &min_delay) ||
+      !NDbusGetLimit(options, NDBUS_RECONNECT_MAX_DELAY, &max_delay) ||
+      min_delay <= 0 || min_delay > max_delay || max_delay > G_MAXUINT)
+    NDBUS_EXCPN_RECONNECT;
+
+  reconnect->enabled = enabled;
+  reconnect->min_delay = min_delay;
+  reconnect->max_delay = max_delay;
+
+  //turned off while away: nothing more to wait for
+  if (!enabled && reconnect->pending)
+    NDbusBusDisconnected(cnxn_info);
+  args.GetReturnValue().SetUndefined();
+}
+
+void NDbusGetReconnectStats (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  NDbusConnectionInfo *cnxn_info = NDbusGetConnection(args.This());
+  if (!cnxn_info || cnxn_info->peer) {
+    args.GetReturnValue().SetNull();
+    return;
+  }
+  args.GetReturnValue().Set(NDbusDescribeReconnect(cnxn_info));
+}
+} //namespace ndbus
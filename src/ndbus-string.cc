@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2011, Motorola Mobility, Inc
+ * All Rights Reserved.
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+#include "ndbus.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+//AVX2 is picked at runtime, the binary itself needs no more than SSE2
+#if defined(__SSE2__) && defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define NDBUS_HAVE_AVX2
+#define NDBUS_TARGET_AVX2             __attribute__((target("avx2")))
+#endif
+
+#define NDBUS_HIGH_BITS               G_GUINT64_CONSTANT(0x8080808080808080)
+
+namespace ndbus {
+
+/**
+ * Keeps the message a string was received in alive for as long as V8
+ * holds the string, which points straight into the message body.
+ */
+class NDbusExternalString : public v8::String::ExternalOneByteStringResource {
+  public:
+    NDbusExternalString (DBusMessage *msg, const gchar *data, gsize len)
+      : msg_(dbus_message_ref(msg)), data_(data), len_(len) {}
+    ~NDbusExternalString () { dbus_message_unref(msg_); }
+    const char* data () const { return data_; }
+    size_t length () const { return len_; }
+
+  private:
+    DBusMessage *msg_;
+    const gchar *data_;
+    gsize len_;
+};
+
+/*
+ * Each scanner comes as IsAscii, over len bytes, and as ScanString,
+ * which also finds the length of a NUL-terminated string in the same
+ * pass. ScanString loads aligned blocks only, which never reach into
+ * the next page, so reading past the NUL is safe.
+ */
+typedef gboolean (*NDbusIsAsciiFunc) (const gchar *data, gsize len);
+typedef gboolean (*NDbusScanStringFunc) (const gchar *str, gsize *len);
+
+static gboolean
+NDbusIsAsciiScalar (const gchar *data, gsize len) {
+  gsize i = 0;
+  guint64 acc = 0;
+  for (; i + 8 <= len; i += 8) {
+    guint64 word;
+    memcpy(&word, data + i, 8);
+    acc |= word;
+  }
+  for (; i < len; i++)
+    acc |= (guchar) data[i];
+  return !(acc & NDBUS_HIGH_BITS);
+}
+
+static gboolean
+NDbusScanStringScalar (const gchar *str, gsize *len) {
+  *len = strlen(str);
+  return NDbusIsAsciiScalar(str, *len);
+}
+
+#ifdef __SSE2__
+static gboolean
+NDbusIsAsciiSSE2 (const gchar *data, gsize len) {
+  gsize i = 0;
+  __m128i acc = _mm_setzero_si128();
+  for (; i + 16 <= len; i += 16)
+    acc = _mm_or_si128(acc, _mm_loadu_si128((const __m128i *) (data + i)));
+  if (_mm_movemask_epi8(acc))
+    return FALSE;
+  return NDbusIsAsciiScalar(data + i, len - i);
+}
+
+static gboolean
+NDbusScanStringSSE2 (const gchar *str, gsize *len) {
+  const gchar *p = str;
+  for (; ((guintptr) p & 15) != 0; p++) {
+    if (*p == '\0') {
+      *len = p - str;
+      return TRUE;
+    } else if (*p & 0x80) {
+      *len = p - str + strlen(p);
+      return FALSE;
+    }
+  }
+
+  const __m128i zero = _mm_setzero_si128();
+  for (;; p += 16) {
+    __m128i block = _mm_load_si128((const __m128i *) p);
+    guint nul = _mm_movemask_epi8(_mm_cmpeq_epi8(block, zero));
+    guint high = _mm_movemask_epi8(block);
+    if (nul) {
+      //only the bytes before the NUL count
+      guint end = __builtin_ctz(nul);
+      *len = p - str + end;
+      return !(high & ((1u << end) - 1));
+    } else if (high) {
+      *len = p - str + strlen(p);
+      return FALSE;
+    }
+  }
+}
+#endif
+
+#ifdef NDBUS_HAVE_AVX2
+NDBUS_TARGET_AVX2 static gboolean
+NDbusIsAsciiAVX2 (const gchar *data, gsize len) {
+  gsize i = 0;
+  __m256i acc = _mm256_setzero_si256();
+  for (; i + 32 <= len; i += 32)
+    acc = _mm256_or_si256(acc, _mm256_loadu_si256((const __m256i *) (data + i)));
+  if (_mm256_movemask_epi8(acc))
+    return FALSE;
+  return NDbusIsAsciiSSE2(data + i, len - i);
+}
+
+NDBUS_TARGET_AVX2 static gboolean
+NDbusScanStringAVX2 (const gchar *str, gsize *len) {
+  const gchar *p = str;
+  for (; ((guintptr) p & 31) != 0; p++) {
+    if (*p == '\0') {
+      *len = p - str;
+      return TRUE;
+    } else if (*p & 0x80) {
+      *len = p - str + strlen(p);
+      return FALSE;
+    }
+  }
+
+  const __m256i zero = _mm256_setzero_si256();
+  for (;; p += 32) {
+    __m256i block = _mm256_load_si256((const __m256i *) p);
+    guint nul = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, zero));
+    guint high = _mm256_movemask_epi8(block);
+    if (nul) {
+      guint end = __builtin_ctz(nul);
+      *len = p - str + end;
+      //end is below 32, the shift is defined
+      return !(high & (guint) ((G_GUINT64_CONSTANT(1) << end) - 1));
+    } else if (high) {
+      *len = p - str + strlen(p);
+      return FALSE;
+    }
+  }
+}
+#endif
+
+static NDbusIsAsciiFunc is_ascii = NULL;
+static NDbusScanStringFunc scan_string = NULL;
+
+/**
+ * Picks the widest scanner the CPU supports, once. Only the
+ * main thread decodes and encodes, so there is no race.
+ */
+static void
+NDbusSelectScanner () {
+#ifdef NDBUS_HAVE_AVX2
+  if (__builtin_cpu_supports("avx2")) {
+    is_ascii = NDbusIsAsciiAVX2;
+    scan_string = NDbusScanStringAVX2;
+    return;
+  }
+#endif
+#ifdef __SSE2__
+  is_ascii = NDbusIsAsciiSSE2;
+  scan_string = NDbusScanStringSSE2;
+#else
+  is_ascii = NDbusIsAsciiScalar;
+  scan_string = NDbusScanStringScalar;
+#endif
+}
+
+/**
+ * Whether none of the len bytes at data has its high bit set.
+ */
+gboolean
+NDbusIsAscii (const gchar *data, gsize len) {
+  if (G_UNLIKELY(is_ascii == NULL))
+    NDbusSelectScanner();
+  return is_ascii(data, len);
+}
+
+/**
+ * Finds the length of the NUL-terminated str and whether it is ASCII
+ * in a single pass.
+ */
+gboolean
+NDbusScanString (const gchar *str, gsize *len) {
+  if (G_UNLIKELY(scan_string == NULL))
+    NDbusSelectScanner();
+  return scan_string(str, len);
+}
+
+/**
+ * A JS string for a string-like value of msg. libdbus has validated the
+ * UTF-8 of received messages already, so ASCII, the most of it, is
+ * copied as Latin-1 with no decoding. Large ASCII strings are not copied
+ * at all, they are external strings holding a reference on msg.
+ */
+Local<v8::String>
+NDbusNewMessageString (DBusMessage *msg, const gchar *value) {
+  Isolate* isolate = Isolate::GetCurrent();
+  gsize len;
+  gboolean ascii = NDbusScanString(value, &len);
+
+  if (ascii && msg && len >= NDBUS_EXTERNAL_STRING_MIN) {
+    NDbusExternalString *resource = new NDbusExternalString(msg, value, len);
+    MaybeLocal<v8::String> str = v8::String::NewExternalOneByte(isolate, resource);
+    if (!str.IsEmpty())
+      return str.ToLocalChecked();
+    //not taken by V8, beyond its maximum length
+    delete resource;
+  }
+  if (ascii)
+    return v8::String::NewFromOneByte(isolate, (const uint8_t *) value,
+        v8::NewStringType::kNormal, len).ToLocalChecked();
+  return v8::String::NewFromUtf8(isolate, value,
+      v8::String::kNormalString, len);
+}
+
+} //namespace ndbus
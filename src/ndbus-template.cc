@@ -0,0 +1,552 @@
+/*
+ * Copyright (c) 2011, Motorola Mobility, Inc
+ * All Rights Reserved.
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+#include "ndbus.h"
+
+namespace ndbus {
+
+#define NDBUS_MAX_CACHED_REPLIES 1024
+
+static GHashTable *templates = NULL;
+static guint last_template_id = 0;
+//the flight of each caller waiting on one, by call id
+static GHashTable *flight_waiters = NULL;
+
+/**
+ * One method-call on the bus on behalf of every identical call made
+ * while it is in flight. It outlives its template if need be.
+ */
+typedef struct {
+  guint template_id;
+  GBytes *key;
+  GSList *waiters;
+  DBusPendingCall *pending;
+} NDbusFlight;
+
+typedef struct {
+  DBusMessage *reply;
+  gint64 expires;
+} NDbusCachedReply;
+
+static void
+NDbusFreeCachedReply (gpointer data) {
+  NDbusCachedReply *cached = (NDbusCachedReply *)data;
+  dbus_message_unref(cached->reply);
+  g_free(cached);
+}
+
+static void
+NDbusFreeFlight (void *data) {
+  NDbusFlight *flight = (NDbusFlight *)data;
+  for (GSList *tmp = flight->waiters; tmp; tmp = tmp->next)
+    g_hash_table_remove(flight_waiters, GUINT_TO_POINTER(
+          ((NDbusCallbackInfo *)tmp->data)->call_id));
+  g_slist_free_full(flight->waiters, NDbusFreeCallbackInfo);
+  g_bytes_unref(flight->key);
+  g_free(flight);
+}
+
+static void
+NDbusFreeTemplate (gpointer data) {
+  NDbusTemplate *tmpl = (NDbusTemplate *)data;
+  if (tmpl) {
+    dbus_message_unref(tmpl->msg);
+    NDbusSignatureFree(tmpl->signature);
+    g_free(tmpl->address);
+    g_free(tmpl->reply_signature);
+    //the flights themselves go with their pending calls
+    if (tmpl->flights)
+      g_hash_table_unref(tmpl->flights);
+    if (tmpl->replies)
+      g_hash_table_unref(tmpl->replies);
+    g_free(tmpl);
+  }
+}
+
+static NDbusTemplate*
+NDbusLookupTemplate (Local<Value> id) {
+  if (templates == NULL || !id->IsUint32())
+    return NULL;
+  return (NDbusTemplate *)g_hash_table_lookup(templates,
+      GUINT_TO_POINTER(id->Uint32Value()));
+}
+
+/**
+ * Copies the header of tmpl into a new message, whose serial is
+ * unset, and appends args to it. A template with a reply signature
+ * takes exactly as many arguments as its signature has.
+ */
+static DBusMessage*
+NDbusTemplateNewMessage (NDbusTemplate *tmpl,
+    Local<Value> args, Local<Object> *error) {
+  Isolate* isolate = Isolate::GetCurrent();
+
+  if (tmpl->reply_signature) {
+    guint given = args->IsArray() ? Local<Array>::Cast(args)->Length() : 0;
+    guint expected = tmpl->signature ? tmpl->signature->arg_signatures->len : 0;
+    if (given != expected) {
+      NDBUS_SET_EXCPN(*error, DBUS_ERROR_INVALID_ARGS, NDBUS_ERROR_ARITY);
+      return NULL;
+    }
+  }
+
+  DBusMessage *msg = dbus_message_copy(tmpl->msg);
+  if (!msg) {
+    NDBUS_SET_EXCPN(*error, DBUS_ERROR_NO_MEMORY, NDBUS_ERROR_OOM);
+    return NULL;
+  }
+  NDBUS_PROBE(message__create, msg);
+
+  if (args->IsArray() && Local<Array>::Cast(args)->Length() > 0) {
+    if (!tmpl->signature) {
+      NDBUS_SET_EXCPN(*error, DBUS_ERROR_FAILED, NDBUS_ERROR_MISMATCH);
+      dbus_message_unref(msg);
+      return NULL;
+    }
+    if (!NDbusMessageAppendSignatureArgs(&msg, tmpl->signature,
+          Local<Array>::Cast(args), error, tmpl->variant_policy, tmpl->codec)) {
+      dbus_message_unref(msg);
+      return NULL;
+    }
+  }
+  return msg;
+}
+
+/**
+ * What identifies a call of a template: the whole marshalled message,
+ * whose header only differs between templates. NULL if msg carries
+ * unix fds, which are not the same file for two calls.
+ */
+static GBytes*
+NDbusTemplateCallKey (DBusMessage *msg) {
+#ifdef DBUS_TYPE_UNIX_FD
+  if (dbus_message_contains_unix_fds(msg))
+    return NULL;
+#endif
+
+  //marshalling leaves an unlocked message unlocked, so it can be sent
+  gchar *data = NULL;
+  gint len = 0;
+  if (!dbus_message_marshal(msg, &data, &len))
+    return NULL;
+  GBytes *key = g_bytes_new(data, len);
+  dbus_free(data);
+  return key;
+}
+
+static gboolean
+NDbusIsReplyExpired (gpointer key, gpointer value, gpointer user_data) {
+  return ((NDbusCachedReply *)value)->expires <= *(gint64 *)user_data;
+}
+
+static void
+NDbusCacheReply (NDbusTemplate *tmpl, GBytes *key, DBusMessage *reply) {
+  gint64 now = g_get_monotonic_time();
+  if (g_hash_table_size(tmpl->replies) >= NDBUS_MAX_CACHED_REPLIES) {
+    g_hash_table_foreach_remove(tmpl->replies, NDbusIsReplyExpired, &now);
+    if (g_hash_table_size(tmpl->replies) >= NDBUS_MAX_CACHED_REPLIES)
+      g_hash_table_remove_all(tmpl->replies);
+  }
+
+  NDbusCachedReply *cached = g_new0(NDbusCachedReply, 1);
+  cached->reply = dbus_message_ref(reply);
+  cached->expires = now + (gint64)tmpl->cache_ttl * 1000;
+  g_hash_table_replace(tmpl->replies, g_bytes_ref(key), cached);
+}
+
+/**
+ * A cached reply for key which has not expired, or NULL.
+ */
+static DBusMessage*
+NDbusLookupCachedReply (NDbusTemplate *tmpl, GBytes *key) {
+  NDbusCachedReply *cached = (NDbusCachedReply *)
+    g_hash_table_lookup(tmpl->replies, key);
+  if (cached == NULL)
+    return NULL;
+  if (cached->expires <= g_get_monotonic_time()) {
+    g_hash_table_remove(tmpl->replies, key);
+    return NULL;
+  }
+  return cached->reply;
+}
+
+/**
+ * Hands the reply of a flight to all its callers, in the order of
+ * their calls, after caching it. The flight is over by then, so a
+ * caller calling again starts a new one or hits the cache.
+ */
+static void
+NDbusHandleFlightReply (DBusPendingCall *pending, void *user_data) {
+  g_return_if_fail(pending != NULL);
+
+  NDbusFlight *flight = (NDbusFlight *)user_data;
+  DBusMessage *reply = dbus_pending_call_steal_reply(pending);
+  NDbusTimeReply(pending, reply);
+
+  NDbusTemplate *tmpl = templates ? (NDbusTemplate *)
+    g_hash_table_lookup(templates, GUINT_TO_POINTER(flight->template_id)) : NULL;
+  if (tmpl) {
+    if (tmpl->flights &&
+        g_hash_table_lookup(tmpl->flights, flight->key) == flight)
+      g_hash_table_remove(tmpl->flights, flight->key);
+    if (tmpl->replies && reply &&
+        dbus_message_get_type(reply) == DBUS_MESSAGE_TYPE_METHOD_RETURN)
+      NDbusCacheReply(tmpl, flight->key, reply);
+  }
+
+  flight->waiters = g_slist_reverse(flight->waiters);
+  for (GSList *tmp = flight->waiters; tmp; tmp = tmp->next)
+    NDbusDispatchCallbackReply((NDbusCallbackInfo *)tmp->data, reply);
+
+  if (reply)
+    dbus_message_unref(reply);
+  dbus_pending_call_unref(pending);
+}
+
+/**
+ * Adds cb_info to the callers of flight under a new call id.
+ */
+static guint
+NDbusJoinFlight (NDbusFlight *flight, NDbusCallbackInfo *cb_info) {
+  if (flight_waiters == NULL)
+    flight_waiters = g_hash_table_new(g_direct_hash, g_direct_equal);
+  cb_info->call_id = NDbusNextCallId();
+  flight->waiters = g_slist_prepend(flight->waiters, cb_info);
+  g_hash_table_insert(flight_waiters, GUINT_TO_POINTER(cb_info->call_id), flight);
+  return cb_info->call_id;
+}
+
+//EXPOSED
+/**
+ * Drops the caller id from its flight, and cancels the flight if it
+ * was the last one waiting on it. Returns FALSE if id is no such
+ * caller or the reply is being handed over.
+ */
+gboolean
+NDbusCancelFlightWaiter (guint id) {
+  NDbusFlight *flight = flight_waiters ? (NDbusFlight *)
+    g_hash_table_lookup(flight_waiters, GUINT_TO_POINTER(id)) : NULL;
+  if (flight == NULL || dbus_pending_call_get_completed(flight->pending))
+    return FALSE;
+
+  g_hash_table_remove(flight_waiters, GUINT_TO_POINTER(id));
+  for (GSList *tmp = flight->waiters; tmp; tmp = tmp->next) {
+    NDbusCallbackInfo *cb_info = (NDbusCallbackInfo *)tmp->data;
+    if (cb_info->call_id == id) {
+      flight->waiters = g_slist_delete_link(flight->waiters, tmp);
+      NDbusFreeCallbackInfo(cb_info);
+      break;
+    }
+  }
+  if (flight->waiters)
+    return TRUE;
+
+  NDbusTemplate *tmpl = templates ? (NDbusTemplate *)
+    g_hash_table_lookup(templates, GUINT_TO_POINTER(flight->template_id)) : NULL;
+  if (tmpl && tmpl->flights &&
+      g_hash_table_lookup(tmpl->flights, flight->key) == flight)
+    g_hash_table_remove(tmpl->flights, flight->key);
+  DBusPendingCall *pending = flight->pending;
+  dbus_pending_call_cancel(pending);
+  dbus_pending_call_unref(pending);
+  return TRUE;
+}
+
+//EXPOSED
+/**
+ * Validates the header described by args[0], falling back to the
+ * message object, and compiles its signature. Returns an id for
+ * emitPrepared()/callPrepared().
+ */
+void
+NDbusPrepare (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  if (!args[0]->IsObject())
+    NDBUS_EXCPN_TEMPLATE;
+  Local<Object> spec = Local<Object>::Cast(args[0]);
+
+  gint message_type =
+    NDbusGetProperty(args.This(),
+        NDBUS_PROPERTY_TYPE)->IntegerValue();
+  if (message_type == DBUS_MESSAGE_TYPE_METHOD_RETURN)
+    message_type = DBUS_MESSAGE_TYPE_METHOD_CALL;
+  if (message_type != DBUS_MESSAGE_TYPE_SIGNAL &&
+      message_type != DBUS_MESSAGE_TYPE_METHOD_CALL)
+    NDBUS_EXCPN_TYPE;
+
+  NDbusConnectionInfo *cnxn_info = NDbusGetConnection(args.This());
+  if (!cnxn_info)
+    NDBUS_EXCPN_DISCONNECTED;
+
+  Local<Object> error;
+  DBusMessage *msg = NDbusNewMessageFromEntry(args.This(), spec,
+      message_type, cnxn_info, &error);
+  if (!msg) {
+    isolate->ThrowException(error);
+    return;
+  }
+
+  NDbusSignature *compiled = NULL;
+  gchar *signature = NDbusV8StringToCStr(
+      NDbusGetProperty(spec, NDBUS_PROPERTY_ENTRY_SIGN));
+  if (signature) {
+    compiled = NDbusSignatureNew(signature);
+    g_free(signature);
+    if (!compiled) {
+      dbus_message_unref(msg);
+      NDBUS_THROW_EXCPN(DBUS_ERROR_INVALID_SIGNATURE, NDBUS_ERROR_SIGN);
+    }
+  }
+
+  gchar *reply_signature = NDbusV8StringToCStr(
+      NDbusGetProperty(spec, NDBUS_PROPERTY_REPLY_SIGN));
+  if (reply_signature &&
+      (message_type != DBUS_MESSAGE_TYPE_METHOD_CALL ||
+       !dbus_signature_validate(reply_signature, NULL))) {
+    g_free(reply_signature);
+    NDbusSignatureFree(compiled);
+    dbus_message_unref(msg);
+    NDBUS_THROW_EXCPN(DBUS_ERROR_INVALID_SIGNATURE, NDBUS_ERROR_SIGN);
+  }
+
+  Local<Value> timeout = NDbusGetProperty(spec, NDBUS_PROPERTY_TIMEOUT);
+  if (!timeout->IsInt32())
+    timeout = NDbusGetProperty(args.This(), NDBUS_PROPERTY_TIMEOUT);
+  Local<Value> decode_flags = NDbusGetProperty(spec, NDBUS_PROPERTY_DECODE_FLAGS);
+  Local<Value> codec = NDbusGetProperty(spec, NDBUS_PROPERTY_CODEC);
+  if (!codec->IsBoolean())
+    codec = NDbusGetProperty(args.This(), NDBUS_PROPERTY_CODEC);
+  gboolean coalesce = NDbusGetProperty(spec, NDBUS_PROPERTY_COALESCE)->BooleanValue();
+  Local<Value> cache_ttl = NDbusGetProperty(spec, NDBUS_PROPERTY_CACHE_TTL);
+  if ((coalesce || NDbusIsValidV8Value(cache_ttl)) &&
+      (message_type != DBUS_MESSAGE_TYPE_METHOD_CALL ||
+       (NDbusIsValidV8Value(cache_ttl) &&
+        (!cache_ttl->IsInt32() || cache_ttl->Int32Value() < 0)))) {
+    g_free(reply_signature);
+    NDbusSignatureFree(compiled);
+    dbus_message_unref(msg);
+    NDBUS_EXCPN_TEMPLATE;
+  }
+
+  NDbusTemplate *tmpl = g_new0(NDbusTemplate, 1);
+  tmpl->msg = msg;
+  tmpl->signature = compiled;
+  tmpl->bus = NDbusGetProperty(args.This(),
+      NDBUS_PROPERTY_BUS)->IntegerValue();
+  tmpl->address = NDbusV8StringToCStr(NDbusGetProperty(args.This(),
+        NDBUS_PROPERTY_ADDRESS));
+  tmpl->timeout = timeout->IntegerValue();
+  tmpl->variant_policy = (NDbusVariantPolicy)NDbusGetProperty(args.This(),
+        NDBUS_PROPERTY_VARIANT_POLICY)->IntegerValue();
+  tmpl->decode_flags = decode_flags->IsUint32() ?
+    decode_flags->Uint32Value() : NDbusGetDecodeFlags(args.This());
+  tmpl->codec = codec->BooleanValue();
+  tmpl->reply_signature = reply_signature;
+  tmpl->coalesce = coalesce;
+  tmpl->cache_ttl = cache_ttl->IsInt32() ? cache_ttl->Int32Value() : 0;
+  if (coalesce)
+    tmpl->flights = g_hash_table_new(g_bytes_hash, g_bytes_equal);
+  if (tmpl->cache_ttl > 0)
+    tmpl->replies = g_hash_table_new_full(g_bytes_hash, g_bytes_equal,
+        g_bytes_unref, NDbusFreeCachedReply);
+
+  if (templates == NULL)
+    templates = g_hash_table_new_full(g_direct_hash,
+        g_direct_equal, NULL, NDbusFreeTemplate);
+  guint id = ++last_template_id;
+  g_hash_table_insert(templates, GUINT_TO_POINTER(id), tmpl);
+
+  args.GetReturnValue().Set(Uint32::NewFromUnsigned(isolate, id));
+}
+
+//EXPOSED
+void
+NDbusEmitPrepared (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  NDbusTemplate *tmpl = NDbusLookupTemplate(args[0]);
+  if (!tmpl ||
+      dbus_message_get_type(tmpl->msg) != DBUS_MESSAGE_TYPE_SIGNAL)
+    NDBUS_EXCPN_TEMPLATE;
+
+  NDbusConnectionInfo *cnxn_info =
+    NDbusLookupConnection(tmpl->bus, tmpl->address);
+  if (!cnxn_info || !cnxn_info->cnxn)
+    NDBUS_EXCPN_DISCONNECTED;
+
+  Local<Object> error;
+  DBusMessage *msg = NDbusTemplateNewMessage(tmpl, args[1], &error);
+  if (!msg) {
+    isolate->ThrowException(error);
+    return;
+  }
+
+  if (!NDbusCanSendMessage(cnxn_info->cnxn, msg)) {
+    dbus_message_unref(msg);
+    NDBUS_EXCPN_UNIXFD;
+  }
+
+  if (!dbus_connection_send(cnxn_info->cnxn, msg, NULL)) {
+    dbus_message_unref(msg);
+    NDBUS_EXCPN_OOM;
+  }
+  NDbusCountMessage(cnxn_info, msg, FALSE);
+  dbus_message_unref(msg);
+
+  args.GetReturnValue().Set(NDbusCheckWritable(cnxn_info, args.This()) == TRUE);
+}
+
+//EXPOSED
+/**
+ * Calls prepared method args[0] with args[1] and hands the reply to
+ * args[2]. Returns the id of the call for cancelCall(), or 0 if it
+ * was answered from the cache.
+ */
+void
+NDbusCallPrepared (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  NDbusTemplate *tmpl = NDbusLookupTemplate(args[0]);
+  if (!tmpl ||
+      dbus_message_get_type(tmpl->msg) != DBUS_MESSAGE_TYPE_METHOD_CALL)
+    NDBUS_EXCPN_TEMPLATE;
+  if (!args[2]->IsFunction())
+    NDBUS_EXCPN_CALLBACK;
+
+  NDbusConnectionInfo *cnxn_info =
+    NDbusLookupConnection(tmpl->bus, tmpl->address);
+  if (!cnxn_info || !cnxn_info->cnxn)
+    NDBUS_EXCPN_DISCONNECTED;
+
+  Local<Object> error;
+  DBusMessage *msg = NDbusTemplateNewMessage(tmpl, args[1], &error);
+  if (!msg) {
+    isolate->ThrowException(error);
+    return;
+  }
+
+  if (!NDbusCanSendMessage(cnxn_info->cnxn, msg)) {
+    dbus_message_unref(msg);
+    NDBUS_EXCPN_UNIXFD;
+  }
+
+  NDbusCallbackInfo *cb_info = g_new0(NDbusCallbackInfo, 1);
+  cb_info->callback.Reset(isolate, Local<Function>::Cast(args[2]));
+  cb_info->cnxn_info = NDbusConnectionInfoRef(cnxn_info);
+  cb_info->decode_flags = tmpl->decode_flags;
+  cb_info->reply_signature = g_strdup(tmpl->reply_signature);
+
+  //an identical call is answered from the cache or joins the one in flight
+  GBytes *key = tmpl->flights || tmpl->replies ?
+    NDbusTemplateCallKey(msg) : NULL;
+  if (key) {
+    DBusMessage *cached = tmpl->replies ?
+      NDbusLookupCachedReply(tmpl, key) : NULL;
+    NDbusFlight *flight = tmpl->flights ? (NDbusFlight *)
+      g_hash_table_lookup(tmpl->flights, key) : NULL;
+    if (cached || flight) {
+      guint call_id = 0;
+      dbus_message_unref(msg);
+      //the callback may release the template and the connection
+      NDbusConnectionInfoRef(cnxn_info);
+      if (cached) {
+        tmpl->hits++;
+        g_bytes_unref(key);
+        cached = dbus_message_ref(cached);
+        NDbusDispatchCallbackReply(cb_info, cached);
+        dbus_message_unref(cached);
+        NDbusFreeCallbackInfo(cb_info);
+      } else {
+        tmpl->coalesced++;
+        g_bytes_unref(key);
+        call_id = NDbusJoinFlight(flight, cb_info);
+      }
+      NDbusCheckWritable(cnxn_info, args.This());
+      NDbusConnectionInfoUnref(cnxn_info);
+      args.GetReturnValue().Set(Uint32::NewFromUnsigned(isolate, call_id));
+      return;
+    }
+    tmpl->misses++;
+  }
+
+  DBusPendingCall *pending = NULL;
+  if (!dbus_connection_send_with_reply(cnxn_info->cnxn, msg,
+        &pending, tmpl->timeout) || !pending) {
+    dbus_message_unref(msg);
+    if (key)
+      g_bytes_unref(key);
+    NDbusFreeCallbackInfo(cb_info);
+    NDBUS_EXCPN_OOM;
+  }
+  NDbusTimeCall(cnxn_info, msg, pending);
+  dbus_message_unref(msg);
+
+  guint call_id;
+  if (key) {
+    NDbusFlight *flight = g_new0(NDbusFlight, 1);
+    flight->template_id = args[0]->Uint32Value();
+    flight->key = key;
+    flight->pending = pending;
+    call_id = NDbusJoinFlight(flight, cb_info);
+    if (tmpl->flights)
+      g_hash_table_insert(tmpl->flights, key, flight);
+    dbus_pending_call_set_notify(pending, NDbusHandleFlightReply,
+        (void *)flight, NDbusFreeFlight);
+  } else {
+    dbus_pending_call_set_notify(pending, NDbusHandleCallbackReply,
+        (void *)cb_info, NDbusFreeCallbackInfo);
+    call_id = NDbusTrackPendingCall(pending);
+  }
+
+  NDbusCheckWritable(cnxn_info, args.This());
+  args.GetReturnValue().Set(Uint32::NewFromUnsigned(isolate, call_id));
+}
+
+//EXPOSED
+/**
+ * { hits, misses, coalesced } of prepared method-call args[0]: calls
+ * answered from the cache, sent to the bus, and joined to one in flight.
+ */
+void
+NDbusGetPreparedStats (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  NDbusTemplate *tmpl = NDbusLookupTemplate(args[0]);
+  if (!tmpl)
+    NDBUS_EXCPN_TEMPLATE;
+
+  Local<Object> stats = Object::New(isolate);
+  stats->Set(v8::String::NewFromUtf8(isolate, "hits"),
+      Number::New(isolate, (gdouble)tmpl->hits));
+  stats->Set(v8::String::NewFromUtf8(isolate, "misses"),
+      Number::New(isolate, (gdouble)tmpl->misses));
+  stats->Set(v8::String::NewFromUtf8(isolate, "coalesced"),
+      Number::New(isolate, (gdouble)tmpl->coalesced));
+  args.GetReturnValue().Set(stats);
+}
+
+//EXPOSED
+void
+NDbusReleasePrepared (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  if (templates && args[0]->IsUint32())
+    g_hash_table_remove(templates,
+        GUINT_TO_POINTER(args[0]->Uint32Value()));
+  args.GetReturnValue().SetUndefined();
+}
+
+} //namespace ndbus
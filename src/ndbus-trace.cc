@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2011, Motorola Mobility, Inc
+ * All Rights Reserved.
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+#include "ndbus.h"
+
+namespace ndbus {
+
+/**
+ * The probes, with the serial, member and size in bytes of the message
+ * they are about. The serial is 0 until the message is sent, the size
+ * that of a message marshalled, or 0 with unix fds.
+ *
+ *   message__create      a message is built for JS, before its arguments
+ *   encode__start/done   its arguments are appended
+ *   queue                it is handed to libdbus, which writes what it can
+ *   flush(written, left) the loop writes bytes the socket did not take
+ *   receive              a message or reply is read from the bus
+ *   route                a signal is matched to listeners
+ *   decode__start/done   the arguments of a message are turned into JS
+ *   callback__start/done JS handles a signal or reply
+ *
+ *   bpftrace -e 'usdt:./build/Release/ndbus.node:ndbus:callback__start
+ *     { @start[tid] = nsecs; }
+ *     usdt:./build/Release/ndbus.node:ndbus:callback__done
+ *     { @us[str(arg1)] = hist((nsecs - @start[tid]) / 1000); }'
+ */
+#ifdef NDBUS_HAVE_PROBES
+extern "C" {
+#define NDBUS_SEMAPHORE __attribute__((unused)) __attribute__((section(".probes")))
+unsigned short ndbus_message__create_semaphore NDBUS_SEMAPHORE;
+unsigned short ndbus_encode__start_semaphore NDBUS_SEMAPHORE;
+unsigned short ndbus_encode__done_semaphore NDBUS_SEMAPHORE;
+unsigned short ndbus_queue_semaphore NDBUS_SEMAPHORE;
+unsigned short ndbus_flush_semaphore NDBUS_SEMAPHORE;
+unsigned short ndbus_receive_semaphore NDBUS_SEMAPHORE;
+unsigned short ndbus_route_semaphore NDBUS_SEMAPHORE;
+unsigned short ndbus_decode__start_semaphore NDBUS_SEMAPHORE;
+unsigned short ndbus_decode__done_semaphore NDBUS_SEMAPHORE;
+unsigned short ndbus_callback__start_semaphore NDBUS_SEMAPHORE;
+unsigned short ndbus_callback__done_semaphore NDBUS_SEMAPHORE;
+} //extern "C"
+#endif
+
+//EXPOSED
+dbus_uint32_t
+NDbusProbedSerial (DBusMessage *msg) {
+  return msg ? dbus_message_get_serial(msg) : 0;
+}
+
+//EXPOSED
+const gchar*
+NDbusProbedMember (DBusMessage *msg) {
+  const gchar *member = msg ? dbus_message_get_member(msg) : NULL;
+  return member ? member : "";
+}
+
+//EXPOSED
+/**
+ * What msg takes on the wire, which libdbus only tells by marshalling
+ * a copy of it, hence only while a probe is attached.
+ */
+guint
+NDbusProbedSize (DBusMessage *msg) {
+  char *marshalled;
+  int len;
+  if (!msg || !dbus_message_marshal(msg, &marshalled, &len))
+    return 0;
+  dbus_free(marshalled);
+  return len;
+}
+} //namespace ndbus
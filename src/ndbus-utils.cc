@@ -14,13 +14,6 @@ namespace ndbus {
 
 extern "C" {
 
-enum {
-  TYPE_MISMATCH,
-  TYPE_NOT_SUPPORTED,
-  OUT_OF_MEMORY,
-  SUCCESS
-};
-
 static gboolean
 async_message_error (DBusMessage *msg) {
   g_return_val_if_fail (msg != NULL, FALSE);
@@ -55,8 +48,225 @@ NDbusIsValidV8Array (const Local<Value> array) {
       (Local<Array>::Cast(array)->Length() > 0));
 }
 
+/**
+ * The number of elements in the container reply_iter points to.
+ * libdbus knows it for arrays from 1.9.16 on, otherwise the
+ * elements are skipped over, which decodes none of them.
+ */
+static guint
+NDbusCountElements (DBusMessageIter *reply_iter) {
+#if defined(DBUS_VERSION) && DBUS_VERSION >= 0x010910
+  if (dbus_message_iter_get_arg_type(reply_iter) == DBUS_TYPE_ARRAY)
+    return dbus_message_iter_get_element_count(reply_iter);
+#endif
+  DBusMessageIter sub_iter;
+  guint count = 0;
+  dbus_message_iter_recurse(reply_iter, &sub_iter);
+  while (dbus_message_iter_get_arg_type(&sub_iter) != DBUS_TYPE_INVALID) {
+    count++;
+    dbus_message_iter_next(&sub_iter);
+  }
+  return count;
+}
+
+/**
+ * Copies the member types of a struct of fixed-width basic types, as in
+ * the element signature "(tdd)", into types and NUL-terminates them.
+ * @return the number of members, 0 if it is no such struct
+ */
+//EXPOSED
+gint
+NDbusColumnTypes (const gchar *signature, gchar *types) {
+  if (signature[0] != DBUS_STRUCT_BEGIN_CHAR)
+    return 0;
+
+  gint ncols = 0;
+  const gchar *type = signature + 1;
+  for (; *type != DBUS_STRUCT_END_CHAR; type++) {
+    switch (*type) {
+      case DBUS_TYPE_BYTE:
+      case DBUS_TYPE_BOOLEAN:
+      case DBUS_TYPE_INT16:
+      case DBUS_TYPE_UINT16:
+      case DBUS_TYPE_INT32:
+      case DBUS_TYPE_UINT32:
+      case DBUS_TYPE_DOUBLE:
+#ifdef NDBUS_HAVE_BIGINT
+      case DBUS_TYPE_INT64:
+      case DBUS_TYPE_UINT64:
+#endif
+        types[ncols++] = *type;
+        break;
+      default:
+        return 0;
+    }
+  }
+  if (type[1] != '\0' || ncols == 0)
+    return 0;
+  types[ncols] = '\0';
+  return ncols;
+}
+
+/**
+ * Size of a column element, which is the size of the dbus type
+ * except for booleans, 4 bytes on the wire and 1 in a Uint8Array.
+ */
+//EXPOSED
+gsize
+NDbusColumnElementSize (gchar type) {
+  switch (type) {
+    case DBUS_TYPE_BYTE:
+    case DBUS_TYPE_BOOLEAN:
+      return 1;
+    case DBUS_TYPE_INT16:
+    case DBUS_TYPE_UINT16:
+      return 2;
+    case DBUS_TYPE_INT32:
+    case DBUS_TYPE_UINT32:
+      return 4;
+    default:
+      return 8;
+  }
+}
+
 static Local<Value>
-NDbusExtractMessageArgs (DBusMessageIter *reply_iter) {
+NDbusNewColumn (Local<ArrayBuffer> buffer, gchar type, guint len) {
+  switch (type) {
+    case DBUS_TYPE_INT16:
+      return Int16Array::New(buffer, 0, len);
+    case DBUS_TYPE_UINT16:
+      return Uint16Array::New(buffer, 0, len);
+    case DBUS_TYPE_INT32:
+      return Int32Array::New(buffer, 0, len);
+    case DBUS_TYPE_UINT32:
+      return Uint32Array::New(buffer, 0, len);
+    case DBUS_TYPE_DOUBLE:
+      return Float64Array::New(buffer, 0, len);
+#ifdef NDBUS_HAVE_BIGINT
+    case DBUS_TYPE_INT64:
+      return BigInt64Array::New(buffer, 0, len);
+    case DBUS_TYPE_UINT64:
+      return BigUint64Array::New(buffer, 0, len);
+#endif
+    default:
+      return Uint8Array::New(buffer, 0, len);
+  }
+}
+
+//EXPOSED
+gboolean
+NDbusIsColumn (Local<Value> column, gchar type) {
+  switch (type) {
+    case DBUS_TYPE_BYTE:
+    case DBUS_TYPE_BOOLEAN:
+      return column->IsUint8Array();
+    case DBUS_TYPE_INT16:
+      return column->IsInt16Array();
+    case DBUS_TYPE_UINT16:
+      return column->IsUint16Array();
+    case DBUS_TYPE_INT32:
+      return column->IsInt32Array();
+    case DBUS_TYPE_UINT32:
+      return column->IsUint32Array();
+    case DBUS_TYPE_DOUBLE:
+      return column->IsFloat64Array();
+#ifdef NDBUS_HAVE_BIGINT
+    case DBUS_TYPE_INT64:
+      return column->IsBigInt64Array();
+    case DBUS_TYPE_UINT64:
+      return column->IsBigUint64Array();
+#endif
+    default:
+      return FALSE;
+  }
+}
+
+/**
+ * Decodes the array reply_iter points to into one TypedArray per struct
+ * member, written in place, with no JS value per element.
+ * @return the { columns, length } object, or an empty handle if the
+ * elements are not structs of fixed-width basic types
+ */
+static Local<Value>
+NDbusExtractColumns (DBusMessageIter *reply_iter) {
+  Isolate* isolate = Isolate::GetCurrent();
+  gchar types[DBUS_MAXIMUM_SIGNATURE_LENGTH];
+
+  gchar *signature = dbus_message_iter_get_signature(reply_iter);
+  gint ncols = signature ? NDbusColumnTypes(signature + 1, types) : 0;
+  dbus_free(signature);
+  if (ncols == 0)
+    return Local<Value>();
+
+  guint len = NDbusCountElements(reply_iter);
+  Local<Array> columns = Array::New(isolate, ncols);
+  guint8 *data[DBUS_MAXIMUM_SIGNATURE_LENGTH];
+  gsize size[DBUS_MAXIMUM_SIGNATURE_LENGTH];
+  for (gint col = 0; col < ncols; col++) {
+    size[col] = NDbusColumnElementSize(types[col]);
+    Local<ArrayBuffer> buffer = ArrayBuffer::New(isolate, len * size[col]);
+    data[col] = (guint8 *) buffer->GetContents().Data();
+    columns->Set(col, NDbusNewColumn(buffer, types[col], len));
+  }
+
+  DBusMessageIter sub_iter;
+  dbus_message_iter_recurse(reply_iter, &sub_iter);
+  for (guint row = 0; row < len &&
+      dbus_message_iter_get_arg_type(&sub_iter) != DBUS_TYPE_INVALID; row++) {
+    DBusMessageIter struct_iter;
+    dbus_message_iter_recurse(&sub_iter, &struct_iter);
+    for (gint col = 0; col < ncols; col++) {
+      if (types[col] == DBUS_TYPE_BOOLEAN) {
+        dbus_bool_t value;
+        dbus_message_iter_get_basic(&struct_iter, &value);
+        data[col][row] = value ? 1 : 0;
+      } else {
+        //fixed-width types are stored at exactly their own size
+        dbus_message_iter_get_basic(&struct_iter, data[col] + row * size[col]);
+      }
+      dbus_message_iter_next(&struct_iter);
+    }
+    dbus_message_iter_next(&sub_iter);
+  }
+
+  Local<Object> ret = Object::New(isolate);
+  ret->Set(String::NewFromUtf8(isolate, NDBUS_PROPERTY_COLUMNS), columns);
+  ret->Set(String::NewFromUtf8(isolate, NDBUS_PROPERTY_LENGTH),
+      Integer::NewFromUnsigned(isolate, len));
+  return ret;
+}
+
+#ifdef NDBUS_HAVE_BIGINT
+/**
+ * Copies an array of x or t in one go into a BigInt64Array or a
+ * BigUint64Array.
+ * @return the TypedArray, or an empty handle for other arrays
+ */
+static Local<Value>
+NDbusExtractInt64Array (DBusMessageIter *reply_iter) {
+  gint type = dbus_message_iter_get_element_type(reply_iter);
+  if (type != DBUS_TYPE_INT64 && type != DBUS_TYPE_UINT64)
+    return Local<Value>();
+
+  DBusMessageIter sub_iter;
+  const gint64 *values = NULL;
+  gint len = 0;
+  dbus_message_iter_recurse(reply_iter, &sub_iter);
+  dbus_message_iter_get_fixed_array(&sub_iter, &values, &len);
+
+  Local<ArrayBuffer> buffer =
+    ArrayBuffer::New(Isolate::GetCurrent(), len * sizeof(gint64));
+  if (len)
+    memcpy(buffer->GetContents().Data(), values, len * sizeof(gint64));
+  if (type == DBUS_TYPE_INT64)
+    return BigInt64Array::New(buffer, 0, len);
+  return BigUint64Array::New(buffer, 0, len);
+}
+#endif
+
+static Local<Value>
+NDbusExtractMessageArgs (DBusMessage *msg, DBusMessageIter *reply_iter,
+    guint decode_flags) {
   Isolate* isolate = Isolate::GetCurrent();
   EscapableHandleScope scope(isolate);
 
@@ -96,6 +306,14 @@ NDbusExtractMessageArgs (DBusMessageIter *reply_iter) {
       {
         guint64 value;
         dbus_message_iter_get_basic(reply_iter, &value);
+#ifdef NDBUS_HAVE_BIGINT
+        if ((decode_flags & NDBUS_DECODE_BIGINT) ||
+            ((decode_flags & NDBUS_DECODE_BIGINT_UNSAFE) &&
+             value > (guint64) NDBUS_MAX_SAFE_INTEGER)) {
+          ret = BigInt::NewFromUnsigned(isolate, value);
+          break;
+        }
+#endif
         //up-casting!
         ret = Number::New(isolate, value);
         break;
@@ -119,6 +337,14 @@ NDbusExtractMessageArgs (DBusMessageIter *reply_iter) {
       {
         gint64 value;
         dbus_message_iter_get_basic(reply_iter, &value);
+#ifdef NDBUS_HAVE_BIGINT
+        if ((decode_flags & NDBUS_DECODE_BIGINT) ||
+            ((decode_flags & NDBUS_DECODE_BIGINT_UNSAFE) &&
+             (value > NDBUS_MAX_SAFE_INTEGER || value < -NDBUS_MAX_SAFE_INTEGER))) {
+          ret = BigInt::New(isolate, value);
+          break;
+        }
+#endif
         ret = Number::New(isolate, value);
         break;
       }
@@ -135,41 +361,82 @@ NDbusExtractMessageArgs (DBusMessageIter *reply_iter) {
       {
         gchar *value;
         dbus_message_iter_get_basic(reply_iter, &value);
-        ret = v8::String::NewFromUtf8(isolate, value);
+        ret = NDbusNewMessageString(msg, value);
         break;
       }
     case DBUS_TYPE_STRUCT:
     case DBUS_TYPE_ARRAY:
       {
+        if ((decode_flags & NDBUS_DECODE_COLUMNAR) &&
+            dbus_message_iter_get_arg_type(reply_iter) == DBUS_TYPE_ARRAY &&
+            dbus_message_iter_get_element_type(reply_iter) == DBUS_TYPE_STRUCT) {
+          ret = NDbusExtractColumns(reply_iter);
+          if (!ret.IsEmpty())
+            break;
+        }
+#ifdef NDBUS_HAVE_BIGINT
+        if ((decode_flags & NDBUS_DECODE_BIGINT) &&
+            dbus_message_iter_get_arg_type(reply_iter) == DBUS_TYPE_ARRAY) {
+          ret = NDbusExtractInt64Array(reply_iter);
+          if (!ret.IsEmpty())
+            break;
+        }
+#endif
+
         DBusMessageIter sub_iter;
         dbus_message_iter_recurse(reply_iter, &sub_iter);
 
-        gboolean dictionary = (dbus_message_iter_get_arg_type(&sub_iter)
-            == DBUS_TYPE_DICT_ENTRY);
+        //from the signature rather than the first element, so that
+        //an empty dictionary does not come out as an array
+        gboolean dictionary =
+          (dbus_message_iter_get_arg_type(reply_iter) == DBUS_TYPE_ARRAY &&
+           dbus_message_iter_get_element_type(reply_iter) == DBUS_TYPE_DICT_ENTRY);
         gint currentType;
-        if (dictionary) {
+        if (dictionary && (decode_flags & NDBUS_DECODE_DICT_AS_MAP)) {
+          Local<Context> context = isolate->GetCurrentContext();
+          Local<Map> map = Map::New(isolate);
+          while((currentType = dbus_message_iter_get_arg_type (&sub_iter)) != DBUS_TYPE_INVALID) {
+            DBusMessageIter dict_iter;
+            dbus_message_iter_recurse(&sub_iter, &dict_iter);
+
+            Local<Value> key =
+              NDbusExtractMessageArgs(msg, &dict_iter, decode_flags);
+
+            dbus_message_iter_next(&dict_iter);
+
+            Local<Value> value =
+              NDbusExtractMessageArgs(msg, &dict_iter, decode_flags);
+
+            map->Set(context, key, value).ToLocalChecked();
+            dbus_message_iter_next(&sub_iter);
+          }
+          ret = map;
+        } else if (dictionary) {
           Local<Object> obj = Object::New(isolate);
           while((currentType = dbus_message_iter_get_arg_type (&sub_iter)) != DBUS_TYPE_INVALID) {
             DBusMessageIter dict_iter;
             dbus_message_iter_recurse(&sub_iter, &dict_iter);
 
             Local<Value> key =
-              NDbusExtractMessageArgs(&dict_iter);
+              NDbusExtractMessageArgs(msg, &dict_iter, decode_flags);
 
             dbus_message_iter_next(&dict_iter);
 
             Local<Value> value =
-              NDbusExtractMessageArgs(&dict_iter);
+              NDbusExtractMessageArgs(msg, &dict_iter, decode_flags);
 
             obj->ForceSet(key, value, None);
             dbus_message_iter_next(&sub_iter);
           }
           ret = obj;
         } else {
-          Local<Array> arr = Array::New(isolate);
-          gint i = 0;
-          while((currentType = dbus_message_iter_get_arg_type (&sub_iter)) != DBUS_TYPE_INVALID) {
-            arr->Set(i++, NDbusExtractMessageArgs(&sub_iter));
+          //sized up front, rather than grown one element at a time
+          guint len = NDbusCountElements(reply_iter);
+          Local<Array> arr = Array::New(isolate, len);
+          guint i = 0;
+          while(i < len &&
+              dbus_message_iter_get_arg_type (&sub_iter) != DBUS_TYPE_INVALID) {
+            arr->Set(i++, NDbusExtractMessageArgs(msg, &sub_iter, decode_flags));
             dbus_message_iter_next(&sub_iter);
           }
           ret = arr;
@@ -180,9 +447,19 @@ NDbusExtractMessageArgs (DBusMessageIter *reply_iter) {
       {
         DBusMessageIter sub_iter;
         dbus_message_iter_recurse(reply_iter, &sub_iter);
-        ret = NDbusExtractMessageArgs(&sub_iter);
+        ret = NDbusExtractMessageArgs(msg, &sub_iter, decode_flags);
         break;
       }
+#ifdef DBUS_TYPE_UNIX_FD
+    case DBUS_TYPE_UNIX_FD:
+      {
+        //libdbus hands out a dup of the descriptor, it is ours to close
+        gint value = -1;
+        dbus_message_iter_get_basic(reply_iter, &value);
+        ret = Int32::New(isolate, value);
+        break;
+      }
+#endif
     default:
       {
         ret = Undefined(isolate);
@@ -194,49 +471,37 @@ NDbusExtractMessageArgs (DBusMessageIter *reply_iter) {
 }
 
 /**
- * Creates a signature string for parameters of type "variant". This string will
- * become a part of the parameter.
+ * Writes the signature of a "variant" value into buffer at index, which
+ * is advanced past it. The caller provides the buffer, usually on its
+ * stack, and NUL-terminates it.
+ *
+ * With the default policy, objects and arrays hold variants, so their
+ * signature is known without looking into them. Only the simple policy
+ * needs to descend, along the first property or element.
  *
  * @param value variant value for which to generate the signature
- * @param status status of the operation, eg. SUCCESS, OF_MEMORY, etc
  * @param variantPolicy indicates how variants should be resolved
- * @param buffer private - do NOT use! Memory where the signature will be stored.
- * @param index private - do NOT use! The current position within the buffer, when signature is created.
- * @return the generated signature or NULL on error. Use g_free to release the signature after use.
+ * @param buffer where the signature is written, DBUS_MAXIMUM_SIGNATURE_LENGTH long
+ * @param index the current position within the buffer
+ * @return SUCCESS, or TYPE_NOT_SUPPORTED/OUT_OF_MEMORY if the value has no
+ * signature or it does not fit
  */
-static char*
-NDbusCreateSignatureForVariant(Local<Value> value, gint &status, NDbusVariantPolicy variantPolicy, gchar* buffer, gint &index) {
-  // allocate memory for the signature, if necessary
-  gboolean cleanUp = FALSE;
-  if (buffer == NULL) {
-      // fill up with zeros, so that we'll be able to construct signature at the beginning
-      // of the buffer and the signature will always be a NULL terminated string.
-      buffer = g_try_new0(gchar, DBUS_MAXIMUM_SIGNATURE_LENGTH);
-      if(buffer == NULL) {
-        status = OUT_OF_MEMORY;
-        return NULL;
-      }
-      index = 0; // just in case
-      cleanUp = TRUE; // in case of error, we'll have to release memory
-  }
-
+//EXPOSED
+gint
+NDbusCreateSignatureForVariant(Local<Value> value, NDbusVariantPolicy variantPolicy,
+    gchar *buffer, gint &index) {
   if (value->IsArray()) {
     // make sure the signature is not too long. We'll need at least 2 characters for array:
     // 1 char for array and 1 for the type of elements
-    if (index + 2 > DBUS_MAXIMUM_SIGNATURE_LENGTH - 1) {
-      status = OUT_OF_MEMORY;
-      if(cleanUp) {
-        g_free(buffer);
-      }
-      return NULL;
-    }
+    if (index + 2 > DBUS_MAXIMUM_SIGNATURE_LENGTH - 1)
+      return OUT_OF_MEMORY;
 
     Local<Array> array = Local<Array>::Cast(value);
     buffer[index++] = DBUS_TYPE_ARRAY;
     if(variantPolicy == NDBUS_VARIANT_POLICY_DEFAULT) {
-        buffer[index++] = DBUS_TYPE_VARIANT;
+      buffer[index++] = DBUS_TYPE_VARIANT;
     } else if (array->Length()) {
-      NDbusCreateSignatureForVariant(array->Get(0), status, variantPolicy, buffer, index);
+      return NDbusCreateSignatureForVariant(array->Get(0), variantPolicy, buffer, index);
     } else {
       // array is empty, so we cannot infer the type of elements - we'll just use a string.
       buffer[index++] = DBUS_TYPE_STRING;
@@ -244,44 +509,37 @@ NDbusCreateSignatureForVariant(Local<Value> value, gint &status, NDbusVariantPol
   } else if(value->IsObject()) {
     // make sure the signature is not too long. We'll need at least 5 characters for a map:
     // 1 char for array, 2 for brackets, 1 for key and 1 for value
-    if (index + 5 > DBUS_MAXIMUM_SIGNATURE_LENGTH - 1) {
-      status = OUT_OF_MEMORY;
-      if(cleanUp) {
-        g_free(buffer);
-      }
-      return NULL;
-    }
-    Local<Object> obj = Local<Object>::Cast(value);
-    Local<Array> properties = obj->GetOwnPropertyNames();
+    if (index + 5 > DBUS_MAXIMUM_SIGNATURE_LENGTH - 1)
+      return OUT_OF_MEMORY;
+
     buffer[index++] = DBUS_TYPE_ARRAY;
     buffer[index++] = DBUS_DICT_ENTRY_BEGIN_CHAR;
     buffer[index++] = DBUS_TYPE_STRING; // keys of objects are strings in JS.
     if(variantPolicy == NDBUS_VARIANT_POLICY_DEFAULT) {
-        buffer[index++] = DBUS_TYPE_VARIANT;
-    } else if(properties->Length()) {
-        NDbusCreateSignatureForVariant(obj->Get(properties->Get(0)), status, variantPolicy, buffer, index);
+      buffer[index++] = DBUS_TYPE_VARIANT;
+    } else {
+      Local<Object> obj = Local<Object>::Cast(value);
+      gboolean map = value->IsMap();
+      Local<Array> properties = map ?
+        Local<Map>::Cast(value)->AsArray() : obj->GetOwnPropertyNames();
+      if(properties->Length()) {
+        gint status = NDbusCreateSignatureForVariant(map ? properties->Get(1) :
+            obj->Get(properties->Get(0)), variantPolicy, buffer, index);
+        if (status != SUCCESS)
+          return status;
         // we do not know how many characters did the method above added, so we have
         // to check, if we can still add the closing bracket
-        if (index + 1 > DBUS_MAXIMUM_SIGNATURE_LENGTH - 1) {
-          status = OUT_OF_MEMORY;
-          if(cleanUp) {
-            g_free(buffer);
-          }
-          return NULL;
-        }
-    } else {
-      buffer[index++] = DBUS_TYPE_STRING; // no properties in this object, so we'll assume values are strings
+        if (index + 1 > DBUS_MAXIMUM_SIGNATURE_LENGTH - 1)
+          return OUT_OF_MEMORY;
+      } else {
+        buffer[index++] = DBUS_TYPE_STRING; // no properties in this object, so we'll assume values are strings
+      }
     }
     buffer[index++] = DBUS_DICT_ENTRY_END_CHAR;
   } else {
     // make sure the signature is not too long
-    if (index + 1 > DBUS_MAXIMUM_SIGNATURE_LENGTH - 1) {
-      status = OUT_OF_MEMORY;
-      if(cleanUp) {
-        g_free(buffer);
-      }
-      return NULL;
-    }
+    if (index + 1 > DBUS_MAXIMUM_SIGNATURE_LENGTH - 1)
+      return OUT_OF_MEMORY;
 
     if (value->IsString()) {
       buffer[index++] = DBUS_TYPE_STRING;
@@ -293,15 +551,141 @@ NDbusCreateSignatureForVariant(Local<Value> value, gint &status, NDbusVariantPol
       buffer[index++] = DBUS_TYPE_DOUBLE;
     } else if (value->IsBoolean()) {
       buffer[index++] = DBUS_TYPE_BOOLEAN;
+#ifdef NDBUS_HAVE_BIGINT
+    } else if (value->IsBigInt()) {
+      //signed, unless it only fits unsigned
+      bool lossless;
+      Local<BigInt>::Cast(value)->Int64Value(&lossless);
+      buffer[index++] = lossless ? DBUS_TYPE_INT64 : DBUS_TYPE_UINT64;
+#endif
     } else {
-        status = TYPE_NOT_SUPPORTED;
-        if(cleanUp) {
-          g_free(buffer);
-        }
-        return NULL;
+      return TYPE_NOT_SUPPORTED;
+    }
+  }
+  return SUCCESS;
+}
+
+/**
+ * Appends a string-like basic type. Most strings, keys of dicts
+ * above all, fit the stack buffer and need no allocation.
+ *
+ * A one-byte string which is ASCII is its own UTF-8 and is copied out
+ * as it is. Anything else is converted to UTF-8, with lone surrogates
+ * replaced, so that the check libdbus makes on it cannot fail.
+ */
+static gint
+NDbusMessageAppendString (DBusMessageIter *iter,
+    gint type, Local<Value> value) {
+  if (!value->IsString())
+    return TYPE_MISMATCH;
+
+  Local<v8::String> str = Local<v8::String>::Cast(value);
+  gchar buffer[NDBUS_STRING_BUFFER_SIZE];
+  gchar *str_value = NULL;
+  gint len = str->Length();
+
+  if (str->IsOneByte()) {
+    str_value = len < NDBUS_STRING_BUFFER_SIZE ?
+      buffer : (gchar *) g_malloc(len + 1);
+    str->WriteOneByte((uint8_t *) str_value, 0, len,
+        v8::String::NO_NULL_TERMINATION);
+    str_value[len] = '\0';
+    if (!NDbusIsAscii(str_value, len)) {
+      if (str_value != buffer)
+        g_free(str_value);
+      str_value = NULL;
+    }
+  }
+
+  if (str_value == NULL) {
+    const gint options = v8::String::NO_NULL_TERMINATION |
+      v8::String::REPLACE_INVALID_UTF8;
+    gint nchars = 0;
+    gint written = str->WriteUtf8(buffer, sizeof(buffer) - 1, &nchars, options);
+    buffer[written] = '\0';
+    str_value = buffer;
+    if (nchars < len) {
+      gint utf8_len = str->Utf8Length();
+      str_value = (gchar *) g_malloc(utf8_len + 1);
+      str->WriteUtf8(str_value, utf8_len, NULL, options);
+      str_value[utf8_len] = '\0';
+    }
+  }
+
+  //like before, an embedded NUL ends the string
+  gint status = dbus_message_iter_append_basic(iter, type, &str_value) ?
+    SUCCESS : OUT_OF_MEMORY;
+  if (str_value != buffer)
+    g_free(str_value);
+  return status;
+}
+
+/**
+ * Appends { columns, length }, as decoded with NDBUS_DECODE_COLUMNAR,
+ * as the array of structs of the element signature, which has the
+ * member types in types. Each column must be the TypedArray of its type.
+ */
+static gint
+NDbusMessageAppendColumns (DBusMessageIter *iter, const gchar *signature,
+    const gchar *types, gint ncols, Local<Value> value) {
+  Isolate* isolate = Isolate::GetCurrent();
+  Local<Object> obj = Local<Object>::Cast(value);
+  Local<Value> columns_value =
+    obj->Get(String::NewFromUtf8(isolate, NDBUS_PROPERTY_COLUMNS));
+  if (!columns_value->IsArray())
+    return TYPE_MISMATCH;
+
+  Local<Array> columns = Local<Array>::Cast(columns_value);
+  if (columns->Length() != (guint) ncols)
+    return TYPE_MISMATCH;
+
+  Local<Value> length =
+    obj->Get(String::NewFromUtf8(isolate, NDBUS_PROPERTY_LENGTH));
+  const guint8 *data[DBUS_MAXIMUM_SIGNATURE_LENGTH];
+  gsize size[DBUS_MAXIMUM_SIGNATURE_LENGTH];
+  guint len = 0;
+  for (gint col = 0; col < ncols; col++) {
+    Local<Value> column = columns->Get(col);
+    if (!NDbusIsColumn(column, types[col]))
+      return TYPE_MISMATCH;
+
+    Local<TypedArray> typed = Local<TypedArray>::Cast(column);
+    //without a length, all of the first column
+    if (col == 0)
+      len = length->IsUint32() ? length->Uint32Value() : typed->Length();
+    if (typed->Length() < len)
+      return TYPE_MISMATCH;
+    size[col] = NDbusColumnElementSize(types[col]);
+    data[col] = (const guint8 *) typed->Buffer()->GetContents().Data() +
+      typed->ByteOffset();
+  }
+
+  DBusMessageIter subiter;
+  if (!dbus_message_iter_open_container
+      (iter, DBUS_TYPE_ARRAY, signature, &subiter))
+    return OUT_OF_MEMORY;
+
+  for (guint row = 0; row < len; row++) {
+    DBusMessageIter structiter;
+    if (!dbus_message_iter_open_container
+        (&subiter, DBUS_TYPE_STRUCT, NULL, &structiter))
+      return OUT_OF_MEMORY;
+
+    for (gint col = 0; col < ncols; col++) {
+      const guint8 *field = data[col] + row * size[col];
+      dbus_bool_t value;
+      if (types[col] == DBUS_TYPE_BOOLEAN) {
+        value = *field ? TRUE : FALSE;
+        field = (const guint8 *) &value;
+      }
+      if (!dbus_message_iter_append_basic(&structiter, types[col], field))
+        return OUT_OF_MEMORY;
     }
+    dbus_message_iter_close_container(&subiter, &structiter);
   }
-  return buffer;
+
+  dbus_message_iter_close_container(iter, &subiter);
+  return SUCCESS;
 }
 
 static gint
@@ -361,12 +745,42 @@ NDbusMessageAppendArgsReal (DBusMessageIter * iter,
       }
     case DBUS_TYPE_INT64:
       {
-        if (!value->IsNumber())
+        gint64 val;
+#ifdef NDBUS_HAVE_BIGINT
+        if (value->IsBigInt()) {
+          bool lossless;
+          val = Local<BigInt>::Cast(value)->Int64Value(&lossless);
+          if (!lossless)
+            return TYPE_MISMATCH;
+        } else
+#endif
+        if (value->IsNumber())
+          val = value->IntegerValue();
+        else
           return TYPE_MISMATCH;
-        gint64 val = value->IntegerValue();
         dbus_message_iter_append_basic(iter, DBUS_TYPE_INT64, &val);
         break;
       }
+    case DBUS_TYPE_UINT64:
+      {
+        guint64 val;
+#ifdef NDBUS_HAVE_BIGINT
+        if (value->IsBigInt()) {
+          bool lossless;
+          val = Local<BigInt>::Cast(value)->Uint64Value(&lossless);
+          if (!lossless)
+            return TYPE_MISMATCH;
+        } else
+#endif
+        //18446744073709551616 is 2^64, the first double out of range
+        if (value->IsNumber() && value->NumberValue() >= 0 &&
+            value->NumberValue() < 18446744073709551616.0)
+          val = (guint64) value->NumberValue();
+        else
+          return TYPE_MISMATCH;
+        dbus_message_iter_append_basic(iter, DBUS_TYPE_UINT64, &val);
+        break;
+      }
     case DBUS_TYPE_DOUBLE:
       {
         if (!value->IsNumber())
@@ -376,34 +790,15 @@ NDbusMessageAppendArgsReal (DBusMessageIter * iter,
         break;
       }
     case DBUS_TYPE_SIGNATURE:
-      {
-        gchar *str_value = NDbusV8StringToCStr(value);
-        if (!str_value)
-          return TYPE_MISMATCH;
-        dbus_message_iter_append_basic(iter, DBUS_TYPE_SIGNATURE, &str_value);
-        g_free(str_value);
-        break;
-      }
     case DBUS_TYPE_OBJECT_PATH:
-      {
-        gchar *str_value = NDbusV8StringToCStr(value);
-        if (!str_value)
-          return TYPE_MISMATCH;
-        dbus_message_iter_append_basic(iter, DBUS_TYPE_OBJECT_PATH, &str_value);
-        g_free(str_value);
-        break;
-      }
     case DBUS_TYPE_STRING:
-      {
-        gchar *str_value = NDbusV8StringToCStr(value);
-        if (!str_value)
-          return TYPE_MISMATCH;
-        dbus_message_iter_append_basic(iter, DBUS_TYPE_STRING, &str_value);
-        g_free(str_value);
-        break;
-      }
+      return NDbusMessageAppendString(iter,
+          dbus_signature_iter_get_current_type(&signiter), value);
     case DBUS_TYPE_ARRAY:
       {
+        //signature is a single complete type, so the element type
+        //is the rest of it and needs no copy from the signature iter
+        const gchar *array_signature = signature + 1;
         DBusMessageIter subiter;
         guint i = 0;
         gint status;
@@ -412,120 +807,125 @@ NDbusMessageAppendArgsReal (DBusMessageIter * iter,
           if (!value->IsObject())
             return TYPE_MISMATCH;
 
-          Local<Object> obj = Local<Object>::Cast(value);
-          Local<Array> obj_properties = obj->GetOwnPropertyNames();
-
-          DBusSignatureIter dictsigniter, dictsignsubiter;
-          dbus_signature_iter_recurse(&signiter, &dictsigniter);
-          gchar *dict_signature =
-            dbus_signature_iter_get_signature(&dictsigniter);
+          //"a{kv}": the key is a basic type, the value lies between it and '}'
+          gchar sign_key[2] = { signature[2], '\0' };
+          gchar sign_val[DBUS_MAXIMUM_SIGNATURE_LENGTH];
+          gsize val_len = strlen(signature + 3) - 1;
+          memcpy(sign_val, signature + 3, val_len);
+          sign_val[val_len] = '\0';
 
           if (!dbus_message_iter_open_container
-              (iter, DBUS_TYPE_ARRAY, dict_signature, &subiter)) {
-            dbus_free(dict_signature);
+              (iter, DBUS_TYPE_ARRAY, array_signature, &subiter))
             return OUT_OF_MEMORY;
-          }
-
-          dbus_free(dict_signature);
-          dbus_signature_iter_recurse(&dictsigniter, &dictsignsubiter);
 
-          gchar *sign_key =
-            dbus_signature_iter_get_signature(&dictsignsubiter);
-          dbus_signature_iter_next(&dictsignsubiter);
-          gchar *sign_val =
-            dbus_signature_iter_get_signature(&dictsignsubiter);
+          //a Map keeps the type of its keys and is walked as
+          //the flat [key, value, ...] array of its entries
+          gboolean map = value->IsMap();
+          Local<Object> obj = Local<Object>::Cast(value);
+          Local<Array> entries = map ?
+            Local<Map>::Cast(value)->AsArray() : obj->GetOwnPropertyNames();
 
-          guint len = obj_properties->Length();
-          for (; i<len; i++) {
+          guint len = entries->Length();
+          for (; i<len; i += map ? 2 : 1) {
             DBusMessageIter dictiter;
             if (!dbus_message_iter_open_container
                 (&subiter, DBUS_TYPE_DICT_ENTRY,
-                 NULL, &dictiter)) {
-              dbus_free(sign_key);
-              dbus_free(sign_val);
+                 NULL, &dictiter))
               return OUT_OF_MEMORY;
-            }
 
+            Local<Value> key = entries->Get(i);
             status = NDbusMessageAppendArgsReal(&dictiter, sign_key,
-                obj_properties->Get(i), variantPolicy);
-
-            if (status != SUCCESS) {
-              dbus_free(sign_key);
-              dbus_free(sign_val);
+                key, variantPolicy);
+            if (status != SUCCESS)
               return status;
-            }
 
             status = NDbusMessageAppendArgsReal(&dictiter, sign_val,
-                obj->Get(obj_properties->Get(i)), variantPolicy);
-
-            if (status != SUCCESS) {
-              dbus_free(sign_key);
-              dbus_free(sign_val);
+                map ? entries->Get(i + 1) : obj->Get(key), variantPolicy);
+            if (status != SUCCESS)
               return status;
-            }
 
             dbus_message_iter_close_container(&subiter, &dictiter);
           }
 
-          dbus_free(sign_key);
-          dbus_free(sign_val);
           dbus_message_iter_close_container(iter, &subiter);
           break;
         } else {
+          gchar types[DBUS_MAXIMUM_SIGNATURE_LENGTH];
+          gint ncols;
+          if (!value->IsArray() && value->IsObject() &&
+              (ncols = NDbusColumnTypes(array_signature, types)) > 0)
+            return NDbusMessageAppendColumns(iter, array_signature,
+                types, ncols, value);
+
+          //a TypedArray of a fixed-width type is appended in one go,
+          //except booleans, which are 4 bytes each on the wire
+          if (array_signature[1] == '\0' &&
+              array_signature[0] != DBUS_TYPE_BOOLEAN &&
+              NDbusIsColumn(value, array_signature[0])) {
+            Local<TypedArray> typed = Local<TypedArray>::Cast(value);
+            const void *data = (const guint8 *)
+              typed->Buffer()->GetContents().Data() + typed->ByteOffset();
+            if (!dbus_message_iter_open_container
+                (iter, DBUS_TYPE_ARRAY, array_signature, &subiter))
+              return OUT_OF_MEMORY;
+            if (!dbus_message_iter_append_fixed_array(&subiter,
+                  array_signature[0], &data, typed->Length()))
+              return OUT_OF_MEMORY;
+            dbus_message_iter_close_container(iter, &subiter);
+            break;
+          }
+
           if (!value->IsArray())
             return TYPE_MISMATCH;
 
           Local<Array> arr = Local<Array>::Cast(value);
 
-          DBusSignatureIter arraysigniter;
-          dbus_signature_iter_recurse(&signiter, &arraysigniter);
-          gchar *array_signature =
-            dbus_signature_iter_get_signature(&arraysigniter);
-
           if (!dbus_message_iter_open_container
-              (iter, DBUS_TYPE_ARRAY, array_signature, &subiter)) {
-            dbus_free(array_signature);
+              (iter, DBUS_TYPE_ARRAY, array_signature, &subiter))
             return OUT_OF_MEMORY;
-          }
 
-          while (i < arr->Length()) {
+          guint len = arr->Length();
+          while (i < len) {
             status = NDbusMessageAppendArgsReal(&subiter,
                 array_signature, arr->Get(i++), variantPolicy);
-            if (status != SUCCESS) {
-              dbus_free(array_signature);
+            if (status != SUCCESS)
               return status;
-            }
           }
 
           dbus_message_iter_close_container(iter, &subiter);
-          dbus_free(array_signature);
           break;
         }
       }
     case DBUS_TYPE_VARIANT:
       {
         DBusMessageIter subiter;
-        gint status = SUCCESS;
+        gchar vsignature[DBUS_MAXIMUM_SIGNATURE_LENGTH];
         gint index = 0;
-        // this method should not require the last 2 params (NULL and index)
-        gchar* vsignature = NDbusCreateSignatureForVariant(value, status, variantPolicy, NULL, index);
-        if(status != SUCCESS) {
+        gint status = NDbusCreateSignatureForVariant(value, variantPolicy, vsignature, index);
+        if(status != SUCCESS)
           return status;
-        }
+        vsignature[index] = '\0';
 
-        if (!dbus_message_iter_open_container(iter, DBUS_TYPE_VARIANT, vsignature, &subiter)) {
-          g_free(vsignature);
+        if (!dbus_message_iter_open_container(iter, DBUS_TYPE_VARIANT, vsignature, &subiter))
           return OUT_OF_MEMORY;
-        }
         status = NDbusMessageAppendArgsReal(&subiter, vsignature, value, variantPolicy);
-        if (status != SUCCESS) {
-          g_free(vsignature);
+        if (status != SUCCESS)
           return status;
-        }
-        g_free(vsignature);
         dbus_message_iter_close_container(iter, &subiter);
         break;
       }
+#ifdef DBUS_TYPE_UNIX_FD
+    case DBUS_TYPE_UNIX_FD:
+      {
+        if (!value->IsInt32() || value->Int32Value() < 0)
+          return TYPE_MISMATCH;
+        //the descriptor is dup'ed, the caller keeps its own copy
+        gint val = value->Int32Value();
+        if (!dbus_message_iter_append_basic(iter, DBUS_TYPE_UNIX_FD, &val))
+          return OUT_OF_MEMORY;
+        break;
+      }
+#endif
     default:
       return TYPE_NOT_SUPPORTED;
   }
@@ -534,7 +934,7 @@ NDbusMessageAppendArgsReal (DBusMessageIter * iter,
 
 static void
 NDbusRetrieveSignalListners (GHashTable *signal_watchers,
-    gchar *key, Local<Array> *listeners) {
+    gchar *key, Local<Array> *listeners, GArray *listener_flags) {
   if (signal_watchers) {
     GSList *object_list = (GSList *)
       g_hash_table_lookup(signal_watchers, key);
@@ -547,8 +947,10 @@ NDbusRetrieveSignalListners (GHashTable *signal_watchers,
         NDbusObjectInfo *info = (NDbusObjectInfo *)tmp->data;
         v8::Local<v8::Object> object = v8::Local<v8::Object>::New(Isolate::GetCurrent(), info->object);
 
-        if (NDbusIsValidV8Value(object))
+        if (NDbusIsValidV8Value(object)) {
           Local<Array>::Cast(*listeners)->Set(index++, object);
+          g_array_append_val(listener_flags, info->decode_flags);
+        }
         tmp = g_slist_next(tmp);
       }
     }
@@ -603,22 +1005,45 @@ NDbusIsMatchAdded (GSList *list, Local<Object> obj) {
   return FALSE;
 }
 
-Local<Value>
-NDbusRetrieveMessageArgs(DBusMessage *msg) {
+static Local<Value>
+NDbusDecodeMessageArgs (DBusMessage *msg, guint decode_flags) {
   DBusMessageIter msg_iter;
   Local<Array> args_array = Array::New(Isolate::GetCurrent());
-  if (dbus_message_iter_init(msg, &msg_iter)) {
+  if ((decode_flags & NDBUS_DECODE_CODEC) &&
+      !(decode_flags & (NDBUS_DECODE_COLUMNAR | NDBUS_DECODE_RAW))) {
+    //unless the codec cannot read it, as with unix fds
+    Local<Value> args = NDbusCodecRetrieveMessageArgs(msg, decode_flags);
+    if (!args.IsEmpty())
+      return args;
+  }
+
+  if (decode_flags & NDBUS_DECODE_RAW) {
+    //unix fds cannot be marshalled, the argument is undefined then
+    Local<Value> raw = NDbusMarshalMessage(msg);
+    args_array->Set(0, raw.IsEmpty() ?
+        Local<Value>(Undefined(Isolate::GetCurrent())) : raw);
+  } else if (dbus_message_iter_init(msg, &msg_iter)) {
     gint i = 0;
     while (dbus_message_iter_get_arg_type(&msg_iter) !=
         DBUS_TYPE_INVALID) {
       args_array->Set(i++,
-          NDbusExtractMessageArgs(&msg_iter));
+          NDbusExtractMessageArgs(msg, &msg_iter, decode_flags));
       dbus_message_iter_next(&msg_iter);
     }
   }
   return args_array;
 }
 
+Local<Value>
+NDbusRetrieveMessageArgs (DBusMessage *msg, guint decode_flags) {
+  NDBUS_PROBE(decode__start, msg);
+  guint64 started = NDbusMetricsNow();
+  Local<Value> args = NDbusDecodeMessageArgs(msg, decode_flags);
+  NDbusCountDecode(started);
+  NDBUS_PROBE(decode__done, msg);
+  return args;
+}
+
 gchar*
 NDbusConstructMatchString (gchar *interface,
     gchar *member, gchar *object_path,
@@ -653,8 +1078,126 @@ NDbusConstructKey (gchar *interface,
   return key;
 }
 
+/**
+ * Validates signature and splits it into the complete type of each
+ * argument. Returns NULL if the signature is invalid.
+ */
+NDbusSignature*
+NDbusSignatureNew (const gchar *signature) {
+  if (!dbus_signature_validate(signature, NULL))
+    return NULL;
+
+  NDbusSignature *compiled = g_new0(NDbusSignature, 1);
+  compiled->signature = g_strdup(signature);
+  compiled->arg_signatures =
+    g_ptr_array_new_with_free_func((GDestroyNotify) dbus_free);
+
+  DBusSignatureIter sigiter;
+  dbus_signature_iter_init(&sigiter, signature);
+  if (dbus_signature_iter_get_current_type(&sigiter) != DBUS_TYPE_INVALID) {
+    do {
+      gchar *sign = dbus_signature_iter_get_signature(&sigiter);
+      if (sign == NULL) {
+        NDbusSignatureFree(compiled);
+        return NULL;
+      }
+      g_ptr_array_add(compiled->arg_signatures, sign);
+    } while (dbus_signature_iter_next(&sigiter));
+  }
+  return compiled;
+}
+
+void
+NDbusSignatureFree (gpointer data) {
+  NDbusSignature *compiled = (NDbusSignature *)data;
+  if (compiled) {
+    if (compiled->program)
+      NDbusCodecProgramUnref(compiled->program);
+    g_ptr_array_unref(compiled->arg_signatures);
+    g_free(compiled->signature);
+    g_free(compiled);
+  }
+}
+
+static void
+NDbusSetAppendError (gint status, Local<Object> *error) {
+  Isolate* isolate = Isolate::GetCurrent();
+  if (status == TYPE_MISMATCH)
+    NDBUS_SET_EXCPN(*error, DBUS_ERROR_FAILED, NDBUS_ERROR_MISMATCH);
+  if (status == TYPE_NOT_SUPPORTED)
+    NDBUS_SET_EXCPN(*error, DBUS_ERROR_FAILED, NDBUS_ERROR_UNSUPPORTED);
+  if (status == OUT_OF_MEMORY)
+    NDBUS_SET_EXCPN(*error, DBUS_ERROR_NO_MEMORY, NDBUS_ERROR_OOM);
+}
+
+/**
+ * Appends args to *msg, which has no arguments yet. With codec, the
+ * whole body is encoded at once and *msg is replaced by a message with
+ * the same header and that body, unless the codec cannot encode args,
+ * as with unix fds, when the iterators are used after all.
+ */
+static gboolean
+NDbusEncodeSignatureArgs (DBusMessage **msg,
+    NDbusSignature *signature, Local<Array> args,
+    Local<Object> *error, NDbusVariantPolicy variantPolicy,
+    gboolean codec) {
+  Isolate* isolate = Isolate::GetCurrent();
+
+  guint len = args->Length();
+  if (len > signature->arg_signatures->len) {
+    NDBUS_SET_EXCPN(*error, DBUS_ERROR_FAILED, NDBUS_ERROR_MISMATCH);
+    return FALSE;
+  }
+
+  if (codec && len > 0) {
+    if (!signature->program)
+      signature->program = NDbusCodecProgramNew(signature->signature);
+    if (signature->program) {
+      DBusMessage *encoded = NULL;
+      gint status = NDbusCodecNewMessage(*msg, signature->program,
+          args, variantPolicy, &encoded);
+      if (status == SUCCESS) {
+        dbus_message_unref(*msg);
+        *msg = encoded;
+        return TRUE;
+      } else if (status != TYPE_NOT_SUPPORTED) {
+        NDbusSetAppendError(status, error);
+        return FALSE;
+      }
+    }
+  }
+
+  DBusMessageIter iter;
+  dbus_message_iter_init_append(*msg, &iter);
+
+  for (guint i = 0; i < len; i++) {
+    gint status = NDbusMessageAppendArgsReal(&iter,
+        (const gchar *)g_ptr_array_index(signature->arg_signatures, i),
+        args->Get(i), variantPolicy);
+    if (status < SUCCESS) {
+      NDbusSetAppendError(status, error);
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+gboolean
+NDbusMessageAppendSignatureArgs (DBusMessage **msg,
+    NDbusSignature *signature, Local<Array> args,
+    Local<Object> *error, NDbusVariantPolicy variantPolicy,
+    gboolean codec) {
+  NDBUS_PROBE(encode__start, *msg);
+  guint64 started = NDbusMetricsNow();
+  gboolean appended = NDbusEncodeSignatureArgs(msg, signature,
+      args, error, variantPolicy, codec);
+  NDbusCountEncode(started);
+  NDBUS_PROBE(encode__done, *msg);
+  return appended;
+}
+
 gboolean
-NDbusMessageAppendArgs (DBusMessage *msg,
+NDbusMessageAppendArgs (DBusMessage **msg,
     Local<Object> obj, Local<Object> *error, NDbusVariantPolicy variantPolicy) {
   Isolate* isolate = Isolate::GetCurrent();
 
@@ -665,45 +1208,201 @@ NDbusMessageAppendArgs (DBusMessage *msg,
 
   if (signature &&
       NDbusIsValidV8Array(args)) {
-
-    if (!dbus_signature_validate(signature, NULL)) {
-      g_free(signature);
+    NDbusSignature *compiled = NDbusSignatureNew(signature);
+    g_free(signature);
+    if (!compiled) {
       NDBUS_SET_EXCPN(*error, DBUS_ERROR_INVALID_SIGNATURE, NDBUS_ERROR_SIGN);
       return FALSE;
     }
 
-    DBusMessageIter iter;
-    dbus_message_iter_init_append(msg, &iter);
-    DBusSignatureIter sigiter;
-    guint i = 0;
+    gboolean codec =
+      NDbusGetProperty(obj, NDBUS_PROPERTY_CODEC)->BooleanValue();
+    gboolean appended = NDbusMessageAppendSignatureArgs(msg,
+        compiled, args, error, variantPolicy, codec);
+    NDbusSignatureFree(compiled);
+    return appended;
+  }
+  g_free(signature);
+  return TRUE;
+}
 
-    dbus_signature_iter_init(&sigiter, signature);
+/**
+ * A message carrying descriptors is silently refused by libdbus on a
+ * transport which cannot pass them, so check it before sending.
+ */
+gboolean
+NDbusCanSendMessage (DBusConnection *cnxn, DBusMessage *msg) {
+#ifdef DBUS_TYPE_UNIX_FD
+  if (dbus_message_contains_unix_fds(msg))
+    return dbus_connection_can_send_type(cnxn, DBUS_TYPE_UNIX_FD);
+#endif
+  return TRUE;
+}
 
-    while (i < args->Length()) {
-      gchar *sign = dbus_signature_iter_get_signature(&sigiter);
-      if(sign == NULL) {
-        g_free(signature);
-        NDBUS_SET_EXCPN(*error, DBUS_ERROR_NO_MEMORY, NDBUS_ERROR_OOM);
-        return FALSE;
-      }
-      gint status = NDbusMessageAppendArgsReal(&iter, sign, args->Get(i++), variantPolicy);
-      dbus_free(sign);
-      if (status < SUCCESS) {
-        g_free(signature);
-        if (status == TYPE_MISMATCH)
-          NDBUS_SET_EXCPN(*error, DBUS_ERROR_FAILED, NDBUS_ERROR_MISMATCH);
-        if (status == TYPE_NOT_SUPPORTED)
-          NDBUS_SET_EXCPN(*error, DBUS_ERROR_FAILED, NDBUS_ERROR_UNSUPPORTED);
-        if (status == OUT_OF_MEMORY)
-          NDBUS_SET_EXCPN(*error, DBUS_ERROR_NO_MEMORY, NDBUS_ERROR_OOM);
-        return FALSE;
-      }
+NDbusConnectionInfo*
+NDbusConnectionInfoNew (DBusConnection *cnxn) {
+  NDbusConnectionInfo *cnxn_info = g_new0(NDbusConnectionInfo, 1);
+  cnxn_info->cnxn = cnxn;
+  cnxn_info->signal_watchers =
+    g_hash_table_new_full(g_str_hash,
+        g_str_equal, (GDestroyNotify) g_free, NULL);
+  cnxn_info->owned_names =
+    g_hash_table_new_full(g_str_hash,
+        g_str_equal, (GDestroyNotify) g_free,
+        (GDestroyNotify) NDbusFreeNameInfo);
+  cnxn_info->name_owners =
+    g_hash_table_new_full(g_str_hash,
+        g_str_equal, (GDestroyNotify) g_free,
+        (GDestroyNotify) NDbusFreeOwnerInfo);
+  cnxn_info->owner_aliases =
+    g_hash_table_new_full(g_str_hash,
+        g_str_equal, (GDestroyNotify) g_free,
+        (GDestroyNotify) NDbusFreeOwnerAliases);
+  cnxn_info->introspections =
+    g_hash_table_new_full(g_str_hash,
+        g_str_equal, (GDestroyNotify) g_free,
+        (GDestroyNotify) NDbusFreeIntrospection);
+  cnxn_info->property_mirrors =
+    g_hash_table_new_full(g_str_hash,
+        g_str_equal, (GDestroyNotify) g_free,
+        (GDestroyNotify) g_ptr_array_unref);
+  cnxn_info->object_mirrors = g_ptr_array_new();
+  cnxn_info->high_watermark = NDBUS_DEFAULT_HIGH_WATERMARK;
+  cnxn_info->low_watermark = NDBUS_DEFAULT_LOW_WATERMARK;
+  cnxn_info->high_unix_fds = NDBUS_DEFAULT_HIGH_UNIX_FDS;
+  cnxn_info->low_unix_fds = NDBUS_DEFAULT_LOW_UNIX_FDS;
+  cnxn_info->reconnect.enabled = TRUE;
+  cnxn_info->reconnect.min_delay = NDBUS_DEFAULT_RECONNECT_MIN;
+  cnxn_info->reconnect.max_delay = NDBUS_DEFAULT_RECONNECT_MAX;
+  cnxn_info->ref_count = 1;
+  return cnxn_info;
+}
 
-      dbus_signature_iter_next(&sigiter);
-    }
-    g_free(signature);
+NDbusConnectionInfo*
+NDbusConnectionInfoRef (NDbusConnectionInfo *cnxn_info) {
+  if (cnxn_info)
+    cnxn_info->ref_count++;
+  return cnxn_info;
+}
+
+void
+NDbusConnectionInfoUnref (NDbusConnectionInfo *cnxn_info) {
+  if (cnxn_info == NULL || --cnxn_info->ref_count > 0)
+    return;
+  g_hash_table_unref(cnxn_info->signal_watchers);
+  g_hash_table_unref(cnxn_info->owned_names);
+  g_hash_table_unref(cnxn_info->name_owners);
+  g_hash_table_unref(cnxn_info->owner_aliases);
+  g_hash_table_unref(cnxn_info->introspections);
+  g_hash_table_unref(cnxn_info->property_mirrors);
+  g_ptr_array_unref(cnxn_info->object_mirrors);
+  NDbusFreeMetrics(&cnxn_info->metrics);
+  g_free(cnxn_info->peer_address);
+  g_free(cnxn_info->bus_address);
+  g_free(cnxn_info);
+}
+
+void
+NDbusConnectionInfoClose (NDbusConnectionInfo *cnxn_info) {
+  if (cnxn_info == NULL)
+    return;
+
+  if (cnxn_info->cnxn) {
+    dbus_connection_remove_filter(cnxn_info->cnxn,
+        NDbusMessageFilter, (void *)cnxn_info);
+    //peer connections are private and ours to close
+    if (cnxn_info->peer)
+      dbus_connection_close(cnxn_info->cnxn);
+    dbus_connection_unref(cnxn_info->cnxn);
+    cnxn_info->cnxn = NULL;
   }
-  return TRUE;
+  cnxn_info->closed = TRUE;
+  NDbusStopReconnect(cnxn_info);
+
+  g_hash_table_foreach_remove(cnxn_info->signal_watchers,
+      (GHRFunc)NDbusRemoveAllSignalListeners, NULL);
+  g_hash_table_remove_all(cnxn_info->owned_names);
+  g_hash_table_remove_all(cnxn_info->name_owners);
+  g_hash_table_remove_all(cnxn_info->owner_aliases);
+  g_hash_table_remove_all(cnxn_info->introspections);
+  //the mirrors themselves stay readable until released
+  g_hash_table_remove_all(cnxn_info->property_mirrors);
+  g_ptr_array_set_size(cnxn_info->object_mirrors, 0);
+  //nothing will drain anymore
+  g_slist_foreach(cnxn_info->blocked, NDbusFreeObjectInfo, NULL);
+  g_slist_free(cnxn_info->blocked);
+  cnxn_info->blocked = NULL;
+  NDbusConnectionInfoUnref(cnxn_info);
+}
+
+static glong
+NDbusOutgoingUnixFds (DBusConnection *cnxn) {
+#ifdef DBUS_TYPE_UNIX_FD
+  return dbus_connection_get_outgoing_unix_fds(cnxn);
+#else
+  return 0;
+#endif
+}
+
+/**
+ * Tells whether obj may keep on sending, like the return value of
+ * write() on a node stream. If not, obj is remembered to be told
+ * once the outgoing queue drains.
+ */
+gboolean
+NDbusCheckWritable (NDbusConnectionInfo *cnxn_info, Local<Object> obj) {
+  if (cnxn_info->cnxn == NULL)
+    return FALSE;
+  if (dbus_connection_get_outgoing_size(cnxn_info->cnxn) <
+        cnxn_info->high_watermark &&
+      NDbusOutgoingUnixFds(cnxn_info->cnxn) < cnxn_info->high_unix_fds)
+    return TRUE;
+
+  if (!NDbusIsMatchAdded(cnxn_info->blocked, obj)) {
+    NDbusObjectInfo *info = g_new0(NDbusObjectInfo, 1);
+    info->object.Reset(Isolate::GetCurrent(), obj);
+    cnxn_info->blocked = g_slist_prepend(cnxn_info->blocked, info);
+  }
+  return FALSE;
+}
+
+void
+NDbusCheckDrain (NDbusConnectionInfo *cnxn_info) {
+  if (cnxn_info->blocked == NULL || cnxn_info->cnxn == NULL)
+    return;
+  if (dbus_connection_get_outgoing_size(cnxn_info->cnxn) >
+        cnxn_info->low_watermark ||
+      NDbusOutgoingUnixFds(cnxn_info->cnxn) > cnxn_info->low_unix_fds)
+    return;
+
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  //'drain' handlers may send and block again
+  GSList *blocked = g_slist_reverse(cnxn_info->blocked);
+  cnxn_info->blocked = NULL;
+
+  Local<Array> object_list = Array::New(isolate);
+  gint i = 0;
+  for (GSList *tmp = blocked; tmp != NULL; tmp = g_slist_next(tmp)) {
+    NDbusObjectInfo *info = (NDbusObjectInfo *)tmp->data;
+    object_list->Set(i++, Local<Object>::New(isolate, info->object));
+  }
+  g_slist_foreach(blocked, NDbusFreeObjectInfo, NULL);
+  g_slist_free(blocked);
+
+  Handle<Object> local_global_target = Local<Object>::New(isolate, global_target);
+  Local<Function> func = Local<Function>::Cast(local_global_target->Get(NDBUS_CB_DRAIN));
+  const gint argc = 1;
+  Local<Value> argv[argc];
+  argv[0] = object_list;
+
+  if (NDbusIsValidV8Value(func) &&
+      func->IsFunction())
+    func->Call(local_global_target, argc, argv);
+  else
+    g_critical("\nSomeone has messed with the internal  \
+        drain handler of dbus.js. 'drain' wont be triggered.");
 }
 
 void
@@ -714,6 +1413,7 @@ NDbusFreeObjectInfo (gpointer data, gpointer user_data) {
     v8::Local<v8::Object> object = v8::Local<v8::Object>::New(Isolate::GetCurrent(), info->object);
     if (NDbusIsValidV8Value(object))
       info->object.Reset();
+    g_free(info->match);
     g_free(info);
   }
 }
@@ -723,6 +1423,7 @@ NDbusMessageFilter (DBusConnection *cnxn,
     DBusMessage * message, void *user_data) {
   Isolate* isolate = Isolate::GetCurrent();
 
+  NDbusCountMessage((NDbusConnectionInfo *)user_data, message, TRUE);
   if (dbus_message_get_type (message)
       != DBUS_MESSAGE_TYPE_SIGNAL)
     return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
@@ -735,14 +1436,23 @@ NDbusMessageFilter (DBusConnection *cnxn,
       dbus_message_get_path(message));
 #endif
 
-  GHashTable *signal_watchers = (GHashTable *)user_data;
+  NDbusConnectionInfo *cnxn_info = (NDbusConnectionInfo *)user_data;
+  GHashTable *signal_watchers = cnxn_info->signal_watchers;
 
   if (dbus_message_is_signal(message,
         DBUS_INTERFACE_LOCAL, "Disconnected")) {
-    if (signal_watchers)
-      g_hash_table_foreach_remove(signal_watchers,
-          (GHRFunc)NDbusRemoveAllSignalListeners, NULL);
+    //a peer can not be reached again by the same connection,
+    //so forget it and let the next send open a new one
+    if (cnxn_info->peer)
+      NDbusPeerDisconnected(cnxn_info);
+    else
+      NDbusBusDisconnected(cnxn_info);
   } else {
+    NDbusHandleNameOwnership(cnxn_info, message);
+    NDbusHandleNameOwnerChanged(cnxn_info, message);
+    NDbusHandlePropertiesChanged(cnxn_info, message);
+    NDbusHandleObjectManagerSignal(cnxn_info, message);
+
     const gchar *member = dbus_message_get_member(message);
     const gchar *interface = dbus_message_get_interface(message);
     const gchar *sender = dbus_message_get_sender(message);
@@ -754,8 +1464,9 @@ NDbusMessageFilter (DBusConnection *cnxn,
       gchar *key = g_strconcat(interface,
           "-", member, NULL);
       Local<Array> object_list = Array::New(isolate);
+      GArray *listener_flags = g_array_new(FALSE, FALSE, sizeof(guint));
 
-      NDbusRetrieveSignalListners(signal_watchers, key, &object_list);
+      NDbusRetrieveSignalListners(signal_watchers, key, &object_list, listener_flags);
 
       gchar *tmpKey = NULL;
       
@@ -763,23 +1474,41 @@ NDbusMessageFilter (DBusConnection *cnxn,
         tmpKey = key;
         key = g_strconcat(tmpKey, "-", object_path, NULL);
         g_free(tmpKey);
-        NDbusRetrieveSignalListners(signal_watchers, key, &object_list);
+        NDbusRetrieveSignalListners(signal_watchers, key, &object_list, listener_flags);
       }
       if (sender) {
+        //listeners may have asked for a well-known name
+        //which the unique sender is known to own
+        GSList *aliases = NDbusGetOwnerAliases(cnxn_info, sender);
+        while (aliases != NULL) {
+          gchar *alias_key = g_strconcat(key, "-",
+              (gchar *)aliases->data, NULL);
+          NDbusRetrieveSignalListners(signal_watchers, alias_key, &object_list, listener_flags);
+          if (destination) {
+            tmpKey = alias_key;
+            alias_key = g_strconcat(tmpKey, "-", destination, NULL);
+            g_free(tmpKey);
+            NDbusRetrieveSignalListners(signal_watchers, alias_key, &object_list, listener_flags);
+          }
+          g_free(alias_key);
+          aliases = g_slist_next(aliases);
+        }
+
         tmpKey = key;
         key = g_strconcat(tmpKey, "-", sender, NULL);
         g_free(tmpKey);
-        NDbusRetrieveSignalListners(signal_watchers, key, &object_list);
+        NDbusRetrieveSignalListners(signal_watchers, key, &object_list, listener_flags);
       }
       if (destination) {
         tmpKey = key;
         key = g_strconcat(tmpKey, "-", destination, NULL);
         g_free(tmpKey);
-        NDbusRetrieveSignalListners(signal_watchers, key, &object_list);
+        NDbusRetrieveSignalListners(signal_watchers, key, &object_list, listener_flags);
       }
       g_free(key);
 
       if (NDbusIsValidV8Array(object_list)) {
+        NDBUS_PROBE(route, message);
         Local<Object> signal = Object::New(isolate);
         signal->Set(String::NewFromUtf8(isolate, NDBUS_PROPERTY_INTERFACE), String::NewFromUtf8(isolate, interface));
         signal->Set(String::NewFromUtf8(isolate, NDBUS_PROPERTY_MEMBER), String::NewFromUtf8(isolate, member));
@@ -802,28 +1531,91 @@ NDbusMessageFilter (DBusConnection *cnxn,
             signal->ForceSet(String::NewFromUtf8(isolate, NDBUS_PROPERTY_DEST), Null(isolate));
         }
 
-        Local<Value> args = NDbusRetrieveMessageArgs(message);
-        const gint argc = 3;
-        Local<Value> argv[argc];
-        argv[0] = object_list;
-        argv[1] = signal;
-        argv[2] = args;
+        //listeners asking for the same decoding share the arguments,
+        //all groups are made before any listener may remove a match
+        Local<Array> groups = Array::New(isolate);
+        GArray *group_flags = g_array_new(FALSE, FALSE, sizeof(guint));
+        guint len = listener_flags->len;
+        gboolean *grouped = g_new0(gboolean, len);
+        for (guint i = 0; i < len; i++) {
+          if (grouped[i])
+            continue;
+          guint flags = g_array_index(listener_flags, guint, i);
+          Local<Array> group = Array::New(isolate);
+          gint n = 0;
+          for (guint j = i; j < len; j++) {
+            if (!grouped[j] &&
+                g_array_index(listener_flags, guint, j) == flags) {
+              group->Set(n++, object_list->Get(j));
+              grouped[j] = TRUE;
+            }
+          }
+          groups->Set(group_flags->len, group);
+          g_array_append_val(group_flags, flags);
+        }
+        g_free(grouped);
 
         Handle<Object> local_global_target = Local<Object>::New(isolate, global_target);
         Local<Function> func = Local<Function>::Cast(local_global_target->Get(NDBUS_CB_SIGNALRECEIPT));
 
-        if (NDbusIsValidV8Value(func) &&
-            func->IsFunction())
-          func->Call(func, argc, argv);
-        else
-          g_critical("\nSomeone has messed with the internal  \
-              signal receipt handler of dbus.js. 'signalReceipt' wont be triggered.");
+        for (guint i = 0; i < group_flags->len; i++) {
+          const gint argc = 3;
+          Local<Value> argv[argc];
+          argv[0] = groups->Get(i);
+          argv[1] = signal;
+          argv[2] = NDbusRetrieveMessageArgs(message,
+              g_array_index(group_flags, guint, i));
+
+          NDBUS_PROBE(callback__start, message);
+          if (NDbusIsValidV8Value(func) &&
+              func->IsFunction())
+            func->Call(func, argc, argv);
+          else
+            g_critical("\nSomeone has messed with the internal  \
+                signal receipt handler of dbus.js. 'signalReceipt' wont be triggered.");
+          NDBUS_PROBE(callback__done, message);
+        }
+        g_array_free(group_flags, TRUE);
       }
+      g_array_free(listener_flags, TRUE);
     }
   }
   return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 }
 
+/**
+ * Sets either args to the output arguments of a method reply
+ * or error to what went wrong, leaving the other undefined.
+ */
+void
+NDbusRetrieveReplyArgs (DBusMessage *reply, guint decode_flags,
+    Local<Value> *args, Local<Value> *error) {
+  Isolate* isolate = Isolate::GetCurrent();
+
+  *args = Undefined(isolate);
+  *error = Undefined(isolate);
+  if(!reply) {
+    NDBUS_SET_EXCPN(*error, DBUS_ERROR_NO_REPLY, NDBUS_ERROR_NOREPLY);
+  } else if (async_message_error(reply)){
+    DBusError err;
+    dbus_error_init(&err);
+    dbus_set_error_from_message(&err, reply);
+    NDBUS_SET_EXCPN(*error, err.name, err.message);
+    dbus_error_free(&err);
+  } else if (dbus_message_get_type(reply) ==
+      DBUS_MESSAGE_TYPE_METHOD_RETURN) {
+    *args = NDbusRetrieveMessageArgs(reply, decode_flags);
+  } else {
+    NDBUS_SET_EXCPN(*error, DBUS_ERROR_FAILED, NDBUS_ERROR_REPLY);
+  }
+}
+
+guint
+NDbusGetDecodeFlags (const Local<Object> obj) {
+  Local<Value> flags = NDbusGetProperty(obj, NDBUS_PROPERTY_DECODE_FLAGS);
+  return flags->IsUint32() ? flags->Uint32Value() : (guint)NDBUS_DECODE_DEFAULT;
+}
+
 void
 NDbusHandleMethodReply (DBusPendingCall *pending,
     void *user_data) {
@@ -848,36 +1640,18 @@ NDbusHandleMethodReply (DBusPendingCall *pending,
     Local<Value> argv[2];
 
     reply = dbus_pending_call_steal_reply(pending);
+    NDbusTimeReply(pending, reply);
+    NDbusRetrieveReplyArgs(reply, info->decode_flags, &argv[0], &argv[1]);
 
-    if(!reply) {
-      argv[0] = Undefined(isolate);
-      NDBUS_SET_EXCPN(argv[1], DBUS_ERROR_NO_REPLY, NDBUS_ERROR_NOREPLY);
-    } else if (async_message_error(reply)){
-      DBusError err;
-      dbus_error_init(&err);
-      dbus_set_error_from_message(&err, reply);
-      argv[0] = Undefined(isolate);
-      NDBUS_SET_EXCPN(argv[1], err.name, err.message);
-      dbus_error_free(&err);
-    } else if (dbus_message_get_type(reply) ==
-        DBUS_MESSAGE_TYPE_METHOD_RETURN) {
-      Local<Value> args = NDbusRetrieveMessageArgs(reply);
-      argv[0] = args;
-      argv[1] = Undefined(isolate);
-    } else {
-      argv[0] = Undefined(isolate);
-      NDBUS_SET_EXCPN(argv[1], DBUS_ERROR_FAILED, NDBUS_ERROR_REPLY);
-    }
-
+    NDBUS_PROBE(callback__start, reply);
     if (NDbusIsValidV8Value(func) &&
         func->IsFunction())
       func->Call(object, argc, argv);
     else
       g_critical("\nSomeone has messed with the internal  \
           method response handler of dbus.js. 'methodResponse' wont be triggered.");
+    NDBUS_PROBE(callback__done, reply);
 
-    info->object.Reset();
-    g_free(info);
     if (reply)
       dbus_message_unref(reply);
   }
@@ -885,4 +1659,14 @@ NDbusHandleMethodReply (DBusPendingCall *pending,
   dbus_pending_call_unref(pending);
 }
 
+//EXPOSED
+/**
+ * Frees the NDbusObjectInfo of a method-call once its pending call
+ * is gone, whether it got a reply or was cancelled.
+ */
+void
+NDbusFreeMethodInfo (void *data) {
+  NDbusFreeObjectInfo(data, NULL);
+}
+
 } //namespace ndbus
@@ -12,10 +12,10 @@
 
 namespace ndbus {
 
-static GHashTable *system_signal_watchers;
-static GHashTable *session_signal_watchers;
-static DBusConnection *system_bus;
-static DBusConnection *session_bus;
+static NDbusConnectionInfo *system_bus;
+static NDbusConnectionInfo *session_bus;
+static GHashTable *peer_connections;
+static GHashTable *peer_servers;
 Persistent<Object> global_target;
 
 #define NDBUS_DEFINE_STRING_CONSTANT(target, constant)          \
@@ -23,6 +23,236 @@ Persistent<Object> global_target;
                 v8::String::NewFromUtf8(isolate, constant),                                                 \
                 static_cast<v8::PropertyAttribute>(v8::ReadOnly|v8::DontDelete))
 
+//EXPOSED
+/**
+ * The connection of cnxn_type at address. There is one bus connection
+ * of each type, which is not the one asked for if it is at another
+ * address, NULL being the bus's own.
+ */
+NDbusConnectionInfo*
+NDbusLookupConnection (gint cnxn_type, const gchar *address) {
+  if (cnxn_type == NDBUS_BUS_PEER)
+    return address ? (NDbusConnectionInfo *)
+      g_hash_table_lookup(peer_connections, address) : NULL;
+  NDbusConnectionInfo *cnxn_info =
+    (cnxn_type == DBUS_BUS_SESSION)?session_bus:system_bus;
+  if (cnxn_info && g_strcmp0(cnxn_info->bus_address, address) != 0)
+    return NULL;
+  return cnxn_info;
+}
+
+//EXPOSED
+NDbusConnectionInfo*
+NDbusGetConnection (const Local<Object> obj) {
+  gint cnxn_type =
+    NDbusGetProperty(obj, NDBUS_PROPERTY_BUS)->IntegerValue();
+  gchar *address =
+    NDbusV8StringToCStr(NDbusGetProperty(obj,
+          NDBUS_PROPERTY_ADDRESS));
+  NDbusConnectionInfo *cnxn_info =
+    NDbusLookupConnection(cnxn_type, address);
+  g_free(address);
+  return cnxn_info;
+}
+
+static NDbusConnectionInfo*
+NDbusSetupPeerConnection (const gchar *address,
+    DBusConnection *cnxn) {
+  dbus_connection_set_exit_on_disconnect(cnxn, FALSE);
+
+  NDbusConnectionInfo *cnxn_info = NDbusConnectionInfoNew(cnxn);
+  if (!NDbusConnectionSetupWithEvLoop(cnxn_info)) {
+    NDbusConnectionInfoUnref(cnxn_info);
+    return NULL;
+  }
+
+  cnxn_info->peer = TRUE;
+  cnxn_info->peer_address = g_strdup(address);
+  dbus_connection_add_filter(cnxn, NDbusMessageFilter, (void *)cnxn_info, NULL);
+  g_hash_table_insert(peer_connections, g_strdup(address), cnxn_info);
+  return cnxn_info;
+}
+
+//EXPOSED
+void
+NDbusPeerDisconnected (NDbusConnectionInfo *cnxn_info) {
+  if (g_hash_table_lookup(peer_connections,
+        cnxn_info->peer_address) == cnxn_info)
+    g_hash_table_remove(peer_connections, cnxn_info->peer_address);
+  NDbusConnectionInfoClose(cnxn_info);
+}
+
+static NDbusConnectionInfo*
+NDbusNewBusConnection (gint cnxn_type, gchar *address) {
+  NDbusConnectionInfo *cnxn_info = NDbusConnectionInfoNew(NULL);
+  cnxn_info->bus_type = cnxn_type;
+  cnxn_info->bus_address = address;
+  if (cnxn_type == DBUS_BUS_SESSION)
+    session_bus = cnxn_info;
+  else
+    system_bus = cnxn_info;
+  return cnxn_info;
+}
+
+/**
+ * Closes a bus connection for good, so that the next init or connect
+ * opens a new one.
+ */
+static void
+NDbusForgetBus (NDbusConnectionInfo *cnxn_info) {
+  if (cnxn_info == session_bus)
+    session_bus = NULL;
+  else if (cnxn_info == system_bus)
+    system_bus = NULL;
+  NDbusConnectionInfoClose(cnxn_info);
+}
+
+//EXPOSED
+/**
+ * Either reconnects to the bus which went away later on, or forgets it.
+ */
+void
+NDbusBusDisconnected (NDbusConnectionInfo *cnxn_info) {
+  if (!NDbusScheduleReconnect(cnxn_info))
+    NDbusForgetBus(cnxn_info);
+}
+
+//EXPOSED
+/**
+ * Connects to the bus of cnxn_type, or the one at address, and says
+ * Hello. Returns NULL with error set if it is not there.
+ */
+DBusConnection*
+NDbusOpenBus (gint cnxn_type, const gchar *address, DBusError *error) {
+  if (address == NULL)
+    return dbus_bus_get(DBusBusType(cnxn_type), error);
+
+  DBusConnection *bus_cnxn = dbus_connection_open(address, error);
+  if (bus_cnxn && !dbus_bus_register(bus_cnxn, error)) {
+    dbus_connection_unref(bus_cnxn);
+    bus_cnxn = NULL;
+  }
+  return bus_cnxn;
+}
+
+/**
+ * The bus to open on the threadpool, and what came of it.
+ */
+typedef struct {
+  uv_work_t req;
+  NDbusConnectionInfo *cnxn_info;
+  gint cnxn_type;
+  gchar *address;
+  DBusConnection *cnxn;
+  DBusError error;
+  NDbusOpenBusNotify notify;
+  gpointer user_data;
+} NDbusOpenRequest;
+
+static void
+NDbusOpenBusWork (uv_work_t *req) {
+  NDbusOpenRequest *open_req = (NDbusOpenRequest *)req->data;
+  open_req->cnxn = NDbusOpenBus(open_req->cnxn_type,
+      open_req->address, &open_req->error);
+}
+
+static void
+NDbusOpenBusDone (uv_work_t *req, gint status) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  NDbusOpenRequest *open_req = (NDbusOpenRequest *)req->data;
+  NDbusConnectionInfo *cnxn_info = open_req->cnxn_info;
+
+  //closed while the handshake was going on
+  if (cnxn_info->closed && open_req->cnxn) {
+    dbus_connection_unref(open_req->cnxn);
+    open_req->cnxn = NULL;
+  }
+  if (open_req->cnxn == NULL && !dbus_error_is_set(&open_req->error))
+    dbus_set_error_const(&open_req->error,
+        DBUS_ERROR_DISCONNECTED, "Connection got disconnected");
+
+  open_req->notify(cnxn_info, open_req->cnxn,
+      &open_req->error, open_req->user_data);
+  dbus_error_free(&open_req->error);
+  NDbusConnectionInfoUnref(cnxn_info);
+  g_free(open_req->address);
+  g_free(open_req);
+}
+
+//EXPOSED
+/**
+ * Connects to the bus of cnxn_info on the threadpool, where the socket
+ * connect, the authentication and Hello may block as long as they like,
+ * and hands the result to notify back on the loop.
+ */
+void
+NDbusOpenBusAsync (NDbusConnectionInfo *cnxn_info,
+    NDbusOpenBusNotify notify, gpointer user_data) {
+  NDbusOpenRequest *open_req = g_new0(NDbusOpenRequest, 1);
+  open_req->req.data = open_req;
+  open_req->cnxn_info = NDbusConnectionInfoRef(cnxn_info);
+  open_req->cnxn_type = cnxn_info->bus_type;
+  open_req->address = g_strdup(cnxn_info->bus_address);
+  open_req->notify = notify;
+  open_req->user_data = user_data;
+  dbus_error_init(&open_req->error);
+  uv_queue_work(uv_default_loop(), &open_req->req,
+      NDbusOpenBusWork, NDbusOpenBusDone);
+}
+
+//EXPOSED
+gboolean
+NDbusAttachBusConnection (NDbusConnectionInfo *cnxn_info,
+    DBusConnection *bus_cnxn) {
+  cnxn_info->cnxn = bus_cnxn;
+  dbus_connection_set_exit_on_disconnect(bus_cnxn, FALSE);
+
+  if (!NDbusConnectionSetupWithEvLoop(cnxn_info))
+    return FALSE;
+
+  dbus_connection_add_filter(bus_cnxn, NDbusMessageFilter, (void *)cnxn_info, NULL);
+  return TRUE;
+}
+
+static void
+NDbusHandleNewPeer (DBusServer *server,
+    DBusConnection *cnxn, void *data) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  NDbusServerInfo *server_info = (NDbusServerInfo *)data;
+  gchar *peer_address = g_strdup_printf("%s#%u",
+      server_info->address, ++server_info->peers);
+
+  //the connection is closed by libdbus unless we hold on to it
+  dbus_connection_ref(cnxn);
+  if (!NDbusSetupPeerConnection(peer_address, cnxn)) {
+    dbus_connection_close(cnxn);
+    dbus_connection_unref(cnxn);
+    g_free(peer_address);
+    return;
+  }
+
+  Local<Object> object =
+    Local<Object>::New(isolate, server_info->object);
+  Handle<Object> local_global_target = Local<Object>::New(isolate, global_target);
+  Local<Function> func = Local<Function>::Cast(local_global_target->Get(NDBUS_CB_PEERCONNECTION));
+  const gint argc = 1;
+  Local<Value> argv[argc];
+  argv[0] = v8::String::NewFromUtf8(isolate, peer_address);
+
+  if (NDbusIsValidV8Value(object) &&
+      NDbusIsValidV8Value(func) &&
+      func->IsFunction())
+    func->Call(object, argc, argv);
+  else
+    g_critical("\nSomeone has messed with the internal  \
+        peer connection handler of dbus.js. 'connection' wont be triggered.");
+  g_free(peer_address);
+}
+
 void NDbusRemoveMatch (const FunctionCallbackInfo<Value>& args) {
   Isolate* isolate = Isolate::GetCurrent();
   HandleScope scope(isolate);
@@ -33,16 +263,11 @@ void NDbusRemoveMatch (const FunctionCallbackInfo<Value>& args) {
   if (message_type != DBUS_MESSAGE_TYPE_SIGNAL)
     NDBUS_EXCPN_TYPE;
 
-  gint cnxn_type =
-    NDbusGetProperty(args.This(),
-        NDBUS_PROPERTY_BUS)->IntegerValue();
-  gboolean sess_bus = (cnxn_type == DBUS_BUS_SESSION);
-  DBusConnection *bus_cnxn =
-    sess_bus?session_bus:system_bus;
-  GHashTable *signal_watchers =
-    sess_bus?session_signal_watchers:system_signal_watchers;
-  if (!bus_cnxn || !signal_watchers)
+  NDbusConnectionInfo *cnxn_info = NDbusGetConnection(args.This());
+  if (!cnxn_info)
     NDBUS_EXCPN_NOMATCH;
+  DBusConnection *bus_cnxn = cnxn_info->cnxn;
+  GHashTable *signal_watchers = cnxn_info->signal_watchers;
 
   gchar *interface =
     NDbusV8StringToCStr(NDbusGetProperty(args.This(),
@@ -96,8 +321,11 @@ void NDbusRemoveMatch (const FunctionCallbackInfo<Value>& args) {
           g_hash_table_insert(signal_watchers, g_strdup(key), object_list);
         }
         removed = TRUE;
-        dbus_bus_remove_match(bus_cnxn, match_str, NULL);
-        dbus_connection_flush(bus_cnxn);
+        //while the bus is away, the match just is not added again
+        if (!cnxn_info->peer && bus_cnxn) {
+          dbus_bus_remove_match(bus_cnxn, match_str, NULL);
+          dbus_connection_flush(bus_cnxn);
+        }
         break;
       }
       tmp = g_slist_next(tmp);
@@ -145,14 +373,14 @@ void NDbusAddMatch (const FunctionCallbackInfo<Value>& args) {
     NDbusV8StringToCStr(NDbusGetProperty(args.This(),
           NDBUS_PROPERTY_SENDER));
 
-  gint cnxn_type =
-    NDbusGetProperty(args.This(),
-        NDBUS_PROPERTY_BUS)->IntegerValue();
-  gboolean sess_bus = (cnxn_type == DBUS_BUS_SESSION);
-  DBusConnection *bus_cnxn =
-    sess_bus?session_bus:system_bus;
-  GHashTable *signal_watchers =
-    sess_bus?session_signal_watchers:system_signal_watchers;
+  NDbusConnectionInfo *cnxn_info = NDbusGetConnection(args.This());
+  if (!cnxn_info) {
+    NDbusFree(destination, interface, object_path, signal_name);
+    g_free(sender);
+    NDBUS_EXCPN_DISCONNECTED;
+  }
+  DBusConnection *bus_cnxn = cnxn_info->cnxn;
+  GHashTable *signal_watchers = cnxn_info->signal_watchers;
 
   gchar *match_str = NDbusConstructMatchString(interface,
       signal_name, object_path, sender, destination);
@@ -165,20 +393,39 @@ void NDbusAddMatch (const FunctionCallbackInfo<Value>& args) {
   if (NDbusIsMatchAdded(object_list, args.This())) {
     g_free(match_str);
     g_free(key);
+    g_free(sender);
     args.GetReturnValue().Set(TRUE);
+    return;
   }
 
   NDbusObjectInfo *listener = g_new0(NDbusObjectInfo, 1);
   listener->object.Reset(isolate, args.This());
+  listener->decode_flags = NDbusGetDecodeFlags(args.This());
   object_list = g_slist_prepend(object_list, (void *) listener);
 
   g_hash_table_insert(signal_watchers, g_strdup(key), object_list);
 
-  dbus_bus_add_match(bus_cnxn, match_str, NULL);
-  dbus_connection_flush(bus_cnxn);
+  //a peer sends its signals straight to us
+  if (!cnxn_info->peer) {
+    //kept to be added again after a reconnect, which also adds it
+    //for the first time if the bus is away right now
+    listener->match = match_str;
+    match_str = NULL;
+    if (bus_cnxn)
+      dbus_bus_add_match(bus_cnxn, listener->match, NULL);
+
+    //signals carry the unique name of the sender, so the owner of a
+    //well-known sender has to be known to route them to this listener
+    if (sender && sender[0] != ':' &&
+        !g_str_equal(sender, DBUS_SERVICE_DBUS))
+      NDbusWatchNameOwner(cnxn_info, sender);
+    if (bus_cnxn)
+      dbus_connection_flush(bus_cnxn);
+  }
 
   g_free(match_str);
   g_free(key);
+  g_free(sender);
   args.GetReturnValue().Set(TRUE);
 }
 
@@ -218,11 +465,12 @@ void NDbusSendSignal (const FunctionCallbackInfo<Value>& args) {
     NDBUS_EXCPN_MEMBER;
   }
 
-  gint cnxn_type =
-    NDbusGetProperty(args.This(),
-        NDBUS_PROPERTY_BUS)->IntegerValue();
-  DBusConnection *bus_cnxn =
-    (cnxn_type == DBUS_BUS_SESSION)?session_bus:system_bus;
+  NDbusConnectionInfo *cnxn_info = NDbusGetConnection(args.This());
+  if (!cnxn_info || !cnxn_info->cnxn) {
+    NDbusFree(NULL, interface, object_path, signal_name);
+    NDBUS_EXCPN_DISCONNECTED;
+  }
+  DBusConnection *bus_cnxn = cnxn_info->cnxn;
   DBusMessage *msg =
     dbus_message_new_signal(object_path,
         interface, signal_name);
@@ -231,22 +479,29 @@ void NDbusSendSignal (const FunctionCallbackInfo<Value>& args) {
 
   if (NULL == msg)
     NDBUS_EXCPN_OOM;
+  NDBUS_PROBE(message__create, msg);
 
   Local<Object> append_error;
-  if (!NDbusMessageAppendArgs (msg, args.This(), &append_error, variantPolicy)) {
+  if (!NDbusMessageAppendArgs (&msg, args.This(), &append_error, variantPolicy)) {
     dbus_message_unref(msg);
     isolate->ThrowException(append_error);
     return;
   }
 
+  if (!NDbusCanSendMessage(bus_cnxn, msg)) {
+    dbus_message_unref(msg);
+    NDBUS_EXCPN_UNIXFD;
+  }
+
+  //queued and written as the socket allows, see NDbusCheckWritable
   if (!dbus_connection_send(bus_cnxn, msg, NULL)) {
     dbus_message_unref(msg);
     NDBUS_EXCPN_OOM;
   }
-  dbus_connection_flush(bus_cnxn);
+  NDbusCountMessage(cnxn_info, msg, FALSE);
   dbus_message_unref(msg);
 
-  args.GetReturnValue().Set(TRUE);
+  args.GetReturnValue().Set(NDbusCheckWritable(cnxn_info, args.This()) == TRUE);
 }
 
 void NDbusInvokeMethod (const FunctionCallbackInfo<Value>& args) {
@@ -263,10 +518,16 @@ void NDbusInvokeMethod (const FunctionCallbackInfo<Value>& args) {
       && message_type != DBUS_MESSAGE_TYPE_METHOD_RETURN)
     NDBUS_EXCPN_TYPE;
 
+  NDbusConnectionInfo *cnxn_info = NDbusGetConnection(args.This());
+  if (!cnxn_info || !cnxn_info->cnxn)
+    NDBUS_EXCPN_DISCONNECTED;
+  DBusConnection *bus_cnxn = cnxn_info->cnxn;
+
+  //there is nobody to route a message to a peer by its name
   gchar *service =
     NDbusV8StringToCStr(NDbusGetProperty(args.This(),
           NDBUS_PROPERTY_DEST));
-  if(!service)
+  if(!service && !cnxn_info->peer)
     NDBUS_EXCPN_DEST;
 
   gchar *object_path =
@@ -290,12 +551,6 @@ void NDbusInvokeMethod (const FunctionCallbackInfo<Value>& args) {
     NDbusV8StringToCStr(NDbusGetProperty(args.This(),
           NDBUS_PROPERTY_INTERFACE));
 
-  gint cnxn_type =
-    NDbusGetProperty(args.This(),
-        NDBUS_PROPERTY_BUS)->IntegerValue();
-  DBusConnection *bus_cnxn =
-    (cnxn_type == DBUS_BUS_SESSION)?session_bus:system_bus;
-
   gint timeout = NDbusGetProperty(args.This(),
       NDBUS_PROPERTY_TIMEOUT)->IntegerValue();
 
@@ -307,22 +562,36 @@ void NDbusInvokeMethod (const FunctionCallbackInfo<Value>& args) {
 
   if (NULL == msg)
     NDBUS_EXCPN_OOM;
+  NDBUS_PROBE(message__create, msg);
 
   Local<Object> append_error;
-  if (!NDbusMessageAppendArgs (msg, args.This(), &append_error, variantPolicy)) {
+  if (!NDbusMessageAppendArgs (&msg, args.This(), &append_error, variantPolicy)) {
     dbus_message_unref(msg);
     isolate->ThrowException(append_error);
     return;
   }
 
+  if (!NDbusCanSendMessage(bus_cnxn, msg)) {
+    dbus_message_unref(msg);
+    NDBUS_EXCPN_UNIXFD;
+  }
+
   if (message_type == DBUS_MESSAGE_TYPE_METHOD_RETURN) {
     DBusPendingCall *pending;
     if (dbus_connection_send_with_reply(bus_cnxn, msg, &pending, timeout)) {
       if (pending) {
+        NDbusTimeCall(cnxn_info, msg, pending);
         NDbusObjectInfo *info = g_new0(NDbusObjectInfo, 1);
 
          info->object.Reset(isolate, args.This());
-        dbus_pending_call_set_notify(pending, NDbusHandleMethodReply, (void *)info, NULL);
+        info->decode_flags = NDbusGetDecodeFlags(args.This());
+        dbus_pending_call_set_notify(pending, NDbusHandleMethodReply,
+            (void *)info, NDbusFreeMethodInfo);
+        //the caller may want to cancel it
+        if (args[0]->IsObject())
+          Local<Object>::Cast(args[0])->Set(
+              v8::String::NewFromUtf8(isolate, NDBUS_PROPERTY_CALL_ID),
+              Uint32::NewFromUnsigned(isolate, NDbusTrackPendingCall(pending)));
       } else {
         dbus_message_unref(msg);
         NDBUS_EXCPN_DISCONNECTED;
@@ -331,12 +600,15 @@ void NDbusInvokeMethod (const FunctionCallbackInfo<Value>& args) {
       dbus_message_unref(msg);
       NDBUS_EXCPN_OOM;
     }
-    dbus_connection_flush(bus_cnxn);
   } else {
     DBusError error;
     dbus_error_init(&error);
+    NDbusLatency *latency = NDbusLatencyFor(cnxn_info, msg);
+    guint64 sent_at = NDbusMetricsNow();
+    NDbusCountMessage(cnxn_info, msg, FALSE);
     DBusMessage *reply =
       dbus_connection_send_with_reply_and_block(bus_cnxn, msg, timeout, &error);
+    NDbusRecordLatency(latency, sent_at);
 
     Handle<Object> local_global_target = Local<Object>::New(isolate, global_target);
     Local<Function> func = Local<Function>::Cast(local_global_target->Get(NDBUS_CB_METHODREPLY));
@@ -348,21 +620,118 @@ void NDbusInvokeMethod (const FunctionCallbackInfo<Value>& args) {
       NDBUS_SET_EXCPN(argv[1], error.name, error.message);
       dbus_error_free(&error);
     } else {
-      Local<Value> msg_args = NDbusRetrieveMessageArgs(reply);
+      NDbusCountMessage(cnxn_info, reply, TRUE);
+      Local<Value> msg_args = NDbusRetrieveMessageArgs(reply,
+          NDbusGetDecodeFlags(args.This()));
       argv[0] = msg_args;
       argv[1] = Undefined(isolate);
-      dbus_message_unref(reply);
     }
 
+    NDBUS_PROBE(callback__start, reply);
     if (NDbusIsValidV8Value(func) &&
         func->IsFunction())
       func->Call(args.This(), argc, argv);
     else
       g_critical("\nSomeone has messed with the internal  \
           method response handler of dbus.js. 'methodResponse' wont be triggered.");
+    NDBUS_PROBE(callback__done, reply);
+    if (reply)
+      dbus_message_unref(reply);
   }
 
   dbus_message_unref(msg);
+  args.GetReturnValue().Set(NDbusCheckWritable(cnxn_info, args.This()) == TRUE);
+}
+
+void NDbusRequestName (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  NDbusConnectionInfo *cnxn_info = NDbusGetConnection(args.This());
+  if (!cnxn_info || !cnxn_info->cnxn)
+    NDBUS_EXCPN_DISCONNECTED;
+
+  if (!args[2]->IsFunction())
+    NDBUS_EXCPN_CALLBACK;
+
+  gchar *name = NDbusV8StringToCStr(args[0]);
+  if (!name || !dbus_validate_bus_name(name, NULL)
+      || name[0] == ':') {
+    g_free(name);
+    NDBUS_EXCPN_NAME;
+  }
+
+  guint flags = args[1]->Uint32Value();
+  gboolean sent = NDbusRequestNameReal(cnxn_info, name, flags,
+      args.This(), Local<Function>::Cast(args[2]));
+  g_free(name);
+  if (!sent)
+    NDBUS_EXCPN_OOM;
+
+  args.GetReturnValue().Set(TRUE);
+}
+
+void NDbusReleaseName (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  NDbusConnectionInfo *cnxn_info = NDbusGetConnection(args.This());
+  if (!cnxn_info || !cnxn_info->cnxn)
+    NDBUS_EXCPN_DISCONNECTED;
+
+  if (!args[1]->IsFunction())
+    NDBUS_EXCPN_CALLBACK;
+
+  gchar *name = NDbusV8StringToCStr(args[0]);
+  if (!name || !dbus_validate_bus_name(name, NULL)) {
+    g_free(name);
+    NDBUS_EXCPN_NAME;
+  }
+
+  gboolean sent = NDbusReleaseNameReal(cnxn_info, name,
+      Local<Function>::Cast(args[1]));
+  g_free(name);
+  if (!sent)
+    NDBUS_EXCPN_OOM;
+
+  args.GetReturnValue().Set(TRUE);
+}
+
+void NDbusHasName (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  NDbusConnectionInfo *cnxn_info = NDbusGetConnection(args.This());
+  gchar *name = NDbusV8StringToCStr(args[0]);
+  gboolean owner = (cnxn_info && name &&
+      NDbusIsNameOwner(cnxn_info, name));
+  g_free(name);
+  args.GetReturnValue().Set(owner ? true : false);
+}
+
+void NDbusGetNameOwner (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  NDbusConnectionInfo *cnxn_info = NDbusGetConnection(args.This());
+  if (!cnxn_info || !cnxn_info->cnxn)
+    NDBUS_EXCPN_DISCONNECTED;
+
+  if (!args[1]->IsFunction())
+    NDBUS_EXCPN_CALLBACK;
+
+  gchar *name = NDbusV8StringToCStr(args[0]);
+  if (!name || !dbus_validate_bus_name(name, NULL)) {
+    g_free(name);
+    NDBUS_EXCPN_NAME;
+  }
+
+  gboolean queried = NDbusGetNameOwnerReal(cnxn_info, name,
+      Local<Function>::Cast(args[1]));
+  g_free(name);
+  if (!queried)
+    NDBUS_EXCPN_OOM;
+
   args.GetReturnValue().Set(TRUE);
 }
 
@@ -377,25 +746,54 @@ void NDbusInit (const FunctionCallbackInfo<Value>& args) {
           NDBUS_PROPERTY_ADDRESS));
   gboolean sess_bus = (cnxn_type == DBUS_BUS_SESSION);
 
-  DBusConnection *bus_cnxn = sess_bus?session_bus:system_bus;
-  if (bus_cnxn) {
+  if (cnxn_type == NDBUS_BUS_PEER) {
+    if (address == NULL)
+      NDBUS_EXCPN_ADDRESS;
+
+    if (!g_hash_table_lookup(peer_connections, address)) {
+      //a peer is not a bus, so no Hello
+      DBusError error;
+      dbus_error_init(&error);
+      DBusConnection *peer_cnxn =
+        dbus_connection_open_private(address, &error);
+      if (dbus_error_is_set(&error)) {
+        g_free(address);
+        Local<Value> exptn;
+        NDBUS_SET_EXCPN(exptn, error.name, error.message);
+        dbus_error_free(&error);
+        isolate->ThrowException(exptn);
+        return;
+      }
+      if (!NDbusSetupPeerConnection(address, peer_cnxn)) {
+        g_free(address);
+        dbus_connection_close(peer_cnxn);
+        dbus_connection_unref(peer_cnxn);
+        NDBUS_EXCPN_OOM;
+      }
+    }
+    g_free(address);
     args.GetReturnValue().SetUndefined();
-    return /* Undefined() */;
+    return;
   }
 
-  DBusError error;
-  dbus_error_init(&error);
-  if (address == NULL) {
-    bus_cnxn = dbus_bus_get(DBusBusType(cnxn_type), &error);
-  } else {
-    bus_cnxn = dbus_connection_open(address, &error);
-    if (!dbus_error_is_set(&error)) {
-      dbus_bus_register(bus_cnxn, &error);
-    }
+  NDbusConnectionInfo *bus = sess_bus?session_bus:system_bus;
+  if (bus) {
+    gboolean other = g_strcmp0(bus->bus_address, address) != 0;
     g_free(address);
+    if (other)
+      NDBUS_EXCPN_BUS_ADDRESS;
+    //connect() is still opening it, which init cannot wait for
+    if (bus->cnxn == NULL && !bus->reconnect.pending)
+      NDBUS_EXCPN_CONNECTING;
+    args.GetReturnValue().SetUndefined();
+    return /* Undefined() */;
   }
 
+  DBusError error;
+  dbus_error_init(&error);
+  DBusConnection *bus_cnxn = NDbusOpenBus(cnxn_type, address, &error);
   if (dbus_error_is_set(&error)) {
+    g_free(address);
     Local<Value> exptn;
     NDBUS_SET_EXCPN(exptn, error.name, error.message);
     dbus_error_free(&error);
@@ -403,24 +801,81 @@ void NDbusInit (const FunctionCallbackInfo<Value>& args) {
     return;
   }
 
-  GHashTable *signal_watchers =
-    g_hash_table_new_full(g_str_hash,
-        g_str_equal, (GDestroyNotify) g_free, NULL);
-  if (sess_bus) {
-    session_bus = bus_cnxn;
-    session_signal_watchers = signal_watchers;
-  } else {
-    system_bus = bus_cnxn;
-    system_signal_watchers = signal_watchers;
+  NDbusConnectionInfo *cnxn_info =
+    NDbusNewBusConnection(cnxn_type, address);
+  if (!NDbusAttachBusConnection(cnxn_info, bus_cnxn))
+    NDBUS_EXCPN_OOM;
+
+  args.GetReturnValue().SetUndefined();
+}
+
+static void
+NDbusHandleBusConnected (NDbusConnectionInfo *cnxn_info,
+    DBusConnection *bus_cnxn, DBusError *error, gpointer user_data) {
+  Isolate* isolate = Isolate::GetCurrent();
+  NDbusCallbackInfo *cb_info = (NDbusCallbackInfo *)user_data;
+
+  if (bus_cnxn && !NDbusAttachBusConnection(cnxn_info, bus_cnxn)) {
+    cnxn_info->cnxn = NULL;
+    dbus_connection_unref(bus_cnxn);
+    bus_cnxn = NULL;
+    dbus_set_error_const(error, DBUS_ERROR_NO_MEMORY, NDBUS_ERROR_OOM);
   }
 
-  dbus_connection_set_exit_on_disconnect(bus_cnxn, FALSE);
+  Local<Value> argv[1];
+  argv[0] = Undefined(isolate);
+  if (bus_cnxn == NULL) {
+    NDBUS_SET_EXCPN(argv[0], error->name, error->message);
+    //nothing to keep, the next init or connect starts afresh
+    if (!cnxn_info->closed)
+      NDbusForgetBus(cnxn_info);
+  }
 
-  if (!NDbusConnectionSetupWithEvLoop(bus_cnxn))
-    NDBUS_EXCPN_OOM;
+  Local<Function> func =
+    Local<Function>::New(isolate, cb_info->callback);
+  if (NDbusIsValidV8Value(func))
+    func->Call(func, 1, argv);
+  NDbusFreeCallbackInfo(cb_info);
+}
 
-  dbus_connection_add_filter(bus_cnxn, NDbusMessageFilter, (void *)signal_watchers, NULL);
-  args.GetReturnValue().SetUndefined();
+/**
+ * Like init, but connects to the bus on the threadpool and calls args[0]
+ * back once done. Returns TRUE instead if there is a connection already,
+ * be it up or on its way back.
+ */
+void NDbusConnect (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  gint cnxn_type = NDbusGetProperty(args.This(),
+      NDBUS_PROPERTY_BUS)->IntegerValue();
+  if (cnxn_type == NDBUS_BUS_PEER)
+    NDBUS_THROW_EXCPN(DBUS_ERROR_NOT_SUPPORTED, "Not a bus");
+  if (!args[0]->IsFunction())
+    NDBUS_EXCPN_CALLBACK;
+
+  gchar *address =
+    NDbusV8StringToCStr(NDbusGetProperty(args.This(),
+          NDBUS_PROPERTY_ADDRESS));
+  if (NDbusLookupConnection(cnxn_type, address)) {
+    g_free(address);
+    args.GetReturnValue().Set(TRUE);
+    return;
+  }
+  //there is one connection of each bus type
+  if (cnxn_type == DBUS_BUS_SESSION ? session_bus : system_bus) {
+    g_free(address);
+    NDBUS_EXCPN_BUS_ADDRESS;
+  }
+
+  NDbusConnectionInfo *cnxn_info =
+    NDbusNewBusConnection(cnxn_type, address);
+
+  NDbusCallbackInfo *cb_info = g_new0(NDbusCallbackInfo, 1);
+  cb_info->callback.Reset(isolate, Local<Function>::Cast(args[0]));
+  cb_info->cnxn_info = NDbusConnectionInfoRef(cnxn_info);
+  NDbusOpenBusAsync(cnxn_info, NDbusHandleBusConnected, cb_info);
+  args.GetReturnValue().Set(FALSE);
 }
 
 void NDbusClose (const FunctionCallbackInfo<Value>& args) {
@@ -428,32 +883,165 @@ void NDbusClose (const FunctionCallbackInfo<Value>& args) {
   HandleScope scope(isolate);
 
   gint cnxn_type = args[0]->IntegerValue();
-  gboolean sess_bus = (cnxn_type == DBUS_BUS_SESSION);
-
-  DBusConnection *bus_cnxn = sess_bus?session_bus:system_bus;
-  if (bus_cnxn) {
-    GHashTable *signal_watchers =
-      sess_bus?session_signal_watchers:system_signal_watchers;
-    dbus_connection_remove_filter(bus_cnxn, NDbusMessageFilter, (void *)signal_watchers);
-    dbus_connection_unref(bus_cnxn);
-
-    if (signal_watchers) {
-      g_hash_table_foreach_remove(signal_watchers,
-          (GHRFunc)NDbusRemoveAllSignalListeners, NULL);
-      g_hash_table_unref(signal_watchers);
+  gchar *address = NDbusV8StringToCStr(args[1]);
+
+  if (cnxn_type == NDBUS_BUS_PEER) {
+    NDbusConnectionInfo *cnxn_info = address ? (NDbusConnectionInfo *)
+      g_hash_table_lookup(peer_connections, address) : NULL;
+    if (cnxn_info) {
+      g_hash_table_remove(peer_connections, address);
+      NDbusConnectionInfoClose(cnxn_info);
     }
+    g_free(address);
+    args.GetReturnValue().SetUndefined();
+    return;
+  }
 
-    if (sess_bus) {
-        session_signal_watchers = NULL;
+  //only the connection at this address, not one of the bus at another
+  NDbusConnectionInfo *cnxn_info =
+    NDbusLookupConnection(cnxn_type, address);
+  g_free(address);
+  if (cnxn_info) {
+    if (cnxn_info == session_bus)
         session_bus = NULL;
-    } else {
-        system_signal_watchers = NULL;
+    else if (cnxn_info == system_bus)
         system_bus = NULL;
-    }
+    NDbusConnectionInfoClose(cnxn_info);
   }
   args.GetReturnValue().SetUndefined();
 }
 
+void NDbusListen (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  gchar *address = NDbusV8StringToCStr(args[0]);
+  if (!address)
+    NDBUS_EXCPN_ADDRESS;
+  if (!args[1]->IsObject()) {
+    g_free(address);
+    NDBUS_THROW_EXCPN(DBUS_ERROR_INVALID_ARGS, "Invalid server object");
+  }
+
+  DBusError error;
+  dbus_error_init(&error);
+  DBusServer *server = dbus_server_listen(address, &error);
+  g_free(address);
+  if (dbus_error_is_set(&error)) {
+    Local<Value> exptn;
+    NDBUS_SET_EXCPN(exptn, error.name, error.message);
+    dbus_error_free(&error);
+    isolate->ThrowException(exptn);
+    return;
+  }
+
+  NDbusServerInfo *server_info = g_new0(NDbusServerInfo, 1);
+  gchar *server_address = dbus_server_get_address(server);
+  server_info->server = server;
+  server_info->address = g_strdup(server_address);
+  dbus_free(server_address);
+  server_info->object.Reset(isolate, Local<Object>::Cast(args[1]));
+
+  dbus_server_set_new_connection_function(server,
+      NDbusHandleNewPeer, (void *)server_info, NULL);
+  if (!NDbusServerSetupWithEvLoop(server)) {
+    dbus_server_disconnect(server);
+    dbus_server_unref(server);
+    server_info->object.Reset();
+    g_free(server_info->address);
+    g_free(server_info);
+    NDBUS_EXCPN_OOM;
+  }
+
+  g_hash_table_insert(peer_servers,
+      g_strdup(server_info->address), server_info);
+  args.GetReturnValue().Set(v8::String::NewFromUtf8(isolate,
+        server_info->address));
+}
+
+void NDbusCloseServer (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  gchar *address = NDbusV8StringToCStr(args[0]);
+  NDbusServerInfo *server_info = address ? (NDbusServerInfo *)
+    g_hash_table_lookup(peer_servers, address) : NULL;
+  if (server_info) {
+    g_hash_table_remove(peer_servers, address);
+    //connections accepted so far stay open
+    dbus_server_disconnect(server_info->server);
+    dbus_server_unref(server_info->server);
+    server_info->object.Reset();
+    g_free(server_info->address);
+    g_free(server_info);
+  }
+  g_free(address);
+  args.GetReturnValue().SetUndefined();
+}
+
+//EXPOSED
+gboolean
+NDbusGetLimit (Local<Object> limits, const gchar *name, glong *value) {
+  Local<Value> limit = NDbusGetProperty(limits, name);
+  if (!NDbusIsValidV8Value(limit))
+    return TRUE;
+  if (!limit->IsNumber() || limit->NumberValue() < 0)
+    return FALSE;
+  *value = limit->IntegerValue();
+  return TRUE;
+}
+
+void NDbusSetLimits (const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = Isolate::GetCurrent();
+  HandleScope scope(isolate);
+
+  if (!args[0]->IsObject())
+    NDBUS_EXCPN_LIMITS;
+  Local<Object> limits = Local<Object>::Cast(args[0]);
+
+  NDbusConnectionInfo *cnxn_info = NDbusGetConnection(args.This());
+  if (!cnxn_info || !cnxn_info->cnxn)
+    NDBUS_EXCPN_DISCONNECTED;
+  DBusConnection *bus_cnxn = cnxn_info->cnxn;
+
+  glong high_watermark = cnxn_info->high_watermark;
+  glong low_watermark = cnxn_info->low_watermark;
+  glong high_unix_fds = cnxn_info->high_unix_fds;
+  glong low_unix_fds = cnxn_info->low_unix_fds;
+  glong max_message_size = dbus_connection_get_max_message_size(bus_cnxn);
+  glong max_received_size = dbus_connection_get_max_received_size(bus_cnxn);
+  glong max_message_fds = -1;
+  glong max_received_fds = -1;
+
+  if (!NDbusGetLimit(limits, NDBUS_LIMIT_HIGH_WATERMARK, &high_watermark) ||
+      !NDbusGetLimit(limits, NDBUS_LIMIT_LOW_WATERMARK, &low_watermark) ||
+      !NDbusGetLimit(limits, NDBUS_LIMIT_HIGH_UNIX_FDS, &high_unix_fds) ||
+      !NDbusGetLimit(limits, NDBUS_LIMIT_LOW_UNIX_FDS, &low_unix_fds) ||
+      !NDbusGetLimit(limits, NDBUS_LIMIT_MAX_MESSAGE_SIZE, &max_message_size) ||
+      !NDbusGetLimit(limits, NDBUS_LIMIT_MAX_RECEIVED_SIZE, &max_received_size) ||
+      !NDbusGetLimit(limits, NDBUS_LIMIT_MAX_MESSAGE_FDS, &max_message_fds) ||
+      !NDbusGetLimit(limits, NDBUS_LIMIT_MAX_RECEIVED_FDS, &max_received_fds))
+    NDBUS_EXCPN_LIMITS;
+  if (low_watermark > high_watermark ||
+      low_unix_fds > high_unix_fds)
+    NDBUS_EXCPN_LIMITS;
+
+  cnxn_info->high_watermark = high_watermark;
+  cnxn_info->low_watermark = low_watermark;
+  cnxn_info->high_unix_fds = high_unix_fds;
+  cnxn_info->low_unix_fds = low_unix_fds;
+  dbus_connection_set_max_message_size(bus_cnxn, max_message_size);
+  dbus_connection_set_max_received_size(bus_cnxn, max_received_size);
+#ifdef DBUS_TYPE_UNIX_FD
+  if (max_message_fds >= 0)
+    dbus_connection_set_max_message_unix_fds(bus_cnxn, max_message_fds);
+  if (max_received_fds >= 0)
+    dbus_connection_set_max_received_unix_fds(bus_cnxn, max_received_fds);
+#endif
+
+  args.GetReturnValue().SetUndefined();
+}
+
 extern "C" {
 void init (Handle<Object> target) {
   Isolate* isolate = Isolate::GetCurrent();
@@ -463,6 +1051,7 @@ void init (Handle<Object> target) {
 
   NODE_DEFINE_CONSTANT(constants, DBUS_BUS_SESSION);
   NODE_DEFINE_CONSTANT(constants, DBUS_BUS_SYSTEM);
+  NODE_DEFINE_CONSTANT(constants, NDBUS_BUS_PEER);
   NODE_DEFINE_CONSTANT(constants, DBUS_MESSAGE_TYPE_INVALID);
   NODE_DEFINE_CONSTANT(constants, DBUS_MESSAGE_TYPE_METHOD_CALL);
   NODE_DEFINE_CONSTANT(constants, DBUS_MESSAGE_TYPE_METHOD_RETURN);
@@ -472,6 +1061,25 @@ void init (Handle<Object> target) {
   NODE_DEFINE_CONSTANT(constants, NDBUS_VARIANT_POLICY_DEFAULT);
   NODE_DEFINE_CONSTANT(constants, NDBUS_VARIANT_POLICY_SIMPLE);
 
+  NODE_DEFINE_CONSTANT(constants, NDBUS_DECODE_DEFAULT);
+  NODE_DEFINE_CONSTANT(constants, NDBUS_DECODE_DICT_AS_MAP);
+  NODE_DEFINE_CONSTANT(constants, NDBUS_DECODE_COLUMNAR);
+  NODE_DEFINE_CONSTANT(constants, NDBUS_DECODE_BIGINT);
+  NODE_DEFINE_CONSTANT(constants, NDBUS_DECODE_BIGINT_UNSAFE);
+  NODE_DEFINE_CONSTANT(constants, NDBUS_DECODE_RAW);
+  NODE_DEFINE_CONSTANT(constants, NDBUS_DECODE_CODEC);
+
+  NODE_DEFINE_CONSTANT(constants, DBUS_NAME_FLAG_ALLOW_REPLACEMENT);
+  NODE_DEFINE_CONSTANT(constants, DBUS_NAME_FLAG_REPLACE_EXISTING);
+  NODE_DEFINE_CONSTANT(constants, DBUS_NAME_FLAG_DO_NOT_QUEUE);
+  NODE_DEFINE_CONSTANT(constants, DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER);
+  NODE_DEFINE_CONSTANT(constants, DBUS_REQUEST_NAME_REPLY_IN_QUEUE);
+  NODE_DEFINE_CONSTANT(constants, DBUS_REQUEST_NAME_REPLY_EXISTS);
+  NODE_DEFINE_CONSTANT(constants, DBUS_REQUEST_NAME_REPLY_ALREADY_OWNER);
+  NODE_DEFINE_CONSTANT(constants, DBUS_RELEASE_NAME_REPLY_RELEASED);
+  NODE_DEFINE_CONSTANT(constants, DBUS_RELEASE_NAME_REPLY_NON_EXISTENT);
+  NODE_DEFINE_CONSTANT(constants, DBUS_RELEASE_NAME_REPLY_NOT_OWNER);
+
   NDBUS_DEFINE_STRING_CONSTANT(constants, DBUS_SERVICE_DBUS);
   NDBUS_DEFINE_STRING_CONSTANT(constants, DBUS_PATH_DBUS);
   NDBUS_DEFINE_STRING_CONSTANT(constants, DBUS_PATH_LOCAL);
@@ -524,11 +1132,57 @@ void init (Handle<Object> target) {
   NDBUS_DEFINE_STRING_CONSTANT(constants, DBUS_ERROR_OBJECT_PATH_IN_USE);
 
   NODE_SET_METHOD(target, "init", NDbusInit);
+  NODE_SET_METHOD(target, "connect", NDbusConnect);
   NODE_SET_METHOD(target, "deinit", NDbusClose);
   NODE_SET_METHOD(target, "invokeMethod", NDbusInvokeMethod);
   NODE_SET_METHOD(target, "sendSignal", NDbusSendSignal);
   NODE_SET_METHOD(target, "addMatch", NDbusAddMatch);
   NODE_SET_METHOD(target, "removeMatch", NDbusRemoveMatch);
+  NODE_SET_METHOD(target, "requestName", NDbusRequestName);
+  NODE_SET_METHOD(target, "releaseName", NDbusReleaseName);
+  NODE_SET_METHOD(target, "hasName", NDbusHasName);
+  NODE_SET_METHOD(target, "getNameOwner", NDbusGetNameOwner);
+  NODE_SET_METHOD(target, "introspect", NDbusIntrospect);
+  NODE_SET_METHOD(target, "mirrorProperties", NDbusMirrorProperties);
+  NODE_SET_METHOD(target, "getMirroredProperty", NDbusGetMirroredProperty);
+  NODE_SET_METHOD(target, "getMirroredProperties", NDbusGetMirroredProperties);
+  NODE_SET_METHOD(target, "releaseMirror", NDbusReleaseMirror);
+  NODE_SET_METHOD(target, "mirrorObjects", NDbusMirrorObjects);
+  NODE_SET_METHOD(target, "getManagedObject", NDbusGetManagedObject);
+  NODE_SET_METHOD(target, "getManagedObjects", NDbusGetManagedObjects);
+  NODE_SET_METHOD(target, "getManagedPaths", NDbusGetManagedPaths);
+  NODE_SET_METHOD(target, "releaseObjectMirror", NDbusReleaseObjectMirror);
+  NODE_SET_METHOD(target, "listen", NDbusListen);
+  NODE_SET_METHOD(target, "closeServer", NDbusCloseServer);
+  NODE_SET_METHOD(target, "setLimits", NDbusSetLimits);
+  NODE_SET_METHOD(target, "setReconnect", NDbusSetReconnect);
+  NODE_SET_METHOD(target, "getReconnectStats", NDbusGetReconnectStats);
+  NODE_SET_METHOD(target, "setMetrics", NDbusSetMetrics);
+  NODE_SET_METHOD(target, "getMetrics", NDbusGetMetrics);
+  NODE_SET_METHOD(target, "sendBatch", NDbusSendBatch);
+  NODE_SET_METHOD(target, "callBatch", NDbusCallBatch);
+  NODE_SET_METHOD(target, "prepare", NDbusPrepare);
+  NODE_SET_METHOD(target, "emitPrepared", NDbusEmitPrepared);
+  NODE_SET_METHOD(target, "callPrepared", NDbusCallPrepared);
+  NODE_SET_METHOD(target, "releasePrepared", NDbusReleasePrepared);
+  NODE_SET_METHOD(target, "getPreparedStats", NDbusGetPreparedStats);
+  NODE_SET_METHOD(target, "cancelCall", NDbusCancelCall);
+  NODE_SET_METHOD(target, "createMemfd", NDbusCreateMemfd);
+  NODE_SET_METHOD(target, "mapFd", NDbusMapFd);
+  NODE_SET_METHOD(target, "marshal", NDbusMarshal);
+  NODE_SET_METHOD(target, "demarshal", NDbusDemarshal);
+  NODE_SET_METHOD(target, "sendRaw", NDbusSendRaw);
+  NODE_SET_METHOD(target, "callRaw", NDbusCallRaw);
+
+  peer_connections =
+    g_hash_table_new_full(g_str_hash,
+        g_str_equal, (GDestroyNotify) g_free, NULL);
+  peer_servers =
+    g_hash_table_new_full(g_str_hash,
+        g_str_equal, (GDestroyNotify) g_free, NULL);
+
+  //connections are opened on the threadpool
+  dbus_threads_init_default();
 
   global_target.Reset(isolate, target);
 }
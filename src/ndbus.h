@@ -12,9 +12,27 @@
 #define __NDBUS_H__
 
 #include <node.h>
+#include <uv.h>
 using namespace v8;
 using namespace node;
 
+//BigInt64Array and BigUint64Array, for 64-bit integers without loss
+#if V8_MAJOR_VERSION > 6 || (V8_MAJOR_VERSION == 6 && V8_MINOR_VERSION >= 7)
+#define NDBUS_HAVE_BIGINT
+#endif
+
+//USDT probes for perf and bpftrace, unless built with NDBUS_NO_PROBES
+#if !defined(NDBUS_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define NDBUS_HAVE_PROBES
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+#endif
+#endif
+
+//Number.MAX_SAFE_INTEGER, 2^53 - 1
+#define NDBUS_MAX_SAFE_INTEGER        G_GINT64_CONSTANT(9007199254740991)
+
 namespace ndbus {
 
 #define NDBUS_PROPERTY_BUS            "bus"
@@ -29,6 +47,44 @@ namespace ndbus {
 #define NDBUS_PROPERTY_SIGN           "_signature"
 #define NDBUS_PROPERTY_TIMEOUT        "timeout"
 #define NDBUS_PROPERTY_VARIANT_POLICY "variantPolicy"
+#define NDBUS_PROPERTY_DECODE_FLAGS   "decodeFlags"
+#define NDBUS_PROPERTY_CODEC          "codec"
+#define NDBUS_PROPERTY_ENTRY_SIGN     "signature"
+#define NDBUS_PROPERTY_REPLY_SIGN     "replySignature"
+#define NDBUS_PROPERTY_COALESCE       "coalesce"
+#define NDBUS_PROPERTY_CACHE_TTL      "cacheTtl"
+#define NDBUS_PROPERTY_CALL_ID        "id"
+#define NDBUS_PROPERTY_ENTRY_ARGS     "args"
+#define NDBUS_PROPERTY_INDEX          "index"
+#define NDBUS_PROPERTY_COLUMNS        "columns"
+#define NDBUS_PROPERTY_LENGTH         "length"
+
+#define NDBUS_LIMIT_HIGH_WATERMARK    "highWaterMark"
+#define NDBUS_LIMIT_LOW_WATERMARK     "lowWaterMark"
+#define NDBUS_LIMIT_HIGH_UNIX_FDS     "highWaterMarkUnixFds"
+#define NDBUS_LIMIT_LOW_UNIX_FDS      "lowWaterMarkUnixFds"
+#define NDBUS_LIMIT_MAX_MESSAGE_SIZE  "maxMessageSize"
+#define NDBUS_LIMIT_MAX_RECEIVED_SIZE "maxReceivedSize"
+#define NDBUS_LIMIT_MAX_MESSAGE_FDS   "maxMessageUnixFds"
+#define NDBUS_LIMIT_MAX_RECEIVED_FDS  "maxReceivedUnixFds"
+
+#define NDBUS_RECONNECT_ENABLED       "enabled"
+#define NDBUS_RECONNECT_MIN_DELAY     "minDelay"
+#define NDBUS_RECONNECT_MAX_DELAY     "maxDelay"
+
+#define NDBUS_METRICS_BYTES           "bytes"
+
+#define NDBUS_STRING_BUFFER_SIZE      256
+//received ASCII strings from this length on are not copied
+#define NDBUS_EXTERNAL_STRING_MIN     (64 * 1024)
+
+#define NDBUS_DEFAULT_HIGH_WATERMARK  (1024 * 1024)
+#define NDBUS_DEFAULT_LOW_WATERMARK   (NDBUS_DEFAULT_HIGH_WATERMARK / 4)
+#define NDBUS_DEFAULT_HIGH_UNIX_FDS   256
+#define NDBUS_DEFAULT_LOW_UNIX_FDS    (NDBUS_DEFAULT_HIGH_UNIX_FDS / 4)
+//milliseconds between attempts to reach a bus again, doubled each time
+#define NDBUS_DEFAULT_RECONNECT_MIN   100
+#define NDBUS_DEFAULT_RECONNECT_MAX   (30 * 1000)
 
 #define NDBUS_SET_EXCPN(excpn, name, message) \
   {                                           \
@@ -56,18 +112,51 @@ namespace ndbus {
 #define NDBUS_ERROR_UNSUPPORTED       "Argument type not supported"
 #define NDBUS_ERROR_OOM               "Out of memory!"
 #define NDBUS_ERROR_SIGN              "Invalid argument signature"
+#define NDBUS_ERROR_TYPE              "Invalid message type"
+#define NDBUS_ERROR_DEST              "Invalid destination"
+#define NDBUS_ERROR_PATH              "Invalid object path"
+#define NDBUS_ERROR_INTERFACE         "Invalid interface name"
+#define NDBUS_ERROR_MEMBER            "Invalid member name"
+#define NDBUS_ERROR_BATCH             "Invalid batch entry"
+#define NDBUS_ERROR_UNIXFD            "Connection cannot pass unix file descriptors"
+#define NDBUS_ERROR_RAW               "Invalid marshalled message"
+#define NDBUS_ERROR_MARSHAL           "Message with unix file descriptors cannot be marshalled"
+#define NDBUS_ERROR_INTROSPECT        "Invalid introspection data"
+#define NDBUS_ERROR_ARITY             "Wrong number of arguments"
+#define NDBUS_ERROR_REPLY_SIGN        "Reply does not match the expected signature"
 
-#define NDBUS_EXCPN_TYPE              NDBUS_THROW_EXCPN(DBUS_ERROR_FAILED, "Invalid message type")
-#define NDBUS_EXCPN_DEST              NDBUS_THROW_EXCPN(DBUS_ERROR_FAILED, "Invalid destination")
-#define NDBUS_EXCPN_PATH              NDBUS_THROW_EXCPN(DBUS_ERROR_FAILED, "Invalid object path")
-#define NDBUS_EXCPN_INTERFACE         NDBUS_THROW_EXCPN(DBUS_ERROR_FAILED, "Invalid interface name")
-#define NDBUS_EXCPN_MEMBER            NDBUS_THROW_EXCPN(DBUS_ERROR_FAILED, "Invalid member name")
+#define NDBUS_EXCPN_TYPE              NDBUS_THROW_EXCPN(DBUS_ERROR_FAILED, NDBUS_ERROR_TYPE)
+#define NDBUS_EXCPN_DEST              NDBUS_THROW_EXCPN(DBUS_ERROR_FAILED, NDBUS_ERROR_DEST)
+#define NDBUS_EXCPN_PATH              NDBUS_THROW_EXCPN(DBUS_ERROR_FAILED, NDBUS_ERROR_PATH)
+#define NDBUS_EXCPN_INTERFACE         NDBUS_THROW_EXCPN(DBUS_ERROR_FAILED, NDBUS_ERROR_INTERFACE)
+#define NDBUS_EXCPN_MEMBER            NDBUS_THROW_EXCPN(DBUS_ERROR_FAILED, NDBUS_ERROR_MEMBER)
+#define NDBUS_EXCPN_TEMPLATE          NDBUS_THROW_EXCPN(DBUS_ERROR_INVALID_ARGS, "Invalid prepared message")
+#define NDBUS_EXCPN_BATCH             NDBUS_THROW_EXCPN(DBUS_ERROR_INVALID_ARGS, "Invalid batch")
 #define NDBUS_EXCPN_OOM               NDBUS_THROW_EXCPN(DBUS_ERROR_NO_MEMORY, NDBUS_ERROR_OOM)
 #define NDBUS_EXCPN_DISCONNECTED      NDBUS_THROW_EXCPN(DBUS_ERROR_DISCONNECTED, "Connection got disconnected")
 #define NDBUS_EXCPN_NOMATCH           NDBUS_THROW_EXCPN(DBUS_ERROR_MATCH_RULE_NOT_FOUND, "The match was already removed or never added.")
+#define NDBUS_EXCPN_NAME              NDBUS_THROW_EXCPN(DBUS_ERROR_INVALID_ARGS, "Invalid bus name")
+#define NDBUS_EXCPN_ADDRESS           NDBUS_THROW_EXCPN(DBUS_ERROR_BAD_ADDRESS, "Invalid peer address")
+#define NDBUS_EXCPN_BUS_ADDRESS       NDBUS_THROW_EXCPN(DBUS_ERROR_FAILED, "Bus already connected at another address")
+#define NDBUS_EXCPN_CONNECTING        NDBUS_THROW_EXCPN(DBUS_ERROR_FAILED, "Connection still being opened by connect()")
+#define NDBUS_EXCPN_CALLBACK          NDBUS_THROW_EXCPN(DBUS_ERROR_INVALID_ARGS, "Invalid callback")
+#define NDBUS_EXCPN_UNIXFD            NDBUS_THROW_EXCPN(DBUS_ERROR_NOT_SUPPORTED, NDBUS_ERROR_UNIXFD)
+#define NDBUS_EXCPN_FD                NDBUS_THROW_EXCPN(DBUS_ERROR_INVALID_ARGS, "Invalid file descriptor")
+#define NDBUS_EXCPN_LIMITS            NDBUS_THROW_EXCPN(DBUS_ERROR_INVALID_ARGS, "Invalid limits")
+#define NDBUS_EXCPN_OBJECTS           NDBUS_THROW_EXCPN(DBUS_ERROR_INVALID_ARGS, "Invalid object mirror")
+#define NDBUS_EXCPN_MIRROR            NDBUS_THROW_EXCPN(DBUS_ERROR_INVALID_ARGS, "Invalid property mirror")
+#define NDBUS_EXCPN_RECONNECT         NDBUS_THROW_EXCPN(DBUS_ERROR_INVALID_ARGS, "Invalid reconnect options")
+#define NDBUS_EXCPN_METRICS           NDBUS_THROW_EXCPN(DBUS_ERROR_INVALID_ARGS, "Invalid metrics options")
+#define NDBUS_EXCPN_MEMFD             NDBUS_THROW_EXCPN(DBUS_ERROR_NOT_SUPPORTED, "Sealed memfd not supported")
 
 #define NDBUS_CB_METHODREPLY          v8::String::NewFromUtf8(isolate, "onMethodResponse")
 #define NDBUS_CB_SIGNALRECEIPT        v8::String::NewFromUtf8(isolate, "onSignalReceipt")
+#define NDBUS_CB_PEERCONNECTION       v8::String::NewFromUtf8(isolate, "onPeerConnection")
+#define NDBUS_CB_NAMEOWNERSHIP        v8::String::NewFromUtf8(isolate, "onNameOwnership")
+#define NDBUS_CB_DRAIN                v8::String::NewFromUtf8(isolate, "onDrain")
+#define NDBUS_CB_PROPERTIESCHANGED    v8::String::NewFromUtf8(isolate, "onPropertiesChanged")
+#define NDBUS_CB_OBJECTSCHANGED       v8::String::NewFromUtf8(isolate, "onObjectsChanged")
+#define NDBUS_CB_RECONNECT            v8::String::NewFromUtf8(isolate, "onReconnect")
 
 /**
  * How should variant in signatures of signals to send be handles.
@@ -93,6 +182,70 @@ typedef enum {
     NDBUS_VARIANT_POLICY_SIMPLE
 } NDbusVariantPolicy;
 
+/**
+ * How received arguments are turned into JS values. These are OR'ed
+ * into the "decodeFlags" of the message object receiving them.
+ */
+typedef enum {
+    NDBUS_DECODE_DEFAULT = 0,
+    /**
+     * Dictionaries become a Map instead of an object, which keeps the
+     * type of their keys and suits integer keys much better.
+     */
+    NDBUS_DECODE_DICT_AS_MAP = 1 << 0,
+    /**
+     * Arrays of structs of fixed-width basic types, such as a(tdd),
+     * become { columns: [BigUint64Array, Float64Array, Float64Array],
+     * length } with one TypedArray per struct member, rather than an
+     * array of arrays. 64-bit integers need BigInt support in V8.
+     */
+    NDBUS_DECODE_COLUMNAR = 1 << 1,
+    /**
+     * 64-bit integers (x and t) become a BigInt, and arrays of them a
+     * BigInt64Array or BigUint64Array. Ignored without BigInt in V8.
+     */
+    NDBUS_DECODE_BIGINT = 1 << 2,
+    /**
+     * 64-bit integers become a BigInt only when a Number cannot hold
+     * them exactly, that is beyond +/-(2^53 - 1).
+     */
+    NDBUS_DECODE_BIGINT_UNSAFE = 1 << 3,
+    /**
+     * No arguments are decoded at all. The only argument is instead
+     * the whole message marshalled into a Buffer, to be forwarded
+     * or stored as it is. Overrides all other flags.
+     */
+    NDBUS_DECODE_RAW = 1 << 4,
+    /**
+     * Arguments are read straight from the wire format by the codec
+     * rather than through libdbus iterators. Not with COLUMNAR or RAW.
+     */
+    NDBUS_DECODE_CODEC = 1 << 5
+} NDbusDecodeFlags;
+
+/**
+ * Outcome of encoding a value, by the iterators or the codec.
+ */
+enum {
+  TYPE_MISMATCH,
+  TYPE_NOT_SUPPORTED,
+  OUT_OF_MEMORY,
+  SUCCESS
+};
+
+/**
+ * Connections which are not to a message bus.
+ */
+typedef enum {
+    /**
+     * A direct connection to another process, either opened to the address
+     * of a peer or accepted by a server from listen(). The "address" of the
+     * message object selects the connection. There is no bus daemon, so
+     * there is no Hello, no match rules and no destination needed.
+     */
+    NDBUS_BUS_PEER = 3 /* past DBUS_BUS_STARTER */
+} NDbusBusType;
+
 extern "C" {
 
 #include <stdlib.h>
@@ -109,7 +262,7 @@ extern "C" {
 #define LOGV(s,...)                   NOOP
 #endif
 
-gboolean NDbusConnectionSetupWithEvLoop   (DBusConnection *bus_cnxn);
+gboolean NDbusServerSetupWithEvLoop       (DBusServer *server);
 DBusHandlerResult NDbusMessageFilter      (DBusConnection *cnxn,
                                            DBusMessage * message,
                                            void *user_data);
@@ -117,27 +270,403 @@ void NDbusFree                            (gchar *service,
                                            gchar *interface,
                                            gchar *object_path,
                                            gchar *member);
+
+/**
+ * The probes of provider ndbus, see ndbus-trace.cc. A probe costs a
+ * nop and a test of its semaphore, which perf and bpftrace raise while
+ * attached; only then are its arguments worked out.
+ */
+#ifdef NDBUS_HAVE_PROBES
+extern unsigned short ndbus_message__create_semaphore;
+extern unsigned short ndbus_encode__start_semaphore;
+extern unsigned short ndbus_encode__done_semaphore;
+extern unsigned short ndbus_queue_semaphore;
+extern unsigned short ndbus_flush_semaphore;
+extern unsigned short ndbus_receive_semaphore;
+extern unsigned short ndbus_route_semaphore;
+extern unsigned short ndbus_decode__start_semaphore;
+extern unsigned short ndbus_decode__done_semaphore;
+extern unsigned short ndbus_callback__start_semaphore;
+extern unsigned short ndbus_callback__done_semaphore;
+
+#define NDBUS_PROBE(name, msg)        do { \
+    if (G_UNLIKELY(ndbus_##name##_semaphore)) { \
+      DBusMessage *probed = (msg); \
+      STAP_PROBE3(ndbus, name, NDbusProbedSerial(probed), \
+          NDbusProbedMember(probed), NDbusProbedSize(probed)); \
+    } \
+  } while (0)
+#define NDBUS_PROBE_FLUSH(cnxn, queued) do { \
+    if (G_UNLIKELY(ndbus_flush_semaphore)) { \
+      glong left = dbus_connection_get_outgoing_size(cnxn); \
+      STAP_PROBE2(ndbus, flush, (queued) - left, left); \
+    } \
+  } while (0)
+#define NDBUS_PROBE_ENABLED(name)     G_UNLIKELY(ndbus_##name##_semaphore)
+#else
+#define NDBUS_PROBE(name, msg)        do {} while (0)
+#define NDBUS_PROBE_FLUSH(cnxn, queued) do {} while (0)
+#define NDBUS_PROBE_ENABLED(name)     FALSE
+#endif
 } //extern "C"
 
 extern Persistent<Object> global_target;
 
 typedef struct {
   Persistent<Object> object;
+  guint decode_flags;
+  gchar *match;
 } NDbusObjectInfo;
 
+/**
+ * How a bus connection comes back once the daemon dropped it, and how
+ * the last time went. Delays are in milliseconds, times in microseconds.
+ */
+typedef struct {
+  gboolean enabled;
+  guint min_delay;
+  guint max_delay;
+  uv_timer_t *timer;
+  gboolean pending;
+  guint attempts;
+  gint64 disconnected_at;
+  guint reconnects;
+  gint64 last_downtime;
+  gint64 last_restore;
+  guint last_attempts;
+  guint last_matches;
+  guint last_names;
+} NDbusReconnectInfo;
+
+/**
+ * The latencies of the method-calls to one destination, interface
+ * and member, see ndbus-metrics.cc.
+ */
+typedef struct _NDbusLatency NDbusLatency;
+
+/**
+ * The traffic of a connection on behalf of JS, indexed by message type,
+ * and its latencies keyed by "destination interface member". Bytes are
+ * only counted with count_bytes, as libdbus has a message marshalled
+ * again to tell its size.
+ */
+typedef struct {
+  guint64 messages_in[DBUS_NUM_MESSAGE_TYPES];
+  guint64 messages_out[DBUS_NUM_MESSAGE_TYPES];
+  guint64 bytes_in[DBUS_NUM_MESSAGE_TYPES];
+  guint64 bytes_out[DBUS_NUM_MESSAGE_TYPES];
+  guint pending_calls;
+  gboolean count_bytes;
+  GHashTable *latencies;
+} NDbusMetrics;
+
+/**
+ * State kept per dbus connection. It is handed to the message filter
+ * as user_data and outlives the connection while replies are pending,
+ * hence the reference count. cnxn is NULL once the connection is closed,
+ * while the bus is being connected to on the threadpool, or while a bus
+ * which went away is being reached again.
+ *
+ * Once the outgoing queue reaches a high watermark, the objects whose
+ * send() returned false wait in blocked for it to fall to the low one.
+ */
+typedef struct {
+  DBusConnection *cnxn;
+  GHashTable *signal_watchers;
+  GHashTable *owned_names;
+  GHashTable *name_owners;
+  GHashTable *owner_aliases;
+  GHashTable *introspections;
+  GHashTable *property_mirrors;
+  GPtrArray *object_mirrors;
+  gchar *peer_address;
+  gboolean peer;
+  gint bus_type;
+  gchar *bus_address;
+  NDbusReconnectInfo reconnect;
+  NDbusMetrics metrics;
+  gboolean closed;
+  glong high_watermark;
+  glong low_watermark;
+  glong high_unix_fds;
+  glong low_unix_fds;
+  GSList *blocked;
+  gint ref_count;
+} NDbusConnectionInfo;
+
+/**
+ * A server accepting peer connections, keyed by its address.
+ */
+typedef struct {
+  DBusServer *server;
+  gchar *address;
+  guint peers;
+  Persistent<Object> object;
+} NDbusServerInfo;
+
+/**
+ * A well-known name requested on a connection, keyed by the name in
+ * NDbusConnectionInfo.owned_names.
+ */
+typedef struct {
+  Persistent<Object> owner;
+  guint flags;
+  gboolean primary;
+} NDbusNameInfo;
+
+/**
+ * The cached owner of a well-known name, keyed by the name in
+ * NDbusConnectionInfo.name_owners. owner_aliases maps the unique
+ * name back to the well-known names it is known to own.
+ */
+typedef struct {
+  gchar *owner;
+  gboolean resolved;
+  gboolean querying;
+  GSList *waiters;
+} NDbusOwnerInfo;
+
+/**
+ * A method, signal or property of an introspected interface. For a
+ * method, signature holds its in and reply_signature its out arguments,
+ * for a signal signature holds its arguments, for a property its type.
+ */
+typedef struct {
+  gchar *interface;
+  gchar *name;
+  gchar kind;
+  gchar *signature;
+  gchar *reply_signature;
+  gchar *access;
+} NDbusIntrospectMember;
+
+/**
+ * The parsed introspection of one object, keyed by its unique owner
+ * and path in NDbusConnectionInfo.introspections. Callers that ask
+ * while Introspect is still on its way wait in waiters.
+ */
+typedef struct {
+  gchar *owner;
+  GPtrArray *members;
+  GPtrArray *nodes;
+  gboolean resolved;
+  GSList *waiters;
+} NDbusIntrospection;
+
+/**
+ * A local copy of the properties of one interface of a remote object,
+ * seeded by GetAll and kept current by PropertiesChanged. values maps
+ * each property name to an NDbusPropertyValue. owner is the unique
+ * name the copy was taken from, seed_serial the serial of the GetAll
+ * whose reply is awaited, if any. Mirrors are indexed by path and
+ * interface in NDbusConnectionInfo.property_mirrors, as GPtrArrays.
+ */
+typedef struct {
+  guint id;
+  NDbusConnectionInfo *cnxn_info;
+  gchar *destination;
+  gchar *owner;
+  gchar *path;
+  gchar *interface;
+  gchar *match;
+  guint decode_flags;
+  gboolean seeded;
+  dbus_uint32_t seed_serial;
+  GHashTable *values;
+  Persistent<Object> object;
+  Persistent<Function> callback;
+} NDbusPropertyMirror;
+
+typedef struct {
+  Persistent<Value> value;
+} NDbusPropertyValue;
+
+/**
+ * An object known through an ObjectManager, with the properties of
+ * each of its interfaces: interface -> (name -> NDbusPropertyValue).
+ */
+typedef struct {
+  gchar *path;
+  GHashTable *interfaces;
+} NDbusManagedObject;
+
+/**
+ * A local replica of the objects of an ObjectManager, seeded by
+ * GetManagedObjects and kept current by InterfacesAdded/Removed and
+ * PropertiesChanged. objects is sorted by path, so that the objects
+ * under a path are a range of it, and index maps each path to its
+ * place in objects. The rest is as for NDbusPropertyMirror.
+ */
+typedef struct {
+  guint id;
+  NDbusConnectionInfo *cnxn_info;
+  gchar *destination;
+  gchar *owner;
+  gchar *path;
+  gchar *match;
+  gchar *properties_match;
+  guint decode_flags;
+  gboolean seeded;
+  dbus_uint32_t seed_serial;
+  GSequence *objects;
+  GHashTable *index;
+  Persistent<Object> object;
+  Persistent<Function> callback;
+} NDbusObjectMirror;
+
+/**
+ * A signature compiled for the codec, see ndbus-codec.cc.
+ */
+typedef struct _NDbusCodecProgram NDbusCodecProgram;
+
+/**
+ * A validated signature split into the complete type of each
+ * argument, so that it is walked once for any number of messages.
+ * program is compiled the first time the codec encodes with it.
+ */
+typedef struct {
+  gchar *signature;
+  GPtrArray *arg_signatures;
+  NDbusCodecProgram *program;
+} NDbusSignature;
+
+/**
+ * A message prepared once to be sent many times with different
+ * arguments. msg holds the validated header only and is copied for
+ * every send. The connection is looked up by bus and address.
+ * A method-call may coalesce identical calls in flight and keep
+ * replies for cache_ttl ms, both keyed by the marshalled message:
+ * flights and replies, hits/misses/coalesced count what they saved.
+ */
+typedef struct {
+  DBusMessage *msg;
+  NDbusSignature *signature;
+  gint bus;
+  gchar *address;
+  gint timeout;
+  NDbusVariantPolicy variant_policy;
+  guint decode_flags;
+  gboolean codec;
+  gchar *reply_signature;
+  gboolean coalesce;
+  gint cache_ttl;
+  GHashTable *flights;
+  GHashTable *replies;
+  guint64 hits;
+  guint64 misses;
+  guint64 coalesced;
+} NDbusTemplate;
+
+/**
+ * Called on the loop once NDbusOpenBusAsync got a connection to the bus
+ * of cnxn_info, or NULL and error set. The connection is the callee's.
+ */
+typedef void (*NDbusOpenBusNotify) (NDbusConnectionInfo *cnxn_info,
+                                    DBusConnection *cnxn,
+                                    DBusError *error,
+                                    gpointer user_data);
+
+/**
+ * A JS callback waiting on a reply from the bus daemon. A reply
+ * which does not have reply_signature, if set, is an error.
+ */
+typedef struct {
+  Persistent<Function> callback;
+  NDbusConnectionInfo *cnxn_info;
+  gchar *name;
+  guint decode_flags;
+  gchar *reply_signature;
+  guint call_id;
+} NDbusCallbackInfo;
+
 gboolean NDbusIsValidV8Value              (const Handle<Value> value);
 gchar* NDbusV8StringToCStr                (const Local<Value> str);
 Local<Value> NDbusGetProperty             (const Local<Object> obj,
                                            const gchar *name);
 gboolean NDbusIsMatchAdded                (GSList *list,
                                            Local<Object> obj);
-gboolean NDbusMessageAppendArgs           (DBusMessage *msg,
+gboolean NDbusMessageAppendArgs           (DBusMessage **msg,
                                            Local<Object> obj,
                                            Local<Object> *error,
                                            NDbusVariantPolicy variantPolicy);
-Local<Value> NDbusRetrieveMessageArgs     (DBusMessage *msg);
+guint NDbusGetDecodeFlags                 (const Local<Object> obj);
+Local<Value> NDbusRetrieveMessageArgs     (DBusMessage *msg,
+                                           guint decode_flags);
+void NDbusRetrieveReplyArgs               (DBusMessage *reply,
+                                           guint decode_flags,
+                                           Local<Value> *args,
+                                           Local<Value> *error);
+NDbusSignature* NDbusSignatureNew         (const gchar *signature);
+void NDbusSignatureFree                   (gpointer data);
+NDbusConnectionInfo* NDbusLookupConnection (gint cnxn_type,
+                                           const gchar *address);
+NDbusConnectionInfo* NDbusGetConnection  (const Local<Object> obj);
+void NDbusFreeCallbackInfo                (void *data);
+void NDbusDispatchCallbackReply           (NDbusCallbackInfo *cb_info,
+                                           DBusMessage *reply);
+void NDbusHandleCallbackReply             (DBusPendingCall *pending,
+                                           void *user_data);
+DBusMessage* NDbusNewMessageFromEntry     (Local<Object> obj,
+                                           Local<Object> entry,
+                                           gint message_type,
+                                           NDbusConnectionInfo *cnxn_info,
+                                           Local<Object> *error);
+void NDbusSendBatch                       (const FunctionCallbackInfo<Value>& args);
+void NDbusCallBatch                       (const FunctionCallbackInfo<Value>& args);
+void NDbusPrepare                         (const FunctionCallbackInfo<Value>& args);
+void NDbusEmitPrepared                    (const FunctionCallbackInfo<Value>& args);
+void NDbusCallPrepared                    (const FunctionCallbackInfo<Value>& args);
+void NDbusReleasePrepared                 (const FunctionCallbackInfo<Value>& args);
+void NDbusGetPreparedStats                (const FunctionCallbackInfo<Value>& args);
+gboolean NDbusCancelFlightWaiter          (guint id);
+guint NDbusNextCallId                     (void);
+guint NDbusTrackPendingCall               (DBusPendingCall *pending);
+void NDbusCancelCall                      (const FunctionCallbackInfo<Value>& args);
+gboolean NDbusMessageAppendSignatureArgs  (DBusMessage **msg,
+                                           NDbusSignature *signature,
+                                           Local<Array> args,
+                                           Local<Object> *error,
+                                           NDbusVariantPolicy variantPolicy,
+                                           gboolean codec);
+gint NDbusCreateSignatureForVariant       (Local<Value> value,
+                                           NDbusVariantPolicy variantPolicy,
+                                           gchar *buffer,
+                                           gint &index);
+gint NDbusColumnTypes                     (const gchar *signature,
+                                           gchar *types);
+gsize NDbusColumnElementSize              (gchar type);
+gboolean NDbusIsColumn                    (Local<Value> column,
+                                           gchar type);
+NDbusCodecProgram* NDbusCodecProgramNew   (const gchar *signature);
+NDbusCodecProgram* NDbusCodecProgramRef   (NDbusCodecProgram *program);
+void NDbusCodecProgramUnref               (NDbusCodecProgram *program);
+gint NDbusCodecNewMessage                 (DBusMessage *header,
+                                           const NDbusCodecProgram *program,
+                                           Local<Array> args,
+                                           NDbusVariantPolicy variantPolicy,
+                                           DBusMessage **encoded);
+Local<Value> NDbusCodecRetrieveMessageArgs (DBusMessage *msg,
+                                           guint decode_flags);
+gboolean NDbusCanSendMessage              (DBusConnection *cnxn,
+                                           DBusMessage *msg);
+gboolean NDbusConnectionSetupWithEvLoop   (NDbusConnectionInfo *cnxn_info);
+gboolean NDbusCheckWritable               (NDbusConnectionInfo *cnxn_info,
+                                           Local<Object> obj);
+void NDbusCheckDrain                      (NDbusConnectionInfo *cnxn_info);
+void NDbusCreateMemfd                     (const FunctionCallbackInfo<Value>& args);
+void NDbusMapFd                           (const FunctionCallbackInfo<Value>& args);
+gboolean NDbusIsAscii                     (const gchar *data,
+                                           gsize len);
+Local<v8::String> NDbusNewMessageString   (DBusMessage *msg,
+                                           const gchar *value);
+Local<Value> NDbusMarshalMessage          (DBusMessage *msg);
+void NDbusMarshal                         (const FunctionCallbackInfo<Value>& args);
+void NDbusDemarshal                       (const FunctionCallbackInfo<Value>& args);
+void NDbusSendRaw                         (const FunctionCallbackInfo<Value>& args);
+void NDbusCallRaw                         (const FunctionCallbackInfo<Value>& args);
 void NDbusHandleMethodReply               (DBusPendingCall *pending,
                                            void *user_data);
+void NDbusFreeMethodInfo                  (void *data);
 gchar* NDbusConstructKey                  (gchar *interface,
                                            gchar *member,
                                            gchar *object_path,
@@ -153,6 +682,108 @@ gboolean NDbusRemoveAllSignalListeners    (gpointer key,
                                            gpointer user_data);
 void NDbusFreeObjectInfo                  (gpointer data,
                                            gpointer user_data);
+
+NDbusConnectionInfo* NDbusConnectionInfoNew (DBusConnection *cnxn);
+NDbusConnectionInfo* NDbusConnectionInfoRef (NDbusConnectionInfo *cnxn_info);
+void NDbusConnectionInfoUnref             (NDbusConnectionInfo *cnxn_info);
+void NDbusConnectionInfoClose             (NDbusConnectionInfo *cnxn_info);
+void NDbusPeerDisconnected                (NDbusConnectionInfo *cnxn_info);
+void NDbusBusDisconnected                 (NDbusConnectionInfo *cnxn_info);
+DBusConnection* NDbusOpenBus              (gint cnxn_type,
+                                           const gchar *address,
+                                           DBusError *error);
+void NDbusOpenBusAsync                    (NDbusConnectionInfo *cnxn_info,
+                                           NDbusOpenBusNotify notify,
+                                           gpointer user_data);
+void NDbusConnect                         (const FunctionCallbackInfo<Value>& args);
+gboolean NDbusAttachBusConnection         (NDbusConnectionInfo *cnxn_info,
+                                           DBusConnection *cnxn);
+gboolean NDbusScheduleReconnect           (NDbusConnectionInfo *cnxn_info);
+void NDbusStopReconnect                   (NDbusConnectionInfo *cnxn_info);
+gboolean NDbusGetLimit                    (Local<Object> limits,
+                                           const gchar *name,
+                                           glong *value);
+void NDbusSetReconnect                    (const FunctionCallbackInfo<Value>& args);
+void NDbusGetReconnectStats               (const FunctionCallbackInfo<Value>& args);
+guint64 NDbusMetricsNow                   (void);
+void NDbusCountEncode                     (guint64 started);
+void NDbusCountDecode                     (guint64 started);
+void NDbusCountDispatch                   (guint64 started);
+void NDbusCountMessage                    (NDbusConnectionInfo *cnxn_info,
+                                           DBusMessage *msg,
+                                           gboolean incoming);
+NDbusLatency* NDbusLatencyFor             (NDbusConnectionInfo *cnxn_info,
+                                           DBusMessage *call);
+void NDbusRecordLatency                   (NDbusLatency *latency,
+                                           guint64 sent_at);
+void NDbusTimeCall                        (NDbusConnectionInfo *cnxn_info,
+                                           DBusMessage *call,
+                                           DBusPendingCall *pending);
+void NDbusTimeReply                       (DBusPendingCall *pending,
+                                           DBusMessage *reply);
+void NDbusFreeMetrics                     (NDbusMetrics *metrics);
+dbus_uint32_t NDbusProbedSerial           (DBusMessage *msg);
+const gchar* NDbusProbedMember            (DBusMessage *msg);
+guint NDbusProbedSize                     (DBusMessage *msg);
+void NDbusSetMetrics                      (const FunctionCallbackInfo<Value>& args);
+void NDbusGetMetrics                      (const FunctionCallbackInfo<Value>& args);
+void NDbusFreeNameInfo                    (gpointer data);
+gboolean NDbusRequestNameReal             (NDbusConnectionInfo *cnxn_info,
+                                           const gchar *name,
+                                           guint flags,
+                                           Local<Object> owner,
+                                           Local<Function> callback);
+gboolean NDbusReleaseNameReal             (NDbusConnectionInfo *cnxn_info,
+                                           const gchar *name,
+                                           Local<Function> callback);
+gboolean NDbusIsNameOwner                 (NDbusConnectionInfo *cnxn_info,
+                                           const gchar *name);
+gboolean NDbusHandleNameOwnership         (NDbusConnectionInfo *cnxn_info,
+                                           DBusMessage *message);
+void NDbusFreeOwnerInfo                   (gpointer data);
+void NDbusFreeOwnerAliases                (gpointer data);
+NDbusOwnerInfo* NDbusWatchNameOwner       (NDbusConnectionInfo *cnxn_info,
+                                           const gchar *name);
+guint NDbusRewatchNameOwners              (NDbusConnectionInfo *cnxn_info);
+void NDbusLoseOwnedNames                  (NDbusConnectionInfo *cnxn_info);
+guint NDbusRequestOwnedNames              (NDbusConnectionInfo *cnxn_info);
+gboolean NDbusGetNameOwnerReal            (NDbusConnectionInfo *cnxn_info,
+                                           const gchar *name,
+                                           Local<Function> callback);
+GSList* NDbusGetOwnerAliases              (NDbusConnectionInfo *cnxn_info,
+                                           const gchar *unique_name);
+gboolean NDbusHandleNameOwnerChanged      (NDbusConnectionInfo *cnxn_info,
+                                           DBusMessage *message);
+void NDbusFreeIntrospection               (gpointer data);
+void NDbusInvalidateIntrospections        (NDbusConnectionInfo *cnxn_info,
+                                           const gchar *owner);
+void NDbusIntrospect                      (const FunctionCallbackInfo<Value>& args);
+gboolean NDbusHandlePropertiesChanged     (NDbusConnectionInfo *cnxn_info,
+                                           DBusMessage *message);
+void NDbusReseedPropertyMirrors           (NDbusConnectionInfo *cnxn_info,
+                                           const gchar *name,
+                                           const gchar *new_owner);
+guint NDbusRestorePropertyMirrors         (NDbusConnectionInfo *cnxn_info);
+GHashTable* NDbusPropertyValuesNew        (void);
+void NDbusStoreProperties                 (GHashTable *values,
+                                           Local<Value> dict,
+                                           Local<Object> changed);
+Local<Object> NDbusDescribeProperties     (GHashTable *values);
+void NDbusMirrorProperties                (const FunctionCallbackInfo<Value>& args);
+void NDbusGetMirroredProperty             (const FunctionCallbackInfo<Value>& args);
+void NDbusGetMirroredProperties           (const FunctionCallbackInfo<Value>& args);
+void NDbusReleaseMirror                   (const FunctionCallbackInfo<Value>& args);
+gboolean NDbusHandleObjectManagerSignal   (NDbusConnectionInfo *cnxn_info,
+                                           DBusMessage *message);
+void NDbusReseedObjectMirrors             (NDbusConnectionInfo *cnxn_info,
+                                           const gchar *name,
+                                           const gchar *new_owner);
+guint NDbusRestoreObjectMirrors           (NDbusConnectionInfo *cnxn_info);
+void NDbusMirrorObjects                   (const FunctionCallbackInfo<Value>& args);
+void NDbusGetManagedObject                (const FunctionCallbackInfo<Value>& args);
+void NDbusGetManagedObjects               (const FunctionCallbackInfo<Value>& args);
+void NDbusGetManagedPaths                 (const FunctionCallbackInfo<Value>& args);
+void NDbusReleaseObjectMirror             (const FunctionCallbackInfo<Value>& args);
 } //namespace ndbus
 
 #endif  /* __NDBUS_H__ */
@@ -0,0 +1,124 @@
+#!/usr/bin/env node
+/*
+<copyright>
+Copyright (c) 2011, Motorola Mobility, Inc
+
+All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+</copyright>
+*/
+
+var dbus = require('../dbus'),
+    events = require('events');
+
+//AbortController is global from node 15 on
+function Controller () {
+  var target = new events.EventEmitter();
+  this.signal = {
+    aborted: false,
+    addEventListener: target.on.bind(target),
+    removeEventListener: target.removeListener.bind(target)
+  };
+  this.abort = function () {
+    this.signal.aborted = true;
+    target.emit('abort');
+  };
+}
+
+var dbusMsg = Object.create(dbus.DBusMessage, {
+  destination: {
+    value: dbus.DBUS_SERVICE_DBUS
+  },
+  path: {
+    value: dbus.DBUS_PATH_DBUS
+  },
+  iface: {
+    value: dbus.DBUS_INTERFACE_DBUS
+  },
+  bus: {
+    value: dbus.DBUS_BUS_SESSION
+  },
+  type: {
+    value: dbus.DBUS_MESSAGE_TYPE_METHOD_RETURN
+  }
+});
+
+dbusMsg.on ('error', function (error) {
+  console.log ("[FAILED] ERROR -- ");
+  console.log (error);
+});
+
+var getId = dbusMsg.prepare({member: 'GetId'}),
+    aborted = new (global.AbortController || Controller)(),
+    kept = new (global.AbortController || Controller)(),
+    pending;
+
+//aborted before the bus can answer
+pending = getId.call(aborted.signal);
+aborted.abort();
+
+pending.then(function () {
+  console.log ("[FAILED] Aborted call resolved");
+}, function (error) {
+  if (error.name === 'AbortError') {
+    console.log ("[PASSED] Aborted call rejected with AbortError");
+  } else {
+    console.log ("[FAILED] ERROR -- ");
+    console.log (error);
+  }
+  return getId.call(kept.signal);
+}).then(function (id) {
+  console.log ("[PASSED] Call with a signal that is not aborted :: " + id);
+  //too late to cancel anything
+  kept.abort();
+  return getId.call(aborted.signal);
+}).then(function () {
+  console.log ("[FAILED] Call with an aborted signal resolved");
+}, function (error) {
+  console.log ("[" + (error.name === 'AbortError' ? "PASSED" : "FAILED") +
+               "] Call with an aborted signal not sent");
+}).then(function () {
+  getId.release();
+  dbusMsg.closeConnection();
+  //the connection goes on the next tick
+  setTimeout(abortWhileConnecting, 10);
+});
+
+//aborted while connect() is on its way: rejected at once, never sent
+function abortWhileConnecting () {
+  var controller = new (global.AbortController || Controller)(),
+      order = [],
+      connected = dbusMsg.connect().then(function () {
+        order.push('connected');
+      }),
+      later = dbusMsg.prepare({member: 'GetId'}),
+      queued = later.call(controller.signal).then(function () {
+        order.push('resolved');
+      }, function (error) {
+        order.push(error.name);
+      }),
+      kept = later.call();
+  controller.abort();
+
+  Promise.all([connected, queued, kept]).then(function (results) {
+    if (order.join() === 'AbortError,connected' && results[2]) {
+      console.log ("[PASSED] Call aborted while connecting rejected before the " +
+                   "connection, the other one answered :: " + results[2]);
+    } else {
+      console.log ("[FAILED] Call aborted while connecting :: " + order.join());
+    }
+  }, function (error) {
+    console.log ("[FAILED] ERROR -- ");
+    console.log (error);
+  }).then(function () {
+    later.release();
+    dbusMsg.closeConnection();
+  });
+}
@@ -0,0 +1,104 @@
+#!/usr/bin/env node
+/*
+<copyright>
+Copyright (c) 2011, Motorola Mobility, Inc
+
+All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+</copyright>
+*/
+
+
+var dbus = require('../dbus');
+
+//runs without a bus: messages are only marshalled and demarshalled
+function message (codec) {
+  return Object.create(dbus.DBusMessage, {
+    path: {
+      value: '/org/ndbus/asciitest'
+    },
+    iface: {
+      value: 'org.ndbus.asciitest'
+    },
+    member: {
+      value: 'TestingNDbusAscii'
+    },
+    type: {
+      value: dbus.DBUS_MESSAGE_TYPE_SIGNAL
+    },
+    codec: {
+      value: codec
+    }
+  });
+}
+
+//lengths around the 16 and 32 byte blocks of the SSE2 and AVX2 scanners,
+//and one long enough to be an external string
+var lengths = [1, 7, 8, 15, 16, 17, 31, 32, 33, 47, 48, 63, 64, 65, 95, 96, 127,
+               128, 129, 1000, 64 * 1024 + 5];
+
+//a one-byte and a two-byte non-ASCII character, which are encoded apart
+var others = ['é', '€'];
+
+function ascii (len) {
+  var chars = new Array(len);
+  for (var i = 0; i < len; i++)
+    chars[i] = String.fromCharCode(33 + i % 94);
+  return chars.join('');
+}
+
+//the positions at the start and in the tail, where a block scan ends
+function positions (len) {
+  var at = [-1];
+  for (var i = 0; i < len; i++) {
+    if (i < 64 || i >= len - 64)
+      at.push(i);
+  }
+  return at;
+}
+
+var failed = 0, count = 0;
+
+[false, true].forEach(function (codec) {
+  var msg = message(codec),
+      how = codec ? " by the codec" : "";
+  msg.on('error', function (e) {
+    console.log("[FAILED] ERROR -- ");
+    console.log(e);
+    failed++;
+  });
+
+  lengths.forEach(function (len) {
+    var base = ascii(len);
+    positions(len).forEach(function (at) {
+      others.forEach(function (other) {
+        var str = at < 0 ? base : base.slice(0, at) + other + base.slice(at + 1);
+        //a leading string moves this one to other offsets within the
+        //scanner blocks, all of them for pure ASCII
+        for (var shift = 0; shift < 8; shift += at < 0 ? 1 : 4) {
+          msg.appendArgs('ss', ascii(shift), str);
+          var buffer = msg.marshal(),
+              args = buffer && dbus.demarshal(buffer, dbus.NDBUS_DECODE_DEFAULT).args;
+          count++;
+          if (!args || args[1] !== str) {
+            console.log("[FAILED] " + len + " chars with " +
+                (at < 0 ? "none" : JSON.stringify(other) + " at " + at) +
+                " changed" + how + " :: " + (args && args[1].length));
+            failed++;
+          }
+        }
+      });
+    });
+  });
+});
+
+if (!failed)
+  console.log("[PASSED] " + count + " strings scanned with a non-ASCII character " +
+      "at each position");
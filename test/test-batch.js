@@ -0,0 +1,115 @@
+#!/usr/bin/env node
+/*
+<copyright>
+Copyright (c) 2011, Motorola Mobility, Inc
+
+All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+</copyright>
+*/
+
+var dbus = require('../dbus');
+
+var dbus = require('../dbus');
+
+var total = 5000,
+    received = 0,
+    entries = [],
+    i = 0;
+
+var dbusBatchMonitor = Object.create(dbus.DBusMessage, {
+  path: {
+    value: '/org/ndbus/batchtest'
+  },
+  iface: {
+    value: 'org.ndbus.batchtest'
+  },
+  member: {
+    value: 'TestingNDbusBatch'
+  },
+  bus: {
+    value: dbus.DBUS_BUS_SESSION
+  },
+  type: {
+    value: dbus.DBUS_MESSAGE_TYPE_SIGNAL
+  }
+});
+
+var dbusBatchCall = Object.create(dbus.DBusMessage, {
+  destination: {
+    value: dbus.DBUS_SERVICE_DBUS
+  },
+  path: {
+    value: dbus.DBUS_PATH_DBUS
+  },
+  iface: {
+    value: dbus.DBUS_INTERFACE_DBUS
+  },
+  bus: {
+    value: dbus.DBUS_BUS_SESSION
+  },
+  type: {
+    value: dbus.DBUS_MESSAGE_TYPE_METHOD_RETURN
+  }
+});
+
+dbusBatchMonitor.on ('signalReceipt', function (signal, index) {
+  if (++received === total) {
+    console.log ("[PASSED] Received all " + total + " batched signals");
+    dbusBatchMonitor.removeMatch();
+    callBatch();
+  }
+});
+
+dbusBatchMonitor.on ('error', function (error) {
+  console.log ("[FAILED] ERROR -- ");
+  console.log (error);
+});
+
+function callBatch () {
+  Promise.all(dbusBatchCall.callBatch([
+    {member: 'GetId'},
+    {member: 'NameHasOwner', signature: 's', args: [dbus.DBUS_SERVICE_DBUS]}
+  ])).then(function (replies) {
+    console.log ("[PASSED] Batched calls replied with :: ");
+    console.log (replies);
+    return halfArgs();
+  }).then(function () {
+    dbusBatchCall.closeConnection();
+  }, function (error) {
+    console.log ("[FAILED] ERROR -- ");
+    console.log (error);
+    dbusBatchCall.closeConnection();
+  });
+}
+
+//a signature without args, or args without a signature, is refused
+//rather than sent without a body
+function halfArgs () {
+  return Promise.all([
+    {member: 'NameHasOwner', signature: 's'},
+    {member: 'GetId', args: []}
+  ].map(function (entry) {
+    return Promise.all(dbusBatchCall.callBatch([{member: 'GetId'}, entry]))
+      .then(function () {
+        console.log ("[FAILED] Batch sent with only half of its arguments");
+      }, function (error) {
+        console.log ("[" + (error.index === 1 ? "PASSED" : "FAILED") +
+            "] Batch entry " + error.index + " with only half of its arguments refused");
+      });
+  }));
+}
+
+for (; i<total; i++) {
+  entries.push({signature: 'us', args: [i, 'batched signal ' + i]});
+}
+
+dbusBatchMonitor.addMatch();
+dbusBatchMonitor.sendBatch(entries);
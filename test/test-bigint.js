@@ -0,0 +1,141 @@
+#!/usr/bin/env node
+/*
+<copyright>
+Copyright (c) 2011, Motorola Mobility, Inc
+
+All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+</copyright>
+*/
+
+
+var dbus = require('../dbus');
+
+if (typeof BigInt === 'undefined') {
+  console.log("[PASSED] Skipped, this node has no BigInt");
+  process.exit(0);
+}
+
+//runs without a bus: messages are only marshalled and demarshalled
+function message (codec) {
+  return Object.create(dbus.DBusMessage, {
+    path: {
+      value: '/org/ndbus/biginttest'
+    },
+    iface: {
+      value: 'org.ndbus.biginttest'
+    },
+    member: {
+      value: 'TestingNDbusBigInt'
+    },
+    type: {
+      value: dbus.DBUS_MESSAGE_TYPE_SIGNAL
+    },
+    codec: {
+      value: codec
+    }
+  });
+}
+
+var MIN64 = BigInt('-9223372036854775808'),
+    MAX64 = BigInt('9223372036854775807'),
+    MAXU64 = BigInt('18446744073709551615'),
+    SAFE = BigInt(Number.MAX_SAFE_INTEGER);
+
+//[signature, BigInt sent]: each comes back unchanged with NDBUS_DECODE_BIGINT
+var exact = [
+  ['x', MIN64], ['x', MIN64 + BigInt(1)], ['x', BigInt(-1)], ['x', BigInt(0)],
+  ['x', SAFE + BigInt(2)], ['x', MAX64],
+  ['t', BigInt(0)], ['t', MAX64 + BigInt(1)], ['t', MAXU64 - BigInt(1)], ['t', MAXU64]
+];
+
+//[signature, BigInt sent] which do not fit the type
+var refused = [
+  ['x', MAX64 + BigInt(1)], ['x', MIN64 - BigInt(1)],
+  ['t', BigInt(-1)], ['t', MAXU64 + BigInt(1)]
+];
+
+//[BigInt, signature it is given in a variant]
+var variants = [
+  [BigInt(-1), 'x'], [MIN64, 'x'], [MAX64, 'x'], [MAX64 + BigInt(1), 't'], [MAXU64, 't']
+];
+
+//the signature a lone variant was given, read off the start of the body
+function variantSignature (buffer) {
+  var fields = buffer[0] === 0x6c ? buffer.readUInt32LE(12) : buffer.readUInt32BE(12),
+      body = (16 + fields + 7) & ~7;
+  return buffer.toString('ascii', body + 1, body + 1 + buffer[body]);
+}
+
+var failed = 0;
+
+function fail (text) {
+  console.log("[FAILED] " + text);
+  failed++;
+}
+
+[false, true].forEach(function (codec) {
+  var msg = message(codec),
+      how = codec ? " by the codec" : "",
+      errors = 0;
+  msg.on('error', function () { errors++; });
+
+  function marshal (signature, value) {
+    msg.appendArgs(signature, value);
+    return msg.marshal();
+  }
+
+  exact.forEach(function (c) {
+    var buffer = marshal(c[0], c[1]),
+        big = buffer && dbus.demarshal(buffer, dbus.NDBUS_DECODE_BIGINT).args[0],
+        unsafe = buffer && dbus.demarshal(buffer, dbus.NDBUS_DECODE_BIGINT_UNSAFE).args[0],
+        number = buffer && dbus.demarshal(buffer, dbus.NDBUS_DECODE_DEFAULT).args[0];
+    if (big !== c[1])
+      fail("'" + c[0] + "' " + c[1] + " came back as " + big + how);
+    //only values a Number cannot hold exactly stay BigInt when unsafe
+    if (c[1] >= -SAFE && c[1] <= SAFE ?
+        unsafe !== Number(c[1]) : unsafe !== c[1])
+      fail("'" + c[0] + "' " + c[1] + " came back unsafe as " + unsafe + how);
+    if (number !== Number(c[1]))
+      fail("'" + c[0] + "' " + c[1] + " came back as the Number " + number + how);
+  });
+
+  //the same values as arrays, which decode to one BigInt64Array/BigUint64Array
+  ['x', 't'].forEach(function (type) {
+    var values = exact.filter(function (c) { return c[0] === type; })
+          .map(function (c) { return c[1]; }),
+        Typed = type === 'x' ? BigInt64Array : BigUint64Array;
+    [values, Typed.from(values)].forEach(function (value) {
+      var buffer = marshal('a' + type, value),
+          array = buffer && dbus.demarshal(buffer, dbus.NDBUS_DECODE_BIGINT).args[0];
+      if (!(array instanceof Typed) || array.join() !== values.join())
+        fail("'a" + type + "' came back as " + array + how);
+    });
+  });
+
+  refused.forEach(function (c) {
+    var before = errors;
+    if (marshal(c[0], c[1]) !== null || errors !== before + 1)
+      fail("'" + c[0] + "' " + c[1] + " was not refused" + how);
+  });
+
+  variants.forEach(function (c) {
+    var buffer = marshal('v', c[0]),
+        signature = buffer && variantSignature(buffer),
+        back = buffer && dbus.demarshal(buffer, dbus.NDBUS_DECODE_BIGINT).args[0];
+    if (signature !== c[1] || back !== c[0])
+      fail("Variant " + c[0] + " sent as '" + signature + "' came back as " +
+          back + how);
+  });
+});
+
+if (!failed)
+  console.log("[PASSED] " + exact.length + " 64-bit integers round-tripped as BigInt, " +
+      refused.length + " refused");
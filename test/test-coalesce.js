@@ -0,0 +1,78 @@
+#!/usr/bin/env node
+/*
+<copyright>
+Copyright (c) 2011, Motorola Mobility, Inc
+
+All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+</copyright>
+*/
+
+var dbus = require('../dbus');
+
+var total = 100,
+    calls = [],
+    i = 0;
+
+var dbusMsg = Object.create(dbus.DBusMessage, {
+  destination: {
+    value: dbus.DBUS_SERVICE_DBUS
+  },
+  path: {
+    value: dbus.DBUS_PATH_DBUS
+  },
+  iface: {
+    value: dbus.DBUS_INTERFACE_DBUS
+  },
+  bus: {
+    value: dbus.DBUS_BUS_SESSION
+  },
+  type: {
+    value: dbus.DBUS_MESSAGE_TYPE_METHOD_RETURN
+  }
+});
+
+dbusMsg.on ('error', function (error) {
+  console.log ("[FAILED] ERROR -- ");
+  console.log (error);
+});
+
+var getOwner = dbusMsg.prepare({member: 'GetNameOwner', signature: 's',
+                                coalesce: true, cacheTtl: 1000});
+
+//all but the first join the call in flight
+for (; i<total; i++) {
+  calls.push(getOwner.call(dbus.DBUS_SERVICE_DBUS));
+}
+
+Promise.all(calls).then(function (owners) {
+  var stats = getOwner.stats();
+  if (stats.misses === 1 && stats.coalesced === total - 1 &&
+      owners.every(function (owner) { return owner[0] === owners[0][0]; })) {
+    console.log ("[PASSED] " + total + " calls sent once :: " + JSON.stringify(stats));
+  } else {
+    console.log ("[FAILED] Calls not coalesced :: " + JSON.stringify(stats));
+  }
+  //answered from the cache now
+  return getOwner.call(dbus.DBUS_SERVICE_DBUS);
+}).then(function () {
+  var stats = getOwner.stats();
+  if (stats.hits === 1 && stats.misses === 1) {
+    console.log ("[PASSED] Reply cached :: " + JSON.stringify(stats));
+  } else {
+    console.log ("[FAILED] Reply not cached :: " + JSON.stringify(stats));
+  }
+  getOwner.release();
+  dbusMsg.closeConnection();
+}, function (error) {
+  console.log ("[FAILED] ERROR -- ");
+  console.log (error);
+  dbusMsg.closeConnection();
+});
@@ -0,0 +1,166 @@
+#!/usr/bin/env node
+/*
+<copyright>
+Copyright (c) 2011, Motorola Mobility, Inc
+
+All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+</copyright>
+*/
+
+var dbus = require('../dbus');
+
+//runs without a bus: messages are only marshalled and demarshalled
+var cases = [
+  ['s', 'hello'],
+  ['si', 'ünïcödé', -5],
+  ['ybnqiuxtd', 255, true, -32768, 65535, -1, 4294967295, -9007199254740991, 9007199254740991, 1.5],
+  ['as', ['a', '', 'c']],
+  ['ai', []],
+  ['aai', [[1, 2], [], [3]]],
+  ['a{sv}', {a: 1, b: 'two', c: [true, false], d: {e: 'f'}}],
+  ['a{ua{ss}}', {1: {x: 'y'}, 2: {}}],
+  ['ay', new Uint8Array([1, 2, 3])],
+  ['ad', new Float64Array([0.5, -2])],
+  ['a(iy)', {columns: [new Int32Array([1, -2]), new Uint8Array([3, 4])]}],
+  ['gos', 'a{sv}', '/org/ndbus/codec', 'tail'],
+  ['v', [1, 2, 3]],
+  ['iis', 1]
+];
+
+function message (codec, policy) {
+  return Object.create(dbus.DBusMessage, {
+    path: {
+      value: '/org/ndbus/codectest'
+    },
+    iface: {
+      value: 'org.ndbus.codectest'
+    },
+    member: {
+      value: 'TestingNDbusCodec'
+    },
+    type: {
+      value: dbus.DBUS_MESSAGE_TYPE_SIGNAL
+    },
+    codec: {
+      value: codec
+    },
+    variantPolicy: {
+      value: policy || dbus.NDBUS_VARIANT_POLICY_DEFAULT
+    }
+  });
+}
+
+function marshal (msg, args) {
+  msg.appendArgs.apply(msg, args);
+  return msg.marshal();
+}
+
+function decode (buffer, flags) {
+  try {
+    return JSON.stringify(dbus.demarshal(buffer, flags));
+  } catch (e) {
+    return 'throws';
+  }
+}
+
+var plain = message(false),
+    codec = message(true),
+    failed = 0,
+    i, j;
+
+plain.on('error', function (e) { console.log(e); });
+codec.on('error', function (e) { console.log(e); });
+
+//either way of encoding must decode the same, either way of decoding
+for (i = 0; i < cases.length; i++) {
+  var a = marshal(plain, cases[i]),
+      b = marshal(codec, cases[i]),
+      expected = decode(a, dbus.NDBUS_DECODE_DEFAULT);
+  if (decode(b, dbus.NDBUS_DECODE_DEFAULT) !== expected ||
+      decode(a, dbus.NDBUS_DECODE_CODEC) !== expected ||
+      decode(b, dbus.NDBUS_DECODE_CODEC) !== expected) {
+    console.log("[FAILED] Codec differs for '" + cases[i][0] + "'");
+    failed++;
+  }
+}
+if (!failed)
+  console.log("[PASSED] Codec matches the iterators for " + cases.length + " signatures");
+
+//mutated messages must either be refused by libdbus or decode the same
+var mutations = 20000,
+    refused = 0,
+    seed = 42;
+function random (n) {
+  seed = (seed * 1103515245 + 12345) & 0x7fffffff;
+  return seed % n;
+}
+for (i = 0; i < mutations; i++) {
+  var buffer = Buffer.from(marshal(plain, cases[random(cases.length)]));
+  for (j = random(4); j >= 0; j--)
+    buffer[random(buffer.length)] = random(256);
+  var iterated = decode(buffer, dbus.NDBUS_DECODE_DEFAULT);
+  if (iterated === 'throws')
+    refused++;
+  else if (decode(buffer, dbus.NDBUS_DECODE_CODEC) !== iterated) {
+    console.log("[FAILED] Codec differs for " + buffer.toString('hex'));
+    failed++;
+  }
+}
+console.log("[" + (failed ? "FAILED" : "PASSED") + "] Fuzzed " + mutations +
+    " messages, " + refused + " refused by libdbus");
+
+//more distinct variant signatures than the codec keeps programs for, all
+//in one message, so the cache is emptied while decoding and encoding them
+var level = [7, 3000000000, 1.5, 'x', true], variants = [];
+for (i = 0; i < 6; i++) {
+  variants = variants.concat(level);
+  level = level.reduce(function (wrapped, shape) {
+    return wrapped.concat([[shape], {k: shape}]);
+  }, []);
+}
+var simple = [message(false, dbus.NDBUS_VARIANT_POLICY_SIMPLE),
+              message(true, dbus.NDBUS_VARIANT_POLICY_SIMPLE)],
+    expected = JSON.stringify(variants);
+simple.forEach(function (msg) {
+  msg.on('error', function (e) { console.log(e); });
+  for (j = 0; j < 2; j++) {
+    var encoded = marshal(msg, ['av', variants]),
+        decoded = encoded && dbus.demarshal(encoded, dbus.NDBUS_DECODE_CODEC).args[0];
+    if (JSON.stringify(decoded) !== expected) {
+      console.log("[FAILED] " + variants.length + " variant signatures came back as " +
+          (decoded && decoded.length) + " values" + (msg.codec ? " by the codec" : ""));
+      failed++;
+    }
+  }
+});
+if (!failed)
+  console.log("[PASSED] " + variants.length + " variant signatures outlasted the cache");
+
+//rough timing of both paths on a large dictionary
+var big = {}, rounds = 200, start;
+for (i = 0; i < 1000; i++)
+  big['key' + i] = ['value' + i, i];
+var bigCase = ['a{sv}', big], encoded = marshal(plain, bigCase);
+
+[['iterators', plain, dbus.NDBUS_DECODE_DEFAULT],
+ ['codec', codec, dbus.NDBUS_DECODE_CODEC]].forEach(function (run) {
+  start = process.hrtime();
+  for (i = 0; i < rounds; i++)
+    marshal(run[1], bigCase);
+  var enc = process.hrtime(start);
+  start = process.hrtime();
+  for (i = 0; i < rounds; i++)
+    dbus.demarshal(encoded, run[2]);
+  var dec = process.hrtime(start);
+  console.log("[BENCH] " + run[0] + ": encode " +
+      ((enc[0] * 1e3 + enc[1] / 1e6) / rounds).toFixed(3) + " ms, decode " +
+      ((dec[0] * 1e3 + dec[1] / 1e6) / rounds).toFixed(3) + " ms");
+});
@@ -0,0 +1,159 @@
+#!/usr/bin/env node
+/*
+<copyright>
+Copyright (c) 2011, Motorola Mobility, Inc
+
+All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+</copyright>
+*/
+
+
+var dbus = require('../dbus');
+
+if (typeof BigUint64Array === 'undefined') {
+  console.log("[PASSED] Skipped, this node has no BigInt");
+  process.exit(0);
+}
+
+//runs without a bus: messages are only marshalled and demarshalled
+function message (codec) {
+  return Object.create(dbus.DBusMessage, {
+    path: {
+      value: '/org/ndbus/columntest'
+    },
+    iface: {
+      value: 'org.ndbus.columntest'
+    },
+    member: {
+      value: 'TestingNDbusColumns'
+    },
+    type: {
+      value: dbus.DBUS_MESSAGE_TYPE_SIGNAL
+    },
+    codec: {
+      value: codec
+    }
+  });
+}
+
+//structs whose members need padding between them and between rows, each
+//after a leading byte so the array itself starts unaligned
+var cases = [
+  ['a(yd)', [Uint8Array, Float64Array],
+   [[1, 2, 255], [0.5, -1e300, Math.PI]]],
+  ['a(qt)', [Uint16Array, BigUint64Array],
+   [[0, 65535, 7], [BigInt(0), BigInt('18446744073709551615'), BigInt(42)]]],
+  ['a(byi)', [Uint8Array, Uint8Array, Int32Array],
+   [[1, 0, 1], [9, 8, 7], [-2147483648, 0, 2147483647]]],
+  ['a(ndy)', [Int16Array, Float64Array, Uint8Array],
+   [[-32768, 1, 32767], [1.25, 0, -2.5], [3, 2, 1]]],
+  ['a(yx)', [Uint8Array, BigInt64Array],
+   [[1], [BigInt('-9223372036854775808')]]],
+  ['a(ud)', [Uint32Array, Float64Array], [[], []]]
+];
+
+function columns (c) {
+  return c[2].map(function (values, i) {
+    return c[1][i].from(values);
+  });
+}
+
+//the same array, row by row, as appendArgs() takes it without columns
+function rows (c) {
+  return c[2][0].map(function (v, row) {
+    return c[2].map(function (values) {
+      return values[row];
+    });
+  });
+}
+
+function same (column, values) {
+  if (column.length !== values.length)
+    return false;
+  for (var i = 0; i < values.length; i++) {
+    if (column[i] !== values[i])
+      return false;
+  }
+  return true;
+}
+
+function check (what, decoded, c, length) {
+  var ok = decoded && decoded.length === length &&
+      decoded.columns.length === c[1].length;
+  if (ok) {
+    decoded.columns.forEach(function (column, i) {
+      ok = ok && column instanceof c[1][i] &&
+        same(column, c[2][i].slice(0, length));
+    });
+  }
+  if (!ok) {
+    console.log("[FAILED] " + what + " '" + c[0] + "' :: " + decoded);
+    failed++;
+  }
+}
+
+//without the flag the columns decode as rows of Numbers and booleans
+function checkRows (what, decoded, c) {
+  var ok = Array.isArray(decoded) && decoded.length === c[2][0].length;
+  if (ok) {
+    decoded.forEach(function (row, r) {
+      ok = ok && row.length === c[1].length && row.every(function (v, i) {
+        return Number(v) === Number(c[2][i][r]);
+      });
+    });
+  }
+  if (!ok) {
+    console.log("[FAILED] " + what + " '" + c[0] + "' :: " +
+        JSON.stringify(decoded));
+    failed++;
+  }
+}
+
+var failed = 0;
+
+[false, true].forEach(function (codec) {
+  var msg = message(codec),
+      how = codec ? " by the codec" : "";
+  msg.on('error', function (e) {
+    console.log("[FAILED] ERROR -- ");
+    console.log(e);
+    failed++;
+  });
+
+  function roundTrip (signature, value, flags) {
+    msg.appendArgs('y' + signature + 'y', 9, value, 10);
+    var buffer = msg.marshal(),
+        args = buffer && dbus.demarshal(buffer, flags).args;
+    if (args && (args[0] !== 9 || args[2] !== 10)) {
+      console.log("[FAILED] Bytes around '" + signature + "' changed" + how);
+      failed++;
+    }
+    return args && args[1];
+  }
+
+  cases.forEach(function (c) {
+    var length = c[2][0].length;
+    check("Columns" + how, roundTrip(c[0], {columns: columns(c)},
+        dbus.NDBUS_DECODE_COLUMNAR), c, length);
+    check("Rows as columns" + how, roundTrip(c[0], rows(c),
+        dbus.NDBUS_DECODE_COLUMNAR), c, length);
+    if (length > 1) {
+      check("Shortened columns" + how, roundTrip(c[0],
+          {columns: columns(c), length: length - 1},
+          dbus.NDBUS_DECODE_COLUMNAR), c, length - 1);
+    }
+    checkRows("Columns as rows" + how, roundTrip(c[0], {columns: columns(c)},
+        dbus.NDBUS_DECODE_DEFAULT), c);
+  });
+});
+
+if (!failed)
+  console.log("[PASSED] " + cases.length + " struct arrays round-tripped as columns");
@@ -0,0 +1,76 @@
+#!/usr/bin/env node
+/*
+<copyright>
+Copyright (c) 2011, Motorola Mobility, Inc
+
+All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+</copyright>
+*/
+
+
+var dbus = require('../dbus');
+
+var dbusSignal = Object.create(dbus.DBusMessage, {
+  path: {
+    value: '/org/ndbus/connecttest'
+  },
+  iface: {
+    value: 'org.ndbus.connecttest'
+  },
+  member: {
+    value: 'Queued'
+  },
+  bus: {
+    value: dbus.DBUS_BUS_SESSION
+  },
+  type: {
+    value: dbus.DBUS_MESSAGE_TYPE_SIGNAL
+  }
+});
+
+dbusSignal.on('error', function (error) {
+  console.log('[FAILED] ERROR -- ');
+  console.log(error);
+});
+
+var received = 0;
+dbusSignal.on('signalReceipt', function (signal, text) {
+  console.log('[PASSED] Received queued signal :: ' + text);
+  if (++received === 2) {
+    dbusSignal.closeConnection();
+  }
+});
+
+var started = process.hrtime();
+dbusSignal.connect().then(function () {
+  var took = process.hrtime(started);
+  console.log('[PASSED] Connected in ' + (took[0] * 1e3 + took[1] / 1e6).toFixed(1) + ' ms');
+}, function (error) {
+  console.log('[FAILED] Could not connect -- ');
+  console.log(error);
+});
+
+//all of these wait for the connection instead of blocking on it
+dbusSignal.addMatch();
+dbusSignal.appendArgs('s', 'first');
+console.log('[PASSED] send() queued :: ' + dbusSignal.send());
+dbusSignal.appendArgs('s', 'second');
+dbusSignal.send();
+dbusSignal.clearArgs();
+
+var ticks = 0;
+var timer = setInterval(function () {
+  ticks++;
+}, 0);
+setTimeout(function () {
+  clearInterval(timer);
+  console.log('[PASSED] The loop went on ' + ticks + ' times meanwhile');
+}, 100);
@@ -0,0 +1,104 @@
+#!/usr/bin/env node
+/*
+<copyright>
+Copyright (c) 2011, Motorola Mobility, Inc
+
+All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+</copyright>
+*/
+
+
+var dbus = require('../dbus');
+
+//runs without a bus: messages are only marshalled and demarshalled.
+//Run with --expose-gc to have the messages collected before the check.
+function message (codec) {
+  return Object.create(dbus.DBusMessage, {
+    path: {
+      value: '/org/ndbus/externaltest'
+    },
+    iface: {
+      value: 'org.ndbus.externaltest'
+    },
+    member: {
+      value: 'TestingNDbusExternalStrings'
+    },
+    type: {
+      value: dbus.DBUS_MESSAGE_TYPE_SIGNAL
+    },
+    codec: {
+      value: codec
+    }
+  });
+}
+
+var MIN = 64 * 1024;
+
+//ASCII strings below, at and above NDBUS_EXTERNAL_STRING_MIN, which
+//differ at every position so that a stale or shifted copy shows
+function ascii (len, seed) {
+  var chars = new Array(len);
+  for (var i = 0; i < len; i++)
+    chars[i] = String.fromCharCode(32 + (i * 7 + seed) % 95);
+  return chars.join('');
+}
+
+var lengths = [MIN - 1, MIN, MIN + 1, 4 * MIN + 3],
+    failed = 0,
+    kept = [];
+
+[false, true].forEach(function (codec) {
+  var msg = message(codec),
+      how = codec ? " by the codec" : "";
+  msg.on('error', function (e) {
+    console.log("[FAILED] ERROR -- ");
+    console.log(e);
+    failed++;
+  });
+
+  lengths.forEach(function (len, seed) {
+    var strs = [ascii(len, seed), ascii(len, seed + 1), ascii(len - 1, seed) + 'é'];
+    msg.appendArgs('sasa{ss}', strs[0], [strs[1], strs[2]], {key: strs[0]});
+    //only the decoded values are kept, the buffer and message go now
+    var args = dbus.demarshal(msg.marshal(), dbus.NDBUS_DECODE_DEFAULT).args;
+    kept.push({
+      what: len + " chars" + how,
+      expected: [strs[0], strs[1], strs[2], strs[0]],
+      got: [args[0], args[1][0], args[1][1], args[2].key]
+    });
+  });
+});
+
+//churns the heap so the messages would be reused if nothing held them
+function churn () {
+  if (global.gc)
+    global.gc();
+  var garbage = [];
+  for (var i = 0; i < 64; i++)
+    garbage.push(Buffer.alloc(MIN, 0x80 + i % 64).toString('latin1'));
+  return garbage.length;
+}
+
+churn();
+setImmediate(function () {
+  churn();
+  kept.forEach(function (k) {
+    k.got.forEach(function (str, i) {
+      if (str !== k.expected[i]) {
+        console.log("[FAILED] String " + i + " of " + k.what + " changed after " +
+            "its message was freed");
+        failed++;
+      }
+    });
+  });
+  if (!failed)
+    console.log("[PASSED] " + kept.length * 4 + " large strings outlived their messages");
+});
@@ -0,0 +1,101 @@
+#!/usr/bin/env node
+/*
+<copyright>
+Copyright (c) 2011, Motorola Mobility, Inc
+
+All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+</copyright>
+*/
+
+var dbus = require('../dbus');
+
+var fs = require('fs');
+var dbus = require('../dbus');
+
+var payload = new Buffer(8 * 1024 * 1024);
+payload.fill(0x5a);
+
+var server = dbus.listen('unix:tmpdir=/tmp');
+
+server.on ('connection', function (peerAddress) {
+  var dbusFdSignal = Object.create(dbus.DBusMessage, {
+    path: {
+      value: '/org/ndbus/fdtest'
+    },
+    iface: {
+      value: 'org.ndbus.fdtest'
+    },
+    member: {
+      value: 'TestingNDbusMemfd'
+    },
+    bus: {
+      value: dbus.NDBUS_BUS_PEER
+    },
+    address: {
+      value: peerAddress
+    },
+    type: {
+      value: dbus.DBUS_MESSAGE_TYPE_SIGNAL
+    }
+  });
+
+  dbusFdSignal.on ('error', function (error) {
+    console.log ("[FAILED] ERROR -- ");
+    console.log (error);
+  });
+
+  //the payload never goes through the socket, only its descriptor does
+  var fd = dbus.bufferToMemfd(payload);
+  dbusFdSignal.appendArgs('uh', payload.length, fd);
+  dbusFdSignal.send();
+  fs.closeSync(fd);
+  server.close();
+});
+
+var dbusFdMonitor = Object.create(dbus.DBusMessage, {
+  path: {
+    value: '/org/ndbus/fdtest'
+  },
+  iface: {
+    value: 'org.ndbus.fdtest'
+  },
+  member: {
+    value: 'TestingNDbusMemfd'
+  },
+  bus: {
+    value: dbus.NDBUS_BUS_PEER
+  },
+  address: {
+    value: server.address
+  },
+  type: {
+    value: dbus.DBUS_MESSAGE_TYPE_SIGNAL
+  }
+});
+
+dbusFdMonitor.on ('signalReceipt', function (signal, length, fd) {
+  var received = dbus.memfdToBuffer(fd);
+  if (received.length === length && received.equals(payload)) {
+    console.log ("[PASSED] Received " + length + " bytes through a memfd");
+  } else {
+    console.log ("[FAILED] Payload mismatch, got " + received.length + " bytes");
+  }
+  dbusFdMonitor.removeMatch();
+  dbusFdMonitor.closeConnection();
+});
+
+dbusFdMonitor.on ('error', function (error) {
+  console.log ("[FAILED] ERROR -- ");
+  console.log (error);
+});
+
+dbus.connectPeer(server.address);
+dbusFdMonitor.addMatch();
@@ -0,0 +1,81 @@
+#!/usr/bin/env node
+/*
+<copyright>
+Copyright (c) 2011, Motorola Mobility, Inc
+
+All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+</copyright>
+*/
+
+
+var dbus = require('../dbus');
+
+var total = 50,
+    calls = [],
+    i = 0;
+
+var dbusMsg = Object.create(dbus.DBusMessage, {
+  destination: {
+    value: dbus.DBUS_SERVICE_DBUS
+  },
+  path: {
+    value: dbus.DBUS_PATH_DBUS
+  },
+  iface: {
+    value: dbus.DBUS_INTERFACE_DBUS
+  },
+  bus: {
+    value: dbus.DBUS_BUS_SESSION
+  },
+  type: {
+    value: dbus.DBUS_MESSAGE_TYPE_METHOD_RETURN
+  }
+});
+
+dbusMsg.on ('error', function (error) {
+  console.log ("[FAILED] ERROR -- ");
+  console.log (error);
+});
+
+dbusMsg.setMetrics({bytes: true});
+var getId = dbusMsg.prepare({member: 'GetId'});
+
+for (; i<total; i++) {
+  calls.push(getId.call());
+}
+
+Promise.all(calls).then(function () {
+  var metrics = dbusMsg.metrics(),
+      latency = metrics.latencies.filter(function (latency) {
+        return latency.member === 'GetId';
+      })[0];
+  if (latency && latency.count === total &&
+      latency.buckets[latency.buckets.length - 1][1] === total &&
+      latency.p50 <= latency.p99 && latency.p99 <= latency.max) {
+    console.log ("[PASSED] " + total + " calls timed :: p50 " + latency.p50 +
+                 "ms, p99 " + latency.p99 + "ms, max " + latency.max + "ms");
+  } else {
+    console.log ("[FAILED] Calls not timed :: " + JSON.stringify(latency));
+  }
+  if (metrics.messagesOut.methodCall >= total &&
+      metrics.messagesIn.methodReturn >= total &&
+      metrics.bytesOut.methodCall > 0 && metrics.pendingCalls === 0) {
+    console.log ("[PASSED] Messages counted :: " + JSON.stringify(metrics.messagesOut));
+  } else {
+    console.log ("[FAILED] Messages not counted :: " + JSON.stringify(metrics));
+  }
+  getId.release();
+  dbusMsg.closeConnection();
+}, function (error) {
+  console.log ("[FAILED] ERROR -- ");
+  console.log (error);
+  dbusMsg.closeConnection();
+});
@@ -0,0 +1,79 @@
+#!/usr/bin/env node
+/*
+<copyright>
+Copyright (c) 2011, Motorola Mobility, Inc
+
+All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+</copyright>
+*/
+
+
+var dbus = require('../dbus');
+
+var name = 'org.ndbus.ownertest',
+    rounds = 3;
+
+var dbusName = Object.create(dbus.DBusMessage, {
+  bus: {
+    value: dbus.DBUS_BUS_SESSION
+  }
+});
+
+dbusName.on ('error', function (error) {
+  console.log ("[FAILED] ERROR -- ");
+  console.log (error);
+});
+
+//the cache follows NameOwnerChanged, which may come after the reply
+function waitForOwner (owned, tries) {
+  return dbusName.getNameOwner(name).then(function (owner) {
+    if ((owner !== null) === owned) {
+      return owner;
+    }
+    if (tries === 0) {
+      throw {name: dbus.DBUS_ERROR_FAILED,
+             message: 'Owner still ' + owner + ' after NameOwnerChanged'};
+    }
+    return new Promise(function (resolve) {
+      setTimeout(resolve, 10);
+    }).then(function () {
+      return waitForOwner(owned, tries - 1);
+    });
+  });
+}
+
+function round (i) {
+  return dbusName.requestName(name, 0).then(function () {
+    return waitForOwner(true, 100);
+  }).then(function (owner) {
+    if (owner.charAt(0) !== ':') {
+      throw {name: dbus.DBUS_ERROR_FAILED, message: 'Not a unique name ' + owner};
+    }
+    console.log ("[PASSED] Round " + i + " owner tracked :: " + owner);
+    return dbusName.releaseName(name);
+  }).then(function () {
+    return waitForOwner(false, 100);
+  }).then(function () {
+    console.log ("[PASSED] Round " + i + " release tracked");
+    return i + 1 < rounds ? round(i + 1) : null;
+  });
+}
+
+waitForOwner(false, 0).then(function () {
+  console.log ("[PASSED] No owner before the request");
+  return round(0);
+}).then(function () {
+  dbusName.closeConnection();
+}, function (error) {
+  console.log ("[FAILED] ERROR -- ");
+  console.log (error);
+  dbusName.closeConnection();
+});
@@ -0,0 +1,59 @@
+#!/usr/bin/env node
+/*
+<copyright>
+Copyright (c) 2011, Motorola Mobility, Inc
+
+All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+</copyright>
+*/
+
+
+var dbus = require('../dbus');
+
+var dbusName = Object.create(dbus.DBusMessage, {
+  bus: {
+    value: dbus.DBUS_BUS_SESSION
+  }
+});
+
+var NAME = 'org.ndbus.rerequesttest',
+    //no such flag, which daemons such as dbus-broker refuse
+    BAD_FLAGS = 0x80;
+
+dbusName.requestName(NAME, dbus.DBUS_NAME_FLAG_DO_NOT_QUEUE)
+  .then(function (reply) {
+    if (reply !== dbus.DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER ||
+        !dbusName.hasName(NAME)) {
+      throw {name: dbus.DBUS_ERROR_FAILED, message: 'Name not acquired, reply ' + reply};
+    }
+    //asked for again, refused this time, while it is still ours
+    return dbusName.requestName(NAME, BAD_FLAGS).then(function (reply) {
+      console.log ("[PASSED] The daemon took the flags and replied :: " + reply +
+          ", owner :: " + dbusName.hasName(NAME));
+    }, function (error) {
+      console.log ("[" + (dbusName.hasName(NAME) ? "PASSED" : "FAILED") +
+          "] Owner after a failed request again :: " + dbusName.hasName(NAME) +
+          ", " + error.name);
+    });
+  })
+  .then(function () {
+    return dbusName.releaseName(NAME);
+  })
+  .then(function (reply) {
+    console.log ("[" + (reply === dbus.DBUS_RELEASE_NAME_REPLY_RELEASED ? "PASSED" : "FAILED") +
+        "] Still held until released :: " + reply);
+    dbusName.closeConnection();
+  })
+  .catch(function (error) {
+    console.log ("[FAILED] ERROR -- ");
+    console.log (error);
+    dbusName.closeConnection();
+  });
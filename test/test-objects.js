@@ -0,0 +1,49 @@
+#!/usr/bin/env node
+/*
+<copyright>
+Copyright (c) 2011, Motorola Mobility, Inc
+
+All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+</copyright>
+*/
+
+var dbus = require('../dbus');
+
+var dbusMsg = Object.create(dbus.DBusMessage, {
+  bus: {
+    value: dbus.DBUS_BUS_SYSTEM
+  }
+});
+
+dbusMsg.on ('error', function (error) {
+  console.log ("[FAILED] ERROR -- ");
+  console.log (error);
+});
+
+//any ObjectManager will do, e.g. test-objects.js org.bluez /, udisks by default
+var destination = process.argv[2] || 'org.freedesktop.UDisks2',
+    path = process.argv[3] || '/org/freedesktop/UDisks2';
+
+dbusMsg.mirrorObjects(destination, path).then(function (mirror) {
+  var paths = mirror.paths();
+  console.log ("[PASSED] Mirrored objects :: " + paths.length);
+  if (paths.length) {
+    console.log (mirror.get(paths[0]));
+    //the objects below the first one are a range of the sorted paths
+    console.log (mirror.paths(paths[0]));
+  }
+  mirror.release();
+  dbusMsg.closeConnection();
+}, function (error) {
+  console.log ("[FAILED] ERROR -- ");
+  console.log (error);
+  dbusMsg.closeConnection();
+});
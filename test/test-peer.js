@@ -0,0 +1,92 @@
+#!/usr/bin/env node
+/*
+<copyright>
+Copyright (c) 2011, Motorola Mobility, Inc
+
+All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+</copyright>
+*/
+
+var dbus = require('../dbus');
+
+var dbus = require('../dbus');
+
+var server = dbus.listen('unix:tmpdir=/tmp');
+
+server.on ('connection', function (peerAddress) {
+  var dbusPeerSignal = Object.create(dbus.DBusMessage, {
+    path: {
+      value: '/org/ndbus/peertest'
+    },
+    iface: {
+      value: 'org.ndbus.peertest'
+    },
+    member: {
+      value: 'TestingNDbusPeer'
+    },
+    bus: {
+      value: dbus.NDBUS_BUS_PEER
+    },
+    address: {
+      value: peerAddress
+    },
+    type: {
+      value: dbus.DBUS_MESSAGE_TYPE_SIGNAL
+    }
+  });
+
+  dbusPeerSignal.on ('error', function (error) {
+    console.log ("[FAILED] ERROR -- ");
+    console.log (error);
+  });
+
+  //tell the peer which connected that we are listening
+  dbusPeerSignal.appendArgs('s', 'Hello peer!');
+  dbusPeerSignal.send();
+  server.close();
+});
+
+var dbusPeerMonitor = Object.create(dbus.DBusMessage, {
+  path: {
+    value: '/org/ndbus/peertest'
+  },
+  iface: {
+    value: 'org.ndbus.peertest'
+  },
+  member: {
+    value: 'TestingNDbusPeer'
+  },
+  bus: {
+    value: dbus.NDBUS_BUS_PEER
+  },
+  address: {
+    value: server.address
+  },
+  type: {
+    value: dbus.DBUS_MESSAGE_TYPE_SIGNAL
+  }
+});
+
+dbusPeerMonitor.on ('signalReceipt', function () {
+  console.log ("[PASSED] Signal received from peer with data :: ");
+  console.log (arguments);
+  dbusPeerMonitor.removeMatch();
+  dbusPeerMonitor.closeConnection();
+});
+
+dbusPeerMonitor.on ('error', function (error) {
+  console.log ("[FAILED] ERROR -- ");
+  console.log (error);
+});
+
+//connect to the server without a bus daemon in between
+dbus.connectPeer(server.address);
+dbusPeerMonitor.addMatch();
@@ -0,0 +1,116 @@
+#!/usr/bin/env node
+/*
+<copyright>
+Copyright (c) 2011, Motorola Mobility, Inc
+
+All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+</copyright>
+*/
+
+
+var dbus = require('../dbus');
+
+var sent = [['first', 1], ['second', 2], ['third', -3]],
+    received = [];
+
+var dbusSignal = Object.create(dbus.DBusMessage, {
+  path: {
+    value: '/org/ndbus/preparetest'
+  },
+  iface: {
+    value: 'org.ndbus.preparetest'
+  },
+  member: {
+    value: 'Prepared'
+  },
+  bus: {
+    value: dbus.DBUS_BUS_SESSION
+  },
+  type: {
+    value: dbus.DBUS_MESSAGE_TYPE_SIGNAL
+  }
+});
+
+var dbusMsg = Object.create(dbus.DBusMessage, {
+  destination: {
+    value: dbus.DBUS_SERVICE_DBUS
+  },
+  path: {
+    value: dbus.DBUS_PATH_DBUS
+  },
+  iface: {
+    value: dbus.DBUS_INTERFACE_DBUS
+  },
+  bus: {
+    value: dbus.DBUS_BUS_SESSION
+  },
+  type: {
+    value: dbus.DBUS_MESSAGE_TYPE_METHOD_RETURN
+  }
+});
+
+function fail (error) {
+  console.log ("[FAILED] ERROR -- ");
+  console.log (error);
+}
+
+dbusSignal.on ('error', fail);
+dbusMsg.on ('error', fail);
+
+var emitter = dbusSignal.prepare({signature: 'si'}),
+    hasOwner = dbusMsg.prepare({member: 'NameHasOwner', signature: 's',
+                                replySignature: 'b'});
+
+//every emit goes out with its own arguments, not those of the last one
+dbusSignal.on ('signalReceipt', function (signal, text, number) {
+  received.push([text, number]);
+  if (received.length < sent.length) {
+    return;
+  }
+  if (JSON.stringify(received) === JSON.stringify(sent)) {
+    console.log ("[PASSED] Prepared signal rebound :: " + JSON.stringify(received));
+  } else {
+    console.log ("[FAILED] Prepared signal arguments :: " + JSON.stringify(received));
+  }
+  emitter.release();
+  dbusSignal.removeMatch();
+  calls();
+});
+dbusSignal.addMatch();
+sent.forEach(function (args) {
+  emitter.emit.apply(emitter, args);
+});
+
+function calls () {
+  Promise.all([
+    hasOwner.call(dbus.DBUS_SERVICE_DBUS),
+    hasOwner.call('org.ndbus.preparetest.nobody'),
+    hasOwner.call(dbus.DBUS_SERVICE_DBUS)
+  ]).then(function (replies) {
+    if (replies[0][0] === true && replies[1][0] === false && replies[2][0] === true) {
+      console.log ("[PASSED] Prepared call rebound :: " + JSON.stringify(replies));
+    } else {
+      console.log ("[FAILED] Prepared call replies :: " + JSON.stringify(replies));
+    }
+    //replySignature makes the arity exact
+    return hasOwner.call().then(function () {
+      console.log ("[FAILED] Call without its argument was sent");
+    }, function (error) {
+      console.log ("[PASSED] Call without its argument rejected :: " + error.message);
+    });
+  }).then(function () {
+    hasOwner.release();
+    dbusMsg.closeConnection();
+  }, function (error) {
+    fail(error);
+    dbusMsg.closeConnection();
+  });
+}
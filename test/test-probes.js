@@ -0,0 +1,83 @@
+#!/usr/bin/env node
+/*
+<copyright>
+Copyright (c) 2011, Motorola Mobility, Inc
+
+All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+</copyright>
+*/
+
+
+/*
+ * Builds the sources with and without the USDT probes, without linking,
+ * and checks that the probes are there only when they should be. Needs
+ * a C++ compiler, pkg-config and readelf, as node-gyp does.
+ */
+var childProcess = require('child_process'),
+    fs = require('fs'),
+    os = require('os'),
+    path = require('path');
+
+var src = path.join(__dirname, '..', 'src'),
+    cxx = process.env.CXX || 'c++',
+    out = path.join(os.tmpdir(), 'ndbus-probes-' + process.pid + '.o'),
+    flags = ['-std=gnu++1y', '-fPIC', '-O2', '-w',
+             '-I' + path.join(path.dirname(process.execPath), '..', 'include', 'node')];
+
+function run (command) {
+  return childProcess.execSync(command, {encoding: 'utf8', stdio: ['ignore', 'pipe', 'pipe']});
+}
+
+flags = flags.concat(run('pkg-config --cflags glib-2.0 dbus-1').trim().split(/\s+/));
+
+//the sdt header is found the same way ndbus.h looks for it
+var hasSdt = true;
+try {
+  run('echo "#include <sys/sdt.h>" | ' + cxx + ' -fsyntax-only -x c++ -');
+} catch (e) {
+  hasSdt = false;
+}
+
+var failed = 0;
+
+[['with the probes', []], ['with NDBUS_NO_PROBES', ['-DNDBUS_NO_PROBES']]]
+  .forEach(function (build) {
+    var probed = 0,
+        sources = fs.readdirSync(src).filter(function (file) {
+          return /\.cc$/.test(file);
+        });
+    sources.forEach(function (file) {
+      try {
+        run([cxx].concat(flags, build[1], ['-c', path.join(src, file), '-o', out])
+            .join(' '));
+        if (/stapsdt/.test(run('readelf --notes ' + out)))
+          probed++;
+      } catch (e) {
+        console.log("[FAILED] " + file + " does not build " + build[0] + " -- ");
+        console.log(e.stderr || e.message);
+        failed++;
+      }
+    });
+    //without the header the probes are left out as with NDBUS_NO_PROBES
+    var expected = hasSdt && !build[1].length;
+    if (expected ? probed === 0 : probed > 0) {
+      console.log("[FAILED] " + probed + " of " + sources.length + " sources have probes " +
+          build[0] + (hasSdt ? "" : ", without sys/sdt.h"));
+      failed++;
+    } else {
+      console.log("[PASSED] " + sources.length + " sources built " + build[0] +
+          (hasSdt ? "" : ", without sys/sdt.h") + ", " + probed + " with probes");
+    }
+  });
+
+try {
+  fs.unlinkSync(out);
+} catch (e) {}
@@ -0,0 +1,56 @@
+#!/usr/bin/env node
+/*
+<copyright>
+Copyright (c) 2011, Motorola Mobility, Inc
+
+All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+</copyright>
+*/
+
+var dbus = require('../dbus');
+
+var dbusMsg = Object.create(dbus.DBusMessage, {
+  bus: {
+    value: dbus.DBUS_BUS_SESSION
+  }
+});
+
+dbusMsg.on ('error', function (error) {
+  console.log ("[FAILED] ERROR -- ");
+  console.log (error);
+});
+
+function fail (error) {
+  console.log ("[FAILED] ERROR -- ");
+  console.log (error);
+  dbusMsg.closeConnection();
+}
+
+dbusMsg.proxy(dbus.DBUS_SERVICE_DBUS, dbus.DBUS_PATH_DBUS).then(function (bus) {
+  var iface = bus[dbus.DBUS_INTERFACE_DBUS];
+  console.log ("[PASSED] Introspected " +
+      Object.keys(bus.description.interfaces).join(', '));
+  return iface.GetNameOwner(dbus.DBUS_SERVICE_DBUS).then(function (owner) {
+    console.log ("[PASSED] GetNameOwner through the proxy replied with :: " + owner);
+    return iface.GetNameOwner();
+  }).then(function () {
+    throw "GetNameOwner accepted too few arguments";
+  }, function (error) {
+    console.log ("[PASSED] Arity checked :: " + error.message);
+    //the second proxy comes from the cache
+    return dbusMsg.proxy(dbus.DBUS_SERVICE_DBUS, dbus.DBUS_PATH_DBUS);
+  }).then(function (again) {
+    console.log ("[PASSED] Proxy again with " + again.description.nodes.length + " child nodes");
+    again.release();
+    bus.release();
+    dbusMsg.closeConnection();
+  });
+}).catch(fail);
@@ -0,0 +1,81 @@
+#!/usr/bin/env node
+/*
+<copyright>
+Copyright (c) 2011, Motorola Mobility, Inc
+
+All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+</copyright>
+*/
+
+
+var dbus = require('../dbus'),
+    spawn = require('child_process').spawn;
+
+//a bus of our own, which can be restarted under the client
+var address = 'unix:path=/tmp/ndbus-reconnect-' + process.pid,
+    daemon;
+
+function startDaemon() {
+  daemon = spawn('dbus-daemon', ['--session', '--nofork', '--address=' + address]);
+}
+
+startDaemon();
+
+var dbusMsg = Object.create(dbus.DBusMessage, {
+  bus: {
+    value: dbus.DBUS_BUS_SESSION
+  },
+  address: {
+    value: address
+  },
+  iface: {
+    value: 'org.ndbus.reconnect',
+    writable: true
+  },
+  member: {
+    value: 'Ping',
+    writable: true
+  }
+});
+
+dbusMsg.on('error', function (error) {
+  console.log('[FAILED] ERROR -- ');
+  console.log(error);
+});
+
+dbusMsg.on('nameLost', function (name) {
+  console.log('[PASSED] Lost name with the bus :: ' + name);
+});
+
+dbusMsg.on('reconnect', function (stats) {
+  console.log('[PASSED] Reconnected after ' + stats.lastAttempts + ' attempts and ' +
+      stats.lastDowntime.toFixed(1) + ' ms, restored ' + stats.lastMatches +
+      ' matches and ' + stats.lastNames + ' names in ' +
+      stats.lastRestoreTime.toFixed(3) + ' ms');
+  dbusMsg.once('nameAcquired', function (name) {
+    console.log('[PASSED] Acquired name again :: ' + name);
+    dbusMsg.closeConnection();
+    daemon.kill();
+  });
+});
+
+//let the daemon come up
+setTimeout(function () {
+  dbusMsg.setReconnect({minDelay: 50, maxDelay: 1000});
+  dbusMsg.addMatch();
+  dbusMsg.requestName('org.ndbus.reconnect', 0).then(function () {
+    console.log('[PASSED] Name acquired, restarting the bus');
+    daemon.kill();
+    daemon.on('exit', function () {
+      setTimeout(startDaemon, 300);
+    });
+  });
+}, 500);
@@ -0,0 +1,53 @@
+#!/usr/bin/env node
+/*
+<copyright>
+Copyright (c) 2011, Motorola Mobility, Inc
+
+All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+</copyright>
+*/
+
+var dbus = require('../dbus');
+
+var dbusName = Object.create(dbus.DBusMessage, {
+  bus: {
+    value: dbus.DBUS_BUS_SESSION
+  }
+});
+
+dbusName.on ("nameAcquired", function (name) {
+  console.log ("[PASSED] Acquired name :: " + name);
+});
+
+dbusName.on ("nameLost", function (name) {
+  console.log ("[PASSED] Lost name :: " + name);
+});
+
+dbusName.requestName('org.ndbus.nametest', dbus.DBUS_NAME_FLAG_ALLOW_REPLACEMENT)
+  .then(function (reply) {
+    if (reply !== dbus.DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER &&
+        reply !== dbus.DBUS_REQUEST_NAME_REPLY_IN_QUEUE) {
+      throw {name: dbus.DBUS_ERROR_FAILED, message: 'Unexpected reply ' + reply};
+    }
+    console.log ("[PASSED] RequestName replied with :: " + reply +
+        ", owner :: " + dbusName.hasName('org.ndbus.nametest'));
+    return dbusName.releaseName('org.ndbus.nametest');
+  })
+  .then(function (reply) {
+    console.log ("[PASSED] ReleaseName replied with :: " + reply +
+        ", owner :: " + dbusName.hasName('org.ndbus.nametest'));
+    dbusName.closeConnection();
+  })
+  .catch(function (error) {
+    console.log ("[FAILED] ERROR -- ");
+    console.log (error);
+    dbusName.closeConnection();
+  });
@@ -0,0 +1,153 @@
+#!/usr/bin/env node
+/*
+<copyright>
+Copyright (c) 2011, Motorola Mobility, Inc
+
+All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+</copyright>
+*/
+
+
+var dbus = require('../dbus');
+
+//runs without a bus: messages are only marshalled and demarshalled
+function message (codec) {
+  return Object.create(dbus.DBusMessage, {
+    path: {
+      value: '/org/ndbus/stringtest'
+    },
+    iface: {
+      value: 'org.ndbus.stringtest'
+    },
+    member: {
+      value: 'TestingNDbusStrings'
+    },
+    type: {
+      value: dbus.DBUS_MESSAGE_TYPE_SIGNAL
+    },
+    codec: {
+      value: codec
+    }
+  });
+}
+
+function repeat (text, count) {
+  return new Array(count + 1).join(text);
+}
+
+//strings around the 256 byte stack buffer, as ASCII, Latin-1 and
+//multi-byte UTF-8, whose UTF-8 length crosses it at different places
+var strings = [], i;
+for (i = 250; i <= 260; i++) {
+  strings.push(repeat('a', i));
+  strings.push(repeat('ÿ', i));
+  strings.push(repeat('a', i - 1) + 'é');
+  strings.push(repeat('a', i - 2) + '€');
+  strings.push(repeat('a', i - 2) + '😀');
+}
+strings.push('', repeat('€', 85), repeat('€', 86), repeat('x', 70000));
+
+//lone surrogates have no UTF-8 and are replaced, as V8 does
+var replaced = [
+  ['\ud800', '�'],
+  ['a\udc00b', 'a�b'],
+  [repeat('a', 255) + '\ud800', repeat('a', 255) + '�'],
+  [repeat('a', 300) + '\udfff' + 'z', repeat('a', 300) + '�' + 'z']
+];
+
+//[signature, value sent, flags, value expected back]
+var maps = [
+  ['a{sv}', new Map([['a', 1], ['b', 'two']]), dbus.NDBUS_DECODE_DEFAULT, {a: 1, b: 'two'}],
+  ['a{us}', new Map([[1, 'one'], [4000000000, 'big']]), dbus.NDBUS_DECODE_DICT_AS_MAP,
+   new Map([[1, 'one'], [4000000000, 'big']])],
+  ['a{ia{ss}}', new Map([[-1, new Map([['x', 'y']])]]), dbus.NDBUS_DECODE_DICT_AS_MAP,
+   new Map([[-1, new Map([['x', 'y']])]])],
+  ['a{sa{ss}}', new Map([['o', {p: 'q'}]]), dbus.NDBUS_DECODE_DEFAULT, {o: {p: 'q'}}],
+  ['a{ss}', new Map(), dbus.NDBUS_DECODE_DICT_AS_MAP, new Map()],
+  ['a{by}', new Map([[true, 1], [false, 0]]), dbus.NDBUS_DECODE_DICT_AS_MAP,
+   new Map([[true, 1], [false, 0]])]
+];
+
+//Maps do not stringify, so they are compared as their entries
+function plain (value) {
+  if (value instanceof Map) {
+    return {map: Array.from(value.entries()).map(plain)};
+  }
+  if (Array.isArray(value)) {
+    return value.map(plain);
+  }
+  if (value !== null && typeof value === 'object') {
+    var copy = {};
+    Object.keys(value).forEach(function (key) {
+      copy[key] = plain(value[key]);
+    });
+    return copy;
+  }
+  return value;
+}
+
+function same (a, b) {
+  return JSON.stringify(plain(a)) === JSON.stringify(plain(b));
+}
+
+var failed = 0;
+
+[false, true].forEach(function (codec) {
+  var msg = message(codec),
+      how = codec ? " by the codec" : "";
+  msg.on('error', function (e) {
+    console.log("[FAILED] ERROR -- ");
+    console.log(e);
+    failed++;
+  });
+
+  function roundTrip (signature, value, flags) {
+    msg.appendArgs(signature, value);
+    var buffer = msg.marshal();
+    return buffer ? dbus.demarshal(buffer, flags).args[0] : undefined;
+  }
+
+  strings.forEach(function (str) {
+    var back = roundTrip('s', str, dbus.NDBUS_DECODE_DEFAULT);
+    if (back !== str) {
+      console.log("[FAILED] String of " + str.length + " chars, ending " +
+          JSON.stringify(str.slice(-2)) + ", changed" + how);
+      failed++;
+    }
+  });
+  replaced.forEach(function (r) {
+    var back = roundTrip('s', r[0], dbus.NDBUS_DECODE_DEFAULT);
+    if (back !== r[1]) {
+      console.log("[FAILED] Lone surrogate not replaced" + how + " :: " +
+          JSON.stringify(back && back.slice(-3)));
+      failed++;
+    }
+  });
+  //the same strings as dict keys, which take the same path
+  var keys = {};
+  strings.slice(0, 20).forEach(function (str, i) { keys[str] = i; });
+  if (!same(roundTrip('a{si}', keys, dbus.NDBUS_DECODE_DEFAULT), keys)) {
+    console.log("[FAILED] Dict keys changed" + how);
+    failed++;
+  }
+  maps.forEach(function (m) {
+    var back = roundTrip(m[0], m[1], m[2]);
+    if (!same(back, m[3])) {
+      console.log("[FAILED] Map as '" + m[0] + "'" + how + " came back as " +
+          JSON.stringify(plain(back)));
+      failed++;
+    }
+  });
+});
+
+if (!failed)
+  console.log("[PASSED] " + strings.length + " strings, " + replaced.length +
+      " lone surrogates and " + maps.length + " Maps round-tripped");
@@ -0,0 +1,112 @@
+#!/usr/bin/env node
+/*
+<copyright>
+Copyright (c) 2011, Motorola Mobility, Inc
+
+All Rights Reserved.
+
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+  - Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+  - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+  - Neither the name of Motorola Mobility nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+</copyright>
+*/
+
+
+var dbus = require('../dbus');
+
+//runs without a bus: messages are only marshalled and demarshalled
+var DEFAULT = dbus.NDBUS_VARIANT_POLICY_DEFAULT,
+    SIMPLE = dbus.NDBUS_VARIANT_POLICY_SIMPLE;
+
+//[value, signature under the default policy, under the simple one]
+var cases = [
+  ['hello', 's', 's'],
+  [7, 'i', 'i'],
+  [-7, 'i', 'i'],
+  [3000000000, 'u', 'u'],
+  [1.5, 'd', 'd'],
+  [true, 'b', 'b'],
+  [[1, 2], 'av', 'ai'],
+  [[], 'av', 'as'],
+  [[[1], [2]], 'av', 'aai'],
+  [{a: 'x', b: 'y'}, 'a{sv}', 'a{ss}'],
+  [{}, 'a{sv}', 'a{ss}'],
+  [{a: {b: [1.5]}}, 'a{sv}', 'a{sa{sad}}'],
+  [new Map([['k', 1]]), 'a{sv}', 'a{si}']
+];
+
+function message (codec, policy) {
+  return Object.create(dbus.DBusMessage, {
+    path: {
+      value: '/org/ndbus/varianttest'
+    },
+    iface: {
+      value: 'org.ndbus.varianttest'
+    },
+    member: {
+      value: 'TestingNDbusVariant'
+    },
+    type: {
+      value: dbus.DBUS_MESSAGE_TYPE_SIGNAL
+    },
+    codec: {
+      value: codec
+    },
+    variantPolicy: {
+      value: policy
+    }
+  });
+}
+
+//the signature a lone variant was given, read off the start of the body
+function variantSignature (buffer) {
+  var fields = buffer[0] === 0x6c ? buffer.readUInt32LE(12) : buffer.readUInt32BE(12),
+      body = (16 + fields + 7) & ~7;
+  return buffer.toString('ascii', body + 1, body + 1 + buffer[body]);
+}
+
+var failed = 0;
+
+[false, true].forEach(function (codec) {
+  [[DEFAULT, 1], [SIMPLE, 2]].forEach(function (policy) {
+    var msg = message(codec, policy[0]);
+    msg.on('error', function (e) {
+      console.log("[FAILED] ERROR -- ");
+      console.log(e);
+      failed++;
+    });
+    cases.forEach(function (c) {
+      msg.appendArgs('v', c[0]);
+      var buffer = msg.marshal(),
+          signature = buffer && variantSignature(buffer),
+          decoded = buffer && dbus.demarshal(buffer).args[0];
+      if (signature !== c[policy[1]]) {
+        console.log("[FAILED] " + JSON.stringify(c[0]) + " inferred as '" +
+            signature + "' instead of '" + c[policy[1]] + "'" +
+            (codec ? " by the codec" : ""));
+        failed++;
+      } else if (!(c[0] instanceof Map) &&
+                 JSON.stringify(decoded) !== JSON.stringify(c[0])) {
+        console.log("[FAILED] " + JSON.stringify(c[0]) + " came back as " +
+            JSON.stringify(decoded));
+        failed++;
+      }
+    });
+  });
+});
+
+//a value with no D-Bus type is refused rather than guessed
+var msg = message(false, SIMPLE), refused = false;
+msg.on('error', function () { refused = true; });
+msg.appendArgs('v', Symbol('nothing'));
+if (msg.marshal() !== null || !refused) {
+  console.log("[FAILED] A symbol was given a variant signature");
+  failed++;
+}
+
+if (!failed)
+  console.log("[PASSED] Variant signatures inferred for " + cases.length + " values");